@@ -0,0 +1,374 @@
+/************************************************************************/
+/* ATBatchDialog                                                        */
+/*                                                                      */
+/* ZigBee Terminal - Remote AT Batch Dialog                             */
+/*                                                                      */
+/* ATBatchDialog.cpp                                                    */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ATBatchDialog.h"
+
+#include <ctype.h>
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+ATBatchDialog::ATBatchDialog()
+{
+        set_title("Remote AT Batch");
+        set_border_width(5);
+        set_default_size(640, 520);
+        
+        btnRun = add_button(Gtk::Stock::EXECUTE, Gtk::RESPONSE_APPLY);
+        btnRun->signal_clicked().connect( sigc::mem_fun(*this, &ATBatchDialog::on_run_click) );
+        btnStop = add_button(Gtk::Stock::STOP, Gtk::RESPONSE_CANCEL);
+        btnStop->signal_clicked().connect( sigc::mem_fun(*this, &ATBatchDialog::on_stop_click) );
+        btnStop->set_sensitive(false);
+        btnClose = add_button(Gtk::Stock::CLOSE, Gtk::RESPONSE_CLOSE);
+        btnClose->signal_clicked().connect( sigc::mem_fun(*this, &ATBatchDialog::on_close_click) );
+        set_default(*btnRun);
+        
+        get_vbox()->pack_start(vpane, true, true, 0);
+        
+        // batch setup
+        frame.set_label("Batch");
+        vpane.pack1(frame, false, false);
+        
+        table.resize(5, 4);
+        table.set_col_spacings(10);
+        table.set_row_spacings(5);
+        table.set_border_width(5);
+        frame.add(table);
+        
+        label1.set_label("Nodes (64-bit address[,16-bit address] per line):");
+        label1.set_alignment(0, 0.5);
+        table.attach(label1, 0, 4, 0, 1, Gtk::FILL, Gtk::FILL);
+        
+        tv_nodes.modify_font(Pango::FontDescription("monospace"));
+        tv_nodes.set_size_request(-1, 100);
+        sw_nodes.add(tv_nodes);
+        sw_nodes.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+        sw_nodes.set_shadow_type(Gtk::SHADOW_IN);
+        table.attach(sw_nodes, 0, 4, 1, 2);
+        
+        label2.set_label("Commands:");
+        table.attach(label2, 0, 1, 2, 3, Gtk::FILL, Gtk::FILL);
+        
+        txtCommands.set_text("NI; VR");
+        table.attach(txtCommands, 1, 4, 2, 3, Gtk::FILL | Gtk::EXPAND, Gtk::FILL);
+        
+        label3.set_label("In flight:");
+        table.attach(label3, 0, 1, 3, 4, Gtk::FILL, Gtk::FILL);
+        
+        spnInFlight.set_range(1, ZIGBEE_AT_BATCH_MAX_IN_FLIGHT);
+        spnInFlight.set_increments(1, 8);
+        spnInFlight.set_value(ZIGBEE_AT_BATCH_DEFAULT_IN_FLIGHT);
+        table.attach(spnInFlight, 1, 2, 3, 4, Gtk::FILL, Gtk::FILL);
+        
+        label4.set_label("Timeout (s):");
+        table.attach(label4, 2, 3, 3, 4, Gtk::FILL, Gtk::FILL);
+        
+        spnTimeout.set_range(1, 120);
+        spnTimeout.set_increments(1, 10);
+        spnTimeout.set_value(ZIGBEE_AT_BATCH_DEFAULT_TIMEOUT_MS / 1000);
+        table.attach(spnTimeout, 3, 4, 3, 4, Gtk::FILL, Gtk::FILL);
+        
+        label5.set_label("Retries:");
+        table.attach(label5, 0, 1, 4, 5, Gtk::FILL, Gtk::FILL);
+        
+        spnRetries.set_range(0, 10);
+        spnRetries.set_increments(1, 1);
+        spnRetries.set_value(ZIGBEE_AT_BATCH_DEFAULT_RETRIES);
+        table.attach(spnRetries, 1, 2, 4, 5, Gtk::FILL, Gtk::FILL);
+        
+        // results
+        vpane.pack2(vbox_results, true, false);
+        
+        tv_results_tm = Gtk::ListStore::create(cResultModel);
+        tv_results.set_model(tv_results_tm);
+        tv_results.append_column("Node", cResultModel.Node);
+        tv_results.append_column("Cmd", cResultModel.Command);
+        tv_results.append_column("Status", cResultModel.Status);
+        tv_results.append_column("Response", cResultModel.Response);
+        tv_results.append_column("Tries", cResultModel.Attempts);
+        tv_results.append_column("Latency", cResultModel.Latency);
+        
+        sw_results.add(tv_results);
+        sw_results.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+        vbox_results.pack_start(sw_results, true, true, 0);
+        
+        lblSummary.set_alignment(0, 0.5);
+        vbox_results.pack_start(lblSummary, false, false, 0);
+        
+        show_all_children();
+}
+
+ATBatchDialog::~ATBatchDialog()
+{
+        c_progress.disconnect();
+}
+
+void ATBatchDialog::set_interface(ZigBeeInterface &zb)
+{
+        batch = std::tr1::shared_ptr<ZigBeeATBatch>(new ZigBeeATBatch(zb));
+        batch->signal_result().connect( sigc::mem_fun(*this, &ATBatchDialog::on_result) );
+        batch->signal_finished().connect( sigc::mem_fun(*this, &ATBatchDialog::on_finished) );
+}
+
+void ATBatchDialog::on_response(int response_id)
+{
+        if (response_id == Gtk::RESPONSE_DELETE_EVENT)
+                hide();
+}
+
+void ATBatchDialog::on_run_click()
+{
+        int nodes, commands;
+        
+        if (!batch || batch->is_running())
+                return;
+        
+        batch->clear();
+        
+        nodes = parse_nodes();
+        commands = parse_commands();
+        
+        if (nodes <= 0 || commands <= 0)
+        {
+                lblSummary.set_label(nodes < 0 ? "Invalid node address" :
+                        commands < 0 ? "Invalid command" : "Nothing to do");
+                return;
+        }
+        
+        batch->set_max_in_flight(spnInFlight.get_value_as_int());
+        batch->set_timeout(spnTimeout.get_value_as_int() * 1000);
+        batch->set_retries(spnRetries.get_value_as_int());
+        
+        tv_results_tm->clear();
+        
+        if (!batch->start())
+                return;
+        
+        for (size_t i = 0; i < batch->get_results().size(); i++)
+        {
+                tv_results_tm->append();
+                update_row(i);
+        }
+        
+        btnRun->set_sensitive(false);
+        btnStop->set_sensitive(true);
+        
+        c_progress.disconnect();
+        c_progress = Glib::signal_timeout().connect( sigc::mem_fun(*this, &ATBatchDialog::on_progress_timeout), 500 );
+        
+        update_summary();
+}
+
+void ATBatchDialog::on_stop_click()
+{
+        if (batch)
+                batch->cancel();
+}
+
+void ATBatchDialog::on_close_click()
+{
+        hide();
+}
+
+void ATBatchDialog::on_result(int index)
+{
+        update_row(index);
+        update_summary();
+}
+
+void ATBatchDialog::on_finished(uint64_t elapsed)
+{
+        c_progress.disconnect();
+        
+        // cancelled entries are not reported one by one
+        for (size_t i = 0; i < batch->get_results().size(); i++)
+                update_row(i);
+        
+        btnRun->set_sensitive(true);
+        btnStop->set_sensitive(false);
+        
+        update_summary();
+}
+
+bool ATBatchDialog::on_progress_timeout()
+{
+        // rows in flight change attempts without finishing
+        for (size_t i = 0; i < batch->get_results().size(); i++)
+        {
+                if (batch->get_results()[i].state == ZigBeeATBatch::BS_InFlight)
+                        update_row(i);
+        }
+        
+        update_summary();
+        
+        return true;
+}
+
+void ATBatchDialog::update_row(int index)
+{
+        const ZigBeeATBatch::Result &r = batch->get_results()[index];
+        Gtk::TreeModel::Row row = tv_results_tm->children()[index];
+        std::stringstream node, resp, lat;
+        std::string status = ZigBeeATBatch::get_state_desc(r.state);
+        bool printable = r.data.size() > 0;
+        
+        node << std::setfill('0') << std::setw(16) << std::hex << r.addr64;
+        
+        if (r.state == ZigBeeATBatch::BS_Error)
+        {
+                std::stringstream ss;
+                ss << status << " (" << (int)r.status << ")";
+                status = ss.str();
+        }
+        
+        for (size_t i = 0; i < r.data.size(); i++)
+        {
+                resp << std::setfill('0') << std::setw(2) << std::hex << (int)r.data[i] << " ";
+                if (r.data[i] < 0x20 || r.data[i] > 0x7e)
+                        printable = false;
+        }
+        
+        // node identifiers and similar read back as text
+        if (printable)
+                resp << "\"" << std::string(r.data.begin(), r.data.end()) << "\"";
+        
+        if (r.latency)
+                lat << std::fixed << std::setprecision(1) << r.latency / 1000.0 << " ms";
+        
+        row[cResultModel.Node] = node.str();
+        row[cResultModel.Command] = r.cmd;
+        row[cResultModel.Status] = status;
+        row[cResultModel.Response] = resp.str();
+        row[cResultModel.Attempts] = r.attempts;
+        row[cResultModel.Latency] = lat.str();
+}
+
+void ATBatchDialog::update_summary()
+{
+        const std::vector<ZigBeeATBatch::Result> &results = batch->get_results();
+        std::stringstream ss;
+        int ok = 0, failed = 0;
+        
+        for (size_t i = 0; i < results.size(); i++)
+        {
+                if (results[i].state == ZigBeeATBatch::BS_OK)
+                        ok++;
+                else if (results[i].state == ZigBeeATBatch::BS_Error || results[i].state == ZigBeeATBatch::BS_Timeout)
+                        failed++;
+        }
+        
+        ss << batch->get_finished_count() << "/" << results.size() << " finished, "
+                << ok << " OK, " << failed << " failed, "
+                << std::fixed << std::setprecision(1) << batch->get_elapsed() / 1000000.0 << " s";
+        
+        if (!batch->is_running() && batch->get_finished_count() < (int)results.size())
+                ss << " (stopped)";
+        
+        lblSummary.set_label(ss.str());
+}
+
+int ATBatchDialog::parse_nodes()
+{
+        std::stringstream ss(tv_nodes.get_buffer()->get_text());
+        std::string line;
+        int count = 0;
+        
+        while (std::getline(ss, line))
+        {
+                size_t comma = line.find(',');
+                std::vector<uint8_t> a64, a16;
+                uint64_t addr64 = 0;
+                uint16_t addr16 = 0xfffe;
+                
+                if (line.find_first_not_of(" \t\r") == std::string::npos)
+                        continue;
+                
+                if (!ZigBeePacket::parse_hex_bytes(line.substr(0, comma), a64) || a64.size() != 8)
+                        return -1;
+                
+                for (int i = 0; i < 8; i++)
+                        addr64 = (addr64 << 8) | a64[i];
+                
+                if (comma != std::string::npos)
+                {
+                        if (!ZigBeePacket::parse_hex_bytes(line.substr(comma + 1), a16) || a16.size() != 2)
+                                return -1;
+                        addr16 = (a16[0] << 8) | a16[1];
+                }
+                
+                batch->add_node(addr64, addr16);
+                count++;
+        }
+        
+        return count;
+}
+
+int ATBatchDialog::parse_commands()
+{
+        std::string str = txtCommands.get_text();
+        int count = 0;
+        size_t start = 0;
+        
+        while (start < str.size())
+        {
+                size_t end = str.find(';', start);
+                if (end == std::string::npos)
+                        end = str.size();
+                
+                std::string cmd = str.substr(start, end - start);
+                std::vector<uint8_t> param;
+                size_t first = cmd.find_first_not_of(" \t");
+                
+                start = end + 1;
+                
+                if (first == std::string::npos)
+                        continue;
+                
+                cmd = cmd.substr(first);
+                
+                if (cmd.size() < 2 || !ZigBeePacket::parse_hex_bytes(cmd.substr(2), param))
+                        return -1;
+                
+                cmd[0] = toupper(cmd[0]);
+                cmd[1] = toupper(cmd[1]);
+                
+                batch->add_command(cmd.substr(0, 2), param);
+                count++;
+        }
+        
+        return count;
+}
+
@@ -0,0 +1,187 @@
+/************************************************************************/
+/* ATBatchDialog                                                        */
+/*                                                                      */
+/* ZigBee Terminal - Remote AT Batch Dialog                             */
+/*                                                                      */
+/* ATBatchDialog.h                                                      */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __ATBATCHDIALOG_H
+#define __ATBATCHDIALOG_H
+
+#include "ZigBeeInterface.h"
+#include "ZigBeeATBatch.h"
+
+#include <gtkmm.h>
+
+#include <tr1/memory>
+
+/** Remote AT Batch Dialog
+ * 
+ * Non-modal dialog for running AT commands on many nodes at once.  Nodes
+ * are entered one per line as a 64-bit address, optionally followed by
+ * a comma and the 16-bit address.  Commands are separated by semicolons;
+ * each is a two character command optionally followed by a hex
+ * parameter, e.g. "NI; D0 05; WR".
+ */
+class ATBatchDialog : public Gtk::Dialog
+{
+public:
+        /**
+         * Create a new Remote AT Batch dialog.
+         */
+        ATBatchDialog();
+        virtual ~ATBatchDialog();
+        
+        /**
+         * Set interface to run commands on.
+         * @param zb interface
+         */
+        void set_interface(ZigBeeInterface &zb);
+        
+protected:
+        //Signal handlers:
+        
+        /**
+         * Response signal handler.  Hides the dialog when the window is
+         * closed.
+         * @param response_id response ID
+         */
+        virtual void on_response(int response_id);
+        
+        /**
+         * Run button click signal handler
+         */
+        void on_run_click();
+        
+        /**
+         * Stop button click signal handler
+         */
+        void on_stop_click();
+        
+        /**
+         * Close button click signal handler
+         */
+        void on_close_click();
+        
+        /**
+         * Batch result handler
+         * @param index result index
+         */
+        void on_result(int index);
+        
+        /**
+         * Batch finished handler
+         * @param elapsed total time in microseconds
+         */
+        void on_finished(uint64_t elapsed);
+        
+        /**
+         * Progress timer handler
+         * @return true to keep timer running
+         */
+        bool on_progress_timeout();
+        
+        /**
+         * Fill in one result row.
+         * @param index result index
+         */
+        void update_row(int index);
+        
+        /**
+         * Update summary line.
+         */
+        void update_summary();
+        
+        /**
+         * Parse node list into the batch.
+         * @return number of nodes, -1 on error
+         */
+        int parse_nodes();
+        
+        /**
+         * Parse command list into the batch.
+         * @return number of commands, -1 on error
+         */
+        int parse_commands();
+        
+        // Tree model columns
+        class ResultModel : public Gtk::TreeModel::ColumnRecord
+        {
+        public:
+                ResultModel()
+                { add(Node); add(Command); add(Status); add(Response); add(Attempts); add(Latency); }
+                
+                Gtk::TreeModelColumn<Glib::ustring> Node;
+                Gtk::TreeModelColumn<Glib::ustring> Command;
+                Gtk::TreeModelColumn<Glib::ustring> Status;
+                Gtk::TreeModelColumn<Glib::ustring> Response;
+                Gtk::TreeModelColumn<int> Attempts;
+                Gtk::TreeModelColumn<Glib::ustring> Latency;
+        };
+        
+        ResultModel cResultModel;
+        
+        Glib::RefPtr<Gtk::ListStore> tv_results_tm;
+        
+        //Child widgets:
+        Gtk::Button *btnRun;
+        Gtk::Button *btnStop;
+        Gtk::Button *btnClose;
+        Gtk::VPaned vpane;
+        Gtk::Frame frame;
+        Gtk::Table table;
+        Gtk::Label label1;
+        Gtk::Label label2;
+        Gtk::Label label3;
+        Gtk::Label label4;
+        Gtk::Label label5;
+        Gtk::ScrolledWindow sw_nodes;
+        Gtk::TextView tv_nodes;
+        Gtk::Entry txtCommands;
+        Gtk::SpinButton spnInFlight;
+        Gtk::SpinButton spnTimeout;
+        Gtk::SpinButton spnRetries;
+        Gtk::VBox vbox_results;
+        Gtk::ScrolledWindow sw_results;
+        Gtk::TreeView tv_results;
+        Gtk::Label lblSummary;
+        
+        /**
+         * Progress timer connection.
+         */
+        sigc::connection c_progress;
+        
+        /**
+         * Batch runner.
+         */
+        std::tr1::shared_ptr<ZigBeeATBatch> batch;
+};
+
+#endif //__ATBATCHDIALOG_H
+
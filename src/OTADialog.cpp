@@ -0,0 +1,199 @@
+/************************************************************************/
+/* OTADialog                                                            */
+/*                                                                      */
+/* ZigBee Terminal - Firmware Update Dialog                             */
+/*                                                                      */
+/* OTADialog.cpp                                                        */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "OTADialog.h"
+
+#include <stdlib.h>
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+
+OTADialog::OTADialog() :
+        fcbImage("Select Firmware Image", Gtk::FILE_CHOOSER_ACTION_OPEN)
+{
+        set_title("Firmware Update");
+        set_border_width(5);
+        
+        btnStart = add_button(Gtk::Stock::EXECUTE, Gtk::RESPONSE_APPLY);
+        btnStart->signal_clicked().connect( sigc::mem_fun(*this, &OTADialog::on_start_click) );
+        btnStop = add_button(Gtk::Stock::STOP, Gtk::RESPONSE_CANCEL);
+        btnStop->signal_clicked().connect( sigc::mem_fun(*this, &OTADialog::on_stop_click) );
+        btnStop->set_sensitive(false);
+        btnClose = add_button(Gtk::Stock::CLOSE, Gtk::RESPONSE_CLOSE);
+        btnClose->signal_clicked().connect( sigc::mem_fun(*this, &OTADialog::on_close_click) );
+        set_default(*btnStart);
+        
+        frame.set_label("Transfer");
+        get_vbox()->pack_start(frame, true, true, 0);
+        
+        table.resize(4, 2);
+        table.set_col_spacings(10);
+        table.set_row_spacings(5);
+        table.set_border_width(5);
+        frame.add(table);
+        
+        label1.set_label("Image:");
+        table.attach(label1, 0, 1, 0, 1, Gtk::FILL, Gtk::FILL);
+        table.attach(fcbImage, 1, 2, 0, 1);
+        
+        label2.set_label("Target (64-bit):");
+        table.attach(label2, 0, 1, 1, 2, Gtk::FILL, Gtk::FILL);
+        txtTarget.set_width_chars(20);
+        table.attach(txtTarget, 1, 2, 1, 2);
+        
+        label3.set_label("Window (blocks):");
+        table.attach(label3, 0, 1, 2, 3, Gtk::FILL, Gtk::FILL);
+        spnWindow.set_range(1, ZIGBEE_OTA_MAX_WINDOW);
+        spnWindow.set_increments(1, 8);
+        spnWindow.set_value(ZIGBEE_OTA_DEFAULT_WINDOW);
+        table.attach(spnWindow, 1, 2, 2, 3);
+        
+        label4.set_label("Block size:");
+        table.attach(label4, 0, 1, 3, 4, Gtk::FILL, Gtk::FILL);
+        spnBlockSize.set_range(1, ZIGBEE_OTA_MAX_BLOCK_SIZE);
+        spnBlockSize.set_increments(1, 16);
+        spnBlockSize.set_value(ZIGBEE_OTA_DEFAULT_BLOCK_SIZE);
+        table.attach(spnBlockSize, 1, 2, 3, 4);
+        
+        get_vbox()->pack_start(progress, false, false, 5);
+        
+        lblStatus.set_alignment(0, 0.5);
+        get_vbox()->pack_start(lblStatus, false, false, 0);
+        
+        show_all_children();
+}
+
+OTADialog::~OTADialog()
+{
+        
+}
+
+void OTADialog::set_interface(ZigBeeInterface &zb)
+{
+        ota = std::tr1::shared_ptr<ZigBeeOTA>(new ZigBeeOTA(zb));
+        ota->signal_progress().connect( sigc::mem_fun(*this, &OTADialog::on_progress) );
+        ota->signal_complete().connect( sigc::mem_fun(*this, &OTADialog::on_complete) );
+}
+
+void OTADialog::on_response(int response_id)
+{
+        if (response_id == Gtk::RESPONSE_DELETE_EVENT)
+                hide();
+}
+
+void OTADialog::on_start_click()
+{
+        std::string target = txtTarget.get_text();
+        std::string filename = fcbImage.get_filename();
+        char *end;
+        uint64_t dest64;
+        
+        if (!ota || ota->is_running())
+                return;
+        
+        if (target.compare(0, 2, "0x") == 0)
+                target = target.substr(2);
+        
+        dest64 = strtoull(target.c_str(), &end, 16);
+        
+        if (target.size() == 0 || *end != 0)
+        {
+                lblStatus.set_label("Invalid target address");
+                return;
+        }
+        
+        if (filename.size() == 0)
+        {
+                lblStatus.set_label("No image selected");
+                return;
+        }
+        
+        ota->set_window(spnWindow.get_value_as_int());
+        ota->set_block_size(spnBlockSize.get_value_as_int());
+        
+        if (!ota->start(filename, dest64, 0xfffe))
+        {
+                lblStatus.set_label("Unable to read image");
+                return;
+        }
+        
+        btnStart->set_sensitive(false);
+        btnStop->set_sensitive(true);
+}
+
+void OTADialog::on_stop_click()
+{
+        if (ota)
+                ota->cancel();
+}
+
+void OTADialog::on_close_click()
+{
+        hide();
+}
+
+void OTADialog::on_progress(int acked, int total)
+{
+        progress.set_fraction(total ? (double)acked / total : 0);
+        update_status();
+}
+
+void OTADialog::on_complete(bool success, uint64_t elapsed)
+{
+        btnStart->set_sensitive(true);
+        btnStop->set_sensitive(false);
+        
+        update_status();
+        
+        lblStatus.set_label((success ? "Complete: " : "Failed: ") + lblStatus.get_label());
+}
+
+void OTADialog::update_status()
+{
+        std::stringstream ss;
+        double secs = ota->get_elapsed() / 1000000.0;
+        double bytes = (double)ota->get_acked_count() * ota->get_block_size();
+        
+        ss << ota->get_acked_count() << "/" << ota->get_block_count() << " blocks, "
+                << ota->get_retransmit_count() << " retransmitted, "
+                << std::fixed << std::setprecision(1) << secs << " s";
+        
+        if (secs > 0)
+                ss << ", " << std::setprecision(0) << bytes / secs << " B/s";
+        
+        lblStatus.set_label(ss.str());
+        progress.set_text(ss.str().substr(0, ss.str().find(',')));
+}
+
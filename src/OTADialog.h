@@ -0,0 +1,133 @@
+/************************************************************************/
+/* OTADialog                                                            */
+/*                                                                      */
+/* ZigBee Terminal - Firmware Update Dialog                             */
+/*                                                                      */
+/* OTADialog.h                                                          */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __OTADIALOG_H
+#define __OTADIALOG_H
+
+#include "ZigBeeInterface.h"
+#include "ZigBeeOTA.h"
+
+#include <gtkmm.h>
+
+#include <tr1/memory>
+
+/** Firmware Update Dialog
+ * 
+ * Non-modal dialog for sending a firmware image to a remote node with
+ * ZigBeeOTA.  Shows progress, retransmissions and throughput while the
+ * transfer runs.
+ */
+class OTADialog : public Gtk::Dialog
+{
+public:
+        /**
+         * Create a new Firmware Update dialog.
+         */
+        OTADialog();
+        virtual ~OTADialog();
+        
+        /**
+         * Set interface to send on.
+         * @param zb interface
+         */
+        void set_interface(ZigBeeInterface &zb);
+        
+protected:
+        //Signal handlers:
+        
+        /**
+         * Response signal handler.  Hides the dialog when the window is
+         * closed.
+         * @param response_id response ID
+         */
+        virtual void on_response(int response_id);
+        
+        /**
+         * Start button click signal handler
+         */
+        void on_start_click();
+        
+        /**
+         * Stop button click signal handler
+         */
+        void on_stop_click();
+        
+        /**
+         * Close button click signal handler
+         */
+        void on_close_click();
+        
+        /**
+         * Transfer progress handler
+         * @param acked blocks acknowledged
+         * @param total total blocks
+         */
+        void on_progress(int acked, int total);
+        
+        /**
+         * Transfer complete handler
+         * @param success true if the whole image was acknowledged
+         * @param elapsed transfer time in microseconds
+         */
+        void on_complete(bool success, uint64_t elapsed);
+        
+        /**
+         * Update status line.
+         */
+        void update_status();
+        
+        //Child widgets:
+        Gtk::Button *btnStart;
+        Gtk::Button *btnStop;
+        Gtk::Button *btnClose;
+        Gtk::Frame frame;
+        Gtk::Table table;
+        Gtk::Label label1;
+        Gtk::Label label2;
+        Gtk::Label label3;
+        Gtk::Label label4;
+        Gtk::FileChooserButton fcbImage;
+        Gtk::Entry txtTarget;
+        Gtk::SpinButton spnWindow;
+        Gtk::SpinButton spnBlockSize;
+        Gtk::ProgressBar progress;
+        Gtk::Label lblStatus;
+        
+        /**
+         * Transfer engine.
+         */
+        std::tr1::shared_ptr<ZigBeeOTA> ota;
+};
+
+#endif //__OTADIALOG_H
+
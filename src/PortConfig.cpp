@@ -55,7 +55,7 @@ PortConfig::PortConfig()
         
         get_vbox()->pack_start(frame, TRUE, TRUE, 0);
         
-        table.resize(4, 3);
+        table.resize(6, 3);
         table.set_col_spacings(10);
         table.set_row_spacings(5);
         table.set_border_width(5);
@@ -67,6 +67,8 @@ PortConfig::PortConfig()
         
         refresh_ports();
         
+        port_monitor.signal_changed().connect( sigc::mem_fun(*this, &PortConfig::on_ports_changed) );
+        
         table.attach(cmbtPort, 0, 1, 1, 2);
         
         label2.set_label("Speed:");
@@ -82,6 +84,9 @@ PortConfig::PortConfig()
         cmbtSpeed.append_text("38400");
         cmbtSpeed.append_text("57600");
         cmbtSpeed.append_text("115200");
+        cmbtSpeed.append_text("230400");
+        cmbtSpeed.append_text("460800");
+        cmbtSpeed.append_text("921600");
         
         cmbtSpeed.set_active(0);
         
@@ -131,12 +136,24 @@ PortConfig::PortConfig()
         
         table.attach(cmbtFlowControl, 2, 3, 3, 4);
         
+        label7.set_label("Latency:");
+        table.attach(label7, 0, 1, 4, 5);
+        
+        cmbtLatency.append_text("default");
+        cmbtLatency.append_text("low latency");
+        cmbtLatency.append_text("throughput");
+        
+        cmbtLatency.set_active(0);
+        
+        table.attach(cmbtLatency, 0, 1, 5, 6);
+        
         port = cmbtPort.get_active_text();
         baud = 115200;
         parity = SerialInterface::SP_None;
         bits = 8;
         stop_bits = 1;
         flow_control = SerialInterface::SF_None;
+        latency = SerialInterface::SL_Default;
         
         show_all_children();
 }
@@ -150,7 +167,7 @@ void PortConfig::refresh_ports()
 {
         int ind = -1;
         int i = 0;
-        std::vector<std::string> ports = SerialInterface::enumerate_ports();
+        std::vector<std::string> ports = port_monitor.get_ports();
         std::vector<std::string>::iterator it;
         
         Gtk::TreeModel::Row row;
@@ -188,6 +205,7 @@ void PortConfig::on_show()
         select_bits(bits);
         select_stop_bits(stop_bits);
         select_flow_control(flow_control);
+        select_latency(latency);
         
         Gtk::Dialog::on_show();
 }
@@ -195,7 +213,9 @@ void PortConfig::on_show()
 void PortConfig::on_ok_click()
 {
         port = cmbtPort.get_active_text();
-        baud = atol(cmbtSpeed.get_active_text().c_str());
+        // speed entry accepts any rate, not just the listed ones
+        if (atol(cmbtSpeed.get_entry()->get_text().c_str()) > 0)
+                baud = atol(cmbtSpeed.get_entry()->get_text().c_str());
         
         switch (cmbtParity.get_active_row_number())
         {
@@ -249,6 +269,19 @@ void PortConfig::on_ok_click()
                         break;
         }
         
+        switch (cmbtLatency.get_active_row_number())
+        {
+                case 0:
+                        latency = SerialInterface::SL_Default;
+                        break;
+                case 1:
+                        latency = SerialInterface::SL_LowLatency;
+                        break;
+                case 2:
+                        latency = SerialInterface::SL_Throughput;
+                        break;
+        }
+        
         hide();
 }
 
@@ -257,6 +290,20 @@ void PortConfig::on_cancel_click()
         hide();
 }
 
+void PortConfig::on_ports_changed()
+{
+        Glib::ustring p = cmbtPort.get_active_text();
+        
+        if (!get_visible())
+                return;
+        
+        refresh_ports();
+        
+        // keep the user's current choice if it is still there
+        if (p.length() > 0)
+                select_port(p);
+}
+
 void PortConfig::set_port(Glib::ustring p)
 {
         port = select_port(p);
@@ -287,6 +334,11 @@ void PortConfig::set_flow_control(SerialInterface::SerialFlow f)
         flow_control = select_flow_control(f);
 }
 
+void PortConfig::set_latency(SerialInterface::SerialLatency l)
+{
+        latency = select_latency(l);
+}
+
 Glib::ustring PortConfig::get_port()
 {
         return port;
@@ -317,6 +369,11 @@ SerialInterface::SerialFlow PortConfig::get_flow_control()
         return flow_control;
 }
 
+SerialInterface::SerialLatency PortConfig::get_latency()
+{
+        return latency;
+}
+
 Glib::ustring PortConfig::select_port(Glib::ustring p)
 {
         if (p.length() > 0)
@@ -331,7 +388,7 @@ unsigned long PortConfig::select_baud(unsigned long b)
 {
         if (b > 0)
         {
-                cmbtSpeed.set_active_text(Glib::ustring::format(b));
+                cmbtSpeed.get_entry()->set_text(Glib::ustring::format(b));
                 return b;
         }
         return baud;
@@ -409,5 +466,23 @@ SerialInterface::SerialFlow PortConfig::select_flow_control(SerialInterface::Ser
         return flow_control;
 }
 
+SerialInterface::SerialLatency PortConfig::select_latency(SerialInterface::SerialLatency l)
+{
+        switch (l)
+        {
+                case SerialInterface::SL_Default:
+                        cmbtLatency.set_active(0);
+                        return l;
+                case SerialInterface::SL_LowLatency:
+                        cmbtLatency.set_active(1);
+                        return l;
+                case SerialInterface::SL_Throughput:
+                        cmbtLatency.set_active(2);
+                        return l;
+        }
+        
+        return latency;
+}
+
 
 
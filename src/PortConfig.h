@@ -35,6 +35,7 @@
 #define __PORTCONFIG_H
 
 #include "SerialInterface.h"
+#include "PortMonitor.h"
 
 #include <string>
 
@@ -107,6 +108,18 @@ public:
          */
         SerialInterface::SerialFlow get_flow_control();
         
+        /**
+         * Set latency profile.
+         * @param l latency profile
+         */
+        void set_latency(SerialInterface::SerialLatency l);
+        
+        /**
+         * Get latency profile.
+         * @return latency profile
+         */
+        SerialInterface::SerialLatency get_latency();
+        
         /**
          * Set parity.
          * @param p parity
@@ -149,6 +162,11 @@ protected:
          */
         void on_cancel_click();
         
+        /**
+         * Port list changed signal handler
+         */
+        void on_ports_changed();
+        
         /**
          * Select port in combo box
          * @param p port
@@ -191,6 +209,18 @@ protected:
          */
         SerialInterface::SerialFlow select_flow_control(SerialInterface::SerialFlow f);
         
+        /**
+         * Select latency profile in combo box
+         * @param l latency profile
+         * @return latency profile
+         */
+        SerialInterface::SerialLatency select_latency(SerialInterface::SerialLatency l);
+        
+        
+        /**
+         * Cached port list.
+         */
+        PortMonitor port_monitor;
         
         //Child widgets:
         Gtk::Button *btnOK;
@@ -203,12 +233,14 @@ protected:
         Gtk::Label label4;
         Gtk::Label label5;
         Gtk::Label label6;
+        Gtk::Label label7;
         Gtk::ComboBoxText cmbtPort;
-        Gtk::ComboBoxText cmbtSpeed;
+        Gtk::ComboBoxEntryText cmbtSpeed;
         Gtk::ComboBoxText cmbtParity;
         Gtk::ComboBoxText cmbtBits;
         Gtk::ComboBoxText cmbtStopBits;
         Gtk::ComboBoxText cmbtFlowControl;
+        Gtk::ComboBoxText cmbtLatency;
         
         Glib::ustring port;
         unsigned long baud;
@@ -216,6 +248,7 @@ protected:
         int bits;
         int stop_bits;
         SerialInterface::SerialFlow flow_control;
+        SerialInterface::SerialLatency latency;
 };
 
 // Prototypes
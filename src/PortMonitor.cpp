@@ -0,0 +1,228 @@
+/************************************************************************/
+/* PortMonitor                                                          */
+/*                                                                      */
+/* ZigBee Terminal - Serial Port Monitor                                */
+/*                                                                      */
+/* PortMonitor.cpp                                                      */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "PortMonitor.h"
+#include "SerialInterface.h"
+
+#ifdef __linux__
+
+#include <sys/inotify.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#endif
+
+#include <iostream>
+#include <algorithm>
+
+#include "alphanum.h"
+
+PortMonitor::PortMonitor()
+{
+        valid = false;
+        inotify_fd = -1;
+        wd_dev = -1;
+        wd_by_id = -1;
+        
+        #ifdef __linux__
+        
+        inotify_fd = inotify_init();
+        
+        if (inotify_fd < 0)
+        {
+                std::cerr << "Error (" << errno << ") initializing inotify" << std::endl;
+                return;
+        }
+        
+        fcntl(inotify_fd, F_SETFL, O_NONBLOCK);
+        
+        // udev creates the node and then fixes up its permissions
+        wd_dev = inotify_add_watch(inotify_fd, "/dev", IN_CREATE | IN_DELETE | IN_ATTRIB);
+        
+        if (wd_dev < 0)
+        {
+                std::cerr << "Error (" << errno << ") watching /dev" << std::endl;
+                close(inotify_fd);
+                inotify_fd = -1;
+                return;
+        }
+        
+        watch_by_id();
+        
+        c_inotify = Glib::signal_io().connect( sigc::mem_fun(*this, &PortMonitor::on_inotify), inotify_fd, Glib::IO_IN );
+        
+        #endif
+}
+
+PortMonitor::~PortMonitor()
+{
+        c_inotify.disconnect();
+        
+        #ifdef __linux__
+        
+        if (inotify_fd >= 0)
+                close(inotify_fd);
+        
+        #endif
+}
+
+std::vector<std::string> PortMonitor::get_ports()
+{
+        std::vector<std::string> list;
+        
+        if (!valid || !is_watching())
+                rescan();
+        
+        list.assign(ports.begin(), ports.end());
+        
+        sort(list.begin(), list.end(), doj::alphanum_less<std::string>());
+        
+        return list;
+}
+
+void PortMonitor::rescan()
+{
+        std::vector<std::string> list = SerialInterface::enumerate_ports();
+        
+        ports.clear();
+        ports.insert(list.begin(), list.end());
+        
+        valid = true;
+}
+
+bool PortMonitor::is_watching()
+{
+        return inotify_fd >= 0;
+}
+
+sigc::signal<void> PortMonitor::signal_changed()
+{
+        return m_signal_changed;
+}
+
+void PortMonitor::watch_by_id()
+{
+        #ifdef __linux__
+        
+        if (inotify_fd < 0 || wd_by_id >= 0)
+                return;
+        
+        wd_by_id = inotify_add_watch(inotify_fd, "/dev/serial/by-id", IN_CREATE | IN_DELETE);
+        
+        #endif
+}
+
+bool PortMonitor::update_port(std::string dev)
+{
+        bool present = SerialInterface::probe_port(dev);
+        
+        if (present == (ports.count(dev) > 0))
+                return false;
+        
+        if (present)
+                ports.insert(dev);
+        else
+                ports.erase(dev);
+        
+        return true;
+}
+
+bool PortMonitor::on_inotify(Glib::IOCondition cond)
+{
+        #ifdef __linux__
+        
+        char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+        char path[PATH_MAX];
+        struct inotify_event *ev;
+        std::string name;
+        ssize_t len;
+        bool changed = false;
+        bool overflow = false;
+        
+        while ((len = read(inotify_fd, buf, sizeof(buf))) > 0)
+        {
+                for (char *ptr = buf; ptr < buf + len; ptr += sizeof(struct inotify_event) + ev->len)
+                {
+                        ev = (struct inotify_event *)ptr;
+                        name = ev->len > 0 ? ev->name : "";
+                        
+                        if (ev->mask & IN_Q_OVERFLOW)
+                        {
+                                overflow = true;
+                        }
+                        else if (ev->wd == wd_dev)
+                        {
+                                if (name == "serial")
+                                {
+                                        // by-id appears with the first USB adapter
+                                        watch_by_id();
+                                }
+                                else if (name.find("tty") == 0 && valid)
+                                {
+                                        changed |= update_port("/dev/" + name);
+                                }
+                        }
+                        else if (ev->wd == wd_by_id)
+                        {
+                                // the link target may be a node we have not
+                                // seen created yet
+                                name = "/dev/serial/by-id/" + name;
+                                if ((ev->mask & IN_CREATE) && valid && realpath(name.c_str(), path))
+                                        changed |= update_port(path);
+                        }
+                        
+                        if (ev->mask & IN_IGNORED)
+                        {
+                                if (ev->wd == wd_by_id)
+                                        wd_by_id = -1;
+                        }
+                }
+        }
+        
+        if (overflow && valid)
+        {
+                rescan();
+                changed = true;
+        }
+        
+        if (changed)
+                m_signal_changed.emit();
+        
+        #endif
+        
+        return true;
+}
+
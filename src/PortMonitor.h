@@ -0,0 +1,141 @@
+/************************************************************************/
+/* PortMonitor                                                          */
+/*                                                                      */
+/* ZigBee Terminal - Serial Port Monitor                                */
+/*                                                                      */
+/* PortMonitor.h                                                        */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __PORTMONITOR_H
+#define __PORTMONITOR_H
+
+#include <gtkmm.h>
+
+#include <string>
+#include <vector>
+#include <set>
+
+/** Port Monitor
+ * 
+ * Keeps a cached list of available serial ports.  On Linux the list is
+ * built once from sysfs and then updated incrementally from inotify events
+ * on /dev and /dev/serial/by-id as adapters are plugged and unplugged.
+ * Where inotify is not available the list is rescanned on every request.
+ */
+class PortMonitor : public sigc::trackable
+{
+public:
+        /**
+         * Create a Port Monitor.
+         */
+        PortMonitor();
+        virtual ~PortMonitor();
+        
+        /**
+         * Get available ports.
+         * @return sorted list of ports
+         */
+        std::vector<std::string> get_ports();
+        
+        /**
+         * Discard the cache and rescan all ports.
+         */
+        void rescan();
+        
+        /**
+         * Check if the list is kept current by hotplug events.
+         * @return true if watching for changes
+         */
+        bool is_watching();
+        
+        /**
+         * Changed signal.  Emitted from the main loop when a port appears
+         * or disappears.
+         * @par Prototype:
+         * <tt>void on_my_%changed()</tt>
+         */
+        sigc::signal<void> signal_changed();
+        
+protected:
+        /**
+         * inotify event handler.
+         * @param cond IO condition
+         * @return true to keep watching
+         */
+        bool on_inotify(Glib::IOCondition cond);
+        
+        /**
+         * Start watching /dev/serial/by-id if it exists.
+         */
+        void watch_by_id();
+        
+        /**
+         * Re-check a single device node.
+         * @param dev device path
+         * @return true if the port list changed
+         */
+        bool update_port(std::string dev);
+        
+        /**
+         * Cached port list.
+         */
+        std::set<std::string> ports;
+        
+        /**
+         * Cache valid.
+         */
+        bool valid;
+        
+        /**
+         * inotify file descriptor, -1 if not watching.
+         */
+        int inotify_fd;
+        
+        /**
+         * Watch descriptor for /dev.
+         */
+        int wd_dev;
+        
+        /**
+         * Watch descriptor for /dev/serial/by-id, -1 if not present.
+         */
+        int wd_by_id;
+        
+        /**
+         * inotify IO watch connection.
+         */
+        sigc::connection c_inotify;
+        
+        /**
+         * Changed signal.
+         */
+        sigc::signal<void> m_signal_changed;
+};
+
+#endif //__PORTMONITOR_H
+
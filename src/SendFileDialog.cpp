@@ -0,0 +1,206 @@
+/************************************************************************/
+/* SendFileDialog                                                       */
+/*                                                                      */
+/* ZigBee Terminal - Send File Dialog                                   */
+/*                                                                      */
+/* SendFileDialog.cpp                                                   */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "SendFileDialog.h"
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+
+SendFileDialog::SendFileDialog() :
+        fcbFile("Select File", Gtk::FILE_CHOOSER_ACTION_OPEN)
+{
+        set_title("Send File");
+        set_border_width(5);
+        
+        btnStart = add_button(Gtk::Stock::EXECUTE, Gtk::RESPONSE_APPLY);
+        btnStart->signal_clicked().connect( sigc::mem_fun(*this, &SendFileDialog::on_start_click) );
+        btnStop = add_button(Gtk::Stock::STOP, Gtk::RESPONSE_CANCEL);
+        btnStop->signal_clicked().connect( sigc::mem_fun(*this, &SendFileDialog::on_stop_click) );
+        btnStop->set_sensitive(false);
+        btnClose = add_button(Gtk::Stock::CLOSE, Gtk::RESPONSE_CLOSE);
+        btnClose->signal_clicked().connect( sigc::mem_fun(*this, &SendFileDialog::on_close_click) );
+        set_default(*btnStart);
+        
+        frame.set_label("Transfer");
+        get_vbox()->pack_start(frame, true, true, 0);
+        
+        table.resize(3, 2);
+        table.set_col_spacings(10);
+        table.set_row_spacings(5);
+        table.set_border_width(5);
+        frame.add(table);
+        
+        label1.set_label("File:");
+        table.attach(label1, 0, 1, 0, 1, Gtk::FILL, Gtk::FILL);
+        table.attach(fcbFile, 1, 2, 0, 1);
+        
+        label2.set_label("Chunk size (NP):");
+        table.attach(label2, 0, 1, 1, 2, Gtk::FILL, Gtk::FILL);
+        spnChunkSize.set_range(1, ZIGBEE_STREAMER_MAX_CHUNK);
+        spnChunkSize.set_increments(1, 16);
+        spnChunkSize.set_value(ZIGBEE_STREAMER_DEFAULT_CHUNK);
+        table.attach(spnChunkSize, 1, 2, 1, 2);
+        
+        label3.set_label("Packetization timeout (RO):");
+        table.attach(label3, 0, 1, 2, 3, Gtk::FILL, Gtk::FILL);
+        spnTimeout.set_range(0, ZIGBEE_STREAMER_MAX_RO);
+        spnTimeout.set_increments(1, 10);
+        spnTimeout.set_value(ZIGBEE_STREAMER_DEFAULT_RO);
+        table.attach(spnTimeout, 1, 2, 2, 3);
+        
+        get_vbox()->pack_start(progress, false, false, 5);
+        
+        lblStatus.set_alignment(0, 0.5);
+        get_vbox()->pack_start(lblStatus, false, false, 0);
+        
+        show_all_children();
+}
+
+SendFileDialog::~SendFileDialog()
+{
+        
+}
+
+void SendFileDialog::set_interface(std::tr1::shared_ptr<SerialInterface> si)
+{
+        ser_int = si;
+        streamer = std::tr1::shared_ptr<ZigBeeStreamer>(new ZigBeeStreamer(si));
+        streamer->signal_progress().connect( sigc::mem_fun(*this, &SendFileDialog::on_progress) );
+        streamer->signal_complete().connect( sigc::mem_fun(*this, &SendFileDialog::on_complete) );
+        streamer->signal_send_data().connect( m_signal_send_data.make_slot() );
+}
+
+bool SendFileDialog::send_text(Glib::ustring text)
+{
+        if (!streamer || streamer->is_running() || !ser_int->is_open())
+                return false;
+        
+        prepare();
+        
+        streamer->send_data(text.data(), text.bytes());
+        
+        return true;
+}
+
+sigc::signal<void, const char*, size_t> SendFileDialog::signal_send_data()
+{
+        return m_signal_send_data;
+}
+
+void SendFileDialog::on_response(int response_id)
+{
+        if (response_id == Gtk::RESPONSE_DELETE_EVENT)
+                hide();
+}
+
+void SendFileDialog::on_start_click()
+{
+        std::string filename = fcbFile.get_filename();
+        
+        if (!streamer || streamer->is_running())
+                return;
+        
+        if (!ser_int->is_open())
+        {
+                lblStatus.set_label("Port not open");
+                return;
+        }
+        
+        if (filename.size() == 0)
+        {
+                lblStatus.set_label("No file selected");
+                return;
+        }
+        
+        prepare();
+        
+        if (!streamer->send_file(filename))
+        {
+                btnStart->set_sensitive(true);
+                btnStop->set_sensitive(false);
+                lblStatus.set_label("Unable to read file");
+        }
+}
+
+void SendFileDialog::on_stop_click()
+{
+        if (streamer)
+                streamer->cancel();
+}
+
+void SendFileDialog::on_close_click()
+{
+        hide();
+}
+
+void SendFileDialog::on_progress(size_t sent, size_t total)
+{
+        progress.set_fraction(total ? (double)sent / total : 0);
+        update_status();
+}
+
+void SendFileDialog::on_complete(bool success, uint64_t elapsed)
+{
+        btnStart->set_sensitive(true);
+        btnStop->set_sensitive(false);
+        
+        update_status();
+        
+        lblStatus.set_label((success ? "Complete: " : "Stopped: ") + lblStatus.get_label());
+}
+
+void SendFileDialog::prepare()
+{
+        streamer->set_chunk_size(spnChunkSize.get_value_as_int());
+        streamer->set_packet_timeout(spnTimeout.get_value_as_int());
+        
+        btnStart->set_sensitive(false);
+        btnStop->set_sensitive(true);
+}
+
+void SendFileDialog::update_status()
+{
+        std::stringstream ss;
+        double secs = streamer->get_elapsed() / 1000000.0;
+        
+        ss << streamer->get_sent() << "/" << streamer->get_total() << " bytes, "
+                << std::fixed << std::setprecision(1) << secs << " s";
+        
+        if (secs > 0)
+                ss << ", " << std::setprecision(0) << streamer->get_sent() / secs << " B/s";
+        
+        lblStatus.set_label(ss.str());
+        progress.set_text(ss.str().substr(0, ss.str().find(',')));
+}
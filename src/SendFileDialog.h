@@ -0,0 +1,160 @@
+/************************************************************************/
+/* SendFileDialog                                                       */
+/*                                                                      */
+/* ZigBee Terminal - Send File Dialog                                   */
+/*                                                                      */
+/* SendFileDialog.h                                                     */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __SENDFILEDIALOG_H
+#define __SENDFILEDIALOG_H
+
+#include "SerialInterface.h"
+#include "ZigBeeStreamer.h"
+
+#include <gtkmm.h>
+
+#include <tr1/memory>
+
+/** Send File Dialog
+ * 
+ * Non-modal dialog for streaming a file, or a large paste, to a module
+ * in transparent mode with ZigBeeStreamer.  Shows progress and rate
+ * while the transfer runs.
+ */
+class SendFileDialog : public Gtk::Dialog
+{
+public:
+        /**
+         * Create a new Send File dialog.
+         */
+        SendFileDialog();
+        virtual ~SendFileDialog();
+        
+        /**
+         * Set serial interface to send on.
+         * @param si serial interface
+         */
+        void set_interface(std::tr1::shared_ptr<SerialInterface> si);
+        
+        /**
+         * Send pasted text with the current pacing settings.
+         * @param text text
+         * @return false if a transfer is already running
+         */
+        bool send_text(Glib::ustring text);
+        
+        /**
+         * Send data signal, for local echo.
+         * @par Prototype:
+         * <tt>void on_my_%send_data(const char *data, size_t n)</tt>
+         * @see ZigBeeStreamer::signal_send_data()
+         */
+        sigc::signal<void, const char*, size_t> signal_send_data();
+        
+protected:
+        //Signal handlers:
+        
+        /**
+         * Response signal handler.  Hides the dialog when the window is
+         * closed.
+         * @param response_id response ID
+         */
+        virtual void on_response(int response_id);
+        
+        /**
+         * Start button click signal handler
+         */
+        void on_start_click();
+        
+        /**
+         * Stop button click signal handler
+         */
+        void on_stop_click();
+        
+        /**
+         * Close button click signal handler
+         */
+        void on_close_click();
+        
+        /**
+         * Transfer progress handler
+         * @param sent bytes written
+         * @param total total bytes
+         */
+        void on_progress(size_t sent, size_t total);
+        
+        /**
+         * Transfer complete handler
+         * @param success true if everything was written
+         * @param elapsed transfer time in microseconds
+         */
+        void on_complete(bool success, uint64_t elapsed);
+        
+        /**
+         * Apply pacing settings and update buttons for a new transfer.
+         */
+        void prepare();
+        
+        /**
+         * Update status line.
+         */
+        void update_status();
+        
+        //Child widgets:
+        Gtk::Button *btnStart;
+        Gtk::Button *btnStop;
+        Gtk::Button *btnClose;
+        Gtk::Frame frame;
+        Gtk::Table table;
+        Gtk::Label label1;
+        Gtk::Label label2;
+        Gtk::Label label3;
+        Gtk::FileChooserButton fcbFile;
+        Gtk::SpinButton spnChunkSize;
+        Gtk::SpinButton spnTimeout;
+        Gtk::ProgressBar progress;
+        Gtk::Label lblStatus;
+        
+        /**
+         * Serial interface.
+         */
+        std::tr1::shared_ptr<SerialInterface> ser_int;
+        
+        /**
+         * Transfer engine.
+         */
+        std::tr1::shared_ptr<ZigBeeStreamer> streamer;
+        
+        /**
+         * Send data signal.
+         */
+        sigc::signal<void, const char*, size_t> m_signal_send_data;
+};
+
+#endif //__SENDFILEDIALOG_H
@@ -39,12 +39,38 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
 #include <linux/serial.h>
+#include <time.h>
+
+#ifdef TCGETS2
+
+// struct termios2 lives in asm/termbits.h, which conflicts with termios.h
+struct termios2
+{
+        tcflag_t c_iflag;
+        tcflag_t c_oflag;
+        tcflag_t c_cflag;
+        tcflag_t c_lflag;
+        cc_t c_line;
+        cc_t c_cc[19];
+        speed_t c_ispeed;
+        speed_t c_ospeed;
+};
+
+#ifndef BOTHER
+#define BOTHER 0010000
+#endif
+
+#endif
 
 #endif
 
 #include <iostream>
 #include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <string.h>
 
 #include "alphanum.h"
 
@@ -56,51 +82,25 @@ std::vector<std::string> SerialInterface::enumerate_ports()
         
         DIR *dp;
         struct dirent *dirp;
-        std::string f, d;
-        std::vector<std::string>::iterator it;
+        std::string f;
         char buf[PATH_MAX];
         
-        struct serial_struct serinfo;
-        int fd;
-        
-        if ((dp = opendir("/dev/")) == NULL)
+        // /sys/class/tty lists every tty the kernel knows about; check the
+        // metadata there instead of opening each device node
+        if ((dp = opendir("/sys/class/tty/")) == NULL)
         {
-                std::cerr << "Error (" << errno << ") opening /dev/" << std::endl;
+                std::cerr << "Error (" << errno << ") opening /sys/class/tty/" << std::endl;
         }
         else
         {
                 while ((dirp = readdir(dp)) != NULL)
                 {
                         f = dirp->d_name;
-                        d = "/dev/" + f;
-                        if (f.find("ttyS") == 0)
-                        {
-                                if ((fd = ::open(d.c_str(), O_RDWR|O_NONBLOCK)) < 0)
-                                {
-                                        std::cerr << "Cannot open port " << d << std::endl;
-                                        continue;
-                                }
-                                
-                                serinfo.reserved_char[0] = 0;
-                                
-                                if (::ioctl(fd, TIOCGSERIAL, &serinfo) < 0)
-                                {
-                                        std::cerr << "Cannot get serial info for " << d << std::endl;
-                                        ::close(fd);
-                                        continue;
-                                }
-                                
-                                if (serinfo.port != 0)
-                                        SerialDeviceList.push_back(d);
-                                
-                                ::close(fd);
-                                
+                        if (f == "." || f == "..")
                                 continue;
-                        }
-                        if (f.find("ttyUSB") == 0)
-                        {
-                                SerialDeviceList.push_back(d);
-                        }
+                        f = "/dev/" + f;
+                        if (probe_port(f))
+                                SerialDeviceList.push_back(f);
                 }
                 
                 closedir(dp);
@@ -114,7 +114,7 @@ std::vector<std::string> SerialInterface::enumerate_ports()
                         if (f == "." || f == "..")
                                 continue;
                         f = "/dev/serial/by-id/" + f;
-                        if (realpath(f.c_str(), buf));
+                        if (realpath(f.c_str(), buf))
                         {
                                 f = buf;
                                 SerialDeviceList.push_back(f);
@@ -158,11 +158,74 @@ std::vector<std::string> SerialInterface::enumerate_ports()
         return SerialDeviceList;
 }
 
+bool SerialInterface::probe_port(std::string dev)
+{
+        #ifdef __unix__
+        
+        std::string name, path, type;
+        struct stat st;
+        
+        name = dev.substr(dev.rfind('/') + 1);
+        
+        if (name.find("tty") != 0)
+                return false;
+        
+        path = "/sys/class/tty/" + name;
+        
+        // virtual terminals and ptys have no backing device
+        if (stat((path + "/device").c_str(), &st) != 0)
+                return false;
+        
+        // UART drivers register placeholder ports; type is 0 (PORT_UNKNOWN)
+        // when no hardware was detected
+        std::ifstream in((path + "/type").c_str());
+        
+        if (in >> type && type == "0")
+                return false;
+        
+        return stat(dev.c_str(), &st) == 0;
+        
+        #elif defined _WIN32
+        
+        return dev.find("COM") == 0;
+        
+        #endif
+}
+
+uint64_t SerialInterface::get_timestamp()
+{
+        #ifdef __unix__
+        
+        struct timespec ts;
+        
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        
+        return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+        
+        #elif defined _WIN32
+        
+        LARGE_INTEGER count;
+        static LARGE_INTEGER freq = {0};
+        
+        if (freq.QuadPart == 0)
+                QueryPerformanceFrequency(&freq);
+        
+        QueryPerformanceCounter(&count);
+        
+        return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000 +
+                (uint64_t)(count.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart;
+        
+        #endif
+}
+
 SerialInterface::SerialInterface()
 {
         #ifdef __unix__
         
         port_fd = -1;
+        wake_fd[0] = -1;
+        wake_fd[1] = -1;
+        serial_flags_saved = -1;
         
         #elif defined _WIN32
         
@@ -173,11 +236,13 @@ SerialInterface::SerialInterface()
         #endif
         
         baud = 19200;
+        actual_baud = 0;
         port = "";
         bits = 8;
         flow = SF_None;
         parity = SP_None;
         stop = 1;
+        latency = SL_Default;
         
         debug = false;
         
@@ -185,9 +250,31 @@ SerialInterface::SerialInterface()
         
         in_on_receive_data = false;
         called_close_port = false;
+        called_port_lost = false;
+        
+        auto_reconnect = false;
+        reconnecting = false;
+        disconnect_timestamp = 0;
+        last_outage = 0;
+        reconnect_count = 0;
+        
+        write_wait = false;
+        write_queue_bytes = 0;
+        write_high_water = SERIAL_WRITE_HIGH_WATER;
+        write_above_high_water = false;
+        
+        cts_asserted = true;
+        cts_line = true;
+        cts_fall_timestamp = 0;
+        cts_last_stall = 0;
+        cts_thread_done = true;
+        cts_thread_ready = false;
+        cts_thread = 0;
         
         signal_receive_data.connect( sigc::mem_fun(*this, &SerialInterface::on_receive_data) );
         signal_error.connect( sigc::mem_fun(*this, &SerialInterface::on_error) );
+        signal_write_ready.connect( sigc::mem_fun(*this, &SerialInterface::on_write_ready) );
+        signal_cts_changed.connect( sigc::mem_fun(*this, &SerialInterface::on_cts_changed) );
 }
 
 SerialInterface::~SerialInterface()
@@ -197,14 +284,14 @@ SerialInterface::~SerialInterface()
 
 void SerialInterface::on_receive_data()
 {
-        in_on_receive_data = true;
-        
         {
                 Glib::Mutex::Lock lock(running_mutex);
                 if (!running)
                         return;
         }
         
+        in_on_receive_data = true;
+        
         {
                 Glib::Mutex::Lock read_lock(read_mutex);
                 m_port_receive_data.emit();
@@ -215,6 +302,8 @@ void SerialInterface::on_receive_data()
         
         if (called_close_port)
                 close_port();
+        else if (called_port_lost)
+                port_lost();
 }
 
 void SerialInterface::on_error()
@@ -227,11 +316,253 @@ void SerialInterface::on_error()
         
         m_port_error.emit();
         
-        close_port();
+        port_lost();
+}
+
+void SerialInterface::on_write_ready()
+{
+        {
+                Glib::Mutex::Lock lock(running_mutex);
+                if (!running)
+                        return;
+        }
+        
+        drain_write_queue();
+}
+
+void SerialInterface::on_cts_changed()
+{
+        bool line;
+        uint64_t stall;
+        
+        {
+                Glib::Mutex::Lock lock(running_mutex);
+                if (!running)
+                        return;
+        }
+        
+        {
+                Glib::Mutex::Lock lock(cts_mutex);
+                line = cts_line;
+                stall = cts_last_stall;
+        }
+        
+        // several edges may have been coalesced; only act on a change
+        if (line == cts_asserted)
+                return;
+        
+        set_cts_asserted(line, stall);
+        
+        if (line)
+                drain_write_queue();
+        else
+                update_write_state();
+}
+
+void SerialInterface::set_cts_asserted(bool line, uint64_t stall)
+{
+        if (line == cts_asserted)
+                return;
+        
+        cts_asserted = line;
+        
+        m_port_cts.emit(line, line ? stall : 0);
+}
+
+#ifdef __unix__
+
+// only needed to interrupt TIOCMIWAIT
+static void cts_wake_handler(int sig)
+{
+        
+}
+
+#endif
+
+void SerialInterface::launch_cts_thread()
+{
+        #ifdef __unix__
+        
+        static bool handler_installed = false;
+        int lines;
+        bool line;
+        
+        if (flow != SF_Hardware)
+                return;
+        
+        if (ioctl(port_fd, TIOCMGET, &lines) < 0)
+        {
+                // ptys and some adapters have no modem lines
+                return;
+        }
+        
+        if (!handler_installed)
+        {
+                struct sigaction sa;
+                
+                // no SA_RESTART, so the ioctl returns EINTR
+                memset(&sa, 0, sizeof(sa));
+                sa.sa_handler = cts_wake_handler;
+                sigemptyset(&sa.sa_mask);
+                sigaction(SERIAL_CTS_WAKE_SIGNAL, &sa, NULL);
+                handler_installed = true;
+        }
+        
+        line = (lines & TIOCM_CTS) != 0;
+        
+        {
+                Glib::Mutex::Lock lock(cts_mutex);
+                cts_line = line;
+                cts_fall_timestamp = get_timestamp();
+                cts_last_stall = 0;
+                cts_thread_done = false;
+                cts_thread_ready = false;
+        }
+        
+        // opening with CTS low must hold the queue of listeners too
+        set_cts_asserted(line, 0);
+        
+        cts_thread = Glib::Thread::create( sigc::mem_fun(*this, &SerialInterface::cts_thread_func), true );
+        
+        #endif
+}
+
+void SerialInterface::stop_cts_thread()
+{
+        uint64_t stall = 0;
+        
+        #ifdef __unix__
+        
+        if (cts_thread)
+        {
+                // running is already false; keep interrupting until the
+                // thread sees it, in case the first signal lands before
+                // it enters the ioctl.  The thread ID is only valid once
+                // the thread has published it.
+                while (true)
+                {
+                        {
+                                Glib::Mutex::Lock lock(cts_mutex);
+                                if (cts_thread_done)
+                                        break;
+                                if (cts_thread_ready)
+                                        pthread_kill(cts_thread_id, SERIAL_CTS_WAKE_SIGNAL);
+                        }
+                        
+                        g_usleep(1000);
+                }
+                
+                cts_thread->join();
+        }
+        
+        #endif
+        
+        cts_thread = 0;
+        
+        {
+                Glib::Mutex::Lock lock(cts_mutex);
+                cts_thread_ready = false;
+                if (!cts_asserted)
+                        stall = get_timestamp() - cts_fall_timestamp;
+        }
+        
+        // the thread's last edge is dropped by on_cts_changed once
+        // running is false, so release listeners here
+        set_cts_asserted(true, stall);
+}
+
+void SerialInterface::cts_thread_func()
+{
+        #ifdef __unix__
+        
+        int lines;
+        bool line;
+        uint64_t now;
+        
+        {
+                Glib::Mutex::Lock lock(cts_mutex);
+                cts_thread_id = pthread_self();
+                cts_thread_ready = true;
+        }
+        
+        while (true)
+        {
+                {
+                        Glib::Mutex::Lock lock(running_mutex);
+                        if (!running)
+                                break;
+                }
+                
+                if (ioctl(port_fd, TIOCMIWAIT, TIOCM_CTS) < 0)
+                {
+                        if (errno == EINTR)
+                                continue;
+                        
+                        // driver cannot wait on modem status; the kernel
+                        // still does flow control, just without pacing
+                        std::cerr << "Error (" << errno << ") waiting for modem status, CTS pacing disabled" << std::endl;
+                        break;
+                }
+                
+                now = get_timestamp();
+                
+                if (ioctl(port_fd, TIOCMGET, &lines) < 0)
+                        break;
+                
+                line = (lines & TIOCM_CTS) != 0;
+                
+                {
+                        Glib::Mutex::Lock lock(cts_mutex);
+                        
+                        if (line == cts_line)
+                                continue;
+                        
+                        cts_line = line;
+                        
+                        if (line)
+                                cts_last_stall = now - cts_fall_timestamp;
+                        else
+                                cts_fall_timestamp = now;
+                }
+                
+                signal_cts_changed.emit();
+        }
+        
+        {
+                Glib::Mutex::Lock lock(cts_mutex);
+                
+                // don't leave the write queue held by a stale state
+                if (!cts_line)
+                {
+                        cts_line = true;
+                        cts_last_stall = get_timestamp() - cts_fall_timestamp;
+                        signal_cts_changed.emit();
+                }
+                
+                cts_thread_done = true;
+        }
+        
+        #endif
 }
 
 void SerialInterface::launch_select_thread()
 {
+        #ifdef __unix__
+        
+        if (pipe(wake_fd) == 0)
+        {
+                fcntl(wake_fd[0], F_SETFL, O_NONBLOCK);
+                fcntl(wake_fd[1], F_SETFL, O_NONBLOCK);
+        }
+        else
+        {
+                std::cerr << "Error (" << errno << ") creating wake pipe" << std::endl;
+                wake_fd[0] = -1;
+                wake_fd[1] = -1;
+        }
+        
+        #endif
+        
         running = true;
         thread = Glib::Thread::create( sigc::mem_fun(*this, &SerialInterface::select_thread), true );
 }
@@ -261,6 +592,30 @@ void SerialInterface::stop_select_thread()
                 thread->join();
         }
         thread = 0;
+        
+        #ifdef __unix__
+        
+        if (wake_fd[0] >= 0)
+        {
+                close(wake_fd[0]);
+                close(wake_fd[1]);
+        }
+        wake_fd[0] = -1;
+        wake_fd[1] = -1;
+        
+        #endif
+}
+
+void SerialInterface::wake_select_thread()
+{
+        #ifdef __unix__
+        
+        char c = 0;
+        
+        if (wake_fd[1] >= 0)
+                ::write(wake_fd[1], &c, 1);
+        
+        #endif
 }
 
 void SerialInterface::select_thread()
@@ -269,7 +624,11 @@ void SerialInterface::select_thread()
         
         int n, max_fd;
         fd_set input;
+        fd_set output;
         struct timeval timeout;
+        bool watch_write;
+        bool throughput = false;
+        char wake_buf[16];
         
         #endif
         
@@ -279,18 +638,44 @@ void SerialInterface::select_thread()
                         Glib::Mutex::Lock lock(running_mutex);
                         if (!running)
                                 break;
+                        
+                        #ifdef __unix__
+                        
+                        // set_latency() may change it from the main thread
+                        throughput = latency == SL_Throughput;
+                        
+                        #endif
                 }
                 
                 #ifdef __unix__
                 
                 FD_ZERO(&input);
+                FD_ZERO(&output);
                 FD_SET(port_fd, &input);
                 max_fd = port_fd + 1;
                 
+                if (wake_fd[0] >= 0)
+                {
+                        FD_SET(wake_fd[0], &input);
+                        if (wake_fd[0] >= max_fd)
+                                max_fd = wake_fd[0] + 1;
+                }
+                
+                {
+                        Glib::Mutex::Lock lock(write_mutex);
+                        watch_write = write_wait;
+                }
+                
+                if (watch_write)
+                        FD_SET(port_fd, &output);
+                
                 timeout.tv_sec = 0;
                 timeout.tv_usec = 100000;
                 
-                n = select(max_fd, &input, NULL, NULL, &timeout);
+                if (throughput)
+                        timeout.tv_usec = SERIAL_THROUGHPUT_WINDOW_US;
+                
+                n = select(max_fd, &input, &output, NULL, &timeout);
                 
                 if (n < 0)
                 {
@@ -301,8 +686,41 @@ void SerialInterface::select_thread()
                 else if (n == 0)
                 {
                         // timeout...
+                        
+                        // in throughput mode select only fires at VMIN
+                        // bytes, so collect any remainder at the end of
+                        // each window
+                        if (throughput)
+                        {
+                                int avail = 0;
+                                
+                                if (ioctl(port_fd, FIONREAD, &avail) == 0 && avail > 0)
+                                {
+                                        FD_SET(port_fd, &input);
+                                        n = 1;
+                                }
+                        }
+                }
+                
+                if (n > 0 && wake_fd[0] >= 0 && FD_ISSET(wake_fd[0], &input))
+                {
+                        // wakeup only, pick up new write_wait on next pass
+                        while (::read(wake_fd[0], wake_buf, sizeof(wake_buf)) > 0) { }
                 }
-                else
+                
+                if (n > 0 && watch_write && FD_ISSET(port_fd, &output))
+                {
+                        // stop watching until the main loop has drained
+                        // what it can and rearmed
+                        {
+                                Glib::Mutex::Lock lock(write_mutex);
+                                write_wait = false;
+                        }
+                        
+                        signal_write_ready.emit();
+                }
+                
+                if (n > 0)
                 {
                         if (FD_ISSET(port_fd, &input))
                         {
@@ -380,9 +798,16 @@ SerialInterface::SerialStatus SerialInterface::write(const char *buf, gsize coun
         
         if (bytes_written == -1)
         {
+                if (errno == EAGAIN)
+                {
+                        // driver buffer full
+                        bytes_written = 0;
+                        return SS_Success;
+                }
+                
                 std::cerr << "Error writing serial port (errno " << errno << ")" << std::endl;
                 m_port_error.emit();
-                close_port();
+                port_lost();
                 return SS_Error;
         }
         
@@ -422,22 +847,169 @@ SerialInterface::SerialStatus SerialInterface::write(const char *buf, gsize coun
                 SetEvent(ov.hEvent);
         }
         
-        bytes_written = d;
+        bytes_written = d;
+        
+        #endif
+        
+        if (debug && bytes_written > 0)
+        {
+                std::cout << "Write: ";
+                for (gsize i = 0; i < bytes_written; i++)
+                        std::cout << std::setfill('0') << std::setw(2) << std::hex << ((unsigned int)buf[i] & 0xff) << ' ';
+                std::cout << std::endl;
+        }
+        
+        return SS_Success;
+}
+
+SerialInterface::SerialStatus SerialInterface::queue_write(const char *buf, gsize count, WriteSlot slot)
+{
+        // data queued during a reconnect goes out once the port is back
+        if (!is_open() && !reconnecting)
+                return SS_PortNotOpen;
+        
+        write_queue.push_back(WriteRequest());
+        
+        WriteRequest &req = write_queue.back();
+        req.data.assign(buf, buf + count);
+        req.offset = 0;
+        req.writes = 0;
+        req.slot = slot;
+        
+        write_queue_bytes += count;
+        
+        // if older data is still waiting, this buffer goes out after it
+        if (write_queue.size() == 1)
+                drain_write_queue();
+        else
+                update_write_state();
+        
+        return SS_Success;
+}
+
+void SerialInterface::drain_write_queue()
+{
+        gsize num;
+        
+        // with CTS deasserted the driver would only buffer the data, so
+        // hold it here until CTS comes back
+        while (write_queue.size() > 0 && is_open() && cts_asserted)
+        {
+                WriteRequest &req = write_queue.front();
+                
+                if (req.offset < req.data.size())
+                {
+                        // on error write() closes the port, which flushes
+                        // the queue and reports the failure
+                        if (write(&req.data[req.offset], req.data.size() - req.offset, num) != SS_Success)
+                                return;
+                        
+                        req.writes++;
+                        req.offset += num;
+                        write_queue_bytes -= num;
+                        
+                        #ifdef __unix__
+                        
+                        // driver buffer full, resume when writable
+                        if (req.offset < req.data.size())
+                                break;
+                        
+                        #elif defined _WIN32
+                        
+                        // overlapped writes wait for completion, so there
+                        // is no writable event to resume on
+                        if (req.offset < req.data.size())
+                                continue;
+                        
+                        #endif
+                }
+                
+                WriteSlot slot = req.slot;
+                gsize len = req.data.size();
+                int writes = req.writes;
+                
+                write_queue.pop_front();
+                
+                // may queue more data
+                slot(SS_Success, len, writes);
+        }
+        
+        update_write_state();
+}
+
+void SerialInterface::flush_write_queue(SerialStatus status)
+{
+        while (write_queue.size() > 0)
+        {
+                WriteRequest req = write_queue.front();
+                
+                write_queue.pop_front();
+                write_queue_bytes -= req.data.size() - req.offset;
+                
+                req.slot(status, req.offset, req.writes);
+        }
+        
+        update_write_state();
+}
+
+void SerialInterface::update_write_state()
+{
+        bool wait = write_queue.size() > 0 && is_open() && cts_asserted;
+        bool was_waiting;
         
-        #endif
+        if (!write_above_high_water && write_queue_bytes > write_high_water)
+        {
+                write_above_high_water = true;
+                m_port_write_high_water.emit(true);
+        }
+        else if (write_above_high_water && write_queue_bytes <= write_high_water / 2)
+        {
+                write_above_high_water = false;
+                m_port_write_high_water.emit(false);
+        }
         
-        if (debug && bytes_written > 0)
         {
-                std::cout << "Write: ";
-                for (gsize i = 0; i < bytes_written; i++)
-                        std::cout << std::setfill('0') << std::setw(2) << std::hex << ((unsigned int)buf[i] & 0xff) << ' ';
-                std::cout << std::endl;
+                Glib::Mutex::Lock lock(write_mutex);
+                was_waiting = write_wait;
+                write_wait = wait;
         }
         
-        return SS_Success;
+        if (wait && !was_waiting)
+                wake_select_thread();
+}
+
+gsize SerialInterface::get_write_queue_size()
+{
+        return write_queue_bytes;
+}
+
+gsize SerialInterface::set_write_high_water(gsize n)
+{
+        write_high_water = n;
+        
+        update_write_state();
+        
+        return write_high_water;
+}
+
+gsize SerialInterface::get_write_high_water()
+{
+        return write_high_water;
+}
+
+bool SerialInterface::get_cts()
+{
+        return cts_asserted;
 }
 
 SerialInterface::SerialStatus SerialInterface::read(char *buf, gsize count, gsize& bytes_read)
+{
+        uint64_t timestamp;
+        
+        return read(buf, count, bytes_read, timestamp);
+}
+
+SerialInterface::SerialStatus SerialInterface::read(char *buf, gsize count, gsize& bytes_read, uint64_t& timestamp)
 {
         #ifdef __WIN32
         DWORD d;
@@ -449,6 +1021,7 @@ SerialInterface::SerialStatus SerialInterface::read(char *buf, gsize count, gsiz
         #ifdef __unix__
         
         bytes_read = ::read(port_fd, buf, count);
+        timestamp = get_timestamp();
         
         if (bytes_read == -1)
         {
@@ -463,7 +1036,7 @@ SerialInterface::SerialStatus SerialInterface::read(char *buf, gsize count, gsiz
                 
                 std::cerr << "Error reading serial port (errno " << errno << ")" << std::endl;
                 m_port_error.emit();
-                close_port();
+                port_lost();
                 return SS_Error;
         }
         
@@ -504,6 +1077,7 @@ SerialInterface::SerialStatus SerialInterface::read(char *buf, gsize count, gsiz
         }
         
         bytes_read = d;
+        timestamp = get_timestamp();
         
         #endif
         
@@ -522,6 +1096,9 @@ SerialInterface::SerialStatus SerialInterface::read(char *buf, gsize count, gsiz
                 if (debug)
                         std::cout << "Read: End of File" << std::endl;
                 
+                // hangup, the device is gone
+                port_lost();
+                
                 return SS_EOF;
         }
         
@@ -531,6 +1108,20 @@ SerialInterface::SerialStatus SerialInterface::read(char *buf, gsize count, gsiz
 }
 
 SerialInterface::SerialStatus SerialInterface::open_port()
+{
+        SerialStatus ret;
+        
+        close_port();
+        
+        ret = open_device();
+        
+        if (ret == SS_Success)
+                reconnect_path = find_stable_path(port);
+        
+        return ret;
+}
+
+SerialInterface::SerialStatus SerialInterface::open_device()
 {
         #ifdef _WIN32
         
@@ -538,8 +1129,6 @@ SerialInterface::SerialStatus SerialInterface::open_port()
         
         #endif
         
-        close_port();
-        
         #ifdef __unix__
         
         port_fd = open(port.c_str(), O_RDWR | O_NOCTTY | O_NDELAY);
@@ -634,6 +1223,7 @@ SerialInterface::SerialStatus SerialInterface::open_port()
         #endif
         
         launch_select_thread();
+        launch_cts_thread();
         
         if (debug)
                 std::cout << "Port opened." << std::endl;
@@ -652,13 +1242,122 @@ SerialInterface::SerialStatus SerialInterface::close_port()
         }
         
         called_close_port = false;
+        called_port_lost = false;
+        
+        if (reconnecting)
+        {
+                // port is already closed; give up on it now
+                c_reconnect.disconnect();
+                reconnecting = false;
+                
+                flush_write_queue(SS_PortNotOpen);
+                
+                m_port_closed.emit();
+        }
+        
+        if (is_open())
+        {
+                close_device();
+                
+                flush_write_queue(SS_PortNotOpen);
+                
+                m_port_closed.emit();
+        }
+        
+        return SS_Success;
+}
+
+void SerialInterface::port_lost()
+{
+        if (in_on_receive_data)
+        {
+                called_port_lost = true;
+                return;
+        }
+        
+        called_port_lost = false;
+        
+        if (!auto_reconnect || !is_open())
+        {
+                close_port();
+                return;
+        }
+        
+        close_device();
+        
+        // bytes of a partly written buffer went to the old device, so
+        // send the whole buffer again once reconnected
+        if (write_queue.size() > 0)
+        {
+                write_queue_bytes += write_queue.front().offset;
+                write_queue.front().offset = 0;
+        }
+        
+        update_write_state();
+        
+        disconnect_timestamp = get_timestamp();
+        reconnecting = true;
+        
+        std::cerr << "Lost port " << port << ", waiting for " << reconnect_path << std::endl;
+        
+        c_reconnect = Glib::signal_timeout().connect( sigc::mem_fun(*this, &SerialInterface::on_reconnect_timeout), SERIAL_RECONNECT_POLL_MS );
+        
+        m_port_disconnected.emit();
+}
+
+bool SerialInterface::on_reconnect_timeout()
+{
+        #ifdef __unix__
+        
+        char buf[PATH_MAX];
+        
+        // wait for udev to recreate the link
+        if (!Glib::file_test(reconnect_path, Glib::FILE_TEST_EXISTS))
+                return true;
+        
+        // the adapter may come back under a different tty name
+        if (realpath(reconnect_path.c_str(), buf) == NULL)
+                return true;
+        
+        port = buf;
+        
+        #elif defined _WIN32
+        
+        std::vector<std::string> ports = enumerate_ports();
+        
+        if (std::find(ports.begin(), ports.end(), std::string(reconnect_path)) == ports.end())
+                return true;
+        
+        #endif
+        
+        if (open_device() != SS_Success)
+                return true;
         
+        reconnecting = false;
+        last_outage = get_timestamp() - disconnect_timestamp;
+        reconnect_count++;
+        
+        std::cerr << "Reconnected to " << port << " after " << last_outage / 1000 << " ms" << std::endl;
+        
+        m_port_reconnected.emit(last_outage);
+        
+        // resume the transmit queue
+        drain_write_queue();
+        
+        return false;
+}
+
+void SerialInterface::close_device()
+{
         if (is_open())
         {
                 stop_select_thread();
+                stop_cts_thread();
                 
                 #ifdef __unix__
                 
+                restore_latency();
+                
                 tcsetattr(port_fd, TCSANOW, &port_termios_saved);
                 tcflush(port_fd, TCOFLUSH);
                 tcflush(port_fd, TCIFLUSH);
@@ -679,11 +1378,44 @@ SerialInterface::SerialStatus SerialInterface::close_port()
                 
                 if (debug)
                         std::cout << "Port closed." << std::endl;
-                
-                m_port_closed.emit();
         }
+}
+
+// Static
+Glib::ustring SerialInterface::find_stable_path(Glib::ustring p)
+{
+        #ifdef __unix__
         
-        return SS_Success;
+        DIR *dp;
+        struct dirent *dirp;
+        std::string f;
+        char buf[PATH_MAX];
+        char target[PATH_MAX];
+        
+        if (realpath(p.c_str(), target) == NULL)
+                return p;
+        
+        if ((dp = opendir("/dev/serial/by-id/")) == NULL)
+                return p;
+        
+        while ((dirp = readdir(dp)) != NULL)
+        {
+                f = dirp->d_name;
+                if (f == "." || f == "..")
+                        continue;
+                f = "/dev/serial/by-id/" + f;
+                if (realpath(f.c_str(), buf) && strcmp(buf, target) == 0)
+                {
+                        p = f;
+                        break;
+                }
+        }
+        
+        closedir(dp);
+        
+        #endif
+        
+        return p;
 }
 
 SerialInterface::SerialStatus SerialInterface::configure_port()
@@ -693,6 +1425,8 @@ SerialInterface::SerialStatus SerialInterface::configure_port()
         
         #ifdef __unix__
         
+        bool custom_baud = false;
+        
         port_termios.c_cflag = B19200;
         switch (baud)
         {
@@ -726,6 +1460,24 @@ SerialInterface::SerialStatus SerialInterface::configure_port()
                 case 115200:
                         port_termios.c_cflag = B115200;
                         break;
+                #ifdef B230400
+                case 230400:
+                        port_termios.c_cflag = B230400;
+                        break;
+                #endif
+                #ifdef B460800
+                case 460800:
+                        port_termios.c_cflag = B460800;
+                        break;
+                #endif
+                #ifdef B921600
+                case 921600:
+                        port_termios.c_cflag = B921600;
+                        break;
+                #endif
+                default:
+                        custom_baud = true;
+                        break;
         }
         
         switch (bits)
@@ -787,8 +1539,49 @@ SerialInterface::SerialStatus SerialInterface::configure_port()
         port_termios.c_lflag = 0;
         port_termios.c_cc[VTIME] = 0;
         port_termios.c_cc[VMIN] = 1;
+        
+        // the port is non-blocking, so VMIN only sets how many bytes must
+        // be waiting before select reports it readable; VTIME must stay 0
+        // or the threshold is ignored
+        if (latency == SL_Throughput)
+                port_termios.c_cc[VMIN] = SERIAL_THROUGHPUT_MIN;
+        
         tcsetattr(port_fd, TCSANOW, &port_termios);
         
+        actual_baud = custom_baud ? 19200 : baud;
+        
+        #ifdef TCGETS2
+        
+        struct termios2 tio2;
+        
+        if (ioctl(port_fd, TCGETS2, &tio2) == 0)
+        {
+                if (custom_baud)
+                {
+                        // program arbitrary rate directly
+                        tio2.c_cflag &= ~CBAUD;
+                        tio2.c_cflag |= BOTHER;
+                        tio2.c_ispeed = baud;
+                        tio2.c_ospeed = baud;
+                        
+                        if (ioctl(port_fd, TCSETS2, &tio2) != 0 || ioctl(port_fd, TCGETS2, &tio2) != 0)
+                                std::cerr << "Error (" << errno << ") setting baud rate " << baud << std::endl;
+                }
+                
+                // driver reports the rate it actually set
+                if (tio2.c_ospeed > 0)
+                        actual_baud = tio2.c_ospeed;
+        }
+        
+        #else
+        
+        if (custom_baud)
+                std::cerr << "Baud rate " << baud << " not supported" << std::endl;
+        
+        #endif
+        
+        configure_latency();
+        
         #elif defined _WIN32
         
         dcb_serial_params.BaudRate = CBR_19200;
@@ -824,6 +1617,10 @@ SerialInterface::SerialStatus SerialInterface::configure_port()
                 case 115200:
                         dcb_serial_params.BaudRate = CBR_115200;
                         break;
+                default:
+                        // non-standard rates are passed to the driver as is
+                        dcb_serial_params.BaudRate = baud;
+                        break;
         }
         
         dcb_serial_params.ByteSize = bits;
@@ -884,6 +1681,13 @@ SerialInterface::SerialStatus SerialInterface::configure_port()
                 return SS_Error;
         }
         
+        actual_baud = dcb_serial_params.BaudRate;
+        
+        DCB dcb;
+        dcb.DCBlength = sizeof(dcb);
+        if (GetCommState(h_port, &dcb))
+                actual_baud = dcb.BaudRate;
+        
         #endif
         
         return SS_Success;
@@ -902,6 +1706,91 @@ Glib::ustring SerialInterface::get_port()
         return port;
 }
 
+void SerialInterface::configure_latency()
+{
+        #ifdef __unix__
+        
+        struct serial_struct serinfo;
+        char buf[PATH_MAX];
+        std::string name, path, val;
+        
+        if (!is_open())
+                return;
+        
+        restore_latency();
+        
+        if (latency != SL_LowLatency)
+                return;
+        
+        // have the driver push received data to the tty immediately
+        if (ioctl(port_fd, TIOCGSERIAL, &serinfo) == 0)
+        {
+                serial_flags_saved = serinfo.flags;
+                serinfo.flags |= ASYNC_LOW_LATENCY;
+                
+                if (ioctl(port_fd, TIOCSSERIAL, &serinfo) != 0)
+                {
+                        serial_flags_saved = -1;
+                        
+                        if (debug)
+                                std::cout << "Unable to set ASYNC_LOW_LATENCY (errno " << errno << ")" << std::endl;
+                }
+        }
+        
+        // FTDI adapters hold received data for latency_timer ms (16 by
+        // default) before sending a USB packet
+        if (realpath(port.c_str(), buf) == NULL)
+                return;
+        
+        name = buf;
+        name = name.substr(name.rfind('/') + 1);
+        path = "/sys/class/tty/" + name + "/device/latency_timer";
+        
+        std::ifstream in(path.c_str());
+        
+        if (!(in >> val))
+                return;
+        
+        std::ofstream out(path.c_str());
+        
+        if (out << "1" << std::endl)
+        {
+                latency_timer_path = path;
+                latency_timer_saved = val;
+        }
+        else if (debug)
+        {
+                std::cout << "Unable to write " << path << std::endl;
+        }
+        
+        #endif
+}
+
+void SerialInterface::restore_latency()
+{
+        #ifdef __unix__
+        
+        struct serial_struct serinfo;
+        
+        if (serial_flags_saved >= 0 && ioctl(port_fd, TIOCGSERIAL, &serinfo) == 0)
+        {
+                serinfo.flags &= ~ASYNC_LOW_LATENCY;
+                serinfo.flags |= serial_flags_saved & ASYNC_LOW_LATENCY;
+                ioctl(port_fd, TIOCSSERIAL, &serinfo);
+        }
+        
+        serial_flags_saved = -1;
+        
+        if (latency_timer_path.length() > 0)
+        {
+                std::ofstream out(latency_timer_path.c_str());
+                out << latency_timer_saved << std::endl;
+                latency_timer_path.clear();
+        }
+        
+        #endif
+}
+
 unsigned long SerialInterface::set_baud(unsigned long b)
 {
         baud = b;
@@ -916,6 +1805,14 @@ unsigned long SerialInterface::get_baud()
         return baud;
 }
 
+unsigned long SerialInterface::get_actual_baud()
+{
+        if (!is_open())
+                return 0;
+        
+        return actual_baud;
+}
+
 int SerialInterface::set_bits(int b)
 {
         if (b >= 5 && b <= 8)
@@ -976,6 +1873,53 @@ int SerialInterface::get_stop()
         return stop;
 }
 
+SerialInterface::SerialLatency SerialInterface::set_latency(SerialLatency l)
+{
+        {
+                Glib::Mutex::Lock lock(running_mutex);
+                latency = l;
+        }
+        
+        configure_port();
+        
+        return latency;
+}
+
+SerialInterface::SerialLatency SerialInterface::get_latency()
+{
+        return latency;
+}
+
+bool SerialInterface::set_auto_reconnect(bool r)
+{
+        auto_reconnect = r;
+        
+        if (!auto_reconnect && reconnecting)
+                close_port();
+        
+        return auto_reconnect;
+}
+
+bool SerialInterface::get_auto_reconnect()
+{
+        return auto_reconnect;
+}
+
+bool SerialInterface::is_reconnecting()
+{
+        return reconnecting;
+}
+
+uint64_t SerialInterface::get_last_outage()
+{
+        return last_outage;
+}
+
+unsigned int SerialInterface::get_reconnect_count()
+{
+        return reconnect_count;
+}
+
 bool SerialInterface::set_debug(bool d)
 {
         debug = d;
@@ -995,6 +1939,8 @@ Glib::ustring SerialInterface::get_status_string()
         {
                 str = port + ": ";
                 str += Glib::ustring::format(baud) + " ";
+                if (actual_baud != baud)
+                        str += "(" + Glib::ustring::format(actual_baud) + ") ";
                 str += Glib::ustring::format(bits) + "-";
                 switch (parity)
                 {
@@ -1021,6 +1967,21 @@ Glib::ustring SerialInterface::get_status_string()
                                 str += "SW";
                                 break;
                 }
+                switch (latency)
+                {
+                        case SL_Default:
+                                break;
+                        case SL_LowLatency:
+                                str += " LAT:LOW";
+                                break;
+                        case SL_Throughput:
+                                str += " LAT:BATCH";
+                                break;
+                }
+        }
+        else if (reconnecting)
+        {
+                str = "Reconnecting to " + reconnect_path + "...";
         }
         else
         {
@@ -1063,6 +2024,26 @@ sigc::signal<void> SerialInterface::port_receive_data()
         return m_port_receive_data;
 }
 
+sigc::signal<void, bool> SerialInterface::port_write_high_water()
+{
+        return m_port_write_high_water;
+}
+
+sigc::signal<void> SerialInterface::port_disconnected()
+{
+        return m_port_disconnected;
+}
+
+sigc::signal<void, uint64_t> SerialInterface::port_reconnected()
+{
+        return m_port_reconnected;
+}
+
+sigc::signal<void, bool, uint64_t> SerialInterface::port_cts()
+{
+        return m_port_cts;
+}
+
 
 
 
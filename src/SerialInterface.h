@@ -36,10 +36,23 @@
 
 #include <string>
 #include <vector>
+#include <deque>
+#include <inttypes.h>
 #include <gtkmm.h>
 
+#define SERIAL_WRITE_HIGH_WATER 4096
+
+#define SERIAL_RECONNECT_POLL_MS 50
+
+#define SERIAL_THROUGHPUT_MIN 64
+#define SERIAL_THROUGHPUT_WINDOW_US 5000
+
+#define SERIAL_CTS_WAKE_SIGNAL SIGUSR2
+
 #ifdef __unix__
 #include <termios.h>
+#include <pthread.h>
+#include <signal.h>
 #elif defined _WIN32
 #include <windows.h>
 #endif
@@ -86,6 +99,27 @@ public:
         }
         SerialParity;
         
+        /**
+         * Latency profile.
+         */
+        typedef enum
+        {
+                SL_Default = 0,         ///< Wake on every byte, driver defaults
+                SL_LowLatency = 1,      ///< Minimize delivery delay of each byte
+                SL_Throughput = 2,      ///< Batch received data to cut wakeups
+        }
+        SerialLatency;
+        
+        /**
+         * Write completion callback.
+         * @par Prototype:
+         * <tt>void on_my_%write_complete(SerialStatus status, gsize bytes_written, int writes)</tt>
+         * @par
+         * writes is the number of write calls it took to send the buffer.
+         * @see queue_write()
+         */
+        typedef sigc::slot<void, SerialStatus, gsize, int> WriteSlot;
+        
         /**
          * Create a Serial Interface.
          */
@@ -101,6 +135,51 @@ public:
          */
         SerialStatus write(const char *buf, gsize count, gsize& bytes_written);
         
+        /**
+         * Queue data for writing.  The data is copied and written as the
+         * port accepts it without blocking; anything the driver does not
+         * take immediately is sent when select reports the port writable.
+         * Buffers are written in order.  The completion callback is called
+         * from the main loop once the whole buffer has been written, or
+         * with an error status if the port closes first.
+         * @param buf pointer to data
+         * @param count number of bytes to send
+         * @param slot completion callback, may be empty
+         * @return status
+         * @see port_write_high_water()
+         */
+        SerialStatus queue_write(const char *buf, gsize count, WriteSlot slot = WriteSlot());
+        
+        /**
+         * Get number of queued bytes not yet written.
+         * @return bytes
+         */
+        gsize get_write_queue_size();
+        
+        /**
+         * Set write queue high water mark.
+         * @param n bytes
+         * @return bytes
+         * @see port_write_high_water()
+         */
+        gsize set_write_high_water(gsize n);
+        
+        /**
+         * Get write queue high water mark.
+         * @return bytes
+         */
+        gsize get_write_high_water();
+        
+        /**
+         * Get CTS state as seen by the write queue.  With hardware flow
+         * control on a port that supports modem status monitoring, the
+         * write queue stops submitting data while CTS is deasserted.
+         * Always true otherwise.
+         * @return true if asserted
+         * @see port_cts()
+         */
+        bool get_cts();
+        
         /**
          * Read data.
          * @param buf pointer to data
@@ -110,6 +189,18 @@ public:
          */
         SerialStatus read(char *buf, gsize count, gsize& bytes_read);
         
+        /**
+         * Read data and timestamp it.  The timestamp is taken with
+         * get_timestamp() as soon as the read returns.
+         * @param buf pointer to data
+         * @param count number of bytes to send
+         * @param bytes_read return number of bytes read
+         * @param timestamp return time of read in microseconds
+         * @return status
+         * @see get_timestamp()
+         */
+        SerialStatus read(char *buf, gsize count, gsize& bytes_read, uint64_t& timestamp);
+        
         /**
          * Open port.
          * @return status
@@ -128,6 +219,45 @@ public:
          */
         bool is_open();
         
+        /**
+         * Set auto reconnect.  When enabled, losing the port (read or write
+         * error, hangup) does not close it; instead the device is polled
+         * for every SERIAL_RECONNECT_POLL_MS and reopened with the same
+         * settings when it reappears.  USB adapters are followed by their
+         * /dev/serial/by-id path, so they may come back under a different
+         * tty name.  Queued writes are kept and sent after reconnecting.
+         * @param r auto reconnect
+         * @return auto reconnect
+         * @see port_disconnected()
+         * @see port_reconnected()
+         */
+        bool set_auto_reconnect(bool r);
+        
+        /**
+         * Get auto reconnect.
+         * @return auto reconnect
+         */
+        bool get_auto_reconnect();
+        
+        /**
+         * Check if waiting for a lost port to reappear.
+         * @return true if reconnecting
+         */
+        bool is_reconnecting();
+        
+        /**
+         * Get duration of the last outage.
+         * @return time from losing the port to reopening it in
+         * microseconds
+         */
+        uint64_t get_last_outage();
+        
+        /**
+         * Get number of successful reconnects.
+         * @return reconnect count
+         */
+        unsigned int get_reconnect_count();
+        
         /**
          * Set serial port.
          * @param p port
@@ -154,6 +284,15 @@ public:
          */
         unsigned long get_baud();
         
+        /**
+         * Get actual baud rate.  Rates that have no standard setting are
+         * programmed directly where supported, and the driver may round
+         * them to the nearest rate its divider can produce.
+         * @return baud rate reported by the driver, or 0 if not open
+         * @see set_baud()
+         */
+        unsigned long get_actual_baud();
+        
         /**
          * Set number of bits.
          * @param b bits
@@ -206,6 +345,23 @@ public:
          */
         int get_stop();
         
+        /**
+         * Set latency profile.  Low latency mode sets ASYNC_LOW_LATENCY on
+         * the port and, for USB serial adapters that have one, drops the
+         * latency timer to 1 ms.  Throughput mode only wakes the reader
+         * once SERIAL_THROUGHPUT_MIN bytes are waiting, collecting anything
+         * less every SERIAL_THROUGHPUT_WINDOW_US.
+         * @param l latency profile
+         * @return latency profile
+         */
+        SerialLatency set_latency(SerialLatency l);
+        
+        /**
+         * Get latency profile.
+         * @return latency profile
+         */
+        SerialLatency get_latency();
+        
         /**
          * Set debug mode.  If debug mode is enabled, all bytes read and
          * written are printed in hex to stdout.
@@ -230,11 +386,37 @@ public:
         
         /**
          * Enumerate serial ports.  Returns a vector of strings with the
-         * names of likely usable ports.
+         * names of likely usable ports.  This rescans every time; use
+         * PortMonitor for a cached, hotplug aware list.
          * @return list of ports
+         * @see probe_port()
          */
         static std::vector<std::string> enumerate_ports();
         
+        /**
+         * Find a stable name for a port.  For USB adapters this is the
+         * /dev/serial/by-id link pointing at the port.
+         * @param p port
+         * @return by-id path, or p if there is none
+         */
+        static Glib::ustring find_stable_path(Glib::ustring p);
+        
+        /**
+         * Check whether a device is a usable serial port.  On Linux this
+         * only reads sysfs metadata and does not open the device.
+         * @param dev device path, such as /dev/ttyUSB0
+         * @return true if the device is likely a usable port
+         * @see enumerate_ports()
+         */
+        static bool probe_port(std::string dev);
+        
+        /**
+         * Get monotonic timestamp.  Used to measure latency; not related to
+         * wall clock time.
+         * @return time in microseconds from an arbitrary starting point
+         */
+        static uint64_t get_timestamp();
+        
         /**
          * Port opened signal.  
          * @par Prototype:
@@ -263,6 +445,40 @@ public:
          */
         sigc::signal<void> port_receive_data();
         
+        /**
+         * Port write high water signal.  Emitted with true when the write
+         * queue grows past the high water mark and with false once it
+         * drains to half of it.
+         * @par Prototype:
+         * <tt>void on_my_%port_write_high_water(bool above)</tt>
+         */
+        sigc::signal<void, bool> port_write_high_water();
+        
+        /**
+         * Port disconnected signal.  Emitted when the port is lost and auto
+         * reconnect is waiting for it to come back.  port_opened is
+         * emitted again on reconnect.
+         * @par Prototype:
+         * <tt>void on_my_%port_disconnected()</tt>
+         */
+        sigc::signal<void> port_disconnected();
+        
+        /**
+         * Port reconnected signal.  
+         * @par Prototype:
+         * <tt>void on_my_%port_reconnected(uint64_t outage_us)</tt>
+         */
+        sigc::signal<void, uint64_t> port_reconnected();
+        
+        /**
+         * Port CTS signal.  Emitted when CTS changes with hardware flow
+         * control.  When CTS is reasserted, stall is the time it was
+         * deasserted; it is 0 when CTS drops.
+         * @par Prototype:
+         * <tt>void on_my_%port_cts(bool asserted, uint64_t stall_us)</tt>
+         */
+        sigc::signal<void, bool, uint64_t> port_cts();
+        
 protected:
         /**
          * Select thread receive data event.  
@@ -276,6 +492,62 @@ protected:
          */
         void on_error();
         
+        /**
+         * Open the device named by port with the current settings.
+         * @return status
+         * @see open_port()
+         */
+        SerialStatus open_device();
+        
+        /**
+         * Close the device without flushing the write queue or emitting
+         * port_closed.
+         * @see close_port()
+         */
+        void close_device();
+        
+        /**
+         * Handle loss of the port.  Closes it, or starts reconnecting if
+         * auto reconnect is enabled.
+         * @see set_auto_reconnect()
+         */
+        void port_lost();
+        
+        /**
+         * Reconnect poll timer handler.
+         * @return true to keep polling
+         */
+        bool on_reconnect_timeout();
+        
+        /**
+         * Select thread port writable event.
+         * @see select_thread()
+         */
+        void on_write_ready();
+        
+        /**
+         * Write as much of the write queue as the port will take.
+         * @see queue_write()
+         */
+        void drain_write_queue();
+        
+        /**
+         * Discard the write queue, calling completions with status.
+         * @param status status passed to completion callbacks
+         */
+        void flush_write_queue(SerialStatus status);
+        
+        /**
+         * Update high water state and select thread write monitoring
+         * after the write queue changes.
+         */
+        void update_write_state();
+        
+        /**
+         * Interrupt select so it picks up a change in write_wait.
+         */
+        void wake_select_thread();
+        
         /**
          * Select thread for monitoring serial port.
          * @see launch_select_thread()
@@ -301,11 +573,57 @@ protected:
          */
         void stop_select_thread();
         
+        /**
+         * CTS thread, waits for modem status changes with TIOCMIWAIT.
+         * @see launch_cts_thread()
+         * @see signal_cts_changed
+         */
+        void cts_thread_func();
+        
+        /**
+         * Read the initial CTS state and start the CTS thread, if hardware
+         * flow control is selected.
+         * @see cts_thread_func()
+         */
+        void launch_cts_thread();
+        
+        /**
+         * Stop the CTS thread.
+         * @see cts_thread_func()
+         */
+        void stop_cts_thread();
+        
+        /**
+         * CTS thread change event.
+         * @see cts_thread_func()
+         */
+        void on_cts_changed();
+        
+        /**
+         * Update CTS state and notify port_cts() listeners on a change.
+         * @param line CTS asserted
+         * @param stall stall duration in microseconds when asserting
+         */
+        void set_cts_asserted(bool line, uint64_t stall);
+        
         /**
          * Configure serial port.
          */
         SerialStatus configure_port();
         
+        /**
+         * Apply latency profile to the open port.
+         * @see set_latency()
+         * @see restore_latency()
+         */
+        void configure_latency();
+        
+        /**
+         * Undo driver settings changed by configure_latency().
+         * @see configure_latency()
+         */
+        void restore_latency();
+        
         /**
          * Receive data signal dispatcher
          * @see select_thread()
@@ -320,12 +638,55 @@ protected:
          */
         Glib::Dispatcher signal_error;
         
+        /**
+         * Write ready signal dispatcher
+         * @see select_thread()
+         * @see on_write_ready()
+         */
+        Glib::Dispatcher signal_write_ready;
+        
+        /**
+         * CTS changed signal dispatcher
+         * @see cts_thread_func()
+         * @see on_cts_changed()
+         */
+        Glib::Dispatcher signal_cts_changed;
+        
         #ifdef __unix__
         
         int port_fd;
         struct termios port_termios;
         struct termios port_termios_saved;
         
+        /**
+         * Pipe used to wake the select thread.
+         * @see wake_select_thread()
+         */
+        int wake_fd[2];
+        
+        /**
+         * Driver flags before ASYNC_LOW_LATENCY was set, -1 if unchanged.
+         */
+        int serial_flags_saved;
+        
+        /**
+         * sysfs latency timer attribute of a USB serial adapter, empty if
+         * unchanged.
+         */
+        std::string latency_timer_path;
+        
+        /**
+         * Latency timer value before it was changed.
+         */
+        std::string latency_timer_saved;
+        
+        /**
+         * CTS thread ID, for interrupting TIOCMIWAIT.  Guarded by
+         * cts_mutex, valid while cts_thread_ready is set.
+         * @see stop_cts_thread()
+         */
+        pthread_t cts_thread_id;
+        
         #elif defined _WIN32
         
         HANDLE h_port;
@@ -356,6 +717,94 @@ protected:
          */
         Glib::Cond read_cond;
         
+        /**
+         * Write mutex, guards write_wait
+         * @see select_thread()
+         */
+        Glib::Mutex write_mutex;
+        
+        /**
+         * Select thread should watch for the port becoming writable.
+         * @see write_mutex
+         */
+        bool write_wait;
+        
+        /**
+         * Queued write.
+         */
+        struct WriteRequest
+        {
+                std::vector<char> data; ///< Data to write
+                gsize offset;           ///< Bytes already written
+                int writes;             ///< Write calls so far
+                WriteSlot slot;         ///< Completion callback
+        };
+        
+        /**
+         * Write queue.  Only accessed from the main loop.
+         * @see queue_write()
+         */
+        std::deque<WriteRequest> write_queue;
+        
+        /**
+         * Bytes in write_queue not yet written.
+         */
+        gsize write_queue_bytes;
+        
+        /**
+         * Write queue high water mark.
+         */
+        gsize write_high_water;
+        
+        /**
+         * Write queue is above the high water mark.
+         */
+        bool write_above_high_water;
+        
+        /**
+         * CTS state as last reported to the main loop.  The write queue
+         * is held while false.
+         * @see get_cts()
+         */
+        bool cts_asserted;
+        
+        /**
+         * CTS line state read by the CTS thread.  Guarded by cts_mutex.
+         */
+        bool cts_line;
+        
+        /**
+         * Time CTS was last seen to drop.  Guarded by cts_mutex.
+         */
+        uint64_t cts_fall_timestamp;
+        
+        /**
+         * Duration of the last CTS stall.  Guarded by cts_mutex.
+         */
+        uint64_t cts_last_stall;
+        
+        /**
+         * CTS thread has exited.  Guarded by cts_mutex.
+         */
+        bool cts_thread_done;
+        
+        /**
+         * CTS thread has published cts_thread_id.  Guarded by cts_mutex.
+         */
+        bool cts_thread_ready;
+        
+        /**
+         * CTS mutex
+         * @see cts_thread_func()
+         */
+        Glib::Mutex cts_mutex;
+        
+        /**
+         * Pointer for CTS thread
+         * @see cts_thread_func()
+         */
+        Glib::Thread *cts_thread;
+        
         /**
          * Pointer for select thread
          * @see select_thread()
@@ -378,6 +827,12 @@ protected:
          */
         unsigned long baud;
         
+        /**
+         * Actual baud rate as read back after configuring the port.
+         * @see get_actual_baud()
+         */
+        unsigned long actual_baud;
+        
         /**
          * Data bits.
          */
@@ -398,6 +853,12 @@ protected:
          */
         int stop;
         
+        /**
+         * Latency profile.  Written under running_mutex, since the select
+         * thread reads it.
+         */
+        SerialLatency latency;
+        
         /**
          * Recieve data synchronization.  Needed to prevent closing the port
          * due to an error when in on_receive_data.
@@ -410,6 +871,48 @@ protected:
          */
         bool called_close_port;
         
+        /**
+         * Port lost while in on_receive_data.
+         * @see port_lost()
+         */
+        bool called_port_lost;
+        
+        /**
+         * Auto reconnect enabled.
+         */
+        bool auto_reconnect;
+        
+        /**
+         * Waiting for lost port to reappear.
+         */
+        bool reconnecting;
+        
+        /**
+         * Stable path of the open port, used to find it again.
+         * @see find_stable_path()
+         */
+        Glib::ustring reconnect_path;
+        
+        /**
+         * Time the port was lost.
+         */
+        uint64_t disconnect_timestamp;
+        
+        /**
+         * Last outage duration.
+         */
+        uint64_t last_outage;
+        
+        /**
+         * Reconnect count.
+         */
+        unsigned int reconnect_count;
+        
+        /**
+         * Reconnect poll timer connection.
+         */
+        sigc::connection c_reconnect;
+        
         /**
          * Debug status.
          */
@@ -434,6 +937,26 @@ protected:
          * Port receive data signal.
          */
         sigc::signal<void> m_port_receive_data;
+        
+        /**
+         * Port write high water signal.
+         */
+        sigc::signal<void, bool> m_port_write_high_water;
+        
+        /**
+         * Port disconnected signal.
+         */
+        sigc::signal<void> m_port_disconnected;
+        
+        /**
+         * Port reconnected signal.
+         */
+        sigc::signal<void, uint64_t> m_port_reconnected;
+        
+        /**
+         * Port CTS signal.
+         */
+        sigc::signal<void, bool, uint64_t> m_port_cts;
 };
 
 #endif //__SERIALINTERFACE_H
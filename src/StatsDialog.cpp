@@ -0,0 +1,121 @@
+/************************************************************************/
+/* StatsDialog                                                          */
+/*                                                                      */
+/* ZigBee Terminal - Statistics Dialog                                  */
+/*                                                                      */
+/* StatsDialog.cpp                                                      */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "StatsDialog.h"
+
+StatsDialog::StatsDialog()
+{
+        stats = 0;
+        
+        set_title("Statistics");
+        set_border_width(5);
+        set_default_size(560, 400);
+        
+        btnReset = add_button(Gtk::Stock::CLEAR, Gtk::RESPONSE_APPLY);
+        btnReset->signal_clicked().connect( sigc::mem_fun(*this, &StatsDialog::on_reset_click) );
+        btnClose = add_button(Gtk::Stock::CLOSE, Gtk::RESPONSE_CLOSE);
+        btnClose->signal_clicked().connect( sigc::mem_fun(*this, &StatsDialog::on_close_click) );
+        set_default(*btnClose);
+        
+        tv.modify_font(Pango::FontDescription("monospace"));
+        tv.set_editable(false);
+        tv.set_wrap_mode(Gtk::WRAP_NONE);
+        
+        sw.add(tv);
+        sw.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+        get_vbox()->pack_start(sw, true, true, 0);
+        
+        show_all_children();
+}
+
+StatsDialog::~StatsDialog()
+{
+        c_refresh.disconnect();
+}
+
+void StatsDialog::set_stats(ZigBeeStats *s)
+{
+        stats = s;
+        refresh();
+}
+
+void StatsDialog::refresh()
+{
+        if (stats)
+                tv.get_buffer()->set_text(stats->get_desc());
+        else
+                tv.get_buffer()->set_text("No statistics available");
+}
+
+void StatsDialog::on_show()
+{
+        refresh();
+        
+        c_refresh.disconnect();
+        c_refresh = Glib::signal_timeout().connect( sigc::mem_fun(*this, &StatsDialog::on_refresh_timeout), 500 );
+        
+        Gtk::Dialog::on_show();
+}
+
+void StatsDialog::on_hide()
+{
+        c_refresh.disconnect();
+        
+        Gtk::Dialog::on_hide();
+}
+
+void StatsDialog::on_response(int response_id)
+{
+        if (response_id == Gtk::RESPONSE_DELETE_EVENT)
+                hide();
+}
+
+void StatsDialog::on_reset_click()
+{
+        if (stats)
+                stats->reset();
+        
+        refresh();
+}
+
+void StatsDialog::on_close_click()
+{
+        hide();
+}
+
+bool StatsDialog::on_refresh_timeout()
+{
+        refresh();
+        return true;
+}
+
@@ -0,0 +1,119 @@
+/************************************************************************/
+/* StatsDialog                                                          */
+/*                                                                      */
+/* ZigBee Terminal - Statistics Dialog                                  */
+/*                                                                      */
+/* StatsDialog.h                                                        */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __STATSDIALOG_H
+#define __STATSDIALOG_H
+
+#include "ZigBeeStats.h"
+
+#include <gtkmm.h>
+
+/** Statistics Dialog
+ * 
+ * Non-modal dialog showing ZigBee interface counters and latency
+ * histograms.  Refreshes periodically while visible.
+ */
+class StatsDialog : public Gtk::Dialog
+{
+public:
+        /**
+         * Create a new Statistics dialog.
+         */
+        StatsDialog();
+        virtual ~StatsDialog();
+        
+        /**
+         * Set statistics block to display.
+         * @param s pointer to statistics block
+         */
+        void set_stats(ZigBeeStats *s);
+        
+        /**
+         * Update displayed statistics.
+         */
+        void refresh();
+        
+protected:
+        //Signal handlers:
+        
+        /**
+         * Show signal handler
+         */
+        virtual void on_show();
+        
+        /**
+         * Hide signal handler
+         */
+        virtual void on_hide();
+        
+        /**
+         * Response signal handler.  Hides the dialog when the window is
+         * closed.
+         * @param response_id response ID
+         */
+        virtual void on_response(int response_id);
+        
+        /**
+         * Reset button click signal handler
+         */
+        void on_reset_click();
+        
+        /**
+         * Close button click signal handler
+         */
+        void on_close_click();
+        
+        /**
+         * Refresh timer handler
+         * @return true to keep timer running
+         */
+        bool on_refresh_timeout();
+        
+        //Child widgets:
+        Gtk::Button *btnReset;
+        Gtk::Button *btnClose;
+        Gtk::ScrolledWindow sw;
+        Gtk::TextView tv;
+        
+        /**
+         * Refresh timer connection.
+         */
+        sigc::connection c_refresh;
+        
+        /**
+         * Statistics block.
+         */
+        ZigBeeStats *stats;
+};
+
+#endif //__STATSDIALOG_H
@@ -0,0 +1,266 @@
+/************************************************************************/
+/* TopologyView                                                         */
+/*                                                                      */
+/* ZigBee Terminal - Network Topology View                              */
+/*                                                                      */
+/* TopologyView.cpp                                                     */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "TopologyView.h"
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+
+TopologyView::TopologyView()
+{
+        set_spacing(5);
+        
+        btnDiscover.set_label("Discover");
+        btnDiscover.signal_clicked().connect( sigc::mem_fun(*this, &TopologyView::on_discover_click) );
+        bbox.pack_start(btnDiscover);
+        
+        btnClear.set_label("Clear");
+        btnClear.signal_clicked().connect( sigc::mem_fun(*this, &TopologyView::on_clear_click) );
+        bbox.pack_start(btnClear);
+        
+        bbox.set_layout(Gtk::BUTTONBOX_START);
+        bbox.set_spacing(5);
+        pack_start(bbox, false, false, 0);
+        
+        tv_nodes_tm = Gtk::TreeStore::create(cNodeModel);
+        tv_nodes.set_model(tv_nodes_tm);
+        tv_nodes.append_column("Address", cNodeModel.Address);
+        tv_nodes.append_column("16-bit", cNodeModel.Addr16);
+        tv_nodes.append_column("Name", cNodeModel.Name);
+        tv_nodes.append_column("Type", cNodeModel.Type);
+        tv_nodes.append_column("Profile", cNodeModel.Profile);
+        tv_nodes.append_column("Manufacturer", cNodeModel.Manufacturer);
+        
+        sw_nodes.add(tv_nodes);
+        sw_nodes.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+        pack_start(sw_nodes, true, true, 0);
+        
+        lblSummary.set_alignment(0, 0.5);
+        pack_start(lblSummary, false, false, 0);
+        
+        show_all_children();
+}
+
+TopologyView::~TopologyView()
+{
+        c_flush.disconnect();
+}
+
+void TopologyView::set_interface(ZigBeeInterface &zb)
+{
+        topology.reset(new ZigBeeTopology(zb));
+        topology->signal_node_changed().connect( sigc::mem_fun(*this, &TopologyView::on_node_changed) );
+        topology->signal_cleared().connect( sigc::mem_fun(*this, &TopologyView::on_cleared) );
+}
+
+void TopologyView::on_discover_click()
+{
+        if (!topology)
+                return;
+        
+        if (topology->discover())
+                lblSummary.set_label("Discovering...");
+        else
+                lblSummary.set_label("Not connected");
+}
+
+void TopologyView::on_clear_click()
+{
+        if (topology)
+                topology->clear();
+}
+
+void TopologyView::on_node_changed(uint64_t addr64)
+{
+        dirty.insert(addr64);
+        
+        if (!c_flush.connected())
+                c_flush = Glib::signal_timeout().connect( sigc::mem_fun(*this, &TopologyView::on_flush_timeout), TOPOLOGY_VIEW_FLUSH_MS);
+}
+
+void TopologyView::on_cleared()
+{
+        c_flush.disconnect();
+        dirty.clear();
+        rows.clear();
+        row_parents.clear();
+        tv_nodes_tm->clear();
+        lblSummary.set_label("");
+}
+
+bool TopologyView::on_flush_timeout()
+{
+        std::set<uint64_t> work;
+        std::stringstream ss;
+        
+        // a node that appears or changes address can adopt existing nodes
+        for (std::set<uint64_t>::iterator it = dirty.begin(); it != dirty.end(); it++)
+        {
+                std::vector<uint64_t> children = topology->get_children(*it);
+                work.insert(*it);
+                work.insert(children.begin(), children.end());
+        }
+        
+        // moving a row queues the rows under it again
+        while (!work.empty())
+        {
+                dirty.clear();
+                
+                for (std::set<uint64_t>::iterator it = work.begin(); it != work.end(); it++)
+                        place_row(*it, 0);
+                
+                work.swap(dirty);
+        }
+        
+        ss << topology->size() << " nodes";
+        if (topology->is_discovering())
+                ss << ", discovering...";
+        lblSummary.set_label(ss.str());
+        
+        return false;
+}
+
+Gtk::TreeModel::iterator TopologyView::place_row(uint64_t addr64, int depth)
+{
+        const ZigBeeTopology::Node *n = topology->get_node(addr64);
+        const ZigBeeTopology::Node *p = NULL;
+        std::map<uint64_t, Gtk::TreeModel::iterator>::iterator it;
+        Gtk::TreeModel::iterator row;
+        uint64_t parent = ZIGBEE_ADDR64_BROADCAST;
+        
+        if (n == NULL)
+                return row;
+        
+        if (depth < TOPOLOGY_VIEW_MAX_DEPTH)
+                p = topology->get_parent(addr64);
+        
+        if (p)
+                parent = p->addr64;
+        
+        it = rows.find(addr64);
+        
+        if (it != rows.end())
+        {
+                // unchanged parent, update in place
+                if (row_parents[addr64] == parent)
+                {
+                        fill_row(*it->second, *n);
+                        return it->second;
+                }
+                
+                remove_row(it->second);
+        }
+        
+        if (p)
+        {
+                Gtk::TreeModel::iterator parent_row;
+                
+                it = rows.find(parent);
+                if (it != rows.end())
+                        parent_row = it->second;
+                else
+                        parent_row = place_row(parent, depth + 1);
+                
+                // placing a parent loop can place this node on the way
+                it = rows.find(addr64);
+                if (it != rows.end())
+                        return it->second;
+                
+                row = tv_nodes_tm->append(parent_row->children());
+        }
+        else
+        {
+                row = tv_nodes_tm->append();
+        }
+        
+        rows[addr64] = row;
+        row_parents[addr64] = parent;
+        
+        fill_row(*row, *n);
+        
+        tv_nodes.expand_to_path(tv_nodes_tm->get_path(row));
+        
+        return row;
+}
+
+void TopologyView::remove_row(Gtk::TreeModel::iterator row)
+{
+        std::vector<Gtk::TreeModel::iterator> stack;
+        
+        stack.push_back(row);
+        
+        while (!stack.empty())
+        {
+                Gtk::TreeModel::iterator r = stack.back();
+                uint64_t addr64 = (*r)[cNodeModel.Addr64];
+                stack.pop_back();
+                
+                rows.erase(addr64);
+                row_parents.erase(addr64);
+                
+                if (r != row)
+                        dirty.insert(addr64);
+                
+                Gtk::TreeModel::Children children = r->children();
+                for (Gtk::TreeModel::iterator c = children.begin(); c != children.end(); c++)
+                        stack.push_back(c);
+        }
+        
+        tv_nodes_tm->erase(row);
+}
+
+void TopologyView::fill_row(Gtk::TreeModel::Row row, const ZigBeeTopology::Node &n)
+{
+        std::stringstream addr, addr16, profile, mfg;
+        
+        addr << std::setfill('0') << std::hex << std::setw(16) << n.addr64;
+        
+        if (n.addr16 != ZIGBEE_ADDR16_UNKNOWN)
+                addr16 << std::setfill('0') << std::hex << std::setw(4) << n.addr16;
+        
+        if (n.identified)
+        {
+                profile << std::setfill('0') << std::hex << std::setw(4) << n.profile_id;
+                mfg << std::setfill('0') << std::hex << std::setw(4) << n.manufacturer_id;
+        }
+        
+        row[cNodeModel.Addr64] = n.addr64;
+        row[cNodeModel.Address] = addr.str();
+        row[cNodeModel.Addr16] = addr16.str();
+        row[cNodeModel.Name] = n.name;
+        row[cNodeModel.Type] = ZigBeeTopology::get_device_type_desc(n.device_type);
+        row[cNodeModel.Profile] = profile.str();
+        row[cNodeModel.Manufacturer] = mfg.str();
+}
@@ -0,0 +1,180 @@
+/************************************************************************/
+/* TopologyView                                                         */
+/*                                                                      */
+/* ZigBee Terminal - Network Topology View                              */
+/*                                                                      */
+/* TopologyView.h                                                       */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __TOPOLOGYVIEW_H
+#define __TOPOLOGYVIEW_H
+
+#include "ZigBeeInterface.h"
+#include "ZigBeeTopology.h"
+
+#include <gtkmm.h>
+
+#include <tr1/memory>
+#include <map>
+#include <set>
+
+#define TOPOLOGY_VIEW_FLUSH_MS 250
+#define TOPOLOGY_VIEW_MAX_DEPTH 16
+
+/** Network Topology View
+ * 
+ * Tree of the nodes in a ZigBeeTopology, with end devices under their
+ * parents and routers under the coordinator.  Node changes are collected
+ * and applied on a short timer, touching only the rows of nodes that
+ * changed; a row is only moved when its parent changes, so large networks
+ * are not redrawn as they are discovered.
+ */
+class TopologyView : public Gtk::VBox
+{
+public:
+        /**
+         * Create a topology view.
+         */
+        TopologyView();
+        virtual ~TopologyView();
+        
+        /**
+         * Set interface to track the topology of.
+         * @param zb interface
+         */
+        void set_interface(ZigBeeInterface &zb);
+        
+protected:
+        //Signal handlers:
+        
+        /**
+         * Discover button click signal handler
+         */
+        void on_discover_click();
+        
+        /**
+         * Clear button click signal handler
+         */
+        void on_clear_click();
+        
+        /**
+         * Topology node changed handler
+         * @param addr64 node 64-bit address
+         */
+        void on_node_changed(uint64_t addr64);
+        
+        /**
+         * Topology cleared handler
+         */
+        void on_cleared();
+        
+        /**
+         * Flush timer handler
+         * @return false, timer is one shot
+         */
+        bool on_flush_timeout();
+        
+        /**
+         * Create or move the row for a node and fill it in.
+         * @param addr64 node 64-bit address
+         * @param depth recursion depth, to stop parent loops
+         * @return row
+         */
+        Gtk::TreeModel::iterator place_row(uint64_t addr64, int depth);
+        
+        /**
+         * Remove a row and forget the rows under it.
+         * @param row row to remove
+         */
+        void remove_row(Gtk::TreeModel::iterator row);
+        
+        /**
+         * Fill in the columns of a row.
+         * @param row row
+         * @param n node
+         */
+        void fill_row(Gtk::TreeModel::Row row, const ZigBeeTopology::Node &n);
+        
+        // Tree model columns
+        class NodeModel : public Gtk::TreeModel::ColumnRecord
+        {
+        public:
+                NodeModel()
+                { add(Addr64); add(Address); add(Addr16); add(Name); add(Type); add(Profile); add(Manufacturer); }
+                
+                Gtk::TreeModelColumn<guint64> Addr64;
+                Gtk::TreeModelColumn<Glib::ustring> Address;
+                Gtk::TreeModelColumn<Glib::ustring> Addr16;
+                Gtk::TreeModelColumn<Glib::ustring> Name;
+                Gtk::TreeModelColumn<Glib::ustring> Type;
+                Gtk::TreeModelColumn<Glib::ustring> Profile;
+                Gtk::TreeModelColumn<Glib::ustring> Manufacturer;
+        };
+        
+        NodeModel cNodeModel;
+        
+        Glib::RefPtr<Gtk::TreeStore> tv_nodes_tm;
+        
+        //Child widgets:
+        Gtk::HButtonBox bbox;
+        Gtk::Button btnDiscover;
+        Gtk::Button btnClear;
+        Gtk::ScrolledWindow sw_nodes;
+        Gtk::TreeView tv_nodes;
+        Gtk::Label lblSummary;
+        
+        /**
+         * Rows by node 64-bit address.  Tree store iterators persist
+         * across changes to other rows.
+         */
+        std::map<uint64_t, Gtk::TreeModel::iterator> rows;
+        
+        /**
+         * Parent each row was placed under, ZIGBEE_ADDR64_BROADCAST for
+         * top level rows.
+         */
+        std::map<uint64_t, uint64_t> row_parents;
+        
+        /**
+         * Nodes changed since the last flush.
+         */
+        std::set<uint64_t> dirty;
+        
+        /**
+         * Flush timer connection.
+         */
+        sigc::connection c_flush;
+        
+        /**
+         * Topology model.
+         */
+        std::tr1::shared_ptr<ZigBeeTopology> topology;
+};
+
+#endif //__TOPOLOGYVIEW_H
+
@@ -0,0 +1,397 @@
+/************************************************************************/
+/* TrafficDialog                                                        */
+/*                                                                      */
+/* ZigBee Terminal - Traffic Generator Dialog                           */
+/*                                                                      */
+/* TrafficDialog.cpp                                                    */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "TrafficDialog.h"
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+TrafficDialog::TrafficDialog()
+{
+        set_title("Traffic Generator");
+        set_border_width(5);
+        set_default_size(640, 600);
+        
+        btnStart = add_button(Gtk::Stock::EXECUTE, Gtk::RESPONSE_APPLY);
+        btnStart->signal_clicked().connect( sigc::mem_fun(*this, &TrafficDialog::on_start_click) );
+        btnStop = add_button(Gtk::Stock::STOP, Gtk::RESPONSE_CANCEL);
+        btnStop->signal_clicked().connect( sigc::mem_fun(*this, &TrafficDialog::on_stop_click) );
+        btnStop->set_sensitive(false);
+        btnClose = add_button(Gtk::Stock::CLOSE, Gtk::RESPONSE_CLOSE);
+        btnClose->signal_clicked().connect( sigc::mem_fun(*this, &TrafficDialog::on_close_click) );
+        set_default(*btnStart);
+        
+        get_vbox()->pack_start(vpane, true, true, 0);
+        
+        // traffic setup
+        frame.set_label("Traffic");
+        vpane.pack1(frame, false, false);
+        
+        table.resize(5, 4);
+        table.set_col_spacings(10);
+        table.set_row_spacings(5);
+        table.set_border_width(5);
+        frame.add(table);
+        
+        label1.set_label("Destinations (64-bit address[,16-bit address] per line):");
+        label1.set_alignment(0, 0.5);
+        table.attach(label1, 0, 4, 0, 1, Gtk::FILL, Gtk::FILL);
+        
+        tv_dest_list.modify_font(Pango::FontDescription("monospace"));
+        tv_dest_list.set_size_request(-1, 80);
+        sw_dests.add(tv_dest_list);
+        sw_dests.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+        sw_dests.set_shadow_type(Gtk::SHADOW_IN);
+        table.attach(sw_dests, 0, 4, 1, 2);
+        
+        label2.set_label("Unicast weight:");
+        table.attach(label2, 0, 1, 2, 3, Gtk::FILL, Gtk::FILL);
+        table.attach(spnWeight[ZigBeeTrafficGen::TK_Unicast], 1, 2, 2, 3, Gtk::FILL, Gtk::FILL);
+        
+        label3.set_label("Broadcast weight:");
+        table.attach(label3, 2, 3, 2, 3, Gtk::FILL, Gtk::FILL);
+        table.attach(spnWeight[ZigBeeTrafficGen::TK_Broadcast], 3, 4, 2, 3, Gtk::FILL, Gtk::FILL);
+        
+        label4.set_label("Explicit unicast weight:");
+        table.attach(label4, 0, 1, 3, 4, Gtk::FILL, Gtk::FILL);
+        table.attach(spnWeight[ZigBeeTrafficGen::TK_EAUnicast], 1, 2, 3, 4, Gtk::FILL, Gtk::FILL);
+        
+        label5.set_label("Explicit broadcast weight:");
+        table.attach(label5, 2, 3, 3, 4, Gtk::FILL, Gtk::FILL);
+        table.attach(spnWeight[ZigBeeTrafficGen::TK_EABroadcast], 3, 4, 3, 4, Gtk::FILL, Gtk::FILL);
+        
+        for (int i = 0; i < ZigBeeTrafficGen::TK_Count; i++)
+        {
+                spnWeight[i].set_range(0, 100);
+                spnWeight[i].set_increments(1, 10);
+                spnWeight[i].set_value(i == ZigBeeTrafficGen::TK_Unicast ? 1 : 0);
+        }
+        
+        label6.set_label("Rate (frames/s):");
+        table.attach(label6, 0, 1, 4, 5, Gtk::FILL, Gtk::FILL);
+        
+        spnRate.set_range(1, ZIGBEE_TRAFFIC_MAX_RATE);
+        spnRate.set_increments(1, 10);
+        spnRate.set_value(ZIGBEE_TRAFFIC_DEFAULT_RATE);
+        table.attach(spnRate, 1, 2, 4, 5, Gtk::FILL, Gtk::FILL);
+        
+        label7.set_label("Payload (bytes):");
+        table.attach(label7, 2, 3, 4, 5, Gtk::FILL, Gtk::FILL);
+        
+        spnPayload.set_range(ZIGBEE_TRAFFIC_MIN_PAYLOAD, ZIGBEE_TRAFFIC_MAX_PAYLOAD);
+        spnPayload.set_increments(1, 8);
+        spnPayload.set_value(ZIGBEE_TRAFFIC_DEFAULT_PAYLOAD);
+        table.attach(spnPayload, 3, 4, 4, 5, Gtk::FILL, Gtk::FILL);
+        
+        // results
+        vpane.pack2(vbox_results, true, false);
+        
+        graph.set_size_request(-1, 160);
+        graph.signal_expose_event().connect( sigc::mem_fun(*this, &TrafficDialog::on_graph_expose) );
+        vbox_results.pack_start(graph, false, false, 0);
+        
+        tv_dests_tm = Gtk::ListStore::create(cDestModel);
+        tv_dests.set_model(tv_dests_tm);
+        tv_dests.append_column("Destination", cDestModel.Dest);
+        tv_dests.append_column("Sent", cDestModel.Sent);
+        tv_dests.append_column("Delivered", cDestModel.Delivered);
+        tv_dests.append_column("Failed", cDestModel.Failed);
+        tv_dests.append_column("Lost", cDestModel.Lost);
+        tv_dests.append_column("Loss", cDestModel.Loss);
+        tv_dests.append_column("Latency", cDestModel.Latency);
+        
+        sw_results.add(tv_dests);
+        sw_results.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+        vbox_results.pack_start(sw_results, true, true, 0);
+        
+        lblSummary.set_alignment(0, 0.5);
+        vbox_results.pack_start(lblSummary, false, false, 0);
+        
+        show_all_children();
+}
+
+TrafficDialog::~TrafficDialog()
+{
+        
+}
+
+void TrafficDialog::set_interface(ZigBeeInterface &zb)
+{
+        gen = std::tr1::shared_ptr<ZigBeeTrafficGen>(new ZigBeeTrafficGen(zb));
+        gen->signal_sample().connect( sigc::mem_fun(*this, &TrafficDialog::on_sample) );
+}
+
+void TrafficDialog::on_response(int response_id)
+{
+        if (response_id == Gtk::RESPONSE_DELETE_EVENT)
+                hide();
+}
+
+void TrafficDialog::on_start_click()
+{
+        int dests;
+        
+        if (!gen || gen->is_running())
+                return;
+        
+        gen->clear_destinations();
+        
+        dests = parse_destinations();
+        
+        if (dests < 0)
+        {
+                lblSummary.set_label("Invalid destination address");
+                return;
+        }
+        
+        for (int i = 0; i < ZigBeeTrafficGen::TK_Count; i++)
+                gen->set_weight((ZigBeeTrafficGen::TrafficKind)i, spnWeight[i].get_value_as_int());
+        
+        gen->set_rate(spnRate.get_value());
+        gen->set_payload_size(spnPayload.get_value_as_int());
+        
+        if (!gen->start())
+        {
+                lblSummary.set_label(dests == 0 ? "No destinations for unicast traffic" : "Unable to start");
+                return;
+        }
+        
+        tv_dests_tm->clear();
+        
+        for (size_t i = 0; i < gen->get_destinations().size(); i++)
+                tv_dests_tm->append();
+        
+        btnStart->set_sensitive(false);
+        btnStop->set_sensitive(true);
+        
+        update_results();
+        graph.queue_draw();
+}
+
+void TrafficDialog::on_stop_click()
+{
+        if (gen)
+                gen->stop();
+        
+        btnStart->set_sensitive(true);
+        btnStop->set_sensitive(false);
+}
+
+void TrafficDialog::on_close_click()
+{
+        hide();
+}
+
+void TrafficDialog::on_sample()
+{
+        update_results();
+        graph.queue_draw();
+}
+
+bool TrafficDialog::on_graph_expose(GdkEventExpose *event)
+{
+        Glib::RefPtr<Gdk::Window> window = graph.get_window();
+        
+        if (!window)
+                return false;
+        
+        Cairo::RefPtr<Cairo::Context> cr = window->create_cairo_context();
+        Gtk::Allocation alloc = graph.get_allocation();
+        double w = alloc.get_width();
+        double h = alloc.get_height();
+        double x_step = w / (ZIGBEE_TRAFFIC_HISTORY - 1);
+        double scale = 1;
+        
+        cr->set_source_rgb(1, 1, 1);
+        cr->paint();
+        
+        // grid
+        cr->set_line_width(1);
+        cr->set_source_rgb(0.85, 0.85, 0.85);
+        for (int i = 1; i < 4; i++)
+        {
+                cr->move_to(0, h * i / 4 + 0.5);
+                cr->line_to(w, h * i / 4 + 0.5);
+        }
+        cr->stroke();
+        
+        if (!gen)
+                return true;
+        
+        const std::deque<ZigBeeTrafficGen::Sample> &history = gen->get_history();
+        
+        // rates share a scale with headroom over the target; loss is 0-100%
+        scale = gen->get_rate() * 1.25;
+        for (size_t i = 0; i < history.size(); i++)
+                if (history[i].sent_rate > scale)
+                        scale = history[i].sent_rate;
+        
+        // newest sample at the right edge
+        double x0 = history.size() > 1 ? w - (history.size() - 1) * x_step : 0;
+        
+        cr->set_line_width(2);
+        
+        for (int series = 0; series < 3 && history.size() > 1; series++)
+        {
+                if (series == 0)
+                        cr->set_source_rgb(0.2, 0.4, 0.8);
+                else if (series == 1)
+                        cr->set_source_rgb(0.2, 0.7, 0.2);
+                else
+                        cr->set_source_rgb(0.8, 0.2, 0.2);
+                
+                for (size_t i = 0; i < history.size(); i++)
+                {
+                        const ZigBeeTrafficGen::Sample &s = history[i];
+                        double v = series == 0 ? s.sent_rate / scale :
+                                series == 1 ? s.delivered_rate / scale : s.loss;
+                        double y = h - 1 - v * (h - 2);
+                        
+                        if (i == 0)
+                                cr->move_to(x0 + i * x_step, y);
+                        else
+                                cr->line_to(x0 + i * x_step, y);
+                }
+                
+                cr->stroke();
+        }
+        
+        // legend
+        std::stringstream ss;
+        ss << "full scale " << (int)scale << " frames/s";
+        
+        cr->set_font_size(11);
+        cr->set_source_rgb(0.2, 0.4, 0.8);
+        cr->move_to(5, 14);
+        cr->show_text("sent");
+        cr->set_source_rgb(0.2, 0.7, 0.2);
+        cr->move_to(45, 14);
+        cr->show_text("delivered");
+        cr->set_source_rgb(0.8, 0.2, 0.2);
+        cr->move_to(115, 14);
+        cr->show_text("loss %");
+        cr->set_source_rgb(0.4, 0.4, 0.4);
+        cr->move_to(170, 14);
+        cr->show_text(ss.str());
+        
+        return true;
+}
+
+void TrafficDialog::update_results()
+{
+        const std::vector<ZigBeeTrafficGen::Destination> &dests = gen->get_destinations();
+        Gtk::TreeModel::Children rows = tv_dests_tm->children();
+        uint64_t sent = 0, delivered = 0, missed = 0;
+        std::stringstream ss;
+        
+        for (size_t i = 0; i < dests.size() && i < rows.size(); i++)
+        {
+                const ZigBeeTrafficGen::Destination &d = dests[i];
+                Gtk::TreeModel::Row row = rows[i];
+                std::stringstream name, loss, lat;
+                uint64_t outcomes = d.delivered + d.failed + d.lost;
+                
+                if (i == 0)
+                        name << "broadcast";
+                else
+                        name << std::setfill('0') << std::setw(16) << std::hex << d.addr64;
+                
+                if (outcomes)
+                        loss << std::fixed << std::setprecision(1) << 100.0 * (d.failed + d.lost) / outcomes << "%";
+                
+                if (d.latency.get_count())
+                        lat << std::fixed << std::setprecision(1) << d.latency.get_mean() / 1000.0 << " ms, p99 "
+                                << d.latency.get_percentile(99) / 1000.0 << " ms";
+                
+                row[cDestModel.Dest] = name.str();
+                row[cDestModel.Sent] = d.sent;
+                row[cDestModel.Delivered] = d.delivered;
+                row[cDestModel.Failed] = d.failed;
+                row[cDestModel.Lost] = d.lost;
+                row[cDestModel.Loss] = loss.str();
+                row[cDestModel.Latency] = lat.str();
+                
+                sent += d.sent;
+                delivered += d.delivered;
+                missed += d.failed + d.lost;
+        }
+        
+        ss << sent << " sent, " << delivered << " delivered, " << missed << " failed or lost";
+        
+        if (gen->get_history().size())
+                ss << ", " << std::fixed << std::setprecision(1) << gen->get_history().back().sent_rate << " frames/s";
+        
+        if (!gen->is_running())
+                ss << " (stopped)";
+        
+        lblSummary.set_label(ss.str());
+}
+
+int TrafficDialog::parse_destinations()
+{
+        std::stringstream ss(tv_dest_list.get_buffer()->get_text());
+        std::string line;
+        int count = 0;
+        
+        while (std::getline(ss, line))
+        {
+                size_t comma = line.find(',');
+                std::vector<uint8_t> a64, a16;
+                uint64_t addr64 = 0;
+                uint16_t addr16 = 0xfffe;
+                
+                if (line.find_first_not_of(" \t\r") == std::string::npos)
+                        continue;
+                
+                if (!ZigBeePacket::parse_hex_bytes(line.substr(0, comma), a64) || a64.size() != 8)
+                        return -1;
+                
+                for (int i = 0; i < 8; i++)
+                        addr64 = (addr64 << 8) | a64[i];
+                
+                if (comma != std::string::npos)
+                {
+                        if (!ZigBeePacket::parse_hex_bytes(line.substr(comma + 1), a16) || a16.size() != 2)
+                                return -1;
+                        addr16 = (a16[0] << 8) | a16[1];
+                }
+                
+                gen->add_destination(addr64, addr16);
+                count++;
+        }
+        
+        return count;
+}
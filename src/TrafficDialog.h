@@ -0,0 +1,167 @@
+/************************************************************************/
+/* TrafficDialog                                                        */
+/*                                                                      */
+/* ZigBee Terminal - Traffic Generator Dialog                           */
+/*                                                                      */
+/* TrafficDialog.h                                                      */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __TRAFFICDIALOG_H
+#define __TRAFFICDIALOG_H
+
+#include "ZigBeeInterface.h"
+#include "ZigBeeTrafficGen.h"
+
+#include <gtkmm.h>
+
+#include <tr1/memory>
+
+/** Traffic Generator Dialog
+ * 
+ * Non-modal dialog for running the traffic generator.  Destinations are
+ * entered one per line as a 64-bit address, optionally followed by a
+ * comma and the 16-bit address.  The graph shows sent and delivered
+ * frames per second and the loss rate over the last two minutes, and the
+ * table shows results per destination.
+ */
+class TrafficDialog : public Gtk::Dialog
+{
+public:
+        /**
+         * Create a new Traffic Generator dialog.
+         */
+        TrafficDialog();
+        virtual ~TrafficDialog();
+        
+        /**
+         * Set interface to send on.
+         * @param zb interface
+         */
+        void set_interface(ZigBeeInterface &zb);
+        
+protected:
+        //Signal handlers:
+        
+        /**
+         * Response signal handler.  Hides the dialog when the window is
+         * closed.
+         * @param response_id response ID
+         */
+        virtual void on_response(int response_id);
+        
+        /**
+         * Start button click signal handler
+         */
+        void on_start_click();
+        
+        /**
+         * Stop button click signal handler
+         */
+        void on_stop_click();
+        
+        /**
+         * Close button click signal handler
+         */
+        void on_close_click();
+        
+        /**
+         * Generator sample handler
+         */
+        void on_sample();
+        
+        /**
+         * Graph expose handler
+         * @param event expose event
+         * @return true if handled
+         */
+        bool on_graph_expose(GdkEventExpose *event);
+        
+        /**
+         * Update destination rows and summary.
+         */
+        void update_results();
+        
+        /**
+         * Parse destination list into the generator.
+         * @return number of destinations, -1 on error
+         */
+        int parse_destinations();
+        
+        // Tree model columns
+        class DestModel : public Gtk::TreeModel::ColumnRecord
+        {
+        public:
+                DestModel()
+                { add(Dest); add(Sent); add(Delivered); add(Failed); add(Lost); add(Loss); add(Latency); }
+                
+                Gtk::TreeModelColumn<Glib::ustring> Dest;
+                Gtk::TreeModelColumn<guint64> Sent;
+                Gtk::TreeModelColumn<guint64> Delivered;
+                Gtk::TreeModelColumn<guint64> Failed;
+                Gtk::TreeModelColumn<guint64> Lost;
+                Gtk::TreeModelColumn<Glib::ustring> Loss;
+                Gtk::TreeModelColumn<Glib::ustring> Latency;
+        };
+        
+        DestModel cDestModel;
+        
+        Glib::RefPtr<Gtk::ListStore> tv_dests_tm;
+        
+        //Child widgets:
+        Gtk::Button *btnStart;
+        Gtk::Button *btnStop;
+        Gtk::Button *btnClose;
+        Gtk::VPaned vpane;
+        Gtk::Frame frame;
+        Gtk::Table table;
+        Gtk::Label label1;
+        Gtk::Label label2;
+        Gtk::Label label3;
+        Gtk::Label label4;
+        Gtk::Label label5;
+        Gtk::Label label6;
+        Gtk::Label label7;
+        Gtk::ScrolledWindow sw_dests;
+        Gtk::TextView tv_dest_list;
+        Gtk::SpinButton spnWeight[ZigBeeTrafficGen::TK_Count];
+        Gtk::SpinButton spnRate;
+        Gtk::SpinButton spnPayload;
+        Gtk::VBox vbox_results;
+        Gtk::DrawingArea graph;
+        Gtk::ScrolledWindow sw_results;
+        Gtk::TreeView tv_dests;
+        Gtk::Label lblSummary;
+        
+        /**
+         * Traffic generator.
+         */
+        std::tr1::shared_ptr<ZigBeeTrafficGen> gen;
+};
+
+#endif //__TRAFFICDIALOG_H
+
@@ -0,0 +1,432 @@
+/************************************************************************/
+/* ZigBeeATBatch                                                        */
+/*                                                                      */
+/* ZigBee Terminal - Remote AT Batch                                    */
+/*                                                                      */
+/* ZigBeeATBatch.cpp                                                    */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ZigBeeATBatch.h"
+
+#include <iostream>
+
+
+ZigBeeATBatch::ZigBeeATBatch(ZigBeeInterface &zb) :
+        zb_int(zb),
+        next_node(0),
+        finished(0),
+        max_in_flight(ZIGBEE_AT_BATCH_DEFAULT_IN_FLIGHT),
+        timeout(ZIGBEE_AT_BATCH_DEFAULT_TIMEOUT_MS),
+        retries(ZIGBEE_AT_BATCH_DEFAULT_RETRIES),
+        running(false),
+        write_blocked(false),
+        start_timestamp(0),
+        finish_timestamp(0)
+{
+        zb_int.signal_receive_packet().connect( sigc::mem_fun(*this, &ZigBeeATBatch::on_receive_packet) );
+        zb_int.signal_write_high_water().connect( sigc::mem_fun(*this, &ZigBeeATBatch::on_write_high_water) );
+}
+
+
+ZigBeeATBatch::~ZigBeeATBatch()
+{
+        c_timeout.disconnect();
+}
+
+
+void ZigBeeATBatch::clear()
+{
+        if (running)
+                cancel();
+        
+        commands.clear();
+        nodes.clear();
+        results.clear();
+        in_flight.clear();
+        finished = 0;
+        start_timestamp = 0;
+        finish_timestamp = 0;
+}
+
+
+void ZigBeeATBatch::add_node(uint64_t addr64, uint16_t addr16)
+{
+        Node n;
+        
+        n.addr64 = addr64;
+        n.addr16 = addr16;
+        n.next = 0;
+        n.busy = false;
+        
+        nodes.push_back(n);
+}
+
+
+bool ZigBeeATBatch::add_command(std::string cmd, std::vector<uint8_t> param)
+{
+        if (cmd.size() != 2)
+                return false;
+        
+        commands.push_back(std::make_pair(cmd, param));
+        
+        return true;
+}
+
+
+bool ZigBeeATBatch::start()
+{
+        if (running || nodes.size() == 0 || commands.size() == 0)
+                return false;
+        
+        results.clear();
+        in_flight.clear();
+        
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+                nodes[i].next = 0;
+                nodes[i].busy = false;
+                
+                for (size_t j = 0; j < commands.size(); j++)
+                {
+                        Result r;
+                        r.addr64 = nodes[i].addr64;
+                        r.addr16 = nodes[i].addr16;
+                        r.cmd = commands[j].first;
+                        r.param = commands[j].second;
+                        r.state = BS_Pending;
+                        r.status = 0;
+                        r.attempts = 0;
+                        r.latency = 0;
+                        results.push_back(r);
+                }
+        }
+        
+        next_node = 0;
+        finished = 0;
+        running = true;
+        write_blocked = zb_int.is_write_blocked();
+        start_timestamp = SerialInterface::get_timestamp();
+        finish_timestamp = 0;
+        
+        c_timeout.disconnect();
+        c_timeout = Glib::signal_timeout().connect( sigc::mem_fun(*this, &ZigBeeATBatch::on_timeout), ZIGBEE_AT_BATCH_POLL_MS );
+        
+        pump();
+        
+        return true;
+}
+
+
+void ZigBeeATBatch::cancel()
+{
+        if (!running)
+                return;
+        
+        in_flight.clear();
+        
+        for (size_t i = 0; i < results.size(); i++)
+        {
+                if (results[i].state == BS_Pending || results[i].state == BS_InFlight)
+                        results[i].state = BS_Cancelled;
+        }
+        
+        running = false;
+        finish_timestamp = SerialInterface::get_timestamp();
+        c_timeout.disconnect();
+        
+        m_signal_finished.emit(finish_timestamp - start_timestamp);
+}
+
+
+bool ZigBeeATBatch::is_running()
+{
+        return running;
+}
+
+
+int ZigBeeATBatch::set_max_in_flight(int n)
+{
+        if (n > 0 && n <= ZIGBEE_AT_BATCH_MAX_IN_FLIGHT)
+                max_in_flight = n;
+        
+        return max_in_flight;
+}
+
+
+int ZigBeeATBatch::get_max_in_flight()
+{
+        return max_in_flight;
+}
+
+
+int ZigBeeATBatch::set_timeout(int ms)
+{
+        if (ms > 0)
+                timeout = ms;
+        
+        return timeout;
+}
+
+
+int ZigBeeATBatch::get_timeout()
+{
+        return timeout;
+}
+
+
+int ZigBeeATBatch::set_retries(int n)
+{
+        if (n >= 0)
+                retries = n;
+        
+        return retries;
+}
+
+
+int ZigBeeATBatch::get_retries()
+{
+        return retries;
+}
+
+
+const std::vector<ZigBeeATBatch::Result> &ZigBeeATBatch::get_results()
+{
+        return results;
+}
+
+
+int ZigBeeATBatch::get_finished_count()
+{
+        return finished;
+}
+
+
+uint64_t ZigBeeATBatch::get_elapsed()
+{
+        if (!start_timestamp)
+                return 0;
+        
+        if (finish_timestamp)
+                return finish_timestamp - start_timestamp;
+        
+        return SerialInterface::get_timestamp() - start_timestamp;
+}
+
+
+// Static
+std::string ZigBeeATBatch::get_state_desc(BatchState s)
+{
+        switch (s)
+        {
+                case BS_Pending:
+                        return "Pending";
+                case BS_InFlight:
+                        return "Sent";
+                case BS_OK:
+                        return "OK";
+                case BS_Error:
+                        return "Error";
+                case BS_Timeout:
+                        return "Timeout";
+                case BS_Cancelled:
+                        return "Cancelled";
+                default:
+                        return "Unknown";
+        }
+}
+
+
+sigc::signal<void, int> ZigBeeATBatch::signal_result()
+{
+        return m_signal_result;
+}
+
+
+sigc::signal<void, uint64_t> ZigBeeATBatch::signal_finished()
+{
+        return m_signal_finished;
+}
+
+
+void ZigBeeATBatch::on_receive_packet(ZigBeePacket pkt)
+{
+        std::map<uint8_t, Request>::iterator it;
+        
+        if (!running || pkt.identifier != ZigBeePacket::ZBPID_RemoteCommandResponse)
+                return;
+        
+        it = in_flight.find(pkt.frame_id);
+        
+        // frame IDs are shared with other senders, so check the source too
+        if (it == in_flight.end() || nodes[it->second.node].addr64 != pkt.src64)
+                return;
+        
+        Request req = it->second;
+        Result &r = results[req.result];
+        
+        in_flight.erase(it);
+        
+        r.latency = SerialInterface::get_timestamp() - req.timestamp;
+        r.addr16 = pkt.src16;
+        nodes[req.node].addr16 = pkt.src16;
+        
+        if (pkt.status == ZIGBEE_AT_STATUS_TX_FAILURE && r.attempts <= retries)
+        {
+                send_request(req.node, req.result);
+                return;
+        }
+        
+        r.status = pkt.status;
+        r.data = pkt.data;
+        
+        finish(req.node, req.result, pkt.status == 0 ? BS_OK : BS_Error);
+        
+        pump();
+}
+
+
+void ZigBeeATBatch::on_write_high_water(bool blocked)
+{
+        write_blocked = blocked;
+        
+        if (!write_blocked)
+                pump();
+}
+
+
+bool ZigBeeATBatch::on_timeout()
+{
+        uint64_t now = SerialInterface::get_timestamp();
+        std::map<uint8_t, Request>::iterator it;
+        std::vector<Request> expired;
+        
+        for (it = in_flight.begin(); it != in_flight.end(); )
+        {
+                if (now - it->second.timestamp > timeout * 1000ULL)
+                {
+                        expired.push_back(it->second);
+                        in_flight.erase(it++);
+                }
+                else
+                {
+                        ++it;
+                }
+        }
+        
+        for (size_t i = 0; i < expired.size() && running; i++)
+        {
+                if (results[expired[i].result].attempts <= retries)
+                        send_request(expired[i].node, expired[i].result);
+                else
+                        finish(expired[i].node, expired[i].result, BS_Timeout);
+        }
+        
+        pump();
+        
+        return running;
+}
+
+
+void ZigBeeATBatch::pump()
+{
+        size_t checked = 0;
+        
+        // round robin over the nodes so a slow node does not hold up the
+        // rest of the list
+        while (running && !write_blocked && zb_int.is_connected() &&
+                (int)in_flight.size() < max_in_flight && checked < nodes.size())
+        {
+                Node &n = nodes[next_node];
+                
+                if (!n.busy && n.next < commands.size())
+                {
+                        send_request(next_node, next_node * commands.size() + n.next);
+                        checked = 0;
+                }
+                else
+                {
+                        checked++;
+                }
+                
+                next_node = (next_node + 1) % nodes.size();
+        }
+}
+
+
+void ZigBeeATBatch::send_request(int node, int result)
+{
+        Node &n = nodes[node];
+        Result &r = results[result];
+        ZigBeePacket pkt;
+        Request req;
+        
+        pkt.identifier = ZigBeePacket::ZBPID_RemoteATCommand;
+        pkt.frame_id = zb_int.get_next_frame_id();
+        pkt.dest64 = n.addr64;
+        pkt.dest16 = n.addr16;
+        // apply changes immediately
+        pkt.options = 0x02;
+        pkt.at_cmd[0] = r.cmd[0];
+        pkt.at_cmd[1] = r.cmd[1];
+        pkt.data = r.param;
+        pkt.build_packet();
+        
+        req.node = node;
+        req.result = result;
+        req.timestamp = SerialInterface::get_timestamp();
+        in_flight[pkt.frame_id] = req;
+        
+        n.busy = true;
+        r.state = BS_InFlight;
+        r.attempts++;
+        
+        zb_int.send_packet(pkt);
+}
+
+
+void ZigBeeATBatch::finish(int node, int result, BatchState state)
+{
+        results[result].state = state;
+        
+        nodes[node].busy = false;
+        nodes[node].next++;
+        
+        finished++;
+        
+        m_signal_result.emit(result);
+        
+        if (finished < (int)results.size())
+                return;
+        
+        running = false;
+        finish_timestamp = SerialInterface::get_timestamp();
+        c_timeout.disconnect();
+        
+        m_signal_finished.emit(finish_timestamp - start_timestamp);
+}
+
@@ -0,0 +1,366 @@
+/************************************************************************/
+/* ZigBeeATBatch                                                        */
+/*                                                                      */
+/* ZigBee Terminal - Remote AT Batch                                    */
+/*                                                                      */
+/* ZigBeeATBatch.h                                                      */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __ZIGBEE_AT_BATCH_H
+#define __ZIGBEE_AT_BATCH_H
+
+#include <gtkmm.h>
+
+#include "ZigBeeInterface.h"
+#include "ZigBeePacket.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <inttypes.h>
+
+#define ZIGBEE_AT_BATCH_DEFAULT_IN_FLIGHT 8
+#define ZIGBEE_AT_BATCH_MAX_IN_FLIGHT 64
+#define ZIGBEE_AT_BATCH_DEFAULT_TIMEOUT_MS 10000
+#define ZIGBEE_AT_BATCH_DEFAULT_RETRIES 2
+#define ZIGBEE_AT_BATCH_POLL_MS 250
+#define ZIGBEE_AT_STATUS_TX_FAILURE 0x04
+
+/** ZigBee Remote AT Batch
+ * 
+ * Runs a set of AT commands on a list of nodes with Remote AT Command
+ * Request (0x17) frames and collects the Remote Command Response (0x97)
+ * results.  Each node runs its commands in order, one at a time, so a
+ * parameter change followed by WR behaves as expected; different nodes
+ * run concurrently, up to the in-flight limit.  Commands that time out or
+ * report a transmission failure are retried.
+ */
+class ZigBeeATBatch : public sigc::trackable
+{
+public:
+        /**
+         * Command state.
+         */
+        typedef enum
+        {
+                BS_Pending = 0,         ///< Not sent yet
+                BS_InFlight = 1,        ///< Waiting for response
+                BS_OK = 2,              ///< Response with status OK
+                BS_Error = 3,           ///< Response with error status
+                BS_Timeout = 4,         ///< No response after all retries
+                BS_Cancelled = 5,       ///< Batch cancelled before completion
+        }
+        BatchState;
+        
+        /**
+         * Result of one command on one node.
+         */
+        struct Result
+        {
+                uint64_t addr64;                ///< Node 64-bit address
+                uint16_t addr16;                ///< Node 16-bit address
+                std::string cmd;                ///< Two character AT command
+                std::vector<uint8_t> param;     ///< Command parameter
+                BatchState state;               ///< Command state
+                uint8_t status;                 ///< Response status byte
+                std::vector<uint8_t> data;      ///< Response data
+                int attempts;                   ///< Requests sent
+                uint64_t latency;               ///< Last request to response (microseconds)
+        };
+        
+        /**
+         * Create a batch runner.
+         * @param zb interface to send and receive on
+         */
+        ZigBeeATBatch(ZigBeeInterface &zb);
+        virtual ~ZigBeeATBatch();
+        
+        /**
+         * Remove all nodes, commands and results.  Cancels a running
+         * batch.
+         */
+        void clear();
+        
+        /**
+         * Add a node.
+         * @param addr64 64-bit address
+         * @param addr16 16-bit address, 0xFFFE if unknown
+         */
+        void add_node(uint64_t addr64, uint16_t addr16);
+        
+        /**
+         * Add a command to run on every node.
+         * @param cmd two character AT command
+         * @param param parameter, empty to read
+         * @return false if cmd is not two characters
+         */
+        bool add_command(std::string cmd, std::vector<uint8_t> param);
+        
+        /**
+         * Start the batch.
+         * @return false if already running or there is nothing to do
+         */
+        bool start();
+        
+        /**
+         * Cancel the batch.  Outstanding commands are marked cancelled.
+         */
+        void cancel();
+        
+        /**
+         * Check if running.
+         * @return true if running
+         */
+        bool is_running();
+        
+        /**
+         * Set maximum commands outstanding at once.
+         * @param n commands
+         * @return commands
+         */
+        int set_max_in_flight(int n);
+        
+        /**
+         * Get maximum commands outstanding at once.
+         * @return commands
+         */
+        int get_max_in_flight();
+        
+        /**
+         * Set response timeout.
+         * @param ms milliseconds
+         * @return milliseconds
+         */
+        int set_timeout(int ms);
+        
+        /**
+         * Get response timeout.
+         * @return milliseconds
+         */
+        int get_timeout();
+        
+        /**
+         * Set retries after a timeout or transmission failure.
+         * @param n retries
+         * @return retries
+         */
+        int set_retries(int n);
+        
+        /**
+         * Get retries.
+         * @return retries
+         */
+        int get_retries();
+        
+        /**
+         * Get results, one per node and command, node major.
+         * @return results
+         */
+        const std::vector<Result> &get_results();
+        
+        /**
+         * Get number of finished commands.
+         * @return commands
+         */
+        int get_finished_count();
+        
+        /**
+         * Get time since start, or total time once finished.
+         * @return microseconds
+         */
+        uint64_t get_elapsed();
+        
+        /**
+         * Get state name.
+         * @param s state
+         * @return name
+         */
+        static std::string get_state_desc(BatchState s);
+        
+        /**
+         * Result signal, emitted when a command finishes.
+         * @par Prototype:
+         * <tt>void on_my_%result(int index)</tt>
+         */
+        sigc::signal<void, int> signal_result();
+        
+        /**
+         * Finished signal, emitted when every command has finished.
+         * @par Prototype:
+         * <tt>void on_my_%finished(uint64_t elapsed_us)</tt>
+         */
+        sigc::signal<void, uint64_t> signal_finished();
+        
+protected:
+        /**
+         * Node progress.
+         */
+        struct Node
+        {
+                uint64_t addr64;                ///< 64-bit address
+                uint16_t addr16;                ///< 16-bit address
+                size_t next;                    ///< Next command
+                bool busy;                      ///< Command outstanding
+        };
+        
+        /**
+         * Outstanding request.
+         */
+        struct Request
+        {
+                int node;                       ///< Node index
+                int result;                     ///< Result index
+                uint64_t timestamp;             ///< Time sent
+        };
+        
+        /**
+         * Receive packet handler.
+         * @param pkt packet
+         */
+        void on_receive_packet(ZigBeePacket pkt);
+        
+        /**
+         * Write high water handler.
+         * @param blocked true if blocked
+         */
+        void on_write_high_water(bool blocked);
+        
+        /**
+         * Timeout timer handler.
+         * @return true to keep running
+         */
+        bool on_timeout();
+        
+        /**
+         * Send commands until the in-flight limit is reached.
+         */
+        void pump();
+        
+        /**
+         * Send one request.
+         * @param node node index
+         * @param result result index
+         */
+        void send_request(int node, int result);
+        
+        /**
+         * Finish a command and move its node on.
+         * @param node node index
+         * @param result result index
+         * @param state final state
+         */
+        void finish(int node, int result, BatchState state);
+        
+        /**
+         * Interface used for requests.
+         */
+        ZigBeeInterface &zb_int;
+        
+        /**
+         * Commands to run.
+         */
+        std::vector< std::pair<std::string, std::vector<uint8_t> > > commands;
+        
+        /**
+         * Nodes.
+         */
+        std::vector<Node> nodes;
+        
+        /**
+         * Results.
+         */
+        std::vector<Result> results;
+        
+        /**
+         * Outstanding requests by frame ID.
+         */
+        std::map<uint8_t, Request> in_flight;
+        
+        /**
+         * Next node to consider when sending.
+         */
+        size_t next_node;
+        
+        /**
+         * Finished commands.
+         */
+        int finished;
+        
+        /**
+         * In-flight limit.
+         */
+        int max_in_flight;
+        
+        /**
+         * Response timeout in milliseconds.
+         */
+        int timeout;
+        
+        /**
+         * Retries.
+         */
+        int retries;
+        
+        /**
+         * Running indicator.
+         */
+        bool running;
+        
+        /**
+         * Serial write queue is above its high water mark.
+         */
+        bool write_blocked;
+        
+        /**
+         * Start time.
+         */
+        uint64_t start_timestamp;
+        
+        /**
+         * Finish time.
+         */
+        uint64_t finish_timestamp;
+        
+        /**
+         * Timer connection.
+         */
+        sigc::connection c_timeout;
+        
+        /**
+         * Result signal.
+         */
+        sigc::signal<void, int> m_signal_result;
+        
+        /**
+         * Finished signal.
+         */
+        sigc::signal<void, uint64_t> m_signal_finished;
+};
+
+#endif //__ZIGBEE_AT_BATCH_H
+
@@ -0,0 +1,149 @@
+/************************************************************************/
+/* ZigBeeAddressTable                                                   */
+/*                                                                      */
+/* ZigBee Terminal - ZigBee Address Table                               */
+/*                                                                      */
+/* ZigBeeAddressTable.cpp                                               */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ZigBeeAddressTable.h"
+
+ZigBeeAddressTable::ZigBeeAddressTable() :
+        max_age(ZIGBEE_ADDRESS_MAX_AGE_US)
+{
+        for (int i = 0; i < 256; i++)
+        {
+                tx_dest64[i] = 0;
+                tx_pending[i] = false;
+        }
+}
+
+ZigBeeAddressTable::~ZigBeeAddressTable()
+{
+        
+}
+
+bool ZigBeeAddressTable::update(ZigBeePacket &pkt, uint64_t now)
+{
+        bool changed = false;
+        
+        if (pkt.identifier == ZigBeePacket::ZBPID_TxStatusS2)
+        {
+                if (!tx_pending[pkt.frame_id])
+                        return false;
+                
+                tx_pending[pkt.frame_id] = false;
+                
+                // a successful status carries the address delivered to
+                if (pkt.delivery_status == 0)
+                        learn(tx_dest64[pkt.frame_id], pkt.dest16, now);
+                else
+                        invalidate(tx_dest64[pkt.frame_id]);
+                
+                return true;
+        }
+        
+        // series 2 frames with a source carry both addresses
+        if (pkt.src64_offset && pkt.src16_offset)
+        {
+                learn(pkt.src64, pkt.src16, now);
+                changed = true;
+        }
+        
+        if (pkt.sender64_offset && pkt.sender16_offset)
+        {
+                learn(pkt.sender64, pkt.sender16, now);
+                changed = true;
+        }
+        
+        return changed;
+}
+
+void ZigBeeAddressTable::note_transmit(uint8_t frame_id, uint64_t addr64)
+{
+        if (frame_id == 0)
+                return;
+        
+        tx_dest64[frame_id] = addr64;
+        tx_pending[frame_id] = true;
+}
+
+void ZigBeeAddressTable::learn(uint64_t addr64, uint16_t addr16, uint64_t now)
+{
+        if (addr16 == ZIGBEE_ADDR16_UNKNOWN || addr64 == ZIGBEE_ADDR64_BROADCAST)
+                return;
+        
+        ZigBeeAddressEntry &e = table[addr64];
+        e.addr16 = addr16;
+        e.timestamp = now;
+}
+
+uint16_t ZigBeeAddressTable::lookup(uint64_t addr64, uint64_t now)
+{
+        std::map<uint64_t, ZigBeeAddressEntry>::iterator it = table.find(addr64);
+        
+        if (it == table.end())
+                return ZIGBEE_ADDR16_UNKNOWN;
+        
+        if (now - it->second.timestamp > max_age)
+        {
+                table.erase(it);
+                return ZIGBEE_ADDR16_UNKNOWN;
+        }
+        
+        return it->second.addr16;
+}
+
+void ZigBeeAddressTable::invalidate(uint64_t addr64)
+{
+        table.erase(addr64);
+}
+
+void ZigBeeAddressTable::clear()
+{
+        table.clear();
+        
+        for (int i = 0; i < 256; i++)
+                tx_pending[i] = false;
+}
+
+size_t ZigBeeAddressTable::size()
+{
+        return table.size();
+}
+
+void ZigBeeAddressTable::set_max_age(uint64_t age)
+{
+        max_age = age;
+}
+
+uint64_t ZigBeeAddressTable::get_max_age()
+{
+        return max_age;
+}
+
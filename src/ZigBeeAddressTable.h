@@ -0,0 +1,152 @@
+/************************************************************************/
+/* ZigBeeAddressTable                                                   */
+/*                                                                      */
+/* ZigBee Terminal - ZigBee Address Table                               */
+/*                                                                      */
+/* ZigBeeAddressTable.h                                                 */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __ZIGBEE_ADDRESS_TABLE_H
+#define __ZIGBEE_ADDRESS_TABLE_H
+
+#include "ZigBeePacket.h"
+#include "ZigBeeRouteCache.h"
+
+#include <map>
+#include <inttypes.h>
+
+#define ZIGBEE_ADDRESS_MAX_AGE_US 1800000000ULL
+
+/** ZigBee address table entry
+ */
+typedef struct
+{
+        uint16_t addr16;                ///< 16-bit network address
+        uint64_t timestamp;             ///< Time the mapping was last seen (microseconds)
+} ZigBeeAddressEntry;
+
+/** ZigBee Address Table
+ * 
+ * Maps 64-bit addresses to 16-bit network addresses learned from the
+ * source fields of received series 2 frames and from successful transmit
+ * status frames.  Transmitting with a known 16-bit address spares the
+ * module a network address discovery.  Entries expire after
+ * ZIGBEE_ADDRESS_MAX_AGE_US and are removed when a transmit to them
+ * fails, since the node may have rejoined with a new address.
+ */
+class ZigBeeAddressTable
+{
+public:
+        ZigBeeAddressTable();
+        virtual ~ZigBeeAddressTable();
+        
+        /**
+         * Learn from a received packet.
+         * @param pkt decoded packet
+         * @param now current time in microseconds
+         * @return true if the table changed
+         */
+        bool update(ZigBeePacket &pkt, uint64_t now);
+        
+        /**
+         * Record a transmit so the matching transmit status can be tied
+         * back to its 64-bit destination.
+         * @param frame_id frame ID, 0 is ignored
+         * @param addr64 destination 64-bit address
+         */
+        void note_transmit(uint8_t frame_id, uint64_t addr64);
+        
+        /**
+         * Add or refresh a mapping.
+         * @param addr64 64-bit address
+         * @param addr16 16-bit address
+         * @param now current time in microseconds
+         */
+        void learn(uint64_t addr64, uint16_t addr16, uint64_t now);
+        
+        /**
+         * Look up a 16-bit address.  Expired entries are removed.
+         * @param addr64 64-bit address
+         * @param now current time in microseconds
+         * @return 16-bit address, or ZIGBEE_ADDR16_UNKNOWN
+         */
+        uint16_t lookup(uint64_t addr64, uint64_t now);
+        
+        /**
+         * Remove a mapping.
+         * @param addr64 64-bit address
+         */
+        void invalidate(uint64_t addr64);
+        
+        /**
+         * Remove all mappings.
+         */
+        void clear();
+        
+        /**
+         * Get number of mappings.
+         * @return mappings
+         */
+        size_t size();
+        
+        /**
+         * Set entry lifetime.
+         * @param age maximum age in microseconds
+         */
+        void set_max_age(uint64_t age);
+        
+        /**
+         * Get entry lifetime.
+         * @return maximum age in microseconds
+         */
+        uint64_t get_max_age();
+        
+protected:
+        /**
+         * Mappings by 64-bit address.
+         */
+        std::map<uint64_t, ZigBeeAddressEntry> table;
+        
+        /**
+         * Destination of each outstanding transmit, indexed by frame ID.
+         */
+        uint64_t tx_dest64[256];
+        
+        /**
+         * Outstanding transmit flags, indexed by frame ID.
+         */
+        bool tx_pending[256];
+        
+        /**
+         * Entry lifetime in microseconds.
+         */
+        uint64_t max_age;
+};
+
+#endif //__ZIGBEE_ADDRESS_TABLE_H
+
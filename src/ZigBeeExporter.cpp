@@ -0,0 +1,354 @@
+/************************************************************************/
+/* ZigBeeExporter                                                       */
+/*                                                                      */
+/* ZigBee Terminal - ZigBee Exporter                                    */
+/*                                                                      */
+/* ZigBeeExporter.cpp                                                   */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ZigBeeExporter.h"
+
+#include <iostream>
+#include <cstring>
+#include <errno.h>
+
+ZigBeeExporter::ZigBeeExporter() :
+        thread(0),
+        running(false),
+        file(0),
+        format(EF_CSV),
+        wall_offset(0),
+        records_written(0),
+        records_dropped(0),
+        bytes_written(0)
+{
+        
+}
+
+ZigBeeExporter::~ZigBeeExporter()
+{
+        stop();
+}
+
+bool ZigBeeExporter::start(std::string fn, ExportFormat fmt)
+{
+        stop();
+        
+        file = fopen(fn.c_str(), fmt == EF_Binary ? "wb" : "w");
+        
+        if (!file)
+        {
+                std::cerr << "[ZigBeeExporter] Error (" << errno << ") opening " << fn << std::endl;
+                return false;
+        }
+        
+        setvbuf(file, NULL, _IOFBF, ZIGBEE_EXPORT_BUFFER);
+        
+        filename = fn;
+        format = fmt;
+        records_written = 0;
+        records_dropped = 0;
+        bytes_written = 0;
+        
+        Glib::TimeVal now;
+        now.assign_current_time();
+        
+        wall_offset = (int64_t)now.tv_sec * 1000000 + now.tv_usec - (int64_t)SerialInterface::get_timestamp();
+        
+        if (format == EF_Binary)
+        {
+                fwrite(ZIGBEE_EXPORT_MAGIC, 1, 4, file);
+                write_le(ZIGBEE_EXPORT_VERSION, 2);
+                write_le(0, 2);
+                write_le(wall_offset, 8);
+                bytes_written = 16;
+        }
+        else
+        {
+                const char *hdr = "timestamp_us,wall_clock_us,node,pin,value\n";
+                fputs(hdr, file);
+                bytes_written = strlen(hdr);
+        }
+        
+        pending.reserve(ZIGBEE_EXPORT_BATCH);
+        
+        running = true;
+        thread = Glib::Thread::create( sigc::mem_fun(*this, &ZigBeeExporter::writer_thread), true );
+        
+        c_flush_timer = Glib::signal_timeout().connect( sigc::mem_fun(*this, &ZigBeeExporter::on_flush_timeout), ZIGBEE_EXPORT_FLUSH_MS );
+        
+        return true;
+}
+
+void ZigBeeExporter::stop()
+{
+        if (!thread)
+                return;
+        
+        c_flush_timer.disconnect();
+        
+        flush();
+        
+        {
+                Glib::Mutex::Lock lock(queue_mutex);
+                running = false;
+        }
+        
+        queue_cond.signal();
+        
+        // the writer drains the queue before exiting
+        thread->join();
+        thread = 0;
+        
+        fclose(file);
+        file = 0;
+        
+        samples.clear();
+}
+
+bool ZigBeeExporter::is_running()
+{
+        return thread != 0;
+}
+
+void ZigBeeExporter::add_packet(ZigBeePacket &pkt)
+{
+        ZigBeeIOSeries *s;
+        ZigBeeExportRecord r;
+        
+        if (!thread || !ZigBeeIOSamples::is_sample_frame(pkt.identifier))
+                return;
+        
+        if (samples.decode(pkt) <= 0)
+                return;
+        
+        s = samples.get_last_series();
+        
+        r.node = s->address;
+        
+        for (size_t i = 0; i < s->size(); i++)
+        {
+                r.timestamp = s->timestamps[i];
+                
+                for (unsigned int m = s->digital_mask[i]; m; m &= m - 1)
+                {
+                        r.pin = __builtin_ctz(m);
+                        r.value = (s->digital[i] >> r.pin) & 1;
+                        pending.push_back(r);
+                }
+                
+                for (unsigned int m = s->analog_seen; m; m &= m - 1)
+                {
+                        int ch = __builtin_ctz(m);
+                        if (s->analog[ch][i] == ZIGBEE_IO_NO_SAMPLE)
+                                continue;
+                        r.pin = ZIGBEE_EXPORT_ANALOG_BASE + ch;
+                        r.value = s->analog[ch][i];
+                        pending.push_back(r);
+                }
+        }
+        
+        s->clear();
+        
+        if (pending.size() >= ZIGBEE_EXPORT_BATCH)
+                flush();
+}
+
+void ZigBeeExporter::flush()
+{
+        if (pending.empty())
+                return;
+        
+        {
+                Glib::Mutex::Lock lock(queue_mutex);
+                
+                if (queue.size() >= ZIGBEE_EXPORT_MAX_BATCHES)
+                {
+                        __sync_fetch_and_add(&records_dropped, pending.size());
+                        pending.clear();
+                        return;
+                }
+                
+                queue.push_back(std::vector<ZigBeeExportRecord>());
+                queue.back().swap(pending);
+        }
+        
+        queue_cond.signal();
+        
+        pending.reserve(ZIGBEE_EXPORT_BATCH);
+}
+
+std::string ZigBeeExporter::get_filename()
+{
+        return filename;
+}
+
+uint64_t ZigBeeExporter::get_records_written()
+{
+        return __sync_fetch_and_add(&records_written, 0);
+}
+
+uint64_t ZigBeeExporter::get_records_dropped()
+{
+        return __sync_fetch_and_add(&records_dropped, 0);
+}
+
+uint64_t ZigBeeExporter::get_bytes_written()
+{
+        return __sync_fetch_and_add(&bytes_written, 0);
+}
+
+// Static
+ZigBeeExporter::ExportFormat ZigBeeExporter::format_from_filename(std::string fn)
+{
+        if (fn.size() >= 4 && fn.compare(fn.size() - 4, 4, ".bin") == 0)
+                return EF_Binary;
+        
+        return EF_CSV;
+}
+
+bool ZigBeeExporter::on_flush_timeout()
+{
+        flush();
+        return true;
+}
+
+void ZigBeeExporter::writer_thread()
+{
+        std::vector<ZigBeeExportRecord> batch;
+        bool ok = true;
+        bool idle;
+        
+        while (true)
+        {
+                {
+                        Glib::Mutex::Lock lock(queue_mutex);
+                        
+                        while (running && queue.empty())
+                                queue_cond.wait(queue_mutex);
+                        
+                        // stopped and drained
+                        if (queue.empty())
+                                break;
+                        
+                        batch.swap(queue.front());
+                        queue.pop_front();
+                        idle = queue.empty();
+                }
+                
+                if (ok)
+                {
+                        if (format == EF_Binary)
+                                ok = write_binary(batch);
+                        else
+                                ok = write_csv(batch);
+                        
+                        if (ok)
+                                __sync_fetch_and_add(&records_written, batch.size());
+                        else
+                                std::cerr << "[ZigBeeExporter] Error (" << errno << ") writing " << filename << std::endl;
+                }
+                
+                if (!ok)
+                        __sync_fetch_and_add(&records_dropped, batch.size());
+                
+                // only push data out to the file once caught up
+                if (ok && idle)
+                        fflush(file);
+                
+                batch.clear();
+        }
+        
+        fflush(file);
+}
+
+bool ZigBeeExporter::write_csv(std::vector<ZigBeeExportRecord> &batch)
+{
+        char buf[80];
+        char pin[8];
+        int len;
+        
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+                ZigBeeExportRecord &r = batch[i];
+                
+                if (r.pin < ZIGBEE_EXPORT_ANALOG_BASE)
+                        snprintf(pin, sizeof(pin), "D%d", r.pin);
+                else if (r.pin == ZIGBEE_EXPORT_ANALOG_BASE + ZIGBEE_IO_SUPPLY_PIN)
+                        snprintf(pin, sizeof(pin), "VCC");
+                else
+                        snprintf(pin, sizeof(pin), "A%d", r.pin - ZIGBEE_EXPORT_ANALOG_BASE);
+                
+                len = snprintf(buf, sizeof(buf), "%llu,%lld,%016llx,%s,%u\n",
+                        (unsigned long long)r.timestamp, (long long)(r.timestamp + wall_offset),
+                        (unsigned long long)r.node, pin, (unsigned int)r.value);
+                
+                if (fwrite(buf, 1, len, file) != (size_t)len)
+                        return false;
+                
+                __sync_fetch_and_add(&bytes_written, len);
+        }
+        
+        return true;
+}
+
+bool ZigBeeExporter::write_binary(std::vector<ZigBeeExportRecord> &batch)
+{
+        size_t n = batch.size();
+        bool ok;
+        
+        ok = write_le(n, 4);
+        
+        for (size_t i = 0; ok && i < n; i++)
+                ok = write_le(batch[i].timestamp, 8);
+        for (size_t i = 0; ok && i < n; i++)
+                ok = write_le(batch[i].node, 8);
+        for (size_t i = 0; ok && i < n; i++)
+                ok = write_le(batch[i].pin, 1);
+        for (size_t i = 0; ok && i < n; i++)
+                ok = write_le(batch[i].value, 2);
+        
+        if (ok)
+                __sync_fetch_and_add(&bytes_written, 4 + n * 19);
+        
+        return ok;
+}
+
+bool ZigBeeExporter::write_le(uint64_t val, int bytes)
+{
+        uint8_t buf[8];
+        
+        for (int i = 0; i < bytes; i++)
+        {
+                buf[i] = val & 0xff;
+                val >>= 8;
+        }
+        
+        return fwrite(buf, 1, bytes, file) == (size_t)bytes;
+}
+
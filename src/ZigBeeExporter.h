@@ -0,0 +1,279 @@
+/************************************************************************/
+/* ZigBeeExporter                                                       */
+/*                                                                      */
+/* ZigBee Terminal - ZigBee Exporter                                    */
+/*                                                                      */
+/* ZigBeeExporter.h                                                     */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __ZIGBEE_EXPORTER_H
+#define __ZIGBEE_EXPORTER_H
+
+#include <gtkmm.h>
+
+#include "SerialInterface.h"
+#include "ZigBeePacket.h"
+#include "ZigBeeIOSamples.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <cstdio>
+#include <inttypes.h>
+
+#define ZIGBEE_EXPORT_BATCH 256
+#define ZIGBEE_EXPORT_MAX_BATCHES 64
+#define ZIGBEE_EXPORT_FLUSH_MS 500
+#define ZIGBEE_EXPORT_BUFFER 65536
+#define ZIGBEE_EXPORT_ANALOG_BASE 16
+#define ZIGBEE_EXPORT_MAGIC "ZBIO"
+#define ZIGBEE_EXPORT_VERSION 2
+
+/** Exported sample record
+ */
+typedef struct
+{
+        uint64_t timestamp;     ///< Sample time (microseconds, SerialInterface::get_timestamp())
+        uint64_t node;          ///< Node address
+        uint8_t pin;            ///< Digital pin, or ZIGBEE_EXPORT_ANALOG_BASE + analog channel
+        uint16_t value;         ///< Pin value
+} ZigBeeExportRecord;
+
+/** ZigBee Exporter
+ * 
+ * Streams decoded IO samples to a file as (timestamp, node, pin, value)
+ * records.  Records are collected in batches on the caller's thread and
+ * handed to a writer thread, so the receive path never waits on the disk.
+ * If the writer falls behind by more than ZIGBEE_EXPORT_MAX_BATCHES
+ * batches, new batches are dropped and counted instead.
+ * 
+ * Record timestamps are monotonic and only comparable within one export.
+ * The wall clock offset, taken when the export starts, converts them to
+ * microseconds since the Unix epoch.  CSV files carry the converted time
+ * in a second column.
+ * 
+ * The binary format is a header of ZIGBEE_EXPORT_MAGIC followed by a
+ * 16-bit version, 16 bits of padding and the wall clock offset (i64),
+ * then one block per batch: a 32-bit record count followed by the
+ * timestamp (u64), node (u64), pin (u8) and value (u16) columns.  All
+ * fields are little endian.
+ */
+class ZigBeeExporter : public sigc::trackable
+{
+public:
+        /**
+         * Export file format.
+         */
+        typedef enum
+        {
+                EF_CSV = 0,     ///< Comma separated text, one record per line
+                EF_Binary = 1,  ///< Binary columnar blocks
+        }
+        ExportFormat;
+        
+        ZigBeeExporter();
+        virtual ~ZigBeeExporter();
+        
+        /**
+         * Open a file and start the writer thread.  Stops any running
+         * export first.
+         * @param filename output file
+         * @param format file format
+         * @return true on success
+         */
+        bool start(std::string filename, ExportFormat format);
+        
+        /**
+         * Write out pending records, stop the writer thread and close the
+         * file.
+         */
+        void stop();
+        
+        /**
+         * Check if an export is running.
+         * @return true if running
+         */
+        bool is_running();
+        
+        /**
+         * Queue the IO samples carried by a packet.  Other packets are
+         * ignored.  Does nothing unless running.
+         * @param pkt decoded packet
+         */
+        void add_packet(ZigBeePacket &pkt);
+        
+        /**
+         * Hand the pending batch to the writer thread.
+         */
+        void flush();
+        
+        /**
+         * Get the output file name.
+         * @return file name
+         */
+        std::string get_filename();
+        
+        /**
+         * Get number of records written.
+         * @return records
+         */
+        uint64_t get_records_written();
+        
+        /**
+         * Get number of records dropped because the writer fell behind.
+         * @return records
+         */
+        uint64_t get_records_dropped();
+        
+        /**
+         * Get number of bytes written.
+         * @return bytes
+         */
+        uint64_t get_bytes_written();
+        
+        /**
+         * Choose a format from a file name; ".bin" selects binary,
+         * anything else CSV.
+         * @param filename file name
+         * @return format
+         */
+        static ExportFormat format_from_filename(std::string filename);
+        
+protected:
+        /**
+         * Flush timer handler.
+         * @return true to keep the timer running
+         */
+        bool on_flush_timeout();
+        
+        /**
+         * Writer thread.
+         */
+        void writer_thread();
+        
+        /**
+         * Write one batch in CSV format.
+         * @param batch records
+         * @return false on write error
+         */
+        bool write_csv(std::vector<ZigBeeExportRecord> &batch);
+        
+        /**
+         * Write one batch as a binary columnar block.
+         * @param batch records
+         * @return false on write error
+         */
+        bool write_binary(std::vector<ZigBeeExportRecord> &batch);
+        
+        /**
+         * Write a little endian value.
+         * @param val value
+         * @param bytes size in bytes
+         * @return false on write error
+         */
+        bool write_le(uint64_t val, int bytes);
+        
+        /**
+         * Sample decoder.  Series are cleared after each packet, so it
+         * only holds the last frame's samples.
+         */
+        ZigBeeIOSamples samples;
+        
+        /**
+         * Batch being filled on the caller's thread.
+         */
+        std::vector<ZigBeeExportRecord> pending;
+        
+        /**
+         * Batches waiting for the writer thread.
+         */
+        std::deque< std::vector<ZigBeeExportRecord> > queue;
+        
+        /**
+         * Queue mutex, also protects running.
+         */
+        Glib::Mutex queue_mutex;
+        
+        /**
+         * Queue condition, signalled when a batch is queued or on stop.
+         */
+        Glib::Cond queue_cond;
+        
+        /**
+         * Writer thread.
+         */
+        Glib::Thread *thread;
+        
+        /**
+         * Writer thread running indicator.
+         */
+        bool running;
+        
+        /**
+         * Output file.
+         */
+        FILE *file;
+        
+        /**
+         * Output file name.
+         */
+        std::string filename;
+        
+        /**
+         * Output format.
+         */
+        ExportFormat format;
+        
+        /**
+         * Wall clock time minus monotonic time at start (microseconds).
+         */
+        int64_t wall_offset;
+        
+        /**
+         * Records written.
+         */
+        uint64_t records_written;
+        
+        /**
+         * Records dropped.
+         */
+        uint64_t records_dropped;
+        
+        /**
+         * Bytes written.
+         */
+        uint64_t bytes_written;
+        
+        /**
+         * Flush timer connection.
+         */
+        sigc::connection c_flush_timer;
+};
+
+#endif //__ZIGBEE_EXPORTER_H
+
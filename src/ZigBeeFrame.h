@@ -0,0 +1,1122 @@
+/************************************************************************/
+/* ZigBeeFrame                                                          */
+/*                                                                      */
+/* ZigBee Terminal - Typed Frames                                       */
+/*                                                                      */
+/* ZigBeeFrame.h                                                        */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __ZIGBEE_FRAME_H
+#define __ZIGBEE_FRAME_H
+
+#include <string.h>
+#include <inttypes.h>
+
+#include "ZigBeePacket.h"
+
+/*
+ * Typed ZigBee frame views.
+ * 
+ * Each API frame type gets its own C++ type, ZigBeeFrame<Id>, whose field
+ * offsets come from a ZigBeeFrameLayout<Id> specialization.  Offsets are
+ * enum constants, so every accessor compiles down to a fixed-offset
+ * big-endian load.  The payload length is checked once against the
+ * layout's MIN_LENGTH when the view is created (or by dispatch()); the
+ * accessors themselves do no bounds or offset checks.  Asking for a field
+ * that a frame type does not carry (for example src64() on a TxStatusS2
+ * frame) fails to compile instead of silently returning zero.
+ * 
+ * Offsets are relative to the payload, i.e. payload[0] is the identifier
+ * byte, matching ZigBeePacket::payload.  The layouts must be kept in step
+ * with ZigBeePacket::set_offsets().
+ * 
+ * The packed sZBP_ structs in ZigBeePacket.h describe the same frames,
+ * but in host byte order, so they cannot be overlaid on received data.
+ */
+
+/**
+ * Read big-endian value.
+ * @param p Pointer to first (most significant) byte
+ * @return Value in host byte order
+ */
+template <typename T>
+inline T zbf_get(const uint8_t *p)
+{
+        T v = 0;
+        for (unsigned int i = 0; i < sizeof(T); i++)
+                v = (T)((v << 8) | p[i]);
+        return v;
+}
+
+/**
+ * Write big-endian value.
+ * @param p Pointer to first (most significant) byte
+ * @param v Value in host byte order
+ */
+template <typename T>
+inline void zbf_put(uint8_t *p, T v)
+{
+        for (int i = sizeof(T) - 1; i >= 0; i--)
+        {
+                p[i] = (uint8_t)v;
+                v = (T)(v >> 8);
+        }
+}
+
+/**
+ * Frame layout.
+ * Specialized per frame identifier; the primary template is left
+ * undefined so that ZigBeeFrame<Id> cannot be instantiated for frame
+ * types without a layout.  Each specialization defines the payload
+ * offset of every field the frame carries plus MIN_LENGTH, the fixed
+ * part of the payload including the identifier byte.  Frames with a
+ * trailing variable length field define DATA or ROUTE_RECORDS.
+ */
+template <ZigBeePacket::ZBP_Identifier Id>
+struct ZigBeeFrameLayout;
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_TxRequest64>
+{
+        enum
+        {
+                FRAME_ID = 1,
+                DEST64 = 2,
+                OPTIONS = 10,
+                DATA = 11,
+                MIN_LENGTH = 11
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_TxRequest16>
+{
+        enum
+        {
+                FRAME_ID = 1,
+                DEST16 = 2,
+                OPTIONS = 4,
+                DATA = 5,
+                MIN_LENGTH = 5
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_ATCommand>
+{
+        enum
+        {
+                FRAME_ID = 1,
+                AT_CMD = 2,
+                DATA = 4,
+                MIN_LENGTH = 4
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_ATCommandQueueRegisterValue>
+{
+        enum
+        {
+                FRAME_ID = 1,
+                AT_CMD = 2,
+                DATA = 4,
+                MIN_LENGTH = 4
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_TxRequest>
+{
+        enum
+        {
+                FRAME_ID = 1,
+                DEST64 = 2,
+                DEST16 = 10,
+                RADIUS = 12,
+                OPTIONS = 13,
+                DATA = 14,
+                MIN_LENGTH = 14
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_EATxRequest>
+{
+        enum
+        {
+                FRAME_ID = 1,
+                DEST64 = 2,
+                DEST16 = 10,
+                SRC_EP = 12,
+                DEST_EP = 13,
+                CLUSTER_ID = 14,
+                PROFILE_ID = 16,
+                RADIUS = 18,
+                OPTIONS = 19,
+                DATA = 20,
+                MIN_LENGTH = 20
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_RemoteATCommand>
+{
+        enum
+        {
+                FRAME_ID = 1,
+                DEST64 = 2,
+                DEST16 = 10,
+                OPTIONS = 12,
+                AT_CMD = 13,
+                DATA = 15,
+                MIN_LENGTH = 15
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_CreateSourceRoute>
+{
+        enum
+        {
+                FRAME_ID = 1,
+                DEST64 = 2,
+                DEST16 = 10,
+                OPTIONS = 12,
+                ROUTE_RECORDS = 13,
+                MIN_LENGTH = 14
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_RegisterJoiningDevice>
+{
+        enum
+        {
+                FRAME_ID = 1,
+                DEST64 = 2,
+                DEST16 = 10,
+                OPTIONS = 12,
+                DATA = 13,
+                MIN_LENGTH = 13
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_RxPacket64>
+{
+        enum
+        {
+                SRC64 = 1,
+                RSSI = 9,
+                OPTIONS = 10,
+                DATA = 11,
+                MIN_LENGTH = 11
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_RxPacket16>
+{
+        enum
+        {
+                SRC16 = 1,
+                RSSI = 3,
+                OPTIONS = 4,
+                DATA = 5,
+                MIN_LENGTH = 5
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_RxPacketIO64>
+{
+        enum
+        {
+                SRC64 = 1,
+                RSSI = 9,
+                OPTIONS = 10,
+                DATA = 11,
+                MIN_LENGTH = 11
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_RxPacketIO16>
+{
+        enum
+        {
+                SRC16 = 1,
+                RSSI = 3,
+                OPTIONS = 4,
+                DATA = 5,
+                MIN_LENGTH = 5
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_ATCommandResponse>
+{
+        enum
+        {
+                FRAME_ID = 1,
+                AT_CMD = 2,
+                STATUS = 4,
+                DATA = 5,
+                MIN_LENGTH = 5
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_TxStatusS1>
+{
+        enum
+        {
+                FRAME_ID = 1,
+                STATUS = 2,
+                MIN_LENGTH = 3
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_ModemStatus>
+{
+        enum
+        {
+                STATUS = 1,
+                MIN_LENGTH = 2
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_TxStatusS2>
+{
+        enum
+        {
+                FRAME_ID = 1,
+                DEST16 = 2,
+                TRANSMIT_RETRIES = 4,
+                DELIVERY_STATUS = 5,
+                DISCOVERY_STATUS = 6,
+                MIN_LENGTH = 7
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_RxPacket>
+{
+        enum
+        {
+                SRC64 = 1,
+                SRC16 = 9,
+                OPTIONS = 11,
+                DATA = 12,
+                MIN_LENGTH = 12
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_EARxPacket>
+{
+        enum
+        {
+                SRC64 = 1,
+                SRC16 = 9,
+                SRC_EP = 11,
+                DEST_EP = 12,
+                CLUSTER_ID = 13,
+                PROFILE_ID = 15,
+                OPTIONS = 17,
+                DATA = 18,
+                MIN_LENGTH = 18
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_IODataSampleRx>
+{
+        enum
+        {
+                SRC64 = 1,
+                SRC16 = 9,
+                OPTIONS = 11,
+                NUM_SAMPLES = 12,
+                DIGITAL_MASK = 13,
+                ANALOG_MASK = 15,
+                DATA = 16,
+                MIN_LENGTH = 16
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_SensorRead>
+{
+        enum
+        {
+                SRC64 = 1,
+                SRC16 = 9,
+                OPTIONS = 11,
+                DATA = 12,
+                MIN_LENGTH = 12
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_NodeIdentification>
+{
+        enum
+        {
+                SENDER64 = 1,
+                SENDER16 = 9,
+                OPTIONS = 11,
+                SRC16 = 12,
+                SRC64 = 14,
+                DATA = 22,
+                MIN_LENGTH = 22
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_RemoteCommandResponse>
+{
+        enum
+        {
+                FRAME_ID = 1,
+                SRC64 = 2,
+                SRC16 = 10,
+                AT_CMD = 12,
+                STATUS = 14,
+                DATA = 15,
+                MIN_LENGTH = 15
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_OTAFirmwareUpdateStatus>
+{
+        enum
+        {
+                SRC64 = 1,
+                DEST16 = 9,
+                OPTIONS = 11,
+                DATA = 12,
+                MIN_LENGTH = 12
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_RouteRecord>
+{
+        enum
+        {
+                SRC64 = 1,
+                SRC16 = 9,
+                OPTIONS = 11,
+                ROUTE_RECORDS = 12,
+                MIN_LENGTH = 13
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_DeviceAuthenticated>
+{
+        enum
+        {
+                SRC64 = 1,
+                SRC16 = 9,
+                STATUS = 11,
+                MIN_LENGTH = 12
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_ManyToOneRouteRequest>
+{
+        enum
+        {
+                SRC64 = 1,
+                SRC16 = 9,
+                RESERVED = 11,
+                MIN_LENGTH = 12
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_RegisterJoiningDeviceStatus>
+{
+        enum
+        {
+                FRAME_ID = 1,
+                STATUS = 2,
+                MIN_LENGTH = 3
+        };
+};
+
+template <>
+struct ZigBeeFrameLayout<ZigBeePacket::ZBPID_JoinNotificationStatus>
+{
+        enum
+        {
+                PARENT16 = 1,
+                NEW16 = 3,
+                NEW64 = 5,
+                STATUS = 13,
+                MIN_LENGTH = 14
+        };
+};
+
+/**
+ * Typed frame view.
+ * Read-only view of a frame payload of one specific type.  The view does
+ * not own the payload; it must outlive the view.  Construct only after
+ * checking the length with check(), or get one from
+ * ZigBeeFrameVisitor::dispatch() which does that already.
+ */
+template <ZigBeePacket::ZBP_Identifier Id>
+class ZigBeeFrame
+{
+public:
+        typedef ZigBeeFrameLayout<Id> Layout;   ///< Field offsets
+        
+        /**
+         * Constructor.
+         * @param payload Frame payload, starting with the identifier byte
+         * @param len Payload length in bytes, at least Layout::MIN_LENGTH
+         */
+        ZigBeeFrame(const uint8_t *payload, size_t len) : p(payload), length(len) {}
+        
+        /**
+         * Check payload.
+         * @param payload Frame payload, starting with the identifier byte
+         * @param len Payload length in bytes
+         * @return true if the payload is a frame of this type
+         */
+        static bool check(const uint8_t *payload, size_t len)
+        {
+                return len >= (size_t)Layout::MIN_LENGTH && payload[0] == Id;
+        }
+        
+        /**
+         * Get identifier.
+         * @return Frame identifier
+         */
+        static ZigBeePacket::ZBP_Identifier get_identifier() { return Id; }
+        
+        /**
+         * Get payload.
+         * @return Pointer to payload, starting with the identifier byte
+         */
+        const uint8_t *get_payload() const { return p; }
+        
+        /**
+         * Get payload length.
+         * @return Payload length in bytes
+         */
+        size_t get_length() const { return length; }
+        
+        /**
+         * Get frame ID.
+         * @return Frame ID field
+         */
+        uint8_t frame_id() const { return zbf_get<uint8_t>(p + Layout::FRAME_ID); }
+        
+        /**
+         * Get status.
+         * @return Status field
+         */
+        uint8_t status() const { return zbf_get<uint8_t>(p + Layout::STATUS); }
+        
+        /**
+         * Get options.
+         * @return Options field
+         */
+        uint8_t options() const { return zbf_get<uint8_t>(p + Layout::OPTIONS); }
+        
+        /**
+         * Get destination 64-bit address.
+         * @return Destination 64-bit address field
+         */
+        uint64_t dest64() const { return zbf_get<uint64_t>(p + Layout::DEST64); }
+        
+        /**
+         * Get destination 16-bit address.
+         * @return Destination 16-bit address field
+         */
+        uint16_t dest16() const { return zbf_get<uint16_t>(p + Layout::DEST16); }
+        
+        /**
+         * Get source 64-bit address.
+         * @return Source 64-bit address field
+         */
+        uint64_t src64() const { return zbf_get<uint64_t>(p + Layout::SRC64); }
+        
+        /**
+         * Get source 16-bit address.
+         * @return Source 16-bit address field
+         */
+        uint16_t src16() const { return zbf_get<uint16_t>(p + Layout::SRC16); }
+        
+        /**
+         * Get sender 64-bit address.
+         * @return Sender 64-bit address field
+         */
+        uint64_t sender64() const { return zbf_get<uint64_t>(p + Layout::SENDER64); }
+        
+        /**
+         * Get sender 16-bit address.
+         * @return Sender 16-bit address field
+         */
+        uint16_t sender16() const { return zbf_get<uint16_t>(p + Layout::SENDER16); }
+        
+        /**
+         * Get parent 16-bit address.
+         * @return Parent 16-bit address field
+         */
+        uint16_t parent16() const { return zbf_get<uint16_t>(p + Layout::PARENT16); }
+        
+        /**
+         * Get new node 64-bit address.
+         * @return New node 64-bit address field
+         */
+        uint64_t new64() const { return zbf_get<uint64_t>(p + Layout::NEW64); }
+        
+        /**
+         * Get new node 16-bit address.
+         * @return New node 16-bit address field
+         */
+        uint16_t new16() const { return zbf_get<uint16_t>(p + Layout::NEW16); }
+        
+        /**
+         * Get source endpoint.
+         * @return Source endpoint field
+         */
+        uint8_t src_ep() const { return zbf_get<uint8_t>(p + Layout::SRC_EP); }
+        
+        /**
+         * Get destination endpoint.
+         * @return Destination endpoint field
+         */
+        uint8_t dest_ep() const { return zbf_get<uint8_t>(p + Layout::DEST_EP); }
+        
+        /**
+         * Get cluster ID.
+         * @return Cluster ID field
+         */
+        uint16_t cluster_id() const { return zbf_get<uint16_t>(p + Layout::CLUSTER_ID); }
+        
+        /**
+         * Get profile ID.
+         * @return Profile ID field
+         */
+        uint16_t profile_id() const { return zbf_get<uint16_t>(p + Layout::PROFILE_ID); }
+        
+        /**
+         * Get broadcast radius.
+         * @return Broadcast radius field
+         */
+        uint8_t radius() const { return zbf_get<uint8_t>(p + Layout::RADIUS); }
+        
+        /**
+         * Get transmit retry count.
+         * @return Transmit retry count field
+         */
+        uint8_t transmit_retries() const { return zbf_get<uint8_t>(p + Layout::TRANSMIT_RETRIES); }
+        
+        /**
+         * Get delivery status.
+         * @return Delivery status field
+         */
+        uint8_t delivery_status() const { return zbf_get<uint8_t>(p + Layout::DELIVERY_STATUS); }
+        
+        /**
+         * Get discovery status.
+         * @return Discovery status field
+         */
+        uint8_t discovery_status() const { return zbf_get<uint8_t>(p + Layout::DISCOVERY_STATUS); }
+        
+        /**
+         * Get number of sample sets.
+         * @return Number of sample sets field
+         */
+        uint8_t num_samples() const { return zbf_get<uint8_t>(p + Layout::NUM_SAMPLES); }
+        
+        /**
+         * Get digital channel mask.
+         * @return Digital channel mask field
+         */
+        uint16_t digital_mask() const { return zbf_get<uint16_t>(p + Layout::DIGITAL_MASK); }
+        
+        /**
+         * Get analog channel mask.
+         * @return Analog channel mask field
+         */
+        uint8_t analog_mask() const { return zbf_get<uint8_t>(p + Layout::ANALOG_MASK); }
+        
+        /**
+         * Get receive signal strength.
+         * @return RSSI field, in -dBm
+         */
+        uint8_t rssi() const { return zbf_get<uint8_t>(p + Layout::RSSI); }
+        
+        /**
+         * Get reserved field.
+         * @return Reserved field
+         */
+        uint8_t reserved() const { return zbf_get<uint8_t>(p + Layout::RESERVED); }
+        
+        /**
+         * Get AT command.
+         * @return Pointer to the two AT command characters
+         */
+        const uint8_t *at_cmd() const { return p + Layout::AT_CMD; }
+        
+        /**
+         * Get data.
+         * @return Pointer to the variable length data field
+         */
+        const uint8_t *data() const { return p + Layout::DATA; }
+        
+        /**
+         * Get data size.
+         * @return Length of the data field in bytes
+         */
+        size_t data_size() const { return length - Layout::DATA; }
+        
+        /**
+         * Get route record count.
+         * Clamped to the number of entries actually present in the payload.
+         * @return Number of route record entries
+         */
+        size_t route_record_count() const
+        {
+                size_t n = p[Layout::ROUTE_RECORDS];
+                size_t avail = (length - Layout::ROUTE_RECORDS - 1) / 2;
+                return n < avail ? n : avail;
+        }
+        
+        /**
+         * Get route record.
+         * @param i Entry index, less than route_record_count()
+         * @return 16-bit address of hop i
+         */
+        uint16_t route_record(size_t i) const
+        {
+                return zbf_get<uint16_t>(p + Layout::ROUTE_RECORDS + 1 + i * 2);
+        }
+        
+private:
+        const uint8_t *p;
+        size_t length;
+};
+
+/**
+ * Typed frame builder.
+ * Writes a complete, unescaped frame of one specific type (start
+ * delimiter, length, payload and checksum) straight into a caller
+ * supplied buffer.  Fields not set are zero.
+ */
+template <ZigBeePacket::ZBP_Identifier Id>
+class ZigBeeFrameBuilder
+{
+public:
+        typedef ZigBeeFrameLayout<Id> Layout;   ///< Field offsets
+        
+        /**
+         * Constructor.
+         * @param buffer Output buffer
+         * @param len Output buffer size in bytes
+         * @param data_len Length of the variable length data field
+         */
+        ZigBeeFrameBuilder(uint8_t *buffer, size_t len, size_t data_len = 0) :
+                buf(buffer), p(buffer + 3), payload_len(Layout::MIN_LENGTH + data_len)
+        {
+                ok = len >= payload_len + 4 && payload_len <= 0xffff;
+                if (!ok)
+                        return;
+                
+                memset(buf, 0, payload_len + 4);
+                buf[0] = ZIGBEE_IDENTIFIER;
+                buf[1] = (uint8_t)(payload_len >> 8);
+                buf[2] = (uint8_t)payload_len;
+                p[0] = Id;
+        }
+        
+        /**
+         * Check buffer.
+         * @return true if the frame fits in the output buffer
+         */
+        bool is_valid() const { return ok; }
+        
+        /**
+         * Get frame size.
+         * @return Size of the complete frame in bytes
+         */
+        size_t get_frame_size() const { return payload_len + 4; }
+        
+        /**
+         * Set frame ID.
+         * @param v Frame ID field
+         */
+        void set_frame_id(uint8_t v) { if (ok) zbf_put<uint8_t>(p + Layout::FRAME_ID, v); }
+        
+        /**
+         * Set status.
+         * @param v Status field
+         */
+        void set_status(uint8_t v) { if (ok) zbf_put<uint8_t>(p + Layout::STATUS, v); }
+        
+        /**
+         * Set options.
+         * @param v Options field
+         */
+        void set_options(uint8_t v) { if (ok) zbf_put<uint8_t>(p + Layout::OPTIONS, v); }
+        
+        /**
+         * Set destination 64-bit address.
+         * @param v Destination 64-bit address field
+         */
+        void set_dest64(uint64_t v) { if (ok) zbf_put<uint64_t>(p + Layout::DEST64, v); }
+        
+        /**
+         * Set destination 16-bit address.
+         * @param v Destination 16-bit address field
+         */
+        void set_dest16(uint16_t v) { if (ok) zbf_put<uint16_t>(p + Layout::DEST16, v); }
+        
+        /**
+         * Set source 64-bit address.
+         * @param v Source 64-bit address field
+         */
+        void set_src64(uint64_t v) { if (ok) zbf_put<uint64_t>(p + Layout::SRC64, v); }
+        
+        /**
+         * Set source 16-bit address.
+         * @param v Source 16-bit address field
+         */
+        void set_src16(uint16_t v) { if (ok) zbf_put<uint16_t>(p + Layout::SRC16, v); }
+        
+        /**
+         * Set sender 64-bit address.
+         * @param v Sender 64-bit address field
+         */
+        void set_sender64(uint64_t v) { if (ok) zbf_put<uint64_t>(p + Layout::SENDER64, v); }
+        
+        /**
+         * Set sender 16-bit address.
+         * @param v Sender 16-bit address field
+         */
+        void set_sender16(uint16_t v) { if (ok) zbf_put<uint16_t>(p + Layout::SENDER16, v); }
+        
+        /**
+         * Set parent 16-bit address.
+         * @param v Parent 16-bit address field
+         */
+        void set_parent16(uint16_t v) { if (ok) zbf_put<uint16_t>(p + Layout::PARENT16, v); }
+        
+        /**
+         * Set new node 64-bit address.
+         * @param v New node 64-bit address field
+         */
+        void set_new64(uint64_t v) { if (ok) zbf_put<uint64_t>(p + Layout::NEW64, v); }
+        
+        /**
+         * Set new node 16-bit address.
+         * @param v New node 16-bit address field
+         */
+        void set_new16(uint16_t v) { if (ok) zbf_put<uint16_t>(p + Layout::NEW16, v); }
+        
+        /**
+         * Set source endpoint.
+         * @param v Source endpoint field
+         */
+        void set_src_ep(uint8_t v) { if (ok) zbf_put<uint8_t>(p + Layout::SRC_EP, v); }
+        
+        /**
+         * Set destination endpoint.
+         * @param v Destination endpoint field
+         */
+        void set_dest_ep(uint8_t v) { if (ok) zbf_put<uint8_t>(p + Layout::DEST_EP, v); }
+        
+        /**
+         * Set cluster ID.
+         * @param v Cluster ID field
+         */
+        void set_cluster_id(uint16_t v) { if (ok) zbf_put<uint16_t>(p + Layout::CLUSTER_ID, v); }
+        
+        /**
+         * Set profile ID.
+         * @param v Profile ID field
+         */
+        void set_profile_id(uint16_t v) { if (ok) zbf_put<uint16_t>(p + Layout::PROFILE_ID, v); }
+        
+        /**
+         * Set broadcast radius.
+         * @param v Broadcast radius field
+         */
+        void set_radius(uint8_t v) { if (ok) zbf_put<uint8_t>(p + Layout::RADIUS, v); }
+        
+        /**
+         * Set transmit retry count.
+         * @param v Transmit retry count field
+         */
+        void set_transmit_retries(uint8_t v) { if (ok) zbf_put<uint8_t>(p + Layout::TRANSMIT_RETRIES, v); }
+        
+        /**
+         * Set delivery status.
+         * @param v Delivery status field
+         */
+        void set_delivery_status(uint8_t v) { if (ok) zbf_put<uint8_t>(p + Layout::DELIVERY_STATUS, v); }
+        
+        /**
+         * Set discovery status.
+         * @param v Discovery status field
+         */
+        void set_discovery_status(uint8_t v) { if (ok) zbf_put<uint8_t>(p + Layout::DISCOVERY_STATUS, v); }
+        
+        /**
+         * Set number of sample sets.
+         * @param v Number of sample sets field
+         */
+        void set_num_samples(uint8_t v) { if (ok) zbf_put<uint8_t>(p + Layout::NUM_SAMPLES, v); }
+        
+        /**
+         * Set digital channel mask.
+         * @param v Digital channel mask field
+         */
+        void set_digital_mask(uint16_t v) { if (ok) zbf_put<uint16_t>(p + Layout::DIGITAL_MASK, v); }
+        
+        /**
+         * Set analog channel mask.
+         * @param v Analog channel mask field
+         */
+        void set_analog_mask(uint8_t v) { if (ok) zbf_put<uint8_t>(p + Layout::ANALOG_MASK, v); }
+        
+        /**
+         * Set receive signal strength.
+         * @param v RSSI field, in -dBm
+         */
+        void set_rssi(uint8_t v) { if (ok) zbf_put<uint8_t>(p + Layout::RSSI, v); }
+        
+        /**
+         * Set AT command.
+         * @param cmd Two AT command characters
+         */
+        void set_at_cmd(const char *cmd)
+        {
+                if (!ok)
+                        return;
+                p[Layout::AT_CMD] = cmd[0];
+                p[Layout::AT_CMD+1] = cmd[1];
+        }
+        
+        /**
+         * Set data.
+         * Copies at most the data length given to the constructor.
+         * @param data Data to copy
+         * @param len Length of data in bytes
+         */
+        void set_data(const uint8_t *data, size_t len)
+        {
+                size_t max = payload_len - Layout::DATA;
+                if (ok)
+                        memcpy(p + Layout::DATA, data, len < max ? len : max);
+        }
+        
+        /**
+         * Finish frame.
+         * Computes the checksum.
+         * @return Size of the complete frame in bytes, 0 if it did not fit
+         */
+        size_t finish()
+        {
+                uint8_t sum = 0xff;
+                
+                if (!ok)
+                        return 0;
+                
+                for (size_t i = 0; i < payload_len; i++)
+                        sum -= p[i];
+                p[payload_len] = sum;
+                
+                return payload_len + 4;
+        }
+        
+private:
+        uint8_t *buf;
+        uint8_t *p;
+        size_t payload_len;
+        bool ok;
+};
+
+/**
+ * Frame visitor.
+ * Base for handlers of typed frames.  Derived visitors add visit()
+ * overloads for the frame types they care about (bringing the defaults
+ * into scope with "using ZigBeeFrameVisitor::visit;") and are passed to
+ * dispatch().  Because the derived type is a template parameter of
+ * dispatch(), the selected visit() is resolved at compile time and is
+ * normally inlined into the switch; there are no virtual calls.
+ */
+class ZigBeeFrameVisitor
+{
+public:
+        /**
+         * Default handler.
+         * Called for known frame types the visitor does not handle.
+         * @param frame Typed frame
+         */
+        template <ZigBeePacket::ZBP_Identifier Id>
+        void visit(const ZigBeeFrame<Id> &) {}
+        
+        /**
+         * Unknown frame handler.
+         * Called for unknown identifiers and for payloads shorter
+         * than the minimum length of their type.
+         * @param payload Frame payload
+         * @param len Payload length in bytes
+         */
+        void visit_other(const uint8_t *, size_t) {}
+        
+        /**
+         * Dispatch payload.
+         * Checks the payload length once against the layout of its type and
+         * calls the matching visit() overload of the visitor.
+         * @param payload Frame payload, starting with the identifier byte
+         * @param len Payload length in bytes
+         * @param v Visitor
+         * @return true if a typed handler was called
+         */
+        template <class Visitor>
+        static bool dispatch(const uint8_t *payload, size_t len, Visitor &v)
+        {
+                if (len < 1)
+                {
+                        v.visit_other(payload, len);
+                        return false;
+                }
+                
+                switch (payload[0])
+                {
+                        case ZigBeePacket::ZBPID_TxRequest64:
+                                return do_visit<ZigBeePacket::ZBPID_TxRequest64>(payload, len, v);
+                        case ZigBeePacket::ZBPID_TxRequest16:
+                                return do_visit<ZigBeePacket::ZBPID_TxRequest16>(payload, len, v);
+                        case ZigBeePacket::ZBPID_ATCommand:
+                                return do_visit<ZigBeePacket::ZBPID_ATCommand>(payload, len, v);
+                        case ZigBeePacket::ZBPID_ATCommandQueueRegisterValue:
+                                return do_visit<ZigBeePacket::ZBPID_ATCommandQueueRegisterValue>(payload, len, v);
+                        case ZigBeePacket::ZBPID_TxRequest:
+                                return do_visit<ZigBeePacket::ZBPID_TxRequest>(payload, len, v);
+                        case ZigBeePacket::ZBPID_EATxRequest:
+                                return do_visit<ZigBeePacket::ZBPID_EATxRequest>(payload, len, v);
+                        case ZigBeePacket::ZBPID_RemoteATCommand:
+                                return do_visit<ZigBeePacket::ZBPID_RemoteATCommand>(payload, len, v);
+                        case ZigBeePacket::ZBPID_CreateSourceRoute:
+                                return do_visit<ZigBeePacket::ZBPID_CreateSourceRoute>(payload, len, v);
+                        case ZigBeePacket::ZBPID_RegisterJoiningDevice:
+                                return do_visit<ZigBeePacket::ZBPID_RegisterJoiningDevice>(payload, len, v);
+                        case ZigBeePacket::ZBPID_RxPacket64:
+                                return do_visit<ZigBeePacket::ZBPID_RxPacket64>(payload, len, v);
+                        case ZigBeePacket::ZBPID_RxPacket16:
+                                return do_visit<ZigBeePacket::ZBPID_RxPacket16>(payload, len, v);
+                        case ZigBeePacket::ZBPID_RxPacketIO64:
+                                return do_visit<ZigBeePacket::ZBPID_RxPacketIO64>(payload, len, v);
+                        case ZigBeePacket::ZBPID_RxPacketIO16:
+                                return do_visit<ZigBeePacket::ZBPID_RxPacketIO16>(payload, len, v);
+                        case ZigBeePacket::ZBPID_ATCommandResponse:
+                                return do_visit<ZigBeePacket::ZBPID_ATCommandResponse>(payload, len, v);
+                        case ZigBeePacket::ZBPID_TxStatusS1:
+                                return do_visit<ZigBeePacket::ZBPID_TxStatusS1>(payload, len, v);
+                        case ZigBeePacket::ZBPID_ModemStatus:
+                                return do_visit<ZigBeePacket::ZBPID_ModemStatus>(payload, len, v);
+                        case ZigBeePacket::ZBPID_TxStatusS2:
+                                return do_visit<ZigBeePacket::ZBPID_TxStatusS2>(payload, len, v);
+                        case ZigBeePacket::ZBPID_RxPacket:
+                                return do_visit<ZigBeePacket::ZBPID_RxPacket>(payload, len, v);
+                        case ZigBeePacket::ZBPID_EARxPacket:
+                                return do_visit<ZigBeePacket::ZBPID_EARxPacket>(payload, len, v);
+                        case ZigBeePacket::ZBPID_IODataSampleRx:
+                                return do_visit<ZigBeePacket::ZBPID_IODataSampleRx>(payload, len, v);
+                        case ZigBeePacket::ZBPID_SensorRead:
+                                return do_visit<ZigBeePacket::ZBPID_SensorRead>(payload, len, v);
+                        case ZigBeePacket::ZBPID_NodeIdentification:
+                                return do_visit<ZigBeePacket::ZBPID_NodeIdentification>(payload, len, v);
+                        case ZigBeePacket::ZBPID_RemoteCommandResponse:
+                                return do_visit<ZigBeePacket::ZBPID_RemoteCommandResponse>(payload, len, v);
+                        case ZigBeePacket::ZBPID_OTAFirmwareUpdateStatus:
+                                return do_visit<ZigBeePacket::ZBPID_OTAFirmwareUpdateStatus>(payload, len, v);
+                        case ZigBeePacket::ZBPID_RouteRecord:
+                                return do_visit<ZigBeePacket::ZBPID_RouteRecord>(payload, len, v);
+                        case ZigBeePacket::ZBPID_DeviceAuthenticated:
+                                return do_visit<ZigBeePacket::ZBPID_DeviceAuthenticated>(payload, len, v);
+                        case ZigBeePacket::ZBPID_ManyToOneRouteRequest:
+                                return do_visit<ZigBeePacket::ZBPID_ManyToOneRouteRequest>(payload, len, v);
+                        case ZigBeePacket::ZBPID_RegisterJoiningDeviceStatus:
+                                return do_visit<ZigBeePacket::ZBPID_RegisterJoiningDeviceStatus>(payload, len, v);
+                        case ZigBeePacket::ZBPID_JoinNotificationStatus:
+                                return do_visit<ZigBeePacket::ZBPID_JoinNotificationStatus>(payload, len, v);
+                        default:
+                                v.visit_other(payload, len);
+                                return false;
+                }
+        }
+        
+        /**
+         * Dispatch packet.
+         * @param pkt Packet with payload read
+         * @param v Visitor
+         * @return true if a typed handler was called
+         */
+        template <class Visitor>
+        static bool dispatch(const ZigBeePacket &pkt, Visitor &v)
+        {
+                if (pkt.payload.empty())
+                {
+                        v.visit_other(0, 0);
+                        return false;
+                }
+                
+                return dispatch(&pkt.payload[0], pkt.payload.size(), v);
+        }
+        
+private:
+        template <ZigBeePacket::ZBP_Identifier Id, class Visitor>
+        static bool do_visit(const uint8_t *payload, size_t len, Visitor &v)
+        {
+                if (len < (size_t)ZigBeeFrameLayout<Id>::MIN_LENGTH)
+                {
+                        v.visit_other(payload, len);
+                        return false;
+                }
+                
+                v.visit(ZigBeeFrame<Id>(payload, len));
+                return true;
+        }
+};
+
+#endif //__ZIGBEE_FRAME_H
@@ -0,0 +1,269 @@
+/************************************************************************/
+/* ZigBeeIOSamples                                                      */
+/*                                                                      */
+/* ZigBee Terminal - ZigBee IO Samples                                  */
+/*                                                                      */
+/* ZigBeeIOSamples.cpp                                                  */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ZigBeeIOSamples.h"
+
+#include <iostream>
+
+// Series 1 channel indicator layout
+#define S1_DIGITAL_MASK 0x01ff
+#define S1_ANALOG_SHIFT 9
+#define S1_ANALOG_MASK 0x3f
+
+ZigBeeIOSeries::ZigBeeIOSeries() :
+        address(0),
+        digital_seen(0),
+        analog_seen(0)
+{
+        
+}
+
+size_t ZigBeeIOSeries::size() const
+{
+        return timestamps.size();
+}
+
+void ZigBeeIOSeries::clear()
+{
+        timestamps.clear();
+        digital_mask.clear();
+        digital.clear();
+        for (int i = 0; i < ZIGBEE_IO_ANALOG_PINS; i++)
+                analog[i].clear();
+        digital_seen = 0;
+        analog_seen = 0;
+}
+
+void ZigBeeIOSeries::erase_front(size_t n)
+{
+        if (n >= size())
+        {
+                clear();
+                return;
+        }
+        
+        timestamps.erase(timestamps.begin(), timestamps.begin() + n);
+        digital_mask.erase(digital_mask.begin(), digital_mask.begin() + n);
+        digital.erase(digital.begin(), digital.begin() + n);
+        for (int i = 0; i < ZIGBEE_IO_ANALOG_PINS; i++)
+                analog[i].erase(analog[i].begin(), analog[i].begin() + n);
+}
+
+void ZigBeeIOSeries::get_digital_pin(int pin, std::vector<uint8_t> &out) const
+{
+        size_t n = size();
+        
+        out.resize(n);
+        
+        if (pin < 0 || pin >= ZIGBEE_IO_DIGITAL_PINS)
+        {
+                out.assign(n, 0xFF);
+                return;
+        }
+        
+        for (size_t i = 0; i < n; i++)
+        {
+                // 0xFF when the pin was not sampled, otherwise its state
+                uint8_t sampled = -((digital_mask[i] >> pin) & 1);
+                out[i] = ((digital[i] >> pin) & 1) | (uint8_t)~sampled;
+        }
+}
+
+void ZigBeeIOSeries::reserve(size_t n)
+{
+        size_t cap = timestamps.size() + n;
+        
+        if (cap <= timestamps.capacity())
+                return;
+        
+        // grow geometrically so columns reallocate together
+        cap = cap < timestamps.capacity() * 2 ? timestamps.capacity() * 2 : cap;
+        
+        timestamps.reserve(cap);
+        digital_mask.reserve(cap);
+        digital.reserve(cap);
+        for (int i = 0; i < ZIGBEE_IO_ANALOG_PINS; i++)
+                analog[i].reserve(cap);
+}
+
+ZigBeeIOSamples::ZigBeeIOSamples() :
+        last(NULL)
+{
+        
+}
+
+ZigBeeIOSamples::~ZigBeeIOSamples()
+{
+        
+}
+
+int ZigBeeIOSamples::decode(ZigBeePacket &pkt, uint64_t timestamp)
+{
+        const uint8_t *p;
+        size_t len;
+        int n;
+        uint16_t dmask;
+        uint8_t amask;
+        uint64_t address;
+        
+        if (!is_sample_frame(pkt.identifier))
+                return 0;
+        
+        p = pkt.data.empty() ? NULL : &pkt.data[0];
+        len = pkt.data.size();
+        
+        if (pkt.identifier == ZigBeePacket::ZBPID_IODataSampleRx)
+        {
+                // masks already decoded from the frame header
+                n = pkt.num_samples;
+                dmask = pkt.digital_mask;
+                amask = pkt.analog_mask;
+                address = pkt.src64;
+        }
+        else
+        {
+                // series 1 data starts with sample count and channel
+                // indicator
+                if (len < 3)
+                        return -1;
+                
+                n = p[0];
+                dmask = ((p[1] << 8) | p[2]) & S1_DIGITAL_MASK;
+                amask = (((p[1] << 8) | p[2]) >> S1_ANALOG_SHIFT) & S1_ANALOG_MASK;
+                p += 3;
+                len -= 3;
+                address = pkt.identifier == ZigBeePacket::ZBPID_RxPacketIO64 ? pkt.src64 : pkt.src16;
+        }
+        
+        // every sample has the same layout: digital word if any digital
+        // channel is enabled, then one word per analog channel
+        size_t sample_len = (dmask ? 2 : 0) + 2 * __builtin_popcount(amask);
+        
+        if (n == 0 || sample_len == 0)
+                return 0;
+        
+        if (len < n * sample_len)
+        {
+                std::cerr << "[ZigBeeIOSamples] Truncated IO sample frame" << std::endl;
+                return -1;
+        }
+        
+        ZigBeeIOSeries &s = lookup(address);
+        size_t base = s.size();
+        
+        s.reserve(n);
+        s.timestamps.insert(s.timestamps.end(), n, timestamp);
+        s.digital_mask.insert(s.digital_mask.end(), n, dmask);
+        s.digital.insert(s.digital.end(), n, 0);
+        for (int i = 0; i < ZIGBEE_IO_ANALOG_PINS; i++)
+                s.analog[i].insert(s.analog[i].end(), n, ZIGBEE_IO_NO_SAMPLE);
+        
+        s.digital_seen |= dmask;
+        s.analog_seen |= amask;
+        
+        for (int i = 0; i < n; i++)
+        {
+                if (dmask)
+                {
+                        s.digital[base + i] = ((p[0] << 8) | p[1]) & dmask;
+                        p += 2;
+                }
+                
+                // walk set bits lowest first, matching the on-air order
+                for (unsigned int m = amask; m; m &= m - 1)
+                {
+                        s.analog[__builtin_ctz(m)][base + i] = (p[0] << 8) | p[1];
+                        p += 2;
+                }
+        }
+        
+        return n;
+}
+
+int ZigBeeIOSamples::decode(ZigBeePacket &pkt)
+{
+        return decode(pkt, pkt.read_timestamp);
+}
+
+ZigBeeIOSeries *ZigBeeIOSamples::get_series(uint64_t address)
+{
+        std::map<uint64_t, ZigBeeIOSeries>::iterator it = series.find(address);
+        
+        if (it == series.end())
+                return NULL;
+        
+        return &it->second;
+}
+
+ZigBeeIOSeries *ZigBeeIOSamples::get_last_series()
+{
+        return last;
+}
+
+std::vector<uint64_t> ZigBeeIOSamples::get_addresses()
+{
+        std::vector<uint64_t> addrs;
+        std::map<uint64_t, ZigBeeIOSeries>::iterator it;
+        
+        for (it = series.begin(); it != series.end(); ++it)
+                addrs.push_back(it->first);
+        
+        return addrs;
+}
+
+void ZigBeeIOSamples::clear()
+{
+        series.clear();
+        last = NULL;
+}
+
+// Static
+bool ZigBeeIOSamples::is_sample_frame(int identifier)
+{
+        return identifier == ZigBeePacket::ZBPID_IODataSampleRx ||
+                identifier == ZigBeePacket::ZBPID_RxPacketIO64 ||
+                identifier == ZigBeePacket::ZBPID_RxPacketIO16;
+}
+
+ZigBeeIOSeries &ZigBeeIOSamples::lookup(uint64_t address)
+{
+        if (last && last->address == address)
+                return *last;
+        
+        ZigBeeIOSeries &s = series[address];
+        s.address = address;
+        last = &s;
+        
+        return s;
+}
+
@@ -0,0 +1,186 @@
+/************************************************************************/
+/* ZigBeeIOSamples                                                      */
+/*                                                                      */
+/* ZigBee Terminal - ZigBee IO Samples                                  */
+/*                                                                      */
+/* ZigBeeIOSamples.h                                                    */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __ZIGBEE_IO_SAMPLES_H
+#define __ZIGBEE_IO_SAMPLES_H
+
+#include "ZigBeePacket.h"
+
+#include <vector>
+#include <map>
+#include <inttypes.h>
+
+#define ZIGBEE_IO_DIGITAL_PINS 16
+#define ZIGBEE_IO_ANALOG_PINS 8
+#define ZIGBEE_IO_SUPPLY_PIN 7
+#define ZIGBEE_IO_NO_SAMPLE 0xFFFF
+
+/** ZigBee IO sample series
+ * 
+ * Time series of IO samples from one node, stored as structure of
+ * arrays.  All columns have one entry per sample.  Digital pins are kept
+ * packed, one bit per pin, alongside the mask of pins that were sampled;
+ * analog columns hold ZIGBEE_IO_NO_SAMPLE where a channel was not
+ * enabled.  Analog index ZIGBEE_IO_SUPPLY_PIN is the series 2 supply
+ * voltage channel.
+ */
+class ZigBeeIOSeries
+{
+public:
+        ZigBeeIOSeries();
+        
+        uint64_t address;                       ///< Node address
+        std::vector<uint64_t> timestamps;       ///< Sample timestamps (microseconds)
+        std::vector<uint16_t> digital_mask;     ///< Digital pins sampled
+        std::vector<uint16_t> digital;          ///< Digital pin states, bit n = pin n
+        std::vector<uint16_t> analog[ZIGBEE_IO_ANALOG_PINS];    ///< Analog values
+        uint16_t digital_seen;                  ///< Digital pins ever sampled
+        uint8_t analog_seen;                    ///< Analog pins ever sampled
+        
+        /**
+         * Get number of samples.
+         * @return samples
+         */
+        size_t size() const;
+        
+        /**
+         * Remove all samples.
+         */
+        void clear();
+        
+        /**
+         * Remove samples from the front, keeping the most recent.
+         * @param n samples to remove
+         */
+        void erase_front(size_t n);
+        
+        /**
+         * Unpack one digital pin into a column.
+         * @param pin pin number
+         * @param out receives 0 or 1 per sample, 0xFF if not sampled
+         */
+        void get_digital_pin(int pin, std::vector<uint8_t> &out) const;
+        
+protected:
+        /**
+         * Reserve room for more samples in every column.
+         * @param n additional samples
+         */
+        void reserve(size_t n);
+        
+        friend class ZigBeeIOSamples;
+};
+
+/** ZigBee IO sample decoder
+ * 
+ * Unpacks the samples carried by IO Data Sample Rx (0x92, series 2) and
+ * IO Rx 64/16 (0x82/0x83, series 1) frames into per-node series.  Nodes
+ * only known by a 16-bit address (0x83) are keyed by that address.
+ */
+class ZigBeeIOSamples
+{
+public:
+        ZigBeeIOSamples();
+        virtual ~ZigBeeIOSamples();
+        
+        /**
+         * Decode IO samples from a packet.  The packet must already be
+         * decoded with ZigBeePacket::decode_packet().
+         * @param pkt packet
+         * @param timestamp sample time in microseconds; every sample in
+         * the frame gets this time
+         * @return number of samples decoded, 0 if pkt is not an IO sample
+         * frame, -1 if it is malformed
+         */
+        int decode(ZigBeePacket &pkt, uint64_t timestamp);
+        
+        /**
+         * Decode IO samples using the packet's read timestamp.
+         * @param pkt packet
+         * @return number of samples decoded
+         */
+        int decode(ZigBeePacket &pkt);
+        
+        /**
+         * Get series for a node.
+         * @param address node address
+         * @return series, or NULL if none
+         */
+        ZigBeeIOSeries *get_series(uint64_t address);
+        
+        /**
+         * Get the series the last decoded frame was added to.
+         * @return series, or NULL if nothing has been decoded
+         */
+        ZigBeeIOSeries *get_last_series();
+        
+        /**
+         * Get addresses of all nodes with samples.
+         * @return addresses
+         */
+        std::vector<uint64_t> get_addresses();
+        
+        /**
+         * Remove all series.
+         */
+        void clear();
+        
+        /**
+         * Check whether a frame type carries IO samples.
+         * @param identifier packet identifier
+         * @return true if it does
+         */
+        static bool is_sample_frame(int identifier);
+        
+protected:
+        /**
+         * Find or create the series for a node.
+         * @param address node address
+         * @return series
+         */
+        ZigBeeIOSeries &lookup(uint64_t address);
+        
+        /**
+         * Series by node address.
+         */
+        std::map<uint64_t, ZigBeeIOSeries> series;
+        
+        /**
+         * Most recently used series; sensor traffic tends to arrive in
+         * runs from the same node.
+         */
+        ZigBeeIOSeries *last;
+};
+
+#endif //__ZIGBEE_IO_SAMPLES_H
+
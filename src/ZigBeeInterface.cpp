@@ -32,6 +32,7 @@
 /************************************************************************/
 
 #include "ZigBeeInterface.h"
+#include "ZigBeeFrame.h"
 
 #include <iostream>
 #include <sstream>
@@ -39,9 +40,17 @@
 
 
 ZigBeeInterface::ZigBeeInterface() :
-        debug(false)
+        read_data_pos(0),
+        debug(false),
+        source_routing(true),
+        address_resolution(true),
+        frame_id(0),
+        write_blocked(false),
+        write_above_high_water(false),
+        cts_blocked(false)
 {
-        // nothing
+        for (int i = 0; i < 256; i++)
+                tx_timestamps[i] = 0;
 }
 
 
@@ -60,6 +69,9 @@ void ZigBeeInterface::set_serial_interface(std::tr1::shared_ptr<SerialInterface>
         c_port_opened = ser_int->port_opened().connect( sigc::mem_fun(*this, &ZigBeeInterface::reset_buffer) );
         c_port_closed = ser_int->port_closed().connect( sigc::mem_fun(*this, &ZigBeeInterface::reset_buffer) );
         c_port_receive_data = ser_int->port_receive_data().connect( sigc::mem_fun(*this, &ZigBeeInterface::on_receive_data) );
+        c_port_write_high_water = ser_int->port_write_high_water().connect( sigc::mem_fun(*this, &ZigBeeInterface::on_write_high_water) );
+        c_port_reconnected = ser_int->port_reconnected().connect( sigc::mem_fun(*this, &ZigBeeInterface::on_port_reconnected) );
+        c_port_cts = ser_int->port_cts().connect( sigc::mem_fun(*this, &ZigBeeInterface::on_port_cts) );
 }
 
 
@@ -70,6 +82,12 @@ void ZigBeeInterface::clear_serial_interface()
         c_port_opened.disconnect();
         c_port_closed.disconnect();
         c_port_receive_data.disconnect();
+        c_port_write_high_water.disconnect();
+        c_port_reconnected.disconnect();
+        c_port_cts.disconnect();
+        write_blocked = false;
+        write_above_high_water = false;
+        cts_blocked = false;
         ser_int = std::tr1::shared_ptr<SerialInterface>();
 }
 
@@ -89,15 +107,17 @@ bool ZigBeeInterface::is_connected()
 void ZigBeeInterface::reset_buffer()
 {
         read_data_queue.clear();
+        read_chunk_times.clear();
+        read_data_pos = 0;
+        stats.set_gauge(ZigBeeStats::SG_ReadQueueDepth, 0);
 }
 
 
 void ZigBeeInterface::send_packet(ZigBeePacket pkt)
 {
-        gsize num;
-        int ret;
-        int len;
-        char *ptr;
+        uint64_t now;
+        bool unicast;
+        size_t len;
         
         if (!ser_int)
         {
@@ -106,29 +126,195 @@ void ZigBeeInterface::send_packet(ZigBeePacket pkt)
                 return;
         }
         
-        std::vector<uint8_t> data = pkt.get_raw_packet();
+        now = SerialInterface::get_timestamp();
         
-        len = data.size();
-        ptr = (char *)&data[0];
+        unicast = pkt.identifier == ZigBeePacket::ZBPID_TxRequest ||
+                pkt.identifier == ZigBeePacket::ZBPID_EATxRequest;
         
-        // write packet
-        while (len > 0)
+        // fill in a known network address to skip address discovery
+        if (address_resolution && (unicast || pkt.identifier == ZigBeePacket::ZBPID_RemoteATCommand) &&
+                pkt.dest16 == ZIGBEE_ADDR16_UNKNOWN)
         {
-                ret = ser_int->write(ptr, len, num);
+                uint16_t addr16 = addresses.lookup(pkt.dest64, now);
                 
-                if (ret != SerialInterface::SS_Success)
+                if (addr16 != ZIGBEE_ADDR16_UNKNOWN)
                 {
-                        std::cerr << "[ZigBeeInterface] Error: unable to write packet!" << std::endl;
-                        m_signal_error.emit();
-                        return;
+                        pkt.dest16 = addr16;
+                        pkt.build_packet();
+                        stats.add(ZigBeeStats::SC_AddressesResolved);
                 }
+        }
+        
+        if (unicast)
+        {
+                addresses.note_transmit(pkt.frame_id, pkt.dest64);
+                routes.note_transmit(pkt.frame_id, pkt.dest64);
+        }
+        
+        // unicast to a node with a known multi-hop route; the source
+        // route must reach the module ahead of the data
+        if (source_routing && unicast)
+        {
+                ZigBeeRoute *route = routes.lookup(pkt.dest64, pkt.dest16, now);
                 
-                if (num > 0)
-                        m_signal_send_raw_data.emit(ptr, num);
+                if (route && route->hops.size() > 0)
+                {
+                        stats.add(ZigBeeStats::SC_SourceRoutes);
+                        send_packet(ZigBeeRouteCache::make_source_route(*route));
+                }
+        }
+        
+        // serialize into the reusable buffer; queue_write copies it
+        if (tx_buffer.size() < pkt.get_max_serialized_size())
+                tx_buffer.resize(pkt.get_max_serialized_size());
+        
+        len = pkt.serialize(&tx_buffer[0], tx_buffer.size());
+        
+        write_frame(&tx_buffer[0], len, pkt.identifier, pkt.frame_id);
+}
+
+
+void ZigBeeInterface::send_template(ZigBeePacketTemplate &tmpl)
+{
+        uint64_t now;
+        bool unicast;
+        bool resolved = false;
+        ZigBeePacket::ZBP_Identifier identifier = tmpl.get_identifier();
+        
+        if (!ser_int)
+        {
+                std::cerr << "[ZigBeeInterface] No SerialInterface associated!" << std::endl;
+                m_signal_error.emit();
+                return;
+        }
+        
+        if (!tmpl.is_valid())
+        {
+                std::cerr << "[ZigBeeInterface] Error: empty packet template!" << std::endl;
+                m_signal_error.emit();
+                return;
+        }
+        
+        now = SerialInterface::get_timestamp();
+        
+        unicast = identifier == ZigBeePacket::ZBPID_TxRequest ||
+                identifier == ZigBeePacket::ZBPID_EATxRequest;
+        
+        // same bookkeeping as send_packet, patching instead of rebuilding
+        if (address_resolution && (unicast || identifier == ZigBeePacket::ZBPID_RemoteATCommand) &&
+                tmpl.has_dest16() && tmpl.get_dest16() == ZIGBEE_ADDR16_UNKNOWN)
+        {
+                uint16_t addr16 = addresses.lookup(tmpl.get_dest64(), now);
+                
+                if (addr16 != ZIGBEE_ADDR16_UNKNOWN)
+                {
+                        tmpl.set_dest16(addr16);
+                        resolved = true;
+                        stats.add(ZigBeeStats::SC_AddressesResolved);
+                }
+        }
+        
+        if (unicast)
+        {
+                addresses.note_transmit(tmpl.get_frame_id(), tmpl.get_dest64());
+                routes.note_transmit(tmpl.get_frame_id(), tmpl.get_dest64());
+        }
+        
+        if (source_routing && unicast)
+        {
+                ZigBeeRoute *route = routes.lookup(tmpl.get_dest64(), tmpl.get_dest16(), now);
                 
-                len -= num;
-                ptr += num;
+                if (route && route->hops.size() > 0)
+                {
+                        stats.add(ZigBeeStats::SC_SourceRoutes);
+                        send_packet(ZigBeeRouteCache::make_source_route(*route));
+                }
         }
+        
+        write_frame(tmpl.get_frame(), tmpl.get_frame_size(), identifier, tmpl.get_frame_id());
+        
+        // the write is queued by copy; leave the template as it was so a
+        // stale address is not kept once the table drops it
+        if (resolved)
+                tmpl.set_dest16(ZIGBEE_ADDR16_UNKNOWN);
+}
+
+
+void ZigBeeInterface::write_frame(const uint8_t *frame, size_t len, ZigBeePacket::ZBP_Identifier identifier, uint8_t frame_id)
+{
+        const char *ptr = (const char *)frame;
+        uint64_t now = SerialInterface::get_timestamp();
+        
+        // queue packet
+        if (ser_int->queue_write(ptr, len, sigc::mem_fun(*this, &ZigBeeInterface::on_write_complete)) != SerialInterface::SS_Success)
+        {
+                std::cerr << "[ZigBeeInterface] Error: unable to write packet!" << std::endl;
+                m_signal_error.emit();
+                return;
+        }
+        
+        stats.add(ZigBeeStats::SC_FramesSent);
+        
+        if ((identifier == ZigBeePacket::ZBPID_TxRequest64 ||
+                identifier == ZigBeePacket::ZBPID_TxRequest16 ||
+                identifier == ZigBeePacket::ZBPID_TxRequest ||
+                identifier == ZigBeePacket::ZBPID_EATxRequest) && frame_id)
+                tx_timestamps[frame_id] = now;
+        
+        m_signal_send_raw_data.emit(ptr, len);
+        
+        stats.set_gauge(ZigBeeStats::SG_WriteQueueDepth, ser_int->get_write_queue_size());
+}
+
+
+uint8_t ZigBeeInterface::get_next_frame_id()
+{
+        if (++frame_id == 0)
+                frame_id = 1;
+        
+        return frame_id;
+}
+
+
+bool ZigBeeInterface::is_write_blocked()
+{
+        return write_blocked;
+}
+
+
+void ZigBeeInterface::set_source_routing(bool enable)
+{
+        source_routing = enable;
+}
+
+
+bool ZigBeeInterface::get_source_routing()
+{
+        return source_routing;
+}
+
+
+void ZigBeeInterface::set_address_resolution(bool enable)
+{
+        address_resolution = enable;
+}
+
+
+bool ZigBeeInterface::get_address_resolution()
+{
+        return address_resolution;
+}
+
+
+ZigBeeAddressTable &ZigBeeInterface::get_address_table()
+{
+        return addresses;
+}
+
+
+ZigBeeRouteCache &ZigBeeInterface::get_route_cache()
+{
+        return routes;
 }
 
 
@@ -145,6 +331,12 @@ bool ZigBeeInterface::get_debug()
 }
 
 
+ZigBeeStats &ZigBeeInterface::get_stats()
+{
+        return stats;
+}
+
+
 sigc::signal<void, ZigBeePacket> ZigBeeInterface::signal_receive_packet()
 {
         return m_signal_receive_packet;
@@ -169,6 +361,12 @@ sigc::signal<void> ZigBeeInterface::signal_error()
 }
 
 
+sigc::signal<void, bool> ZigBeeInterface::signal_write_high_water()
+{
+        return m_signal_write_high_water;
+}
+
+
 void ZigBeeInterface::on_receive_data()
 {
         gsize num;
@@ -176,6 +374,8 @@ void ZigBeeInterface::on_receive_data()
         static char buf[1024];
         ZigBeePacket pkt;
         size_t len;
+        uint64_t read_time;
+        bool decoded;
         
         if (!ser_int)
         {
@@ -187,13 +387,16 @@ void ZigBeeInterface::on_receive_data()
         // read raw data from serial port
         do
         {
-                status = ser_int->read(buf, 1024, num);
+                status = ser_int->read(buf, 1024, num, read_time);
                 
+                stats.add(ZigBeeStats::SC_ReadCalls);
+                
+                // the serial interface has already closed the port or
+                // started reconnecting
                 if (status == SerialInterface::SS_Error)
                 {
                         std::cerr << "[ZigBeeInterface] Read error!" << std::endl;
                         m_signal_error.emit();
-                        ser_int->close_port();
                         return;
                 }
                 
@@ -201,7 +404,6 @@ void ZigBeeInterface::on_receive_data()
                 {
                         std::cerr << "[ZigBeeInterface] End of file!" << std::endl;
                         m_signal_error.emit();
-                        ser_int->close_port();
                         return;
                 }
                 
@@ -216,23 +418,186 @@ void ZigBeeInterface::on_receive_data()
                 }
                 
                 if (num > 0)
+                {
+                        read_chunk_times.push_back(std::make_pair(read_data_pos + read_data_queue.size(), read_time));
+                        stats.add(ZigBeeStats::SC_BytesRead, num);
                         m_signal_receive_raw_data.emit(buf, num);
+                }
         }
         while (num == 1024);
         
+        stats.set_gauge(ZigBeeStats::SG_ReadQueueDepth, read_data_queue.size());
+        
         // try to read packets
         do
         {
                 len = 0;
                 if (pkt.read_packet(read_data_queue, len))
                 {
-                        pkt.decode_packet();
+                        pkt.read_timestamp = get_chunk_timestamp(read_data_pos + len);
+                        
+                        decoded = pkt.decode_packet();
+                        
+                        pkt.decode_timestamp = SerialInterface::get_timestamp();
+                        stats.add(decoded ? ZigBeeStats::SC_FramesDecoded : ZigBeeStats::SC_DecodeErrors);
+                        if (pkt.read_timestamp)
+                                stats.record(ZigBeeStats::SH_ReadToDecode, pkt.decode_timestamp - pkt.read_timestamp);
+                        
+                        update_rx_stats(pkt);
+                        
+                        if (decoded)
+                        {
+                                routes.update(pkt, pkt.decode_timestamp);
+                                addresses.update(pkt, pkt.decode_timestamp);
+                        }
+                        
+                        pkt.emit_timestamp = SerialInterface::get_timestamp();
+                        
                         m_signal_receive_packet.emit(pkt);
+                        
+                        stats.record(ZigBeeStats::SH_DecodeToEmit, SerialInterface::get_timestamp() - pkt.decode_timestamp);
+                }
+                else if (len > 0)
+                {
+                        // a rejected frame starts on a delimiter; anything
+                        // else is junk skipped while resynchronizing
+                        if (read_data_queue.front() == (char)ZIGBEE_IDENTIFIER)
+                                stats.add(ZigBeeStats::SC_ChecksumErrors);
+                        else
+                                stats.add(ZigBeeStats::SC_ResyncBytes, len);
                 }
                 for (int i = 0; i < len; i++)
                         read_data_queue.pop_front();
+                
+                read_data_pos += len;
+                
+                // drop timestamps of chunks that have been fully consumed
+                while (read_chunk_times.size() > 0 && read_chunk_times.front().first <= read_data_pos)
+                        read_chunk_times.pop_front();
         }
         while (read_data_queue.size() > 0 && len > 0);
+        
+        stats.set_gauge(ZigBeeStats::SG_ReadQueueDepth, read_data_queue.size());
+}
+
+
+void ZigBeeInterface::on_write_complete(SerialInterface::SerialStatus status, gsize bytes_written, int writes)
+{
+        stats.add(ZigBeeStats::SC_BytesWritten, bytes_written);
+        
+        if (writes > 1)
+                stats.add(ZigBeeStats::SC_PartialWrites, writes - 1);
+        
+        if (ser_int)
+                stats.set_gauge(ZigBeeStats::SG_WriteQueueDepth, ser_int->get_write_queue_size());
+        
+        if (status == SerialInterface::SS_PortNotOpen)
+        {
+                // frame was still queued when the port was closed
+                stats.add(ZigBeeStats::SC_WritesCancelled);
+        }
+        else if (status != SerialInterface::SS_Success)
+        {
+                std::cerr << "[ZigBeeInterface] Error: unable to write packet!" << std::endl;
+                m_signal_error.emit();
+        }
+}
+
+
+void ZigBeeInterface::on_port_reconnected(uint64_t outage)
+{
+        stats.add(ZigBeeStats::SC_Reconnects);
+        stats.record(ZigBeeStats::SH_ReconnectOutage, outage);
+}
+
+
+void ZigBeeInterface::on_write_high_water(bool above)
+{
+        write_above_high_water = above;
+        update_write_blocked();
+}
+
+
+void ZigBeeInterface::on_port_cts(bool asserted, uint64_t stall)
+{
+        if (asserted)
+        {
+                stats.add(ZigBeeStats::SC_CTSStalls);
+                stats.record(ZigBeeStats::SH_CTSStall, stall);
+        }
+        
+        cts_blocked = !asserted;
+        update_write_blocked();
+}
+
+
+void ZigBeeInterface::update_write_blocked()
+{
+        bool blocked = write_above_high_water || cts_blocked;
+        
+        if (blocked == write_blocked)
+                return;
+        
+        write_blocked = blocked;
+        m_signal_write_high_water.emit(blocked);
+}
+
+
+uint64_t ZigBeeInterface::get_chunk_timestamp(uint64_t pos)
+{
+        std::deque< std::pair<uint64_t, uint64_t> >::iterator it;
+        
+        for (it = read_chunk_times.begin(); it != read_chunk_times.end(); ++it)
+        {
+                if (it->first >= pos)
+                        return it->second;
+        }
+        
+        return 0;
+}
+
+
+// Receive statistics, fed straight from the typed frame payload
+struct RxStatsVisitor : public ZigBeeFrameVisitor
+{
+        using ZigBeeFrameVisitor::visit;
+        
+        RxStatsVisitor(ZigBeeStats &s, uint64_t *ts) : stats(s), tx_timestamps(ts) {}
+        
+        void visit(const ZigBeeFrame<ZigBeePacket::ZBPID_TxStatusS1> &frame)
+        {
+                tx_status(frame.frame_id(), frame.status() != 0);
+        }
+        
+        void visit(const ZigBeeFrame<ZigBeePacket::ZBPID_TxStatusS2> &frame)
+        {
+                tx_status(frame.frame_id(), frame.delivery_status() != 0);
+        }
+        
+        void tx_status(uint8_t frame_id, bool failed)
+        {
+                stats.add(ZigBeeStats::SC_TxStatus);
+                
+                if (failed)
+                        stats.add(ZigBeeStats::SC_TxStatusFailures);
+                
+                if (tx_timestamps[frame_id])
+                {
+                        stats.record(ZigBeeStats::SH_SendToTxStatus, SerialInterface::get_timestamp() - tx_timestamps[frame_id]);
+                        tx_timestamps[frame_id] = 0;
+                }
+        }
+        
+        ZigBeeStats &stats;
+        uint64_t *tx_timestamps;
+};
+
+
+void ZigBeeInterface::update_rx_stats(ZigBeePacket &pkt)
+{
+        RxStatsVisitor v(stats, tx_timestamps);
+        
+        ZigBeeFrameVisitor::dispatch(pkt, v);
 }
 
 
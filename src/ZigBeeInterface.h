@@ -37,7 +37,11 @@
 #include <gtkmm.h>
 
 #include "ZigBeePacket.h"
+#include "ZigBeePacketTemplate.h"
 #include "SerialInterface.h"
+#include "ZigBeeStats.h"
+#include "ZigBeeRouteCache.h"
+#include "ZigBeeAddressTable.h"
 
 #include <string>
 #include <tr1/memory>
@@ -50,7 +54,7 @@
  * The ZigBee interface class is used to manage transmission and reception
  * of ZigBee packets through a serial interface to a ZigBee module.
  */
-class ZigBeeInterface
+class ZigBeeInterface : public sigc::trackable
 {
 public:
         /**
@@ -98,11 +102,82 @@ public:
         void reset_buffer();
         
         /**
-         * Transmit a packet.
+         * Transmit a packet.  The packet is queued on the serial interface
+         * and written without blocking; write errors are reported through
+         * the error signal.
          * @param pkt packet to transmit
+         * @see signal_write_high_water()
          */
         void send_packet(ZigBeePacket pkt);
         
+        /**
+         * Transmit a precompiled packet template.  Address resolution,
+         * source routing and statistics are handled as for send_packet(),
+         * but the frame is written as is, without being rebuilt.
+         * @param tmpl packet template
+         * @see send_packet()
+         */
+        void send_template(ZigBeePacketTemplate &tmpl);
+        
+        /**
+         * Allocate a frame ID.  Cycles through 1-255, skipping 0, which
+         * disables transmit status.
+         * @return frame ID
+         */
+        uint8_t get_next_frame_id();
+        
+        /**
+         * Check transmit back-pressure.
+         * @return true if the serial write queue is above its high water
+         * mark, or CTS is deasserted with hardware flow control
+         * @see signal_write_high_water()
+         */
+        bool is_write_blocked();
+        
+        /**
+         * Enable or disable automatic source routing.  When enabled, a
+         * Create Source Route frame is sent ahead of each unicast
+         * transmit request to a destination with a cached multi-hop
+         * route.
+         * @param enable true to enable
+         * @see get_route_cache()
+         */
+        void set_source_routing(bool enable);
+        
+        /**
+         * Get automatic source routing state.
+         * @return true if enabled
+         */
+        bool get_source_routing();
+        
+        /**
+         * Enable or disable automatic address resolution.  When enabled,
+         * transmit requests and remote AT commands addressed with an
+         * unknown 16-bit address (0xFFFE) get the 16-bit address from the
+         * address table, if known.
+         * @param enable true to enable
+         * @see get_address_table()
+         */
+        void set_address_resolution(bool enable);
+        
+        /**
+         * Get automatic address resolution state.
+         * @return true if enabled
+         */
+        bool get_address_resolution();
+        
+        /**
+         * Get the address table, learned from received frames.
+         * @return reference to address table
+         */
+        ZigBeeAddressTable &get_address_table();
+        
+        /**
+         * Get the route cache, learned from received route records.
+         * @return reference to route cache
+         */
+        ZigBeeRouteCache &get_route_cache();
+        
         /**
          * Set debug status.  If debug mode is enabled, received byte counts
          * will be printed to stdout.  
@@ -120,6 +195,14 @@ public:
          */
         bool get_debug();
         
+        /**
+         * Get interface statistics.  Counters and latency histograms are
+         * always collected; see ZigBeeStats for details.
+         * @return reference to statistics block
+         * @see stats
+         */
+        ZigBeeStats &get_stats();
+        
         /**
          * Receive packet signal. 
          * @par Prototype:
@@ -148,12 +231,78 @@ public:
          */
         sigc::signal<void> signal_error();
         
+        /**
+         * Write high water signal.  Emitted with true when queued transmit
+         * data passes the serial interface high water mark or the module
+         * deasserts CTS, and with false once the queue has drained and
+         * CTS is back.  Senders should hold off while blocked.
+         * @par Prototype:
+         * <tt>void on_my_%write_high_water(bool blocked)</tt>
+         */
+        sigc::signal<void, bool> signal_write_high_water();
+        
 protected:
         /**
          * Serial interface receive data event handler.
          */
         void on_receive_data();
         
+        /**
+         * Serial interface write completion handler.  Frames discarded
+         * by closing the port are counted rather than reported as errors.
+         * @param status write status
+         * @param bytes_written bytes written
+         * @param writes number of write calls needed
+         */
+        void on_write_complete(SerialInterface::SerialStatus status, gsize bytes_written, int writes);
+        
+        /**
+         * Serial interface reconnected handler.
+         * @param outage time the port was gone in microseconds
+         */
+        void on_port_reconnected(uint64_t outage);
+        
+        /**
+         * Serial interface write high water handler.
+         * @param above true if above high water mark
+         */
+        void on_write_high_water(bool above);
+        
+        /**
+         * Serial interface CTS handler.
+         * @param asserted true if CTS is asserted
+         * @param stall time CTS was deasserted, when reasserted
+         */
+        void on_port_cts(bool asserted, uint64_t stall);
+        
+        /**
+         * Recompute write_blocked and signal a change.
+         */
+        void update_write_blocked();
+        
+        /**
+         * Queue a serialized frame for transmit and update statistics.
+         * @param frame frame, start delimiter through checksum
+         * @param len frame length
+         * @param identifier packet type
+         * @param frame_id frame ID, 0 if none
+         */
+        void write_frame(const uint8_t *frame, size_t len, ZigBeePacket::ZBP_Identifier identifier, uint8_t frame_id);
+        
+        /**
+         * Find the read timestamp for a stream position.
+         * @param pos stream position just past the last byte of a frame
+         * @return timestamp of the read that delivered that byte, or 0
+         * @see read_chunk_times
+         */
+        uint64_t get_chunk_timestamp(uint64_t pos);
+        
+        /**
+         * Update statistics for a received packet.
+         * @param pkt decoded packet
+         */
+        void update_rx_stats(ZigBeePacket &pkt);
+        
         /**
          * Shared pointer to serial interface instance.
          * @see set_serial_interface()
@@ -167,6 +316,19 @@ protected:
          */
         std::deque<char> read_data_queue;
         
+        /**
+         * Read chunk timestamps.  Each entry holds the stream position just
+         * past the end of a chunk read from the serial port and the time the
+         * chunk was read.
+         * @see get_chunk_timestamp()
+         */
+        std::deque< std::pair<uint64_t, uint64_t> > read_chunk_times;
+        
+        /**
+         * Stream position of the first byte in read_data_queue.
+         */
+        uint64_t read_data_pos;
+        
         /**
          * Debug mode.
          * @see set_debug()
@@ -174,6 +336,50 @@ protected:
          */
         bool debug;
         
+        /**
+         * Interface statistics.
+         * @see get_stats()
+         */
+        ZigBeeStats stats;
+        
+        /**
+         * Route cache.
+         * @see get_route_cache()
+         */
+        ZigBeeRouteCache routes;
+        
+        /**
+         * Automatic source routing.
+         * @see set_source_routing()
+         */
+        bool source_routing;
+        
+        /**
+         * 64 to 16-bit address table.
+         * @see get_address_table()
+         */
+        ZigBeeAddressTable addresses;
+        
+        /**
+         * Automatic address resolution.
+         * @see set_address_resolution()
+         */
+        bool address_resolution;
+        
+        /**
+         * Transmit serialization buffer, kept between sends so the
+         * transmit path stops allocating once it has grown.
+         * @see send_packet()
+         */
+        std::vector<uint8_t> tx_buffer;
+        
+        /**
+         * Transmit timestamps indexed by frame ID, used to measure time
+         * until the matching transmit status arrives.  Zero if no frame is
+         * outstanding.
+         */
+        uint64_t tx_timestamps[256];
+        
         /**
          * Receive packet signal.
          */
@@ -194,6 +400,33 @@ protected:
          */
         sigc::signal<void> m_signal_error;
         
+        /**
+         * Write high water signal.
+         */
+        sigc::signal<void, bool> m_signal_write_high_water;
+        
+        /**
+         * Last allocated frame ID.
+         * @see get_next_frame_id()
+         */
+        uint8_t frame_id;
+        
+        /**
+         * Transmit back-pressure state.
+         * @see is_write_blocked()
+         */
+        bool write_blocked;
+        
+        /**
+         * Serial write queue is above its high water mark.
+         */
+        bool write_above_high_water;
+        
+        /**
+         * CTS is deasserted.
+         */
+        bool cts_blocked;
+        
         /**
          * Serial interface port opened signal connection.
          */
@@ -208,6 +441,21 @@ protected:
          * Serial interface port receive data signal connection.
          */
         sigc::connection c_port_receive_data;
+        
+        /**
+         * Serial interface port write high water signal connection.
+         */
+        sigc::connection c_port_write_high_water;
+        
+        /**
+         * Serial interface port reconnected signal connection.
+         */
+        sigc::connection c_port_reconnected;
+        
+        /**
+         * Serial interface port CTS signal connection.
+         */
+        sigc::connection c_port_cts;
 };
 
 #endif //__ZIGBEE_INTERFACE_H
@@ -0,0 +1,237 @@
+/************************************************************************/
+/* ZigBeeLogFormatter                                                   */
+/*                                                                      */
+/* ZigBee Terminal - Packet Log Formatter                               */
+/*                                                                      */
+/* ZigBeeLogFormatter.cpp                                               */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ZigBeeLogFormatter.h"
+
+#include <cstdio>
+
+ZigBeeLogFormatter::ZigBeeLogFormatter() :
+        push_seq(0),
+        pop_seq(0),
+        skip(0),
+        start_timestamp(0),
+        running(false),
+        records_dropped(0)
+{
+        for (int i = 0; i < ZIGBEE_LOG_WORKERS; i++)
+        {
+                rings[i].write = 0;
+                rings[i].done = 0;
+                rings[i].read = 0;
+                rings[i].sleeping = false;
+                rings[i].thread = 0;
+        }
+}
+
+ZigBeeLogFormatter::~ZigBeeLogFormatter()
+{
+        stop();
+}
+
+void ZigBeeLogFormatter::start()
+{
+        if (running)
+                return;
+        
+        running = true;
+        
+        for (int i = 0; i < ZIGBEE_LOG_WORKERS; i++)
+                rings[i].thread = Glib::Thread::create( sigc::bind(sigc::mem_fun(*this, &ZigBeeLogFormatter::worker_thread), &rings[i]), true );
+}
+
+void ZigBeeLogFormatter::stop()
+{
+        if (!running)
+                return;
+        
+        for (int i = 0; i < ZIGBEE_LOG_WORKERS; i++)
+        {
+                Glib::Mutex::Lock lock(rings[i].mutex);
+                running = false;
+                rings[i].cond.signal();
+        }
+        
+        for (int i = 0; i < ZIGBEE_LOG_WORKERS; i++)
+        {
+                rings[i].thread->join();
+                rings[i].thread = 0;
+                rings[i].write = 0;
+                rings[i].done = 0;
+                rings[i].read = 0;
+        }
+        
+        push_seq = 0;
+        pop_seq = 0;
+        skip = 0;
+}
+
+void ZigBeeLogFormatter::set_start_timestamp(uint64_t timestamp)
+{
+        start_timestamp = timestamp;
+}
+
+bool ZigBeeLogFormatter::push(ZigBeePacket &pkt, uint64_t timestamp, bool tx)
+{
+        Ring &ring = rings[push_seq % ZIGBEE_LOG_WORKERS];
+        ZigBeeLogRecord *r;
+        
+        start();
+        
+        if (ring.write - ring.read >= ZIGBEE_LOG_RING_SIZE)
+        {
+                records_dropped++;
+                return false;
+        }
+        
+        r = &ring.records[ring.write % ZIGBEE_LOG_RING_SIZE];
+        r->pkt = pkt;
+        r->timestamp = timestamp;
+        r->tx = tx;
+        
+        // publish the slot, then check whether the worker needs waking;
+        // pairs with the barrier in worker_thread
+        __sync_synchronize();
+        ring.write = ring.write + 1;
+        __sync_synchronize();
+        
+        if (ring.sleeping)
+        {
+                Glib::Mutex::Lock lock(ring.mutex);
+                ring.cond.signal();
+        }
+        
+        push_seq++;
+        
+        return true;
+}
+
+ZigBeeLogRecord *ZigBeeLogFormatter::front()
+{
+        while (pop_seq < push_seq)
+        {
+                Ring &ring = rings[pop_seq % ZIGBEE_LOG_WORKERS];
+                
+                if (ring.done == ring.read)
+                        return 0;
+                
+                // slot contents were written before done was published
+                __sync_synchronize();
+                
+                if (!skip)
+                        return &ring.records[ring.read % ZIGBEE_LOG_RING_SIZE];
+                
+                skip--;
+                pop();
+        }
+        
+        return 0;
+}
+
+void ZigBeeLogFormatter::pop()
+{
+        Ring &ring = rings[pop_seq % ZIGBEE_LOG_WORKERS];
+        
+        ring.read++;
+        pop_seq++;
+}
+
+bool ZigBeeLogFormatter::empty()
+{
+        return pop_seq == push_seq;
+}
+
+void ZigBeeLogFormatter::clear()
+{
+        skip = push_seq - pop_seq;
+        front();
+}
+
+uint64_t ZigBeeLogFormatter::get_records_dropped()
+{
+        return records_dropped;
+}
+
+// Static
+std::string ZigBeeLogFormatter::format_time(uint64_t timestamp, uint64_t start)
+{
+        char buf[32];
+        
+        if (timestamp < start)
+                return "";
+        
+        snprintf(buf, sizeof(buf), "%.6f", (timestamp - start) / 1000000.0);
+        
+        return buf;
+}
+
+void ZigBeeLogFormatter::worker_thread(Ring *ring)
+{
+        unsigned int end;
+        
+        while (true)
+        {
+                {
+                        Glib::Mutex::Lock lock(ring->mutex);
+                        
+                        ring->sleeping = true;
+                        __sync_synchronize();
+                        
+                        while (running && ring->done == ring->write)
+                                ring->cond.wait(ring->mutex);
+                        
+                        ring->sleeping = false;
+                        
+                        if (!running)
+                                break;
+                }
+                
+                // slot contents were written before write was published
+                end = ring->write;
+                __sync_synchronize();
+                
+                while (ring->done != end)
+                {
+                        format(ring->records[ring->done % ZIGBEE_LOG_RING_SIZE]);
+                        __sync_synchronize();
+                        ring->done = ring->done + 1;
+                }
+        }
+}
+
+void ZigBeeLogFormatter::format(ZigBeeLogRecord &r)
+{
+        r.time = format_time(r.timestamp, start_timestamp);
+        r.type = r.pkt.get_type_desc();
+        r.size = r.pkt.get_length();
+        r.data = r.pkt.get_hex_packet();
+}
@@ -0,0 +1,215 @@
+/************************************************************************/
+/* ZigBeeLogFormatter                                                   */
+/*                                                                      */
+/* ZigBee Terminal - Packet Log Formatter                               */
+/*                                                                      */
+/* ZigBeeLogFormatter.h                                                 */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __ZIGBEE_LOG_FORMATTER_H
+#define __ZIGBEE_LOG_FORMATTER_H
+
+#include <gtkmm.h>
+
+#include "ZigBeePacket.h"
+
+#include <string>
+#include <inttypes.h>
+
+#define ZIGBEE_LOG_WORKERS 2
+#define ZIGBEE_LOG_RING_SIZE 1024
+#define ZIGBEE_LOG_BATCH 256
+#define ZIGBEE_LOG_TICK_MS 16
+
+/** Display-ready packet log record
+ */
+typedef struct
+{
+        ZigBeePacket pkt;       ///< Packet
+        uint64_t timestamp;     ///< Packet time (microseconds)
+        bool tx;                ///< Transmitted packet
+        std::string time;       ///< Formatted time, relative to start
+        std::string type;       ///< Packet type description
+        int size;               ///< Packet length
+        std::string data;       ///< Hex dump of the raw packet
+} ZigBeeLogRecord;
+
+/** ZigBee Log Formatter
+ * 
+ * Formats packets for the packet log on a pool of worker threads, so the
+ * hex dump and type description of a burst of frames are not built on the
+ * GTK thread.  Each worker owns a single producer, single consumer ring
+ * of ZIGBEE_LOG_RING_SIZE records.  The GTK thread copies a packet into
+ * the next free slot, the worker formats it in place, and the GTK thread
+ * takes the finished record back out; slot ownership is handed over by
+ * publishing ring indices, so neither side takes a lock on the data path.
+ * Packets are dealt to the workers round robin and taken back in the same
+ * order, so records come out in the order they were queued.
+ * 
+ * Workers sleep on a condition variable when their ring is empty and are
+ * only woken, under the ring mutex, if they went to sleep.  If a ring is
+ * full the packet is dropped and counted instead of stalling the GTK
+ * thread.
+ * 
+ * All methods other than the worker thread must be called from the GTK
+ * thread.
+ */
+class ZigBeeLogFormatter : public sigc::trackable
+{
+public:
+        ZigBeeLogFormatter();
+        virtual ~ZigBeeLogFormatter();
+        
+        /**
+         * Start the worker threads.  Called automatically by push().
+         */
+        void start();
+        
+        /**
+         * Stop the worker threads.  Records not yet taken are discarded.
+         */
+        void stop();
+        
+        /**
+         * Set start time that record times are relative to.  Call before
+         * the first push().
+         * @param timestamp start time (microseconds)
+         */
+        void set_start_timestamp(uint64_t timestamp);
+        
+        /**
+         * Queue a packet for formatting.
+         * @param pkt packet
+         * @param timestamp packet time (microseconds)
+         * @param tx true for a transmitted packet
+         * @return false if the packet was dropped
+         */
+        bool push(ZigBeePacket &pkt, uint64_t timestamp, bool tx);
+        
+        /**
+         * Get next finished record, in push order.
+         * @return record, or NULL if the next record is not ready yet
+         */
+        ZigBeeLogRecord *front();
+        
+        /**
+         * Release the record returned by front().
+         */
+        void pop();
+        
+        /**
+         * Check for queued records.
+         * @return true if no records are queued or being formatted
+         */
+        bool empty();
+        
+        /**
+         * Discard records not yet taken.  Records being formatted are
+         * skipped as they finish.
+         */
+        void clear();
+        
+        /**
+         * Get number of packets dropped because a ring was full.
+         * @return packets
+         */
+        uint64_t get_records_dropped();
+        
+        /**
+         * Format a time relative to a start time.
+         * @param timestamp time (microseconds)
+         * @param start start time (microseconds)
+         * @return seconds with six decimal places, or empty if before start
+         */
+        static std::string format_time(uint64_t timestamp, uint64_t start);
+        
+protected:
+        /**
+         * Per worker record ring.
+         */
+        struct Ring
+        {
+                ZigBeeLogRecord records[ZIGBEE_LOG_RING_SIZE];  ///< Record slots
+                volatile unsigned int write;    ///< Slots filled by the GTK thread
+                volatile unsigned int done;     ///< Slots formatted by the worker
+                unsigned int read;              ///< Slots taken by the GTK thread
+                volatile bool sleeping;         ///< Worker waiting for work
+                Glib::Mutex mutex;              ///< Wakeup mutex
+                Glib::Cond cond;                ///< Wakeup condition
+                Glib::Thread *thread;           ///< Worker thread
+        };
+        
+        /**
+         * Worker thread.
+         * @param ring ring served by the worker
+         */
+        void worker_thread(Ring *ring);
+        
+        /**
+         * Format one record.
+         * @param r record
+         */
+        void format(ZigBeeLogRecord &r);
+        
+        /**
+         * Worker rings.
+         */
+        Ring rings[ZIGBEE_LOG_WORKERS];
+        
+        /**
+         * Number of packets pushed.
+         */
+        uint64_t push_seq;
+        
+        /**
+         * Number of records popped.
+         */
+        uint64_t pop_seq;
+        
+        /**
+         * Records to discard before front() returns one.
+         */
+        uint64_t skip;
+        
+        /**
+         * Start time, read by the workers.
+         */
+        uint64_t start_timestamp;
+        
+        /**
+         * Worker threads running indicator.
+         */
+        volatile bool running;
+        
+        /**
+         * Packets dropped.
+         */
+        uint64_t records_dropped;
+};
+
+#endif //__ZIGBEE_LOG_FORMATTER_H
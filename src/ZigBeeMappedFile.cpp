@@ -0,0 +1,161 @@
+/************************************************************************/
+/* ZigBeeMappedFile                                                     */
+/*                                                                      */
+/* ZigBee Terminal - Read-only Mapped File                              */
+/*                                                                      */
+/* ZigBeeMappedFile.cpp                                                 */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ZigBeeMappedFile.h"
+
+#ifdef __unix__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#endif
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+
+
+ZigBeeMappedFile::ZigBeeMappedFile() :
+        data(0),
+        size(0),
+        mapped(false)
+{
+        
+}
+
+
+ZigBeeMappedFile::~ZigBeeMappedFile()
+{
+        close();
+}
+
+
+bool ZigBeeMappedFile::open(std::string filename)
+{
+        close();
+        
+        #ifdef __unix__
+        
+        int fd;
+        struct stat st;
+        void *p;
+        
+        fd = ::open(filename.c_str(), O_RDONLY);
+        
+        if (fd < 0)
+        {
+                std::cerr << "[ZigBeeMappedFile] Error (" << errno << ") opening " << filename << std::endl;
+                return false;
+        }
+        
+        if (fstat(fd, &st) < 0)
+        {
+                std::cerr << "[ZigBeeMappedFile] Error (" << errno << ") reading " << filename << std::endl;
+                ::close(fd);
+                return false;
+        }
+        
+        size = st.st_size;
+        
+        if (size == 0)
+        {
+                ::close(fd);
+                return true;
+        }
+        
+        p = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        
+        if (p == MAP_FAILED)
+        {
+                std::cerr << "[ZigBeeMappedFile] Error (" << errno << ") mapping " << filename << std::endl;
+                size = 0;
+                return false;
+        }
+        
+        // transfers read front to back
+        madvise(p, size, MADV_SEQUENTIAL);
+        
+        data = (const uint8_t *)p;
+        mapped = true;
+        
+        #else
+        
+        std::ifstream f(filename.c_str(), std::ios::in | std::ios::binary);
+        
+        if (!f)
+        {
+                std::cerr << "[ZigBeeMappedFile] Error opening " << filename << std::endl;
+                return false;
+        }
+        
+        buffer.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+        size = buffer.size();
+        data = size ? &buffer[0] : 0;
+        
+        #endif
+        
+        return true;
+}
+
+
+void ZigBeeMappedFile::close()
+{
+        #ifdef __unix__
+        
+        if (mapped && data && size)
+                munmap((void *)data, size);
+        
+        #endif
+        
+        mapped = false;
+        buffer.clear();
+        data = 0;
+        size = 0;
+}
+
+
+const uint8_t *ZigBeeMappedFile::get_data()
+{
+        return data;
+}
+
+
+size_t ZigBeeMappedFile::get_size()
+{
+        return size;
+}
+
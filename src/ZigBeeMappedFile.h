@@ -0,0 +1,102 @@
+/************************************************************************/
+/* ZigBeeMappedFile                                                     */
+/*                                                                      */
+/* ZigBee Terminal - Read-only Mapped File                              */
+/*                                                                      */
+/* ZigBeeMappedFile.h                                                   */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __ZIGBEE_MAPPED_FILE_H
+#define __ZIGBEE_MAPPED_FILE_H
+
+#include <string>
+#include <vector>
+#include <inttypes.h>
+#include <stddef.h>
+
+/** ZigBee Mapped File
+ * 
+ * Read-only view of a file used by the OTA and file transfers.  The file
+ * is memory mapped with sequential access advice where mmap is available,
+ * otherwise it is read into a buffer.
+ */
+class ZigBeeMappedFile
+{
+public:
+        ZigBeeMappedFile();
+        virtual ~ZigBeeMappedFile();
+        
+        /**
+         * Map a file, releasing any file already mapped.  An empty file
+         * succeeds with no data.
+         * @param filename file
+         * @return true on success
+         */
+        bool open(std::string filename);
+        
+        /**
+         * Unmap the file or free the copied data.
+         */
+        void close();
+        
+        /**
+         * Get file data.
+         * @return data, or NULL if empty
+         */
+        const uint8_t *get_data();
+        
+        /**
+         * Get file size.
+         * @return size in bytes
+         */
+        size_t get_size();
+        
+protected:
+        /**
+         * File data.
+         */
+        const uint8_t *data;
+        
+        /**
+         * File size.
+         */
+        size_t size;
+        
+        /**
+         * Data is a memory mapped file.
+         */
+        bool mapped;
+        
+        /**
+         * File copy where memory mapping is not available.
+         */
+        std::vector<uint8_t> buffer;
+};
+
+#endif //__ZIGBEE_MAPPED_FILE_H
+
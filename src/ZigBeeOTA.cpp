@@ -0,0 +1,405 @@
+/************************************************************************/
+/* ZigBeeOTA                                                            */
+/*                                                                      */
+/* ZigBee Terminal - Over-the-Air Firmware Transfer                     */
+/*                                                                      */
+/* ZigBeeOTA.cpp                                                        */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ZigBeeOTA.h"
+
+#include <iostream>
+
+
+ZigBeeOTA::ZigBeeOTA(ZigBeeInterface &zb) :
+        zb_int(zb),
+        image(0),
+        image_size(0),
+        dest64(0),
+        dest16(0xfffe),
+        block_size(ZIGBEE_OTA_DEFAULT_BLOCK_SIZE),
+        window(ZIGBEE_OTA_DEFAULT_WINDOW),
+        block_count(0),
+        next_block(0),
+        acked_count(0),
+        retransmit_count(0),
+        running(false),
+        write_blocked(false),
+        start_timestamp(0),
+        finish_timestamp(0)
+{
+        zb_int.signal_receive_packet().connect( sigc::mem_fun(*this, &ZigBeeOTA::on_receive_packet) );
+        zb_int.signal_write_high_water().connect( sigc::mem_fun(*this, &ZigBeeOTA::on_write_high_water) );
+}
+
+
+ZigBeeOTA::~ZigBeeOTA()
+{
+        c_timeout.disconnect();
+        unmap_image();
+}
+
+
+bool ZigBeeOTA::start(std::string filename, uint64_t d64, uint16_t d16)
+{
+        if (running)
+                return false;
+        
+        if (!map_image(filename))
+                return false;
+        
+        if (image_size == 0)
+        {
+                std::cerr << "[ZigBeeOTA] Empty image " << filename << std::endl;
+                unmap_image();
+                return false;
+        }
+        
+        dest64 = d64;
+        dest16 = d16;
+        block_count = (image_size + block_size - 1) / block_size;
+        next_block = 0;
+        acked_count = 0;
+        retransmit_count = 0;
+        acked.assign(block_count, false);
+        retries.assign(block_count, 0);
+        in_flight.clear();
+        running = true;
+        write_blocked = zb_int.is_write_blocked();
+        start_timestamp = SerialInterface::get_timestamp();
+        finish_timestamp = 0;
+        
+        c_timeout.disconnect();
+        c_timeout = Glib::signal_timeout().connect( sigc::mem_fun(*this, &ZigBeeOTA::on_timeout), ZIGBEE_OTA_POLL_MS );
+        
+        m_signal_progress.emit(0, block_count);
+        
+        pump();
+        
+        return true;
+}
+
+
+void ZigBeeOTA::cancel()
+{
+        if (running)
+                complete(false);
+}
+
+
+bool ZigBeeOTA::is_running()
+{
+        return running;
+}
+
+
+int ZigBeeOTA::set_block_size(int n)
+{
+        if (n > 0 && n <= ZIGBEE_OTA_MAX_BLOCK_SIZE && !running)
+                block_size = n;
+        
+        return block_size;
+}
+
+
+int ZigBeeOTA::get_block_size()
+{
+        return block_size;
+}
+
+
+int ZigBeeOTA::set_window(int n)
+{
+        // block numbers are 8 bits, so the window must stay well under
+        // half the number space to tell blocks apart
+        if (n > 0 && n <= ZIGBEE_OTA_MAX_WINDOW)
+                window = n;
+        
+        pump();
+        
+        return window;
+}
+
+
+int ZigBeeOTA::get_window()
+{
+        return window;
+}
+
+
+int ZigBeeOTA::get_block_count()
+{
+        return block_count;
+}
+
+
+int ZigBeeOTA::get_acked_count()
+{
+        return acked_count;
+}
+
+
+int ZigBeeOTA::get_retransmit_count()
+{
+        return retransmit_count;
+}
+
+
+uint64_t ZigBeeOTA::get_elapsed()
+{
+        if (!start_timestamp)
+                return 0;
+        
+        if (finish_timestamp)
+                return finish_timestamp - start_timestamp;
+        
+        return SerialInterface::get_timestamp() - start_timestamp;
+}
+
+
+sigc::signal<void, int, int> ZigBeeOTA::signal_progress()
+{
+        return m_signal_progress;
+}
+
+
+sigc::signal<void, bool, uint64_t> ZigBeeOTA::signal_complete()
+{
+        return m_signal_complete;
+}
+
+
+void ZigBeeOTA::on_receive_packet(ZigBeePacket pkt)
+{
+        if (!running)
+                return;
+        
+        if (pkt.identifier == ZigBeePacket::ZBPID_OTAFirmwareUpdateStatus)
+                handle_status(pkt);
+        else if (pkt.identifier == ZigBeePacket::ZBPID_TxStatusS2)
+                handle_tx_status(pkt);
+}
+
+
+void ZigBeeOTA::on_write_high_water(bool blocked)
+{
+        write_blocked = blocked;
+        
+        if (!write_blocked)
+                pump();
+}
+
+
+bool ZigBeeOTA::on_timeout()
+{
+        uint64_t now = SerialInterface::get_timestamp();
+        std::map<int, InFlight>::iterator it;
+        std::vector<int> lost;
+        
+        for (it = in_flight.begin(); it != in_flight.end(); ++it)
+        {
+                if (now - it->second.timestamp > ZIGBEE_OTA_BLOCK_TIMEOUT_MS * 1000ULL)
+                        lost.push_back(it->first);
+        }
+        
+        for (size_t i = 0; i < lost.size() && running; i++)
+                retransmit(lost[i]);
+        
+        return running;
+}
+
+
+void ZigBeeOTA::handle_status(ZigBeePacket &pkt)
+{
+        std::vector<uint8_t> &d = pkt.data;
+        int index;
+        
+        // bootloader message type, block number, target address
+        if (d.size() < 2 || pkt.src64 != dest64)
+                return;
+        
+        index = find_block(d[1]);
+        
+        if (index < 0)
+                return;
+        
+        switch (d[0])
+        {
+                case ZIGBEE_OTA_MSG_ACK:
+                        in_flight.erase(index);
+                        acked[index] = true;
+                        acked_count++;
+                        
+                        m_signal_progress.emit(acked_count, block_count);
+                        
+                        if (acked_count == block_count)
+                        {
+                                complete(true);
+                                return;
+                        }
+                        
+                        pump();
+                        break;
+                case ZIGBEE_OTA_MSG_NACK:
+                case ZIGBEE_OTA_MSG_NO_MAC_ACK:
+                        retransmit(index);
+                        break;
+                default:
+                        break;
+        }
+}
+
+
+void ZigBeeOTA::handle_tx_status(ZigBeePacket &pkt)
+{
+        std::map<int, InFlight>::iterator it;
+        
+        if (pkt.delivery_status == 0)
+                return;
+        
+        for (it = in_flight.begin(); it != in_flight.end(); ++it)
+        {
+                if (it->second.frame_id == pkt.frame_id)
+                {
+                        retransmit(it->first);
+                        return;
+                }
+        }
+}
+
+
+int ZigBeeOTA::find_block(uint8_t num)
+{
+        std::map<int, InFlight>::iterator it;
+        
+        for (it = in_flight.begin(); it != in_flight.end(); ++it)
+        {
+                if ((uint8_t)(it->first + 1) == num)
+                        return it->first;
+        }
+        
+        return -1;
+}
+
+
+void ZigBeeOTA::pump()
+{
+        while (running && !write_blocked && zb_int.is_connected() &&
+                next_block < block_count && (int)in_flight.size() < window)
+        {
+                send_block(next_block++);
+        }
+}
+
+
+void ZigBeeOTA::send_block(int index)
+{
+        size_t start = (size_t)index * block_size;
+        size_t end = start + block_size;
+        ZigBeePacket pkt;
+        InFlight f;
+        
+        if (end > image_size)
+                end = image_size;
+        
+        pkt.identifier = ZigBeePacket::ZBPID_EATxRequest;
+        pkt.frame_id = zb_int.get_next_frame_id();
+        pkt.dest64 = dest64;
+        pkt.dest16 = dest16;
+        pkt.src_ep = ZIGBEE_OTA_ENDPOINT;
+        pkt.dest_ep = ZIGBEE_OTA_ENDPOINT;
+        pkt.cluster_id = ZIGBEE_OTA_CLUSTER;
+        pkt.profile_id = ZIGBEE_OTA_PROFILE;
+        pkt.radius = 0;
+        pkt.options = 0;
+        
+        pkt.data.reserve(1 + end - start);
+        pkt.data.push_back(index + 1);
+        pkt.data.insert(pkt.data.end(), image + start, image + end);
+        
+        pkt.build_packet();
+        
+        f.frame_id = pkt.frame_id;
+        f.timestamp = SerialInterface::get_timestamp();
+        in_flight[index] = f;
+        
+        zb_int.send_packet(pkt);
+}
+
+
+void ZigBeeOTA::retransmit(int index)
+{
+        if (acked[index])
+                return;
+        
+        if (++retries[index] > ZIGBEE_OTA_RETRIES)
+        {
+                std::cerr << "[ZigBeeOTA] Block " << index << " failed after " << ZIGBEE_OTA_RETRIES << " retries" << std::endl;
+                complete(false);
+                return;
+        }
+        
+        retransmit_count++;
+        send_block(index);
+}
+
+
+void ZigBeeOTA::complete(bool success)
+{
+        running = false;
+        finish_timestamp = SerialInterface::get_timestamp();
+        in_flight.clear();
+        c_timeout.disconnect();
+        
+        unmap_image();
+        
+        m_signal_complete.emit(success, finish_timestamp - start_timestamp);
+}
+
+
+bool ZigBeeOTA::map_image(std::string filename)
+{
+        unmap_image();
+        
+        if (!image_file.open(filename))
+                return false;
+        
+        image = image_file.get_data();
+        image_size = image_file.get_size();
+        
+        return true;
+}
+
+
+void ZigBeeOTA::unmap_image()
+{
+        image_file.close();
+        image = 0;
+        image_size = 0;
+}
+
@@ -0,0 +1,367 @@
+/************************************************************************/
+/* ZigBeeOTA                                                            */
+/*                                                                      */
+/* ZigBee Terminal - Over-the-Air Firmware Transfer                     */
+/*                                                                      */
+/* ZigBeeOTA.h                                                          */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __ZIGBEE_OTA_H
+#define __ZIGBEE_OTA_H
+
+#include <gtkmm.h>
+
+#include "ZigBeeInterface.h"
+#include "ZigBeePacket.h"
+#include "ZigBeeMappedFile.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <inttypes.h>
+
+#define ZIGBEE_OTA_ENDPOINT 0xe8
+#define ZIGBEE_OTA_CLUSTER 0x0071
+#define ZIGBEE_OTA_PROFILE 0xc105
+#define ZIGBEE_OTA_DEFAULT_BLOCK_SIZE 64
+#define ZIGBEE_OTA_MAX_BLOCK_SIZE 80
+#define ZIGBEE_OTA_DEFAULT_WINDOW 8
+#define ZIGBEE_OTA_MAX_WINDOW 64
+#define ZIGBEE_OTA_RETRIES 5
+#define ZIGBEE_OTA_BLOCK_TIMEOUT_MS 5000
+#define ZIGBEE_OTA_POLL_MS 250
+
+#define ZIGBEE_OTA_MSG_ACK 0x06
+#define ZIGBEE_OTA_MSG_NACK 0x15
+#define ZIGBEE_OTA_MSG_NO_MAC_ACK 0x40
+
+/** ZigBee OTA firmware transfer
+ * 
+ * Streams a firmware image to a remote node's bootloader in blocks sent
+ * with Explicit Addressing Transmit Request (0x11) frames to endpoint
+ * 0xE8, cluster 0x0071.  Each block carries a one byte block number
+ * (starting at 1 and wrapping) followed by the image data.  The image
+ * is memory mapped, so blocks are sent straight from the page cache.
+ * 
+ * Up to window blocks are in flight at once.  Firmware update status
+ * (0xA0) frames acknowledge blocks; a NACK, a missing MAC acknowledge or
+ * a failed transmit status retransmits only the block concerned, and
+ * blocks with no answer are retransmitted after a timeout.  A window of
+ * 1 gives the stop-and-wait behaviour expected by bootloaders that only
+ * accept blocks in order.
+ */
+class ZigBeeOTA : public sigc::trackable
+{
+public:
+        /**
+         * Create an OTA transfer engine.
+         * @param zb interface to send and receive on
+         */
+        ZigBeeOTA(ZigBeeInterface &zb);
+        virtual ~ZigBeeOTA();
+        
+        /**
+         * Map an image and start sending it.
+         * @param filename firmware image file
+         * @param dest64 target 64-bit address
+         * @param dest16 target 16-bit address, 0xFFFE if unknown
+         * @return false if a transfer is running or the file cannot be
+         * mapped
+         */
+        bool start(std::string filename, uint64_t dest64, uint16_t dest16);
+        
+        /**
+         * Abort the transfer.
+         */
+        void cancel();
+        
+        /**
+         * Check if a transfer is running.
+         * @return true if running
+         */
+        bool is_running();
+        
+        /**
+         * Set block size.  Takes effect on the next transfer.
+         * @param n bytes of image data per block
+         * @return bytes
+         */
+        int set_block_size(int n);
+        
+        /**
+         * Get block size.
+         * @return bytes
+         */
+        int get_block_size();
+        
+        /**
+         * Set window.
+         * @param n blocks in flight
+         * @return blocks
+         */
+        int set_window(int n);
+        
+        /**
+         * Get window.
+         * @return blocks
+         */
+        int get_window();
+        
+        /**
+         * Get number of blocks in the image.
+         * @return blocks
+         */
+        int get_block_count();
+        
+        /**
+         * Get number of blocks acknowledged.
+         * @return blocks
+         */
+        int get_acked_count();
+        
+        /**
+         * Get number of block retransmissions.
+         * @return retransmissions
+         */
+        int get_retransmit_count();
+        
+        /**
+         * Get time since start, or total time once finished.
+         * @return microseconds
+         */
+        uint64_t get_elapsed();
+        
+        /**
+         * Progress signal, emitted as blocks are acknowledged.
+         * @par Prototype:
+         * <tt>void on_my_%progress(int acked, int total)</tt>
+         */
+        sigc::signal<void, int, int> signal_progress();
+        
+        /**
+         * Complete signal.
+         * @par Prototype:
+         * <tt>void on_my_%complete(bool success, uint64_t elapsed_us)</tt>
+         */
+        sigc::signal<void, bool, uint64_t> signal_complete();
+        
+protected:
+        /**
+         * Block in flight.
+         */
+        struct InFlight
+        {
+                uint8_t frame_id;               ///< Frame ID of last send
+                uint64_t timestamp;             ///< Time of last send
+        };
+        
+        /**
+         * Receive packet handler.
+         * @param pkt packet
+         */
+        void on_receive_packet(ZigBeePacket pkt);
+        
+        /**
+         * Write high water handler.
+         * @param blocked true if blocked
+         */
+        void on_write_high_water(bool blocked);
+        
+        /**
+         * Retransmit timer handler.
+         * @return true to keep running
+         */
+        bool on_timeout();
+        
+        /**
+         * Handle a firmware update status frame.
+         * @param pkt status packet
+         */
+        void handle_status(ZigBeePacket &pkt);
+        
+        /**
+         * Handle transmit status for a block.
+         * @param pkt transmit status packet
+         */
+        void handle_tx_status(ZigBeePacket &pkt);
+        
+        /**
+         * Find the in-flight block with a block number.
+         * @param num block number
+         * @return block index, or -1
+         */
+        int find_block(uint8_t num);
+        
+        /**
+         * Send new blocks until the window is full.
+         */
+        void pump();
+        
+        /**
+         * Send or resend one block.
+         * @param index block index
+         */
+        void send_block(int index);
+        
+        /**
+         * Retransmit a block, or fail the transfer when out of retries.
+         * @param index block index
+         */
+        void retransmit(int index);
+        
+        /**
+         * Finish the transfer and unmap the image.
+         * @param success true if every block was acknowledged
+         */
+        void complete(bool success);
+        
+        /**
+         * Map an image file.
+         * @param filename file
+         * @return true on success
+         */
+        bool map_image(std::string filename);
+        
+        /**
+         * Unmap the image.
+         */
+        void unmap_image();
+        
+        /**
+         * Interface used for the transfer.
+         */
+        ZigBeeInterface &zb_int;
+        
+        /**
+         * Image data.
+         */
+        const uint8_t *image;
+        
+        /**
+         * Image size.
+         */
+        size_t image_size;
+        
+        /**
+         * Mapped image file.
+         */
+        ZigBeeMappedFile image_file;
+        
+        /**
+         * Target 64-bit address.
+         */
+        uint64_t dest64;
+        
+        /**
+         * Target 16-bit address.
+         */
+        uint16_t dest16;
+        
+        /**
+         * Block size.
+         */
+        int block_size;
+        
+        /**
+         * Window.
+         */
+        int window;
+        
+        /**
+         * Number of blocks.
+         */
+        int block_count;
+        
+        /**
+         * Next block not yet sent.
+         */
+        int next_block;
+        
+        /**
+         * Blocks acknowledged.
+         */
+        int acked_count;
+        
+        /**
+         * Retransmissions.
+         */
+        int retransmit_count;
+        
+        /**
+         * Acknowledged flags per block.
+         */
+        std::vector<bool> acked;
+        
+        /**
+         * Retries per block.
+         */
+        std::vector<int> retries;
+        
+        /**
+         * Blocks in flight by block index.
+         */
+        std::map<int, InFlight> in_flight;
+        
+        /**
+         * Running indicator.
+         */
+        bool running;
+        
+        /**
+         * Serial write queue is above its high water mark.
+         */
+        bool write_blocked;
+        
+        /**
+         * Start time.
+         */
+        uint64_t start_timestamp;
+        
+        /**
+         * Finish time.
+         */
+        uint64_t finish_timestamp;
+        
+        /**
+         * Timer connection.
+         */
+        sigc::connection c_timeout;
+        
+        /**
+         * Progress signal.
+         */
+        sigc::signal<void, int, int> m_signal_progress;
+        
+        /**
+         * Complete signal.
+         */
+        sigc::signal<void, bool, uint64_t> m_signal_complete;
+};
+
+#endif //__ZIGBEE_OTA_H
+
@@ -35,6 +35,8 @@
 
 #include <sstream>
 #include <iomanip>
+#include <stdlib.h>
+#include <ctype.h>
 
 // Static
 bool ZigBeePacket::is_valid_identifier(int identifier)
@@ -186,6 +188,30 @@ std::string ZigBeePacket::get_type_desc(int identifier)
         }
 }
 
+// Static
+bool ZigBeePacket::parse_hex_bytes(std::string str, std::vector<uint8_t> &out)
+{
+        std::string digits;
+        
+        out.clear();
+        
+        for (size_t i = 0; i < str.size(); i++)
+        {
+                if (isxdigit((unsigned char)str[i]))
+                        digits += str[i];
+                else if (!isspace((unsigned char)str[i]))
+                        return false;
+        }
+        
+        if (digits.size() % 2)
+                return false;
+        
+        for (size_t i = 0; i < digits.size(); i += 2)
+                out.push_back(strtoul(digits.substr(i, 2).c_str(), 0, 16));
+        
+        return true;
+}
+
 ZigBeePacket::ZigBeePacket()
 {
         zero();
@@ -257,6 +283,10 @@ void ZigBeePacket::zero()
         data_offset = 0;
         route_records.clear();
         route_records_offset = 0;
+        read_timestamp = 0;
+        decode_timestamp = 0;
+        emit_timestamp = 0;
+        render_timestamp = 0;
 }
 
 uint16_t ZigBeePacket::get_length()
@@ -278,43 +308,193 @@ uint8_t ZigBeePacket::get_checksum()
 
 std::vector<uint8_t> ZigBeePacket::get_raw_packet()
 {
-        std::vector<uint8_t> dataout;
+        std::vector<uint8_t> dataout(get_serialized_size(false));
         
-        dataout.push_back(ZIGBEE_IDENTIFIER);
-        dataout.push_back(payload.size() >> 8);
-        dataout.push_back(payload.size());
+        serialize(&dataout[0], dataout.size(), false);
         
-        dataout.insert(dataout.end(), payload.begin(), payload.end());
+        return dataout;
+}
+
+std::vector<uint8_t> ZigBeePacket::get_escaped_raw_packet()
+{
+        std::vector<uint8_t> dataout(get_serialized_size(true));
         
-        dataout.push_back(get_checksum());
+        serialize(&dataout[0], dataout.size(), true);
         
         return dataout;
 }
 
-std::vector<uint8_t> ZigBeePacket::get_escaped_raw_packet()
+// Check if a byte must be escaped in API mode 2
+static inline bool needs_escape(uint8_t b)
 {
-        std::vector<uint8_t> datain = get_raw_packet();
-        std::vector<uint8_t> dataout;
+        return b == ZIGBEE_IDENTIFIER || b == ZIGBEE_ESCAPE || b == ZIGBEE_XON || b == ZIGBEE_XOFF;
+}
+
+// Write a byte with API mode 2 escaping, checking for room
+static inline bool put_escaped(uint8_t *&p, uint8_t *end, uint8_t b)
+{
+        if (needs_escape(b))
+        {
+                if (end - p < 2)
+                        return false;
+                
+                *p++ = ZIGBEE_ESCAPE;
+                *p++ = b ^ 0x20;
+                return true;
+        }
         
-        dataout.push_back(ZIGBEE_IDENTIFIER);
+        if (p == end)
+                return false;
         
-        for (int i = 1; i < datain.size(); i++)
+        *p++ = b;
+        return true;
+}
+
+size_t ZigBeePacket::get_serialized_size(bool escaped)
+{
+        size_t n = payload.size();
+        size_t count = n + 4;
+        
+        if (!escaped)
+                return count;
+        
+        count += needs_escape(n >> 8) + needs_escape(n & 0xff) + needs_escape(get_checksum());
+        
+        for (size_t i = 0; i < n; i++)
+                count += needs_escape(payload[i]);
+        
+        return count;
+}
+
+size_t ZigBeePacket::get_max_serialized_size(bool escaped)
+{
+        // everything after the start delimiter may double
+        return escaped ? 1 + (payload.size() + 3) * 2 : payload.size() + 4;
+}
+
+size_t ZigBeePacket::serialize(uint8_t *buf, size_t len, bool escaped)
+{
+        size_t n = payload.size();
+        const uint8_t *src = n ? &payload[0] : 0;
+        uint8_t *p = buf;
+        uint8_t *end = buf + len;
+        uint8_t sum = 0xFF;
+        uint8_t b;
+        
+        if (len < n + 4)
+                return 0;
+        
+        *p++ = ZIGBEE_IDENTIFIER;
+        
+        if (!escaped)
         {
-                if (datain[i] == ZIGBEE_IDENTIFIER || datain[i] == ZIGBEE_ESCAPE ||
-                        datain[i] == 0x11 || datain[i] == 0x13)
+                *p++ = n >> 8;
+                *p++ = n;
+                
+                for (size_t i = 0; i < n; i++)
                 {
-                        dataout.push_back(ZIGBEE_ESCAPE);
-                        dataout.push_back(datain[i]^0x20);
+                        b = src[i];
+                        sum -= b;
+                        *p++ = b;
                 }
-                else
+                
+                *p++ = sum;
+                
+                return p - buf;
+        }
+        
+        if (!put_escaped(p, end, n >> 8) || !put_escaped(p, end, n))
+                return 0;
+        
+        for (size_t i = 0; i < n; i++)
+        {
+                b = src[i];
+                sum -= b;
+                
+                if (!put_escaped(p, end, b))
+                        return 0;
+        }
+        
+        if (!put_escaped(p, end, sum))
+                return 0;
+        
+        return p - buf;
+}
+
+#ifdef __unix__
+
+/** Sequential writer over scatter buffers. */
+struct IOVecWriter
+{
+        const struct iovec *iov;        ///< Buffers
+        int iovcnt;                     ///< Number of buffers
+        int index;                      ///< Current buffer
+        uint8_t *p;                     ///< Write pointer
+        uint8_t *end;                   ///< End of current buffer
+        size_t count;                   ///< Bytes written
+        
+        IOVecWriter(const struct iovec *v, int cnt) :
+                iov(v),
+                iovcnt(cnt),
+                index(-1),
+                p(0),
+                end(0),
+                count(0)
+        {
+                
+        }
+        
+        bool put(uint8_t b)
+        {
+                while (p == end)
                 {
-                        dataout.push_back(datain[i]);
+                        if (++index >= iovcnt)
+                                return false;
+                        
+                        p = (uint8_t *)iov[index].iov_base;
+                        end = p + iov[index].iov_len;
                 }
+                
+                *p++ = b;
+                count++;
+                
+                return true;
         }
         
-        return dataout;
+        bool put(uint8_t b, bool escaped)
+        {
+                if (escaped && needs_escape(b))
+                        return put(ZIGBEE_ESCAPE) && put(b ^ 0x20);
+                
+                return put(b);
+        }
+};
+
+size_t ZigBeePacket::serialize(const struct iovec *iov, int iovcnt, bool escaped)
+{
+        IOVecWriter w(iov, iovcnt);
+        size_t n = payload.size();
+        uint8_t sum = 0xFF;
+        
+        if (!w.put(ZIGBEE_IDENTIFIER) || !w.put(n >> 8, escaped) || !w.put(n, escaped))
+                return 0;
+        
+        for (size_t i = 0; i < n; i++)
+        {
+                sum -= payload[i];
+                
+                if (!w.put(payload[i], escaped))
+                        return 0;
+        }
+        
+        if (!w.put(sum, escaped))
+                return 0;
+        
+        return w.count;
 }
 
+#endif
+
 bool ZigBeePacket::read_packet(std::vector<char> bytes, size_t &bytes_read)
 {
         return read_packet((uint8_t *)&bytes[0], bytes.size(), bytes_read);
@@ -618,10 +798,10 @@ bool ZigBeePacket::set_offsets()
                         sender64_offset = 1;
                         sender16_offset = 9;
                         options_offset = 11;
-                        src64_offset = 12;
-                        src16_offset = 20;
-                        data_offset = 21;
-                        min_length = 21;
+                        src16_offset = 12;
+                        src64_offset = 14;
+                        data_offset = 22;
+                        min_length = 22;
                         field_count = 7;
                         return true;
                 case ZBPID_RemoteCommandResponse:
@@ -659,12 +839,11 @@ bool ZigBeePacket::set_offsets()
                         field_count = 4;
                         return true;
                 case ZBPID_ManyToOneRouteRequest:
-                        frame_id_offset = 1;
-                        src64_offset = 2;
-                        src16_offset = 10;
-                        reserved_offset = 12;
-                        min_length = 13;
-                        field_count = 5;
+                        src64_offset = 1;
+                        src16_offset = 9;
+                        reserved_offset = 11;
+                        min_length = 12;
+                        field_count = 4;
                         return true;
                 case ZBPID_RegisterJoiningDeviceStatus:
                         frame_id_offset = 1;
@@ -691,8 +870,9 @@ bool ZigBeePacket::build_packet()
         if (!set_offsets())
                 return false;
         
-        // init payload
+        // init payload, sized once for data and route records
         payload.clear();
+        payload.reserve(min_length + data.size() + route_records.size() * 2);
         payload.push_back(identifier);
         payload.resize(min_length);
         
@@ -746,6 +926,8 @@ bool ZigBeePacket::build_packet()
                         payload[route_records_offset+1+i*2+1] = route_records[i];
                 }
         }
+        
+        return true;
 }
 
 bool ZigBeePacket::decode_packet()
@@ -903,13 +1085,20 @@ bool ZigBeePacket::decode_packet()
         {
                 route_records.clear();
                 
-                for (int i = read_payload_uint8(route_records_offset); i > 0; i--)
+                int count = read_payload_uint8(route_records_offset);
+                
+                if (payload.size() < (size_t)(route_records_offset + 1 + count * 2))
+                        return false;
+                
+                for (int i = 0; i < count; i++)
                 {
-                        uint16_t n = (uint16_t)payload[route_records_offset+1+n*2] << 8;
-                        n |= (uint16_t)payload[route_records_offset+1+n*2+1];
+                        uint16_t n = (uint16_t)payload[route_records_offset+1+i*2] << 8;
+                        n |= (uint16_t)payload[route_records_offset+1+i*2+1];
                         route_records.push_back(n);
                 }
         }
+        
+        return true;
 }
 
 std::string ZigBeePacket::get_type_desc()
@@ -1080,6 +1269,17 @@ std::string ZigBeePacket::get_desc()
         
         desc << "  Checksum: 0x" << std::setfill('0') << std::setw(2) << std::hex << (int)get_checksum();
         
+        if (read_timestamp)
+        {
+                desc << std::endl << "  Latency (us): read";
+                if (decode_timestamp)
+                        desc << " / decode +" << std::dec << decode_timestamp - read_timestamp;
+                if (emit_timestamp)
+                        desc << " / emit +" << std::dec << emit_timestamp - read_timestamp;
+                if (render_timestamp)
+                        desc << " / render +" << std::dec << render_timestamp - read_timestamp;
+        }
+        
         return desc.str();
 }
 
@@ -1098,6 +1298,39 @@ std::string ZigBeePacket::get_hex_packet()
         return out.str();
 }
 
+std::string ZigBeePacket::get_trace_events(unsigned int index)
+{
+        std::stringstream out;
+        uint64_t stages[4] = {read_timestamp, decode_timestamp, emit_timestamp, render_timestamp};
+        const char *names[3] = {"read to decode", "decode to emit", "emit to render"};
+        bool first = true;
+        
+        if (!read_timestamp)
+                return "";
+        
+        for (int i = 0; i < 3; i++)
+        {
+                if (!stages[i] || !stages[i+1] || stages[i+1] < stages[i])
+                        break;
+                
+                if (!first)
+                        out << ",";
+                first = false;
+                
+                out << "{\"name\":\"" << get_type_desc() << "\",";
+                out << "\"cat\":\"" << names[i] << "\",";
+                out << "\"ph\":\"X\",";
+                out << "\"pid\":1,\"tid\":" << std::dec << i+1 << ",";
+                out << "\"ts\":" << stages[i] << ",";
+                out << "\"dur\":" << stages[i+1] - stages[i] << ",";
+                out << "\"args\":{\"frame\":" << index << ",";
+                out << "\"identifier\":\"0x" << std::setfill('0') << std::setw(2) << std::hex << identifier << "\",";
+                out << "\"length\":" << std::dec << get_length() << "}}";
+        }
+        
+        return out.str();
+}
+
 
 // read and write payload data
 uint8_t ZigBeePacket::read_payload_uint8(int offset)
@@ -39,8 +39,14 @@
 #include <deque>
 #include <inttypes.h>
 
+#ifdef __unix__
+#include <sys/uio.h>
+#endif
+
 #define ZIGBEE_IDENTIFIER 0x7E
 #define ZIGBEE_ESCAPE 0x7D
+#define ZIGBEE_XON 0x11
+#define ZIGBEE_XOFF 0x13
 
 /** ZigBee packet
  * 
@@ -463,6 +469,12 @@ public:
         std::vector<uint16_t> route_records;    ///< Route records field
         int route_records_offset;               ///< Route records field offset
         
+        // pipeline timestamps (microseconds, monotonic, 0 if not reached)
+        uint64_t read_timestamp;        ///< Serial read that completed the frame
+        uint64_t decode_timestamp;      ///< Frame decoded
+        uint64_t emit_timestamp;        ///< Frame passed to receive handlers
+        uint64_t render_timestamp;      ///< Frame displayed or stored
+        
         /**
          * Zero out all packet fields.
          */
@@ -492,6 +504,52 @@ public:
          */
         std::vector<uint8_t> get_escaped_raw_packet();
         
+        /**
+         * Get exact size of the serialized packet.
+         * @param escaped true to count API mode 2 (AP=2) escapes
+         * @return size in bytes
+         * @see serialize()
+         */
+        size_t get_serialized_size(bool escaped = false);
+        
+        /**
+         * Get an upper bound on the size of the serialized packet, without
+         * looking at the payload.  A buffer of this size always fits.
+         * @param escaped true to allow for API mode 2 (AP=2) escapes
+         * @return size in bytes
+         * @see serialize()
+         */
+        size_t get_max_serialized_size(bool escaped = false);
+        
+        /**
+         * Serialize packet into a caller supplied buffer.  Writes start
+         * delimiter, length, payload and checksum in a single pass over
+         * the payload, escaping as it goes when requested.  Nothing is
+         * allocated.  The payload must already be built.
+         * @param buf output buffer
+         * @param len buffer size
+         * @param escaped true for API mode 2 (AP=2) escaping
+         * @return bytes written, or 0 if the buffer is too small
+         * @see get_serialized_size()
+         * @see build_packet()
+         */
+        size_t serialize(uint8_t *buf, size_t len, bool escaped = false);
+        
+        #ifdef __unix__
+        
+        /**
+         * Serialize packet into caller supplied scatter buffers, such as
+         * the free segments of a ring buffer.  Buffers are filled in order.
+         * @param iov buffers
+         * @param iovcnt number of buffers
+         * @param escaped true for API mode 2 (AP=2) escaping
+         * @return bytes written, or 0 if the buffers are too small
+         * @see serialize()
+         */
+        size_t serialize(const struct iovec *iov, int iovcnt, bool escaped = false);
+        
+        #endif
+        
         /**
          * Try to read packet from a vector of bytes. Looks for identifier
          * byte to indicate start of packet.
@@ -580,6 +638,18 @@ public:
          */
         std::string get_hex_packet();
         
+        /**
+         * Get pipeline timestamps as Chrome trace events.  Returns one
+         * complete ("X") event per pipeline stage that was reached, as a
+         * comma separated list of JSON objects suitable for the traceEvents
+         * array of a Chrome trace file.  Stages are read to decode (tid 1),
+         * decode to emit (tid 2) and emit to render (tid 3).
+         * @param index frame index, stored in event args
+         * @return JSON event list, empty if the frame has no read timestamp
+         * @see read_timestamp
+         */
+        std::string get_trace_events(unsigned int index);
+        
         /**
          * Check identifier
          * @return true if valid identifier
@@ -601,6 +671,14 @@ public:
          */
         static std::string get_type_desc(int identifier);
         
+        /**
+         * Parse hex digits into bytes, ignoring spaces.
+         * @param str hex string
+         * @param out parsed bytes
+         * @return false on odd length or bad digits
+         */
+        static bool parse_hex_bytes(std::string str, std::vector<uint8_t> &out);
+        
 protected:
         // read and write payload data
         /**
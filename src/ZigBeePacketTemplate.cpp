@@ -0,0 +1,210 @@
+/************************************************************************/
+/* ZigBeePacketTemplate                                                 */
+/*                                                                      */
+/* ZigBee Terminal - Packet Template                                    */
+/*                                                                      */
+/* ZigBeePacketTemplate.cpp                                             */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ZigBeePacketTemplate.h"
+
+// start delimiter and length ahead of the frame data
+#define TEMPLATE_HEADER_LEN 3
+
+ZigBeePacketTemplate::ZigBeePacketTemplate() :
+        identifier(ZigBeePacket::ZBPID_ATCommand),
+        checksum_pos(0),
+        frame_id_pos(0),
+        dest64_pos(0),
+        dest16_pos(0),
+        data_pos(0),
+        data_len(0)
+{
+        
+}
+
+ZigBeePacketTemplate::ZigBeePacketTemplate(ZigBeePacket pkt) :
+        identifier(ZigBeePacket::ZBPID_ATCommand),
+        checksum_pos(0),
+        frame_id_pos(0),
+        dest64_pos(0),
+        dest16_pos(0),
+        data_pos(0),
+        data_len(0)
+{
+        compile(pkt);
+}
+
+ZigBeePacketTemplate::~ZigBeePacketTemplate()
+{
+        
+}
+
+bool ZigBeePacketTemplate::compile(ZigBeePacket pkt)
+{
+        frame.clear();
+        checksum_pos = 0;
+        
+        if (!pkt.build_packet())
+                return false;
+        
+        frame = pkt.get_raw_packet();
+        identifier = pkt.identifier;
+        checksum_pos = frame.size() - 1;
+        
+        frame_id_pos = pkt.frame_id_offset ? pkt.frame_id_offset + TEMPLATE_HEADER_LEN : 0;
+        dest64_pos = pkt.dest64_offset ? pkt.dest64_offset + TEMPLATE_HEADER_LEN : 0;
+        dest16_pos = pkt.dest16_offset ? pkt.dest16_offset + TEMPLATE_HEADER_LEN : 0;
+        data_pos = pkt.data_offset ? pkt.data_offset + TEMPLATE_HEADER_LEN : 0;
+        data_len = pkt.data_offset ? pkt.data.size() : 0;
+        
+        return true;
+}
+
+bool ZigBeePacketTemplate::is_valid()
+{
+        return checksum_pos > 0;
+}
+
+bool ZigBeePacketTemplate::set_frame_id(uint8_t id)
+{
+        if (!frame_id_pos)
+                return false;
+        
+        patch(frame_id_pos, id);
+        
+        return true;
+}
+
+bool ZigBeePacketTemplate::set_dest64(uint64_t addr64)
+{
+        if (!dest64_pos)
+                return false;
+        
+        for (int i = 7; i >= 0; i--)
+        {
+                patch(dest64_pos + i, addr64);
+                addr64 >>= 8;
+        }
+        
+        return true;
+}
+
+bool ZigBeePacketTemplate::set_dest16(uint16_t addr16)
+{
+        if (!dest16_pos)
+                return false;
+        
+        patch(dest16_pos, addr16 >> 8);
+        patch(dest16_pos + 1, addr16);
+        
+        return true;
+}
+
+bool ZigBeePacketTemplate::set_data(size_t offset, const uint8_t *buf, size_t len)
+{
+        if (!data_pos || offset > data_len || len > data_len - offset)
+                return false;
+        
+        for (size_t i = 0; i < len; i++)
+                patch(data_pos + offset + i, buf[i]);
+        
+        return true;
+}
+
+bool ZigBeePacketTemplate::set_data_uint8(size_t offset, uint8_t b)
+{
+        if (!data_pos || offset >= data_len)
+                return false;
+        
+        patch(data_pos + offset, b);
+        
+        return true;
+}
+
+ZigBeePacket::ZBP_Identifier ZigBeePacketTemplate::get_identifier()
+{
+        return identifier;
+}
+
+uint8_t ZigBeePacketTemplate::get_frame_id()
+{
+        return frame_id_pos ? frame[frame_id_pos] : 0;
+}
+
+uint64_t ZigBeePacketTemplate::get_dest64()
+{
+        uint64_t addr64 = 0;
+        
+        if (!dest64_pos)
+                return 0;
+        
+        for (int i = 0; i < 8; i++)
+                addr64 = (addr64 << 8) | frame[dest64_pos + i];
+        
+        return addr64;
+}
+
+uint16_t ZigBeePacketTemplate::get_dest16()
+{
+        if (!dest16_pos)
+                return 0;
+        
+        return (frame[dest16_pos] << 8) | frame[dest16_pos + 1];
+}
+
+bool ZigBeePacketTemplate::has_dest16()
+{
+        return dest16_pos != 0;
+}
+
+size_t ZigBeePacketTemplate::get_data_size()
+{
+        return data_len;
+}
+
+const uint8_t *ZigBeePacketTemplate::get_frame()
+{
+        return frame.size() ? &frame[0] : 0;
+}
+
+size_t ZigBeePacketTemplate::get_frame_size()
+{
+        return frame.size();
+}
+
+ZigBeePacket ZigBeePacketTemplate::get_packet()
+{
+        ZigBeePacket pkt;
+        size_t n;
+        
+        if (is_valid() && pkt.read_packet(&frame[0], frame.size(), n))
+                pkt.decode_packet();
+        
+        return pkt;
+}
@@ -0,0 +1,199 @@
+/************************************************************************/
+/* ZigBeePacketTemplate                                                 */
+/*                                                                      */
+/* ZigBee Terminal - Packet Template                                    */
+/*                                                                      */
+/* ZigBeePacketTemplate.h                                               */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __ZIGBEE_PACKET_TEMPLATE_H
+#define __ZIGBEE_PACKET_TEMPLATE_H
+
+#include "ZigBeePacket.h"
+
+#include <vector>
+#include <inttypes.h>
+
+/** ZigBee Packet Template
+ * 
+ * A frame serialized once, with the positions of the frame ID, destination
+ * address and data fields precomputed, for sending the same frame shape
+ * over and over.  Patching a field writes the new bytes in place and
+ * adjusts the checksum by the difference, so the frame is never rebuilt.
+ * The checksum is 0xFF minus the sum of the frame data, so changing a
+ * byte from old to new takes (new - old) off the checksum.
+ * 
+ * Patches cannot change the frame length; data can only be overwritten
+ * within the data field the template was compiled with.
+ */
+class ZigBeePacketTemplate
+{
+public:
+        /**
+         * Create an empty template.
+         */
+        ZigBeePacketTemplate();
+        
+        /**
+         * Create a template from a packet.
+         * @param pkt packet
+         * @see compile()
+         */
+        ZigBeePacketTemplate(ZigBeePacket pkt);
+        
+        virtual ~ZigBeePacketTemplate();
+        
+        /**
+         * Build and serialize a packet into the template.
+         * @param pkt packet
+         * @return true if the packet was built
+         */
+        bool compile(ZigBeePacket pkt);
+        
+        /**
+         * Check for a compiled frame.
+         * @return true if valid
+         */
+        bool is_valid();
+        
+        /**
+         * Patch frame ID.
+         * @param id frame ID
+         * @return false if the frame has no frame ID field
+         */
+        bool set_frame_id(uint8_t id);
+        
+        /**
+         * Patch destination 64-bit address.
+         * @param addr64 address
+         * @return false if the frame has no such field
+         */
+        bool set_dest64(uint64_t addr64);
+        
+        /**
+         * Patch destination 16-bit address.
+         * @param addr16 address
+         * @return false if the frame has no such field
+         */
+        bool set_dest16(uint16_t addr16);
+        
+        /**
+         * Patch data bytes.
+         * @param offset offset into the data field
+         * @param buf new bytes
+         * @param len number of bytes
+         * @return false if the range is outside the data field
+         */
+        bool set_data(size_t offset, const uint8_t *buf, size_t len);
+        
+        /**
+         * Patch one data byte.
+         * @param offset offset into the data field
+         * @param b new byte
+         * @return false if outside the data field
+         */
+        bool set_data_uint8(size_t offset, uint8_t b);
+        
+        /**
+         * Get packet type.
+         * @return identifier
+         */
+        ZigBeePacket::ZBP_Identifier get_identifier();
+        
+        /**
+         * Get frame ID.
+         * @return frame ID, 0 if no field
+         */
+        uint8_t get_frame_id();
+        
+        /**
+         * Get destination 64-bit address.
+         * @return address, 0 if no field
+         */
+        uint64_t get_dest64();
+        
+        /**
+         * Get destination 16-bit address.
+         * @return address, 0 if no field
+         */
+        uint16_t get_dest16();
+        
+        /**
+         * Check for a destination 16-bit address field.
+         * @return true if present
+         */
+        bool has_dest16();
+        
+        /**
+         * Get data field length.
+         * @return length in bytes
+         */
+        size_t get_data_size();
+        
+        /**
+         * Get serialized frame, start delimiter through checksum, unescaped.
+         * @return pointer to frame
+         */
+        const uint8_t *get_frame();
+        
+        /**
+         * Get serialized frame length.
+         * @return length in bytes
+         */
+        size_t get_frame_size();
+        
+        /**
+         * Decode the current frame into a packet.
+         * @return packet
+         */
+        ZigBeePacket get_packet();
+        
+protected:
+        /**
+         * Write a byte and adjust the checksum.
+         * @param pos frame position
+         * @param b new byte
+         */
+        void patch(int pos, uint8_t b)
+        {
+                frame[checksum_pos] += frame[pos] - b;
+                frame[pos] = b;
+        }
+        
+        std::vector<uint8_t> frame;                     ///< Serialized frame
+        ZigBeePacket::ZBP_Identifier identifier;        ///< Packet type
+        int checksum_pos;                               ///< Checksum position
+        int frame_id_pos;                               ///< Frame ID position, 0 if none
+        int dest64_pos;                                 ///< Destination 64-bit address position, 0 if none
+        int dest16_pos;                                 ///< Destination 16-bit address position, 0 if none
+        int data_pos;                                   ///< Data position, 0 if none
+        size_t data_len;                                ///< Data length
+};
+
+#endif //__ZIGBEE_PACKET_TEMPLATE_H
+
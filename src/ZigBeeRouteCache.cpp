@@ -0,0 +1,220 @@
+/************************************************************************/
+/* ZigBeeRouteCache                                                     */
+/*                                                                      */
+/* ZigBee Terminal - ZigBee Route Cache                                 */
+/*                                                                      */
+/* ZigBeeRouteCache.cpp                                                 */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ZigBeeRouteCache.h"
+
+ZigBeeRouteCache::ZigBeeRouteCache() :
+        max_age(ZIGBEE_ROUTE_MAX_AGE_US)
+{
+        for (int i = 0; i < 256; i++)
+        {
+                tx_dest64[i] = 0;
+                tx_pending[i] = false;
+        }
+}
+
+ZigBeeRouteCache::~ZigBeeRouteCache()
+{
+        
+}
+
+bool ZigBeeRouteCache::update(ZigBeePacket &pkt, uint64_t now)
+{
+        switch (pkt.identifier)
+        {
+                case ZigBeePacket::ZBPID_RouteRecord:
+                {
+                        ZigBeeRoute &r = routes[pkt.src64];
+                        
+                        // the 16-bit address may have changed after a rejoin
+                        if (r.timestamp && r.addr16 != pkt.src16)
+                                routes16.erase(r.addr16);
+                        
+                        r.addr64 = pkt.src64;
+                        r.addr16 = pkt.src16;
+                        r.hops = pkt.route_records;
+                        r.timestamp = now;
+                        routes16[pkt.src16] = pkt.src64;
+                        return true;
+                }
+                case ZigBeePacket::ZBPID_ManyToOneRouteRequest:
+                {
+                        // another concentrator announcing itself; this is
+                        // periodic, so it says nothing about our routes.
+                        // It carries no hops, so only refresh a route we
+                        // already hold to the concentrator.
+                        std::map<uint64_t, ZigBeeRoute>::iterator it = routes.find(pkt.src64);
+                        
+                        if (it == routes.end())
+                                return false;
+                        
+                        if (it->second.addr16 != pkt.src16)
+                        {
+                                routes16.erase(it->second.addr16);
+                                it->second.addr16 = pkt.src16;
+                                routes16[pkt.src16] = pkt.src64;
+                        }
+                        
+                        it->second.timestamp = now;
+                        return true;
+                }
+                case ZigBeePacket::ZBPID_TxStatusS2:
+                        if (tx_pending[pkt.frame_id])
+                        {
+                                tx_pending[pkt.frame_id] = false;
+                                
+                                if (pkt.delivery_status == 0 || routes.find(tx_dest64[pkt.frame_id]) == routes.end())
+                                        return false;
+                                invalidate(tx_dest64[pkt.frame_id]);
+                                return true;
+                        }
+                        
+                        // not sent through note_transmit; only the 16-bit
+                        // address is known
+                        if (pkt.delivery_status == 0 || routes16.find(pkt.dest16) == routes16.end())
+                                return false;
+                        invalidate16(pkt.dest16);
+                        return true;
+                default:
+                        return false;
+        }
+}
+
+ZigBeeRoute *ZigBeeRouteCache::lookup(uint64_t addr64, uint16_t addr16, uint64_t now)
+{
+        std::map<uint64_t, ZigBeeRoute>::iterator it = routes.end();
+        
+        if (addr64 == ZIGBEE_ADDR64_BROADCAST)
+                return NULL;
+        
+        it = routes.find(addr64);
+        
+        if (it == routes.end() && addr16 != ZIGBEE_ADDR16_UNKNOWN)
+        {
+                std::map<uint16_t, uint64_t>::iterator it16 = routes16.find(addr16);
+                if (it16 != routes16.end())
+                        it = routes.find(it16->second);
+        }
+        
+        if (it == routes.end())
+                return NULL;
+        
+        if (now - it->second.timestamp > max_age)
+        {
+                routes16.erase(it->second.addr16);
+                routes.erase(it);
+                return NULL;
+        }
+        
+        return &it->second;
+}
+
+void ZigBeeRouteCache::note_transmit(uint8_t frame_id, uint64_t addr64)
+{
+        if (frame_id == 0)
+                return;
+        
+        tx_dest64[frame_id] = addr64;
+        tx_pending[frame_id] = true;
+}
+
+void ZigBeeRouteCache::invalidate(uint64_t addr64)
+{
+        std::map<uint64_t, ZigBeeRoute>::iterator it = routes.find(addr64);
+        
+        if (it == routes.end())
+                return;
+        
+        routes16.erase(it->second.addr16);
+        routes.erase(it);
+}
+
+void ZigBeeRouteCache::invalidate16(uint16_t addr16)
+{
+        std::map<uint16_t, uint64_t>::iterator it = routes16.find(addr16);
+        
+        if (it == routes16.end())
+                return;
+        
+        routes.erase(it->second);
+        routes16.erase(it);
+}
+
+void ZigBeeRouteCache::clear()
+{
+        routes.clear();
+        routes16.clear();
+}
+
+size_t ZigBeeRouteCache::size()
+{
+        return routes.size();
+}
+
+std::vector<ZigBeeRoute> ZigBeeRouteCache::get_routes()
+{
+        std::vector<ZigBeeRoute> v;
+        std::map<uint64_t, ZigBeeRoute>::iterator it;
+        
+        for (it = routes.begin(); it != routes.end(); ++it)
+                v.push_back(it->second);
+        
+        return v;
+}
+
+void ZigBeeRouteCache::set_max_age(uint64_t age)
+{
+        max_age = age;
+}
+
+uint64_t ZigBeeRouteCache::get_max_age()
+{
+        return max_age;
+}
+
+// Static
+ZigBeePacket ZigBeeRouteCache::make_source_route(const ZigBeeRoute &route)
+{
+        ZigBeePacket pkt;
+        
+        pkt.identifier = ZigBeePacket::ZBPID_CreateSourceRoute;
+        pkt.frame_id = 0;
+        pkt.dest64 = route.addr64;
+        pkt.dest16 = route.addr16;
+        pkt.options = 0;
+        pkt.route_records = route.hops;
+        pkt.build_packet();
+        
+        return pkt;
+}
+
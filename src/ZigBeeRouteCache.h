@@ -0,0 +1,178 @@
+/************************************************************************/
+/* ZigBeeRouteCache                                                     */
+/*                                                                      */
+/* ZigBee Terminal - ZigBee Route Cache                                 */
+/*                                                                      */
+/* ZigBeeRouteCache.h                                                   */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __ZIGBEE_ROUTE_CACHE_H
+#define __ZIGBEE_ROUTE_CACHE_H
+
+#include "ZigBeePacket.h"
+
+#include <vector>
+#include <map>
+#include <inttypes.h>
+
+#define ZIGBEE_ROUTE_MAX_AGE_US 900000000ULL
+#define ZIGBEE_ADDR64_BROADCAST 0x000000000000ffffULL
+#define ZIGBEE_ADDR16_UNKNOWN 0xfffe
+
+/** ZigBee source route
+ */
+typedef struct
+{
+        uint64_t addr64;                ///< Destination 64-bit address
+        uint16_t addr16;                ///< Destination 16-bit address
+        std::vector<uint16_t> hops;     ///< Intermediate hops, as reported in the route record
+        uint64_t timestamp;             ///< Time the route was recorded (microseconds)
+} ZigBeeRoute;
+
+/** ZigBee Route Cache
+ * 
+ * Caches the source routes reported by Route Record (0xA1) frames, which
+ * a concentrator receives whenever a remote node sends it data.  Routes
+ * are keyed by 64-bit address and can also be found by 16-bit address.
+ * Entries expire after ZIGBEE_ROUTE_MAX_AGE_US and are dropped when a
+ * transmit status reports a delivery failure.  Transmits are noted by
+ * frame ID so a failure can be tied to its 64-bit destination, since the
+ * status only carries 0xFFFE or 0xFFFD when no 16-bit address was sent.
+ * A Many-to-One Route Request (0xA3) from a concentrator refreshes the
+ * age and 16-bit address of an existing route to that concentrator.
+ */
+class ZigBeeRouteCache
+{
+public:
+        ZigBeeRouteCache();
+        virtual ~ZigBeeRouteCache();
+        
+        /**
+         * Update the cache from a received packet.
+         * @param pkt decoded packet
+         * @param now current time in microseconds
+         * @return true if the cache changed
+         */
+        bool update(ZigBeePacket &pkt, uint64_t now);
+        
+        /**
+         * Record a transmit so the matching transmit status can be tied
+         * back to its 64-bit destination.
+         * @param frame_id frame ID, 0 is ignored
+         * @param addr64 destination 64-bit address
+         */
+        void note_transmit(uint8_t frame_id, uint64_t addr64);
+        
+        /**
+         * Find a route.  The 64-bit address is tried first, then the
+         * 16-bit address.  Expired routes are removed.
+         * @param addr64 destination 64-bit address
+         * @param addr16 destination 16-bit address
+         * @param now current time in microseconds
+         * @return route, or NULL if none
+         */
+        ZigBeeRoute *lookup(uint64_t addr64, uint16_t addr16, uint64_t now);
+        
+        /**
+         * Remove the route to a 64-bit address.
+         * @param addr64 destination 64-bit address
+         */
+        void invalidate(uint64_t addr64);
+        
+        /**
+         * Remove the route to a 16-bit address.
+         * @param addr16 destination 16-bit address
+         */
+        void invalidate16(uint16_t addr16);
+        
+        /**
+         * Remove all routes.
+         */
+        void clear();
+        
+        /**
+         * Get number of cached routes.
+         * @return routes
+         */
+        size_t size();
+        
+        /**
+         * Get a copy of all cached routes.
+         * @return routes
+         */
+        std::vector<ZigBeeRoute> get_routes();
+        
+        /**
+         * Set route lifetime.
+         * @param age maximum age in microseconds
+         */
+        void set_max_age(uint64_t age);
+        
+        /**
+         * Get route lifetime.
+         * @return maximum age in microseconds
+         */
+        uint64_t get_max_age();
+        
+        /**
+         * Build a Create Source Route (0x21) frame for a route.  The
+         * frame ID is 0 since the module does not answer it.
+         * @param route route
+         * @return packet
+         */
+        static ZigBeePacket make_source_route(const ZigBeeRoute &route);
+        
+protected:
+        /**
+         * Routes by 64-bit address.
+         */
+        std::map<uint64_t, ZigBeeRoute> routes;
+        
+        /**
+         * 64-bit address by 16-bit address.
+         */
+        std::map<uint16_t, uint64_t> routes16;
+        
+        /**
+         * Destination of each outstanding transmit, indexed by frame ID.
+         */
+        uint64_t tx_dest64[256];
+        
+        /**
+         * Outstanding transmit flags, indexed by frame ID.
+         */
+        bool tx_pending[256];
+        
+        /**
+         * Route lifetime in microseconds.
+         */
+        uint64_t max_age;
+};
+
+#endif //__ZIGBEE_ROUTE_CACHE_H
+
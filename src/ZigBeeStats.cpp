@@ -0,0 +1,374 @@
+/************************************************************************/
+/* ZigBeeStats                                                          */
+/*                                                                      */
+/* ZigBee Terminal - ZigBee Statistics                                  */
+/*                                                                      */
+/* ZigBeeStats.cpp                                                      */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ZigBeeStats.h"
+
+#include <sstream>
+#include <iomanip>
+
+// atomic load helper; a locked add of zero also works on 32 bit targets
+static inline uint64_t atomic_get(const volatile uint64_t *p)
+{
+        return __sync_fetch_and_add(const_cast<volatile uint64_t *>(p), 0);
+}
+
+// atomic store of maximum
+static inline void atomic_max(volatile uint64_t *p, uint64_t value)
+{
+        uint64_t old = *p;
+        while (value > old)
+        {
+                uint64_t prev = __sync_val_compare_and_swap(p, old, value);
+                if (prev == old)
+                        break;
+                old = prev;
+        }
+}
+
+// atomic store of minimum
+static inline void atomic_min(volatile uint64_t *p, uint64_t value)
+{
+        uint64_t old = *p;
+        while (value < old)
+        {
+                uint64_t prev = __sync_val_compare_and_swap(p, old, value);
+                if (prev == old)
+                        break;
+                old = prev;
+        }
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+        reset();
+}
+
+// Static
+int LatencyHistogram::get_bucket_index(uint64_t value)
+{
+        int e;
+        
+        if (value < sub_bucket_count)
+                return value;
+        
+        e = 63 - __builtin_clzll(value);
+        
+        if (e > max_exponent)
+                return bucket_count - 1;
+        
+        return (e - sub_bucket_bits + 1) * sub_bucket_count + (int)(value >> (e - sub_bucket_bits)) - sub_bucket_count;
+}
+
+// Static
+uint64_t LatencyHistogram::get_bucket_lower(int index)
+{
+        int group = index / sub_bucket_count;
+        uint64_t sub = index % sub_bucket_count;
+        
+        if (group == 0)
+                return sub;
+        
+        return (sub + sub_bucket_count) << (group - 1);
+}
+
+// Static
+uint64_t LatencyHistogram::get_bucket_upper(int index)
+{
+        if (index >= bucket_count - 1)
+                return ~(uint64_t)0;
+        
+        return get_bucket_lower(index + 1) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value)
+{
+        __sync_fetch_and_add(&buckets[get_bucket_index(value)], 1);
+        __sync_fetch_and_add(&count, 1);
+        __sync_fetch_and_add(&sum, value);
+        atomic_min(&min, value);
+        atomic_max(&max, value);
+}
+
+void LatencyHistogram::reset()
+{
+        for (int i = 0; i < bucket_count; i++)
+                buckets[i] = 0;
+        count = 0;
+        sum = 0;
+        min = ~(uint64_t)0;
+        max = 0;
+        __sync_synchronize();
+}
+
+uint64_t LatencyHistogram::get_count() const
+{
+        return atomic_get(&count);
+}
+
+uint64_t LatencyHistogram::get_min() const
+{
+        uint64_t m = atomic_get(&min);
+        return m == ~(uint64_t)0 ? 0 : m;
+}
+
+uint64_t LatencyHistogram::get_max() const
+{
+        return atomic_get(&max);
+}
+
+double LatencyHistogram::get_mean() const
+{
+        uint64_t c = atomic_get(&count);
+        
+        if (c == 0)
+                return 0;
+        
+        return (double)atomic_get(&sum) / c;
+}
+
+uint64_t LatencyHistogram::get_percentile(double p) const
+{
+        uint64_t total = 0;
+        uint64_t target;
+        uint64_t acc = 0;
+        uint64_t counts[bucket_count];
+        
+        // snapshot so the walk is consistent with the total
+        for (int i = 0; i < bucket_count; i++)
+        {
+                counts[i] = atomic_get(&buckets[i]);
+                total += counts[i];
+        }
+        
+        if (total == 0)
+                return 0;
+        
+        if (p < 0)
+                p = 0;
+        if (p > 100)
+                p = 100;
+        
+        target = (uint64_t)(p / 100.0 * total + 0.5);
+        if (target < 1)
+                target = 1;
+        
+        for (int i = 0; i < bucket_count; i++)
+        {
+                acc += counts[i];
+                if (acc >= target)
+                {
+                        uint64_t upper = get_bucket_upper(i);
+                        uint64_t m = get_max();
+                        return upper < m ? upper : m;
+                }
+        }
+        
+        return get_max();
+}
+
+std::string LatencyHistogram::get_desc() const
+{
+        std::stringstream desc;
+        
+        desc << std::dec << "n=" << get_count();
+        
+        if (get_count() > 0)
+        {
+                desc << " min=" << get_min();
+                desc << " mean=" << std::fixed << std::setprecision(1) << get_mean();
+                desc << " p50=" << get_percentile(50);
+                desc << " p90=" << get_percentile(90);
+                desc << " p99=" << get_percentile(99);
+                desc << " p99.9=" << get_percentile(99.9);
+                desc << " max=" << get_max();
+                desc << " us";
+        }
+        
+        return desc.str();
+}
+
+ZigBeeStats::ZigBeeStats()
+{
+        for (int i = 0; i < SG_Count; i++)
+                gauges[i] = 0;
+        
+        reset();
+}
+
+ZigBeeStats::~ZigBeeStats()
+{
+        // nothing
+}
+
+uint64_t ZigBeeStats::get(StatCounter c) const
+{
+        return atomic_get(&counters[c]);
+}
+
+void ZigBeeStats::set_gauge(StatGauge g, uint64_t value)
+{
+        gauges[g] = value;
+        atomic_max(&gauge_peaks[g], value);
+}
+
+uint64_t ZigBeeStats::get_gauge(StatGauge g) const
+{
+        return atomic_get(&gauges[g]);
+}
+
+uint64_t ZigBeeStats::get_gauge_peak(StatGauge g) const
+{
+        return atomic_get(&gauge_peaks[g]);
+}
+
+const LatencyHistogram &ZigBeeStats::get_histogram(StatHistogram h) const
+{
+        return histograms[h];
+}
+
+void ZigBeeStats::reset()
+{
+        for (int i = 0; i < SC_Count; i++)
+                counters[i] = 0;
+        
+        for (int i = 0; i < SG_Count; i++)
+                gauge_peaks[i] = gauges[i];
+        
+        for (int i = 0; i < SH_Count; i++)
+                histograms[i].reset();
+        
+        __sync_synchronize();
+}
+
+std::string ZigBeeStats::get_desc() const
+{
+        std::stringstream desc;
+        
+        desc << "Counters:" << std::endl;
+        for (int i = 0; i < SC_Count; i++)
+        {
+                desc << "  " << get_counter_desc(StatCounter(i)) << ": " << std::dec << get(StatCounter(i)) << std::endl;
+        }
+        
+        desc << "Gauges:" << std::endl;
+        for (int i = 0; i < SG_Count; i++)
+        {
+                desc << "  " << get_gauge_desc(StatGauge(i)) << ": " << std::dec << get_gauge(StatGauge(i));
+                desc << " (peak " << get_gauge_peak(StatGauge(i)) << ")" << std::endl;
+        }
+        
+        desc << "Latency:" << std::endl;
+        for (int i = 0; i < SH_Count; i++)
+        {
+                desc << "  " << get_histogram_desc(StatHistogram(i)) << ": " << histograms[i].get_desc() << std::endl;
+        }
+        
+        return desc.str();
+}
+
+// Static
+std::string ZigBeeStats::get_counter_desc(StatCounter c)
+{
+        switch (c)
+        {
+                case SC_BytesRead:
+                        return "Bytes read";
+                case SC_BytesWritten:
+                        return "Bytes written";
+                case SC_ReadCalls:
+                        return "Read calls";
+                case SC_FramesDecoded:
+                        return "Frames decoded";
+                case SC_FramesSent:
+                        return "Frames sent";
+                case SC_ChecksumErrors:
+                        return "Checksum errors";
+                case SC_ResyncBytes:
+                        return "Resync discarded bytes";
+                case SC_PartialWrites:
+                        return "Partial writes";
+                case SC_TxStatus:
+                        return "Transmit status frames";
+                case SC_TxStatusFailures:
+                        return "Transmit status failures";
+                case SC_Reconnects:
+                        return "Reconnects";
+                case SC_SourceRoutes:
+                        return "Source routes created";
+                case SC_AddressesResolved:
+                        return "Addresses resolved";
+                case SC_CTSStalls:
+                        return "CTS stalls";
+                case SC_WritesCancelled:
+                        return "Writes cancelled";
+                case SC_DecodeErrors:
+                        return "Decode errors";
+                default:
+                        return "Unknown";
+        }
+}
+
+// Static
+std::string ZigBeeStats::get_gauge_desc(StatGauge g)
+{
+        switch (g)
+        {
+                case SG_ReadQueueDepth:
+                        return "Receive queue depth";
+                case SG_WriteQueueDepth:
+                        return "Transmit queue depth";
+                default:
+                        return "Unknown";
+        }
+}
+
+// Static
+std::string ZigBeeStats::get_histogram_desc(StatHistogram h)
+{
+        switch (h)
+        {
+                case SH_ReadToDecode:
+                        return "Read to decode";
+                case SH_DecodeToEmit:
+                        return "Decode to emit";
+                case SH_SendToTxStatus:
+                        return "Send to transmit status";
+                case SH_ReconnectOutage:
+                        return "Reconnect outage";
+                case SH_CTSStall:
+                        return "CTS stall";
+                default:
+                        return "Unknown";
+        }
+}
+
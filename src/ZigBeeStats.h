@@ -0,0 +1,315 @@
+/************************************************************************/
+/* ZigBeeStats                                                          */
+/*                                                                      */
+/* ZigBee Terminal - ZigBee Statistics                                  */
+/*                                                                      */
+/* ZigBeeStats.h                                                        */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __ZIGBEE_STATS_H
+#define __ZIGBEE_STATS_H
+
+#include <string>
+#include <inttypes.h>
+
+/** Latency Histogram
+ * 
+ * Log-linear histogram in the style of HdrHistogram.  Values are sorted into
+ * power of two ranges, each split into 16 linear sub-buckets, giving a fixed
+ * relative precision of about 6% from 1 us up to 2^40 us (about 12.7 days)
+ * with a constant, allocation-free record path.  All updates use atomic adds so the
+ * histogram can be recorded from one thread and read from another.
+ */
+class LatencyHistogram
+{
+public:
+        /**
+         * Sub-bucket bits.  Each power of two range is split into
+         * 2^sub_bucket_bits buckets.
+         */
+        static const int sub_bucket_bits = 4;
+        
+        /**
+         * Number of sub-buckets per power of two range.
+         */
+        static const int sub_bucket_count = 1 << sub_bucket_bits;
+        
+        /**
+         * Largest exponent tracked.  Larger values are clamped.
+         */
+        static const int max_exponent = 39;
+        
+        /**
+         * Total number of buckets.
+         */
+        static const int bucket_count = (max_exponent - sub_bucket_bits + 2) * sub_bucket_count;
+        
+        /**
+         * Create an empty histogram.
+         */
+        LatencyHistogram();
+        
+        /**
+         * Record a value.
+         * @param value value to record, in microseconds
+         */
+        void record(uint64_t value);
+        
+        /**
+         * Clear all recorded values.
+         */
+        void reset();
+        
+        /**
+         * Get number of recorded values.
+         * @return count
+         */
+        uint64_t get_count() const;
+        
+        /**
+         * Get minimum recorded value.
+         * @return minimum, or 0 if empty
+         */
+        uint64_t get_min() const;
+        
+        /**
+         * Get maximum recorded value.
+         * @return maximum, or 0 if empty
+         */
+        uint64_t get_max() const;
+        
+        /**
+         * Get mean of recorded values.
+         * @return mean, or 0 if empty
+         */
+        double get_mean() const;
+        
+        /**
+         * Get value at percentile.  Returns the upper bound of the bucket
+         * containing the requested percentile.
+         * @param p percentile, 0 to 100
+         * @return value at percentile
+         */
+        uint64_t get_percentile(double p) const;
+        
+        /**
+         * Get a one line summary of the histogram.
+         * @return description string
+         */
+        std::string get_desc() const;
+        
+        /**
+         * Get bucket index for value.
+         * @param value value
+         * @return bucket index
+         */
+        static int get_bucket_index(uint64_t value);
+        
+        /**
+         * Get lowest value sorted into bucket.
+         * @param index bucket index
+         * @return lowest value
+         */
+        static uint64_t get_bucket_lower(int index);
+        
+        /**
+         * Get highest value sorted into bucket.
+         * @param index bucket index
+         * @return highest value
+         */
+        static uint64_t get_bucket_upper(int index);
+        
+protected:
+        volatile uint64_t buckets[bucket_count];        ///< Bucket counts
+        volatile uint64_t count;                        ///< Number of values
+        volatile uint64_t sum;                          ///< Sum of values
+        volatile uint64_t min;                          ///< Minimum value
+        volatile uint64_t max;                          ///< Maximum value
+};
+
+/** ZigBee Statistics
+ * 
+ * Always-on instrumentation for the ZigBee interface.  Holds event counters,
+ * gauges and latency histograms.  Recording is cheap enough to leave enabled
+ * on the receive and transmit paths; all updates are atomic so the values can
+ * be sampled from any thread.
+ */
+class ZigBeeStats
+{
+public:
+        /**
+         * Event counters.
+         */
+        typedef enum
+        {
+                SC_BytesRead = 0,               ///< Bytes read from serial port
+                SC_BytesWritten,                ///< Bytes written to serial port
+                SC_ReadCalls,                   ///< Serial port read calls
+                SC_FramesDecoded,               ///< Frames read and decoded
+                SC_FramesSent,                  ///< Frames submitted for transmit
+                SC_ChecksumErrors,              ///< Frames discarded due to bad checksum
+                SC_ResyncBytes,                 ///< Bytes discarded while searching for start delimiter
+                SC_PartialWrites,               ///< Writes that did not complete in one call
+                SC_TxStatus,                    ///< Transmit status frames received
+                SC_TxStatusFailures,            ///< Transmit status frames reporting failure
+                SC_Reconnects,                  ///< Serial port reconnects after loss
+                SC_SourceRoutes,                ///< Create source route frames sent automatically
+                SC_AddressesResolved,           ///< Transmit 16-bit addresses filled from address table
+                SC_CTSStalls,                   ///< Transmit stalls on CTS deasserted
+                SC_WritesCancelled,             ///< Queued frames discarded when the port was closed
+                SC_DecodeErrors,                ///< Frames read with a valid checksum that failed to decode
+                SC_Count
+        }
+        StatCounter;
+        
+        /**
+         * Gauges.  Each gauge tracks its current and peak value.
+         */
+        typedef enum
+        {
+                SG_ReadQueueDepth = 0,          ///< Bytes waiting in receive buffer
+                SG_WriteQueueDepth,             ///< Bytes waiting for transmit
+                SG_Count
+        }
+        StatGauge;
+        
+        /**
+         * Latency histograms.
+         */
+        typedef enum
+        {
+                SH_ReadToDecode = 0,            ///< Serial read to decoded frame
+                SH_DecodeToEmit,                ///< Decoded frame to receive handlers complete
+                SH_SendToTxStatus,              ///< Frame sent to matching transmit status
+                SH_ReconnectOutage,             ///< Serial port lost to reopened
+                SH_CTSStall,                    ///< CTS deasserted to reasserted
+                SH_Count
+        }
+        StatHistogram;
+        
+        /**
+         * Create a zeroed statistics block.
+         */
+        ZigBeeStats();
+        virtual ~ZigBeeStats();
+        
+        /**
+         * Increment counter.
+         * @param c counter
+         * @param n amount to add
+         */
+        void add(StatCounter c, uint64_t n = 1)
+        {
+                __sync_fetch_and_add(&counters[c], n);
+        }
+        
+        /**
+         * Get counter value.
+         * @param c counter
+         * @return value
+         */
+        uint64_t get(StatCounter c) const;
+        
+        /**
+         * Set gauge value.  Updates peak value.
+         * @param g gauge
+         * @param value new value
+         */
+        void set_gauge(StatGauge g, uint64_t value);
+        
+        /**
+         * Get current gauge value.
+         * @param g gauge
+         * @return value
+         */
+        uint64_t get_gauge(StatGauge g) const;
+        
+        /**
+         * Get peak gauge value.
+         * @param g gauge
+         * @return peak value
+         */
+        uint64_t get_gauge_peak(StatGauge g) const;
+        
+        /**
+         * Record latency sample.
+         * @param h histogram
+         * @param us latency in microseconds
+         */
+        void record(StatHistogram h, uint64_t us)
+        {
+                histograms[h].record(us);
+        }
+        
+        /**
+         * Get histogram.
+         * @param h histogram
+         * @return reference to histogram
+         */
+        const LatencyHistogram &get_histogram(StatHistogram h) const;
+        
+        /**
+         * Reset all counters, gauge peaks and histograms.
+         */
+        void reset();
+        
+        /**
+         * Get a multi-line text report of all statistics.
+         * @return description string
+         */
+        std::string get_desc() const;
+        
+        /**
+         * Get a string description of a counter.
+         * @param c counter
+         * @return description string
+         */
+        static std::string get_counter_desc(StatCounter c);
+        
+        /**
+         * Get a string description of a gauge.
+         * @param g gauge
+         * @return description string
+         */
+        static std::string get_gauge_desc(StatGauge g);
+        
+        /**
+         * Get a string description of a histogram.
+         * @param h histogram
+         * @return description string
+         */
+        static std::string get_histogram_desc(StatHistogram h);
+        
+protected:
+        volatile uint64_t counters[SC_Count];           ///< Counter values
+        volatile uint64_t gauges[SG_Count];             ///< Current gauge values
+        volatile uint64_t gauge_peaks[SG_Count];        ///< Peak gauge values
+        LatencyHistogram histograms[SH_Count];          ///< Latency histograms
+};
+
+#endif //__ZIGBEE_STATS_H
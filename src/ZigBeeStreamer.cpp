@@ -0,0 +1,421 @@
+/************************************************************************/
+/* ZigBeeStreamer                                                       */
+/*                                                                      */
+/* ZigBee Terminal - Transparent Mode Streamer                          */
+/*                                                                      */
+/* ZigBeeStreamer.cpp                                                   */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ZigBeeStreamer.h"
+
+#include <iostream>
+#include <algorithm>
+
+
+ZigBeeStreamer::ZigBeeStreamer(std::tr1::shared_ptr<SerialInterface> si) :
+        ser_int(si),
+        data(0),
+        data_size(0),
+        total(0),
+        chunk_size(ZIGBEE_STREAMER_DEFAULT_CHUNK),
+        packet_timeout(ZIGBEE_STREAMER_DEFAULT_RO),
+        offset(0),
+        sent(0),
+        in_flight(0),
+        generation(0),
+        running(false),
+        pumping(false),
+        pump_again(false),
+        start_timestamp(0),
+        finish_timestamp(0),
+        chunk_timestamp(0),
+        next_timestamp(0),
+        progress_timestamp(0)
+{
+        c_write_high_water = ser_int->port_write_high_water().connect( sigc::mem_fun(*this, &ZigBeeStreamer::on_write_high_water) );
+}
+
+
+ZigBeeStreamer::~ZigBeeStreamer()
+{
+        c_timer.disconnect();
+        c_write_high_water.disconnect();
+        unmap_file();
+}
+
+
+bool ZigBeeStreamer::send_file(std::string filename)
+{
+        if (running)
+                return false;
+        
+        if (!map_file(filename))
+                return false;
+        
+        start();
+        
+        return true;
+}
+
+
+bool ZigBeeStreamer::send_data(const char *buf, size_t len)
+{
+        if (running)
+                return false;
+        
+        unmap_file();
+        
+        data_buffer.assign(buf, buf + len);
+        data_size = len;
+        data = len ? &data_buffer[0] : 0;
+        
+        start();
+        
+        return true;
+}
+
+
+void ZigBeeStreamer::cancel()
+{
+        if (running)
+                complete(false);
+}
+
+
+bool ZigBeeStreamer::is_running()
+{
+        return running;
+}
+
+
+int ZigBeeStreamer::set_chunk_size(int n)
+{
+        if (n > 0 && n <= ZIGBEE_STREAMER_MAX_CHUNK && !running)
+                chunk_size = n;
+        
+        return chunk_size;
+}
+
+
+int ZigBeeStreamer::get_chunk_size()
+{
+        return chunk_size;
+}
+
+
+int ZigBeeStreamer::set_packet_timeout(int n)
+{
+        if (n >= 0 && n <= ZIGBEE_STREAMER_MAX_RO && !running)
+                packet_timeout = n;
+        
+        return packet_timeout;
+}
+
+
+int ZigBeeStreamer::get_packet_timeout()
+{
+        return packet_timeout;
+}
+
+
+size_t ZigBeeStreamer::get_total()
+{
+        return total;
+}
+
+
+size_t ZigBeeStreamer::get_sent()
+{
+        return sent;
+}
+
+
+uint64_t ZigBeeStreamer::get_elapsed()
+{
+        if (!start_timestamp)
+                return 0;
+        
+        if (finish_timestamp)
+                return finish_timestamp - start_timestamp;
+        
+        return SerialInterface::get_timestamp() - start_timestamp;
+}
+
+
+sigc::signal<void, size_t, size_t> ZigBeeStreamer::signal_progress()
+{
+        return m_signal_progress;
+}
+
+
+sigc::signal<void, bool, uint64_t> ZigBeeStreamer::signal_complete()
+{
+        return m_signal_complete;
+}
+
+
+sigc::signal<void, const char*, size_t> ZigBeeStreamer::signal_send_data()
+{
+        return m_signal_send_data;
+}
+
+
+void ZigBeeStreamer::start()
+{
+        total = data_size;
+        offset = 0;
+        sent = 0;
+        in_flight = 0;
+        generation++;
+        running = true;
+        start_timestamp = SerialInterface::get_timestamp();
+        finish_timestamp = 0;
+        chunk_timestamp = 0;
+        next_timestamp = 0;
+        progress_timestamp = start_timestamp;
+        
+        m_signal_progress.emit(0, total);
+        
+        if (data_size == 0)
+        {
+                complete(true);
+                return;
+        }
+        
+        pump();
+}
+
+
+void ZigBeeStreamer::pump()
+{
+        // on Windows every write completes inside queue_write(), so
+        // recursing here would grow the stack with the file size
+        if (pumping)
+        {
+                pump_again = true;
+                return;
+        }
+        
+        pumping = true;
+        
+        do
+        {
+                pump_again = false;
+                fill();
+        }
+        while (pump_again);
+        
+        pumping = false;
+}
+
+
+void ZigBeeStreamer::fill()
+{
+        if (!running || c_timer.connected())
+                return;
+        
+        if (packet_timeout > 0)
+        {
+                // one chunk at a time, each followed by an idle gap
+                uint64_t now;
+                
+                if (in_flight > 0 || offset >= data_size)
+                        return;
+                
+                now = SerialInterface::get_timestamp();
+                
+                if (now < next_timestamp)
+                {
+                        c_timer = Glib::signal_timeout().connect( sigc::mem_fun(*this, &ZigBeeStreamer::on_timer),
+                                (next_timestamp - now + 999) / 1000 );
+                        return;
+                }
+                
+                queue_chunk(chunk_size);
+                return;
+        }
+        
+        // no gaps needed, keep the write queue topped up to the high
+        // water mark and let flow control set the pace
+        while (running && offset < data_size && ser_int->get_write_queue_size() < ser_int->get_write_high_water())
+        {
+                if (!queue_chunk(ZIGBEE_STREAMER_BULK_CHUNK))
+                        return;
+        }
+}
+
+
+bool ZigBeeStreamer::queue_chunk(size_t n)
+{
+        SerialInterface::SerialStatus status;
+        const char *p = (const char *)data + offset;
+        
+        n = std::min(n, data_size - offset);
+        
+        // account for the chunk first, the write may complete inside
+        // queue_write()
+        chunk_timestamp = SerialInterface::get_timestamp();
+        offset += n;
+        in_flight++;
+        
+        m_signal_send_data.emit(p, n);
+        
+        status = ser_int->queue_write(p, n,
+                sigc::bind(sigc::mem_fun(*this, &ZigBeeStreamer::on_write_complete), generation));
+        
+        if (status != SerialInterface::SS_Success)
+        {
+                std::cerr << "[ZigBeeStreamer] Write error at offset " << offset - n << std::endl;
+                complete(false);
+                return false;
+        }
+        
+        return true;
+}
+
+
+void ZigBeeStreamer::on_write_complete(SerialInterface::SerialStatus status, gsize bytes_written, int writes, unsigned int gen)
+{
+        if (!running || gen != generation)
+                return;
+        
+        in_flight--;
+        sent += bytes_written;
+        
+        if (status != SerialInterface::SS_Success)
+        {
+                std::cerr << "[ZigBeeStreamer] Write error at offset " << sent << std::endl;
+                complete(false);
+                return;
+        }
+        
+        if (packet_timeout > 0)
+        {
+                // the write queue is empty once the driver has the chunk,
+                // but the line is busy until the last byte has been
+                // clocked out; wait for that plus RO idle characters
+                uint64_t now = SerialInterface::get_timestamp();
+                double t = get_char_time();
+                uint64_t line_free = chunk_timestamp + (uint64_t)(bytes_written * t);
+                
+                next_timestamp = std::max(now, line_free) + (uint64_t)(packet_timeout * t);
+        }
+        
+        if (sent >= data_size && in_flight == 0)
+        {
+                complete(true);
+                return;
+        }
+        
+        update_progress(false);
+        
+        pump();
+}
+
+
+void ZigBeeStreamer::on_write_high_water(bool above)
+{
+        if (!above)
+                pump();
+}
+
+
+bool ZigBeeStreamer::on_timer()
+{
+        c_timer.disconnect();
+        
+        pump();
+        
+        return false;
+}
+
+
+void ZigBeeStreamer::update_progress(bool force)
+{
+        uint64_t now = SerialInterface::get_timestamp();
+        
+        if (!force && now - progress_timestamp < ZIGBEE_STREAMER_PROGRESS_MS * 1000)
+                return;
+        
+        progress_timestamp = now;
+        
+        m_signal_progress.emit(sent, total);
+}
+
+
+void ZigBeeStreamer::complete(bool success)
+{
+        running = false;
+        finish_timestamp = SerialInterface::get_timestamp();
+        
+        c_timer.disconnect();
+        
+        update_progress(true);
+        
+        unmap_file();
+        
+        m_signal_complete.emit(success, finish_timestamp - start_timestamp);
+}
+
+
+double ZigBeeStreamer::get_char_time()
+{
+        int bits = 1 + ser_int->get_bits() + ser_int->get_stop();
+        unsigned long baud = ser_int->get_baud();
+        
+        if (ser_int->get_parity() != SerialInterface::SP_None)
+                bits++;
+        
+        if (baud == 0)
+                return 0;
+        
+        return bits * 1000000.0 / baud;
+}
+
+
+bool ZigBeeStreamer::map_file(std::string filename)
+{
+        unmap_file();
+        
+        if (!file.open(filename))
+                return false;
+        
+        data = file.get_data();
+        data_size = file.get_size();
+        
+        return true;
+}
+
+
+void ZigBeeStreamer::unmap_file()
+{
+        file.close();
+        data_buffer.clear();
+        data = 0;
+        data_size = 0;
+}
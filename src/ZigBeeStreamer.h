@@ -0,0 +1,382 @@
+/************************************************************************/
+/* ZigBeeStreamer                                                       */
+/*                                                                      */
+/* ZigBee Terminal - Transparent Mode Streamer                          */
+/*                                                                      */
+/* ZigBeeStreamer.h                                                     */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __ZIGBEE_STREAMER_H
+#define __ZIGBEE_STREAMER_H
+
+#include <gtkmm.h>
+
+#include "SerialInterface.h"
+#include "ZigBeeMappedFile.h"
+
+#include <string>
+#include <vector>
+#include <tr1/memory>
+#include <inttypes.h>
+
+#define ZIGBEE_STREAMER_DEFAULT_CHUNK 72
+#define ZIGBEE_STREAMER_MAX_CHUNK 256
+#define ZIGBEE_STREAMER_BULK_CHUNK 1024
+#define ZIGBEE_STREAMER_DEFAULT_RO 3
+#define ZIGBEE_STREAMER_MAX_RO 255
+#define ZIGBEE_STREAMER_PROGRESS_MS 100
+
+/** ZigBee transparent mode streamer
+ * 
+ * Streams a file or a block of pasted text to a module in transparent
+ * mode.  Files are memory mapped and handed to the serial interface
+ * write queue in chunks instead of byte by byte, so hardware flow
+ * control and the write queue high water mark set the pace.
+ * 
+ * In transparent mode the module sends an RF packet when it has NP
+ * bytes buffered or when the serial line has been idle for RO character
+ * times.  With a packetization timeout set, the streamer sends one
+ * chunk at a time and leaves RO character times of idle line after each
+ * one, so every chunk goes out as its own RF packet instead of being
+ * split at arbitrary points.  With a timeout of 0 data is streamed
+ * back to back and the module packetizes on NP alone.
+ */
+class ZigBeeStreamer : public sigc::trackable
+{
+public:
+        /**
+         * Create a streamer.
+         * @param si serial interface to write to
+         */
+        ZigBeeStreamer(std::tr1::shared_ptr<SerialInterface> si);
+        virtual ~ZigBeeStreamer();
+        
+        /**
+         * Map a file and start sending it.
+         * @param filename file
+         * @return false if a transfer is running or the file cannot be
+         * mapped
+         */
+        bool send_file(std::string filename);
+        
+        /**
+         * Copy a block of data and start sending it.
+         * @param buf data
+         * @param len length
+         * @return false if a transfer is running
+         */
+        bool send_data(const char *buf, size_t len);
+        
+        /**
+         * Abort the transfer.  Data already handed to the serial
+         * interface is still written.
+         */
+        void cancel();
+        
+        /**
+         * Check if a transfer is running.
+         * @return true if running
+         */
+        bool is_running();
+        
+        /**
+         * Set chunk size, used when a packetization timeout is set.
+         * Should not exceed the module's NP.  Takes effect on the next
+         * transfer.
+         * @param n bytes
+         * @return bytes
+         */
+        int set_chunk_size(int n);
+        
+        /**
+         * Get chunk size.
+         * @return bytes
+         */
+        int get_chunk_size();
+        
+        /**
+         * Set packetization timeout to match the module's RO setting.
+         * Takes effect on the next transfer.
+         * @param n character times, 0 to stream without gaps
+         * @return character times
+         */
+        int set_packet_timeout(int n);
+        
+        /**
+         * Get packetization timeout.
+         * @return character times
+         */
+        int get_packet_timeout();
+        
+        /**
+         * Get transfer size.
+         * @return bytes
+         */
+        size_t get_total();
+        
+        /**
+         * Get number of bytes written to the port.
+         * @return bytes
+         */
+        size_t get_sent();
+        
+        /**
+         * Get time since start, or total time once finished.
+         * @return microseconds
+         */
+        uint64_t get_elapsed();
+        
+        /**
+         * Progress signal, emitted at most every
+         * ZIGBEE_STREAMER_PROGRESS_MS and at the end of the transfer.
+         * @par Prototype:
+         * <tt>void on_my_%progress(size_t sent, size_t total)</tt>
+         */
+        sigc::signal<void, size_t, size_t> signal_progress();
+        
+        /**
+         * Complete signal.
+         * @par Prototype:
+         * <tt>void on_my_%complete(bool success, uint64_t elapsed_us)</tt>
+         */
+        sigc::signal<void, bool, uint64_t> signal_complete();
+        
+        /**
+         * Send data signal, emitted for each chunk as it is queued, for
+         * local echo.
+         * @par Prototype:
+         * <tt>void on_my_%send_data(const char *data, size_t n)</tt>
+         */
+        sigc::signal<void, const char*, size_t> signal_send_data();
+        
+protected:
+        /**
+         * Start sending the mapped or copied data.
+         */
+        void start();
+        
+        /**
+         * Queue chunks as pacing allows.  Writes may complete inside
+         * queue_write(), so calls made from a completion are deferred to
+         * the outermost call, which loops instead of recursing.
+         */
+        void pump();
+        
+        /**
+         * Queue chunks as pacing allows, once.
+         * @see pump()
+         */
+        void fill();
+        
+        /**
+         * Queue one chunk.
+         * @param n maximum chunk size
+         * @return false on write error
+         */
+        bool queue_chunk(size_t n);
+        
+        /**
+         * Serial interface write completion handler.
+         * @param status write status
+         * @param bytes_written bytes written
+         * @param writes number of write calls needed
+         * @param gen transfer the chunk belongs to
+         */
+        void on_write_complete(SerialInterface::SerialStatus status, gsize bytes_written, int writes, unsigned int gen);
+        
+        /**
+         * Serial interface write high water handler.
+         * @param above true if above high water mark
+         */
+        void on_write_high_water(bool above);
+        
+        /**
+         * Packetization gap timer handler.
+         * @return false, one shot
+         */
+        bool on_timer();
+        
+        /**
+         * Emit progress, rate limited unless forced.
+         * @param force emit regardless of time since the last one
+         */
+        void update_progress(bool force);
+        
+        /**
+         * Finish the transfer and release the data.
+         * @param success true if everything was written
+         */
+        void complete(bool success);
+        
+        /**
+         * Map a file.
+         * @param filename file
+         * @return true on success
+         */
+        bool map_file(std::string filename);
+        
+        /**
+         * Unmap the file or free the copied data.
+         */
+        void unmap_file();
+        
+        /**
+         * Get the time to send one character at the current port
+         * settings.
+         * @return microseconds
+         */
+        double get_char_time();
+        
+        /**
+         * Serial interface.
+         */
+        std::tr1::shared_ptr<SerialInterface> ser_int;
+        
+        /**
+         * Data to send.
+         */
+        const uint8_t *data;
+        
+        /**
+         * Data size.
+         */
+        size_t data_size;
+        
+        /**
+         * Mapped file.
+         */
+        ZigBeeMappedFile file;
+        
+        /**
+         * Copy of pasted data.
+         */
+        std::vector<uint8_t> data_buffer;
+        
+        /**
+         * Transfer size, kept after the data is released.
+         */
+        size_t total;
+        
+        /**
+         * Chunk size.
+         */
+        int chunk_size;
+        
+        /**
+         * Packetization timeout in character times.
+         */
+        int packet_timeout;
+        
+        /**
+         * Offset of next byte to queue.
+         */
+        size_t offset;
+        
+        /**
+         * Bytes written to the port.
+         */
+        size_t sent;
+        
+        /**
+         * Chunks queued and not yet written.
+         */
+        int in_flight;
+        
+        /**
+         * Transfer generation, so completions from a cancelled transfer
+         * are ignored.
+         */
+        unsigned int generation;
+        
+        /**
+         * Running indicator.
+         */
+        bool running;
+        
+        /**
+         * Inside pump().
+         */
+        bool pumping;
+        
+        /**
+         * pump() was called again while pumping.
+         */
+        bool pump_again;
+        
+        /**
+         * Start time.
+         */
+        uint64_t start_timestamp;
+        
+        /**
+         * Finish time.
+         */
+        uint64_t finish_timestamp;
+        
+        /**
+         * Time the last chunk was queued.
+         */
+        uint64_t chunk_timestamp;
+        
+        /**
+         * Earliest time the next chunk may be queued.
+         */
+        uint64_t next_timestamp;
+        
+        /**
+         * Time of last progress signal.
+         */
+        uint64_t progress_timestamp;
+        
+        /**
+         * Packetization gap timer connection.
+         */
+        sigc::connection c_timer;
+        
+        /**
+         * Serial interface write high water connection.
+         */
+        sigc::connection c_write_high_water;
+        
+        /**
+         * Progress signal.
+         */
+        sigc::signal<void, size_t, size_t> m_signal_progress;
+        
+        /**
+         * Complete signal.
+         */
+        sigc::signal<void, bool, uint64_t> m_signal_complete;
+        
+        /**
+         * Send data signal.
+         */
+        sigc::signal<void, const char*, size_t> m_signal_send_data;
+};
+
+#endif //__ZIGBEE_STREAMER_H
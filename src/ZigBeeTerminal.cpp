@@ -38,6 +38,8 @@
 
 #include <iostream>
 #include <iomanip>
+#include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -58,6 +60,20 @@ ZigBeeTerminal::ZigBeeTerminal()
         
         file_menu_item.set_submenu(file_menu);
         
+        file_export_trace_item.set_label("Export Trace...");
+        file_export_trace_item.signal_activate().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_file_export_trace_item_activate) );
+        file_menu.append(file_export_trace_item);
+        
+        file_export_samples_item.set_label("Export Samples...");
+        file_export_samples_item.signal_toggled().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_file_export_samples_toggled) );
+        file_menu.append(file_export_samples_item);
+        
+        file_send_item.set_label("Send File...");
+        file_send_item.signal_activate().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_file_send_item_activate) );
+        file_menu.append(file_send_item);
+        
+        file_menu.append(file_sep1);
+        
         file_quit_item.set_label(Gtk::Stock::QUIT.id);
         file_quit_item.set_use_stock(true);
         file_quit_item.signal_activate().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_file_quit_item_activate) );
@@ -83,6 +99,12 @@ ZigBeeTerminal::ZigBeeTerminal()
         view_clear_item.signal_activate().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_view_clear_activate) );
         view_menu.append(view_clear_item);
         
+        view_menu.append(view_sep2);
+        
+        view_stats_item.set_label("Statistics");
+        view_stats_item.signal_activate().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_view_stats_activate) );
+        view_menu.append(view_stats_item);
+        
         config_menu_item.set_label("_Config");
         config_menu_item.set_use_underline(true);
         main_menu.append(config_menu_item);
@@ -103,8 +125,42 @@ ZigBeeTerminal::ZigBeeTerminal()
         config_menu.append(config_local_echo);
         
         config_api_mode.set_label("Use API Mode");
+        config_api_mode.signal_toggled().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_config_api_mode_toggled) );
         config_menu.append(config_api_mode);
         
+        config_auto_reconnect.set_label("Auto Reconnect");
+        config_auto_reconnect.set_active(true);
+        config_auto_reconnect.signal_toggled().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_config_auto_reconnect_toggled) );
+        config_menu.append(config_auto_reconnect);
+        
+        config_source_routing.set_label("Source Routing");
+        config_source_routing.set_active(zb_int.get_source_routing());
+        config_source_routing.signal_toggled().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_config_source_routing_toggled) );
+        config_menu.append(config_source_routing);
+        
+        config_address_resolution.set_label("Address Resolution");
+        config_address_resolution.set_active(zb_int.get_address_resolution());
+        config_address_resolution.signal_toggled().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_config_address_resolution_toggled) );
+        config_menu.append(config_address_resolution);
+        
+        tools_menu_item.set_label("_Tools");
+        tools_menu_item.set_use_underline(true);
+        main_menu.append(tools_menu_item);
+        
+        tools_menu_item.set_submenu(tools_menu);
+        
+        tools_at_batch_item.set_label("Remote AT Batch...");
+        tools_at_batch_item.signal_activate().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_tools_at_batch_activate) );
+        tools_menu.append(tools_at_batch_item);
+        
+        tools_ota_item.set_label("Firmware Update...");
+        tools_ota_item.signal_activate().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_tools_ota_activate) );
+        tools_menu.append(tools_ota_item);
+        
+        tools_traffic_item.set_label("Traffic Generator...");
+        tools_traffic_item.signal_activate().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_tools_traffic_activate) );
+        tools_menu.append(tools_traffic_item);
+        
         // Tabs
         note.set_border_width(5);
         vbox1.pack_start(note, true, true, 0);
@@ -117,6 +173,7 @@ ZigBeeTerminal::ZigBeeTerminal()
         tv_term.set_editable(false);
         tv_term.set_wrap_mode(Gtk::WRAP_WORD_CHAR);
         tv_term.signal_key_press_event().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_tv_key_press), false );
+        tv_term.signal_paste_clipboard().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_tv_paste_clipboard) );
         
         // tags
         {
@@ -154,6 +211,7 @@ ZigBeeTerminal::ZigBeeTerminal()
         tv_pkt_log.set_model(tv_pkt_log_tm);
         tv_pkt_log.signal_cursor_changed().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_tv_pkt_log_cursor_changed) );
         
+        tv_pkt_log.append_column("Time", cPacketLogModel.Time);
         tv_pkt_log.append_column("Dir", cPacketLogModel.Direction);
         tv_pkt_log.append_column("Type", cPacketLogModel.Type);
         tv_pkt_log.append_column("Sz", cPacketLogModel.Size);
@@ -203,6 +261,12 @@ ZigBeeTerminal::ZigBeeTerminal()
         btn_pkt_builder_send.signal_clicked().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_btn_pkt_builder_send_click) );
         bbox_pkt_builder.add(btn_pkt_builder_send);
         
+        // topology
+        
+        note.append_page(topology_view, "Topology");
+        
+        topology_view.set_border_width(5);
+        
         // status bar
         
         status.push("Not connected");
@@ -214,25 +278,34 @@ ZigBeeTerminal::ZigBeeTerminal()
         bits = 8;
         stop_bits = 1;
         flow_control = SerialInterface::SF_None;
+        latency = SerialInterface::SL_Default;
         
         data_log_ptr = 0;
         raw_data_log_ptr = 0;
         
+        start_timestamp = SerialInterface::get_timestamp();
+        
+        log_formatter.set_start_timestamp(start_timestamp);
+        log_records_dropped = 0;
+        
         dlgPort.set_port(port);
         dlgPort.set_baud(baud);
         dlgPort.set_parity(parity);
         dlgPort.set_bits(bits);
         dlgPort.set_stop_bits(stop_bits);
         dlgPort.set_flow_control(flow_control);
+        dlgPort.set_latency(latency);
         
         ser_int = std::tr1::shared_ptr<SerialInterface>(new SerialInterface());
         
         ser_int->port_opened().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_port_open) );
         ser_int->port_closed().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_port_close) );
+        ser_int->port_disconnected().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_port_disconnected) );
         //ser_int->port_error().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_port_error) );
         //ser_int->port_receive_data().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_port_receive_data) );
         
         ser_int->set_debug(true);
+        ser_int->set_auto_reconnect(config_auto_reconnect.get_active());
         
         zb_int.set_serial_interface(ser_int);
         
@@ -240,6 +313,24 @@ ZigBeeTerminal::ZigBeeTerminal()
         zb_int.signal_receive_raw_data().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_receive_raw_data) );
         zb_int.signal_send_raw_data().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_send_raw_data) );
         
+        dlgStats.set_transient_for(*this);
+        dlgStats.set_stats(&zb_int.get_stats());
+        
+        dlgATBatch.set_transient_for(*this);
+        dlgATBatch.set_interface(zb_int);
+        
+        dlgOTA.set_transient_for(*this);
+        dlgOTA.set_interface(zb_int);
+        
+        dlgTraffic.set_transient_for(*this);
+        dlgTraffic.set_interface(zb_int);
+        
+        dlgSend.set_transient_for(*this);
+        dlgSend.set_interface(ser_int);
+        dlgSend.signal_send_data().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_stream_send_data) );
+        
+        topology_view.set_interface(zb_int);
+        
         show_all_children();
 }
 
@@ -250,6 +341,107 @@ ZigBeeTerminal::~ZigBeeTerminal()
 }
 
 
+void ZigBeeTerminal::on_file_export_trace_item_activate()
+{
+        Gtk::FileChooserDialog dlg(*this, "Export Trace", Gtk::FILE_CHOOSER_ACTION_SAVE);
+        unsigned int index = 0;
+        
+        dlg.add_button(Gtk::Stock::CANCEL, Gtk::RESPONSE_CANCEL);
+        dlg.add_button(Gtk::Stock::SAVE, Gtk::RESPONSE_OK);
+        dlg.set_do_overwrite_confirmation(true);
+        dlg.set_current_name("trace.json");
+        
+        if (dlg.run() != Gtk::RESPONSE_OK)
+                return;
+        
+        std::ofstream f(dlg.get_filename().c_str());
+        
+        if (!f)
+        {
+                std::cerr << "Error opening " << dlg.get_filename() << std::endl;
+                return;
+        }
+        
+        // Chrome trace event format, one thread per pipeline stage
+        f << "{\"traceEvents\":[" << std::endl;
+        f << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"read to decode\"}}," << std::endl;
+        f << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"decode to emit\"}}," << std::endl;
+        f << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":3,\"args\":{\"name\":\"emit to render\"}}";
+        
+        Gtk::TreeModel::Children rows = tv_pkt_log_tm->children();
+        for (Gtk::TreeModel::iterator it = rows.begin(); it != rows.end(); ++it)
+        {
+                Gtk::TreeModel::Row row = *it;
+                ZigBeePacket pkt = (ZigBeePacket)row[cPacketLogModel.Packet];
+                std::string events = pkt.get_trace_events(index++);
+                
+                if (events.size() > 0)
+                        f << "," << std::endl << events;
+        }
+        
+        f << std::endl << "],\"displayTimeUnit\":\"ms\"}" << std::endl;
+}
+
+
+void ZigBeeTerminal::on_file_export_samples_toggled()
+{
+        std::ostringstream msg;
+        
+        if (!file_export_samples_item.get_active())
+        {
+                if (!exporter.is_running())
+                        return;
+                
+                exporter.stop();
+                
+                msg << "Exported " << exporter.get_records_written() << " samples to " << exporter.get_filename();
+                if (exporter.get_records_dropped() > 0)
+                        msg << " (" << exporter.get_records_dropped() << " dropped)";
+                status.pop();
+                status.push(msg.str());
+                return;
+        }
+        
+        if (exporter.is_running())
+                return;
+        
+        Gtk::FileChooserDialog dlg(*this, "Export Samples", Gtk::FILE_CHOOSER_ACTION_SAVE);
+        
+        dlg.add_button(Gtk::Stock::CANCEL, Gtk::RESPONSE_CANCEL);
+        dlg.add_button(Gtk::Stock::SAVE, Gtk::RESPONSE_OK);
+        dlg.set_do_overwrite_confirmation(true);
+        dlg.set_current_name("samples.csv");
+        
+        Gtk::FileFilter csv_filter;
+        csv_filter.set_name("CSV (*.csv)");
+        csv_filter.add_pattern("*.csv");
+        dlg.add_filter(csv_filter);
+        
+        Gtk::FileFilter bin_filter;
+        bin_filter.set_name("Binary columnar (*.bin)");
+        bin_filter.add_pattern("*.bin");
+        dlg.add_filter(bin_filter);
+        
+        if (dlg.run() != Gtk::RESPONSE_OK ||
+                !exporter.start(dlg.get_filename(), ZigBeeExporter::format_from_filename(dlg.get_filename())))
+        {
+                // untick without starting anything
+                file_export_samples_item.set_active(false);
+                return;
+        }
+        
+        msg << "Exporting samples to " << dlg.get_filename();
+        status.pop();
+        status.push(msg.str());
+}
+
+
+void ZigBeeTerminal::on_file_send_item_activate()
+{
+        dlgSend.present();
+}
+
+
 void ZigBeeTerminal::on_file_quit_item_activate()
 {
         gtk_main_quit();
@@ -266,6 +458,7 @@ void ZigBeeTerminal::on_config_port_item_activate()
         dlgPort.set_bits(bits);
         dlgPort.set_stop_bits(stop_bits);
         dlgPort.set_flow_control(flow_control);
+        dlgPort.set_latency(latency);
         response = dlgPort.run();
         
         if (response == Gtk::RESPONSE_OK)
@@ -278,6 +471,7 @@ void ZigBeeTerminal::on_config_port_item_activate()
                 bits = dlgPort.get_bits();
                 stop_bits = dlgPort.get_stop_bits();
                 flow_control = dlgPort.get_flow_control();
+                latency = dlgPort.get_latency();
                 
                 open_port();
         }
@@ -316,6 +510,31 @@ void ZigBeeTerminal::on_view_clear_activate()
         tv_term.get_buffer()->set_text("");
         tv_raw_log.get_buffer()->set_text("");
         tv_pkt_log_tm->clear();
+        log_formatter.clear();
+}
+
+
+void ZigBeeTerminal::on_view_stats_activate()
+{
+        dlgStats.present();
+}
+
+
+void ZigBeeTerminal::on_tools_at_batch_activate()
+{
+        dlgATBatch.present();
+}
+
+
+void ZigBeeTerminal::on_tools_ota_activate()
+{
+        dlgOTA.present();
+}
+
+
+void ZigBeeTerminal::on_tools_traffic_activate()
+{
+        dlgTraffic.present();
 }
 
 
@@ -323,7 +542,12 @@ bool ZigBeeTerminal::on_tv_key_press(GdkEventKey *key)
 {
         guint u = gdk_keyval_to_unicode(key->keyval);
         Glib::ustring str = "";
-        gsize num;
+        
+        if ((key->state & GDK_CONTROL_MASK) && (key->keyval == GDK_v || key->keyval == GDK_V))
+        {
+                on_tv_paste_clipboard();
+                return true;
+        }
         
         if (u > 0)
         {
@@ -343,19 +567,64 @@ bool ZigBeeTerminal::on_tv_key_press(GdkEventKey *key)
         {
                 if (ser_int->is_open() && !config_api_mode.get_active())
                 {
-                        ser_int->write(str.c_str(), str.size(), num);
+                        ser_int->queue_write(str.c_str(), str.bytes());
                         
                         if (config_local_echo.get_active())
                         {
-                                for (int i = 0; i < str.size(); i++)
+                                for (int i = 0; i < str.bytes(); i++)
                                 {
-                                        data_log.push_back(0x1000 | ((int)str[i] & 0x00FF));
+                                        data_log.push_back(0x1000 | ((int)str.data()[i] & 0x00FF));
                                 }
                                 
                                 update_log();
                         }
                 }
+                
+                return true;
+        }
+        
+        return false;
+}
+
+
+void ZigBeeTerminal::on_tv_paste_clipboard()
+{
+        if (!ser_int->is_open() || config_api_mode.get_active())
+                return;
+        
+        Gtk::Clipboard::get()->request_text( sigc::mem_fun(*this, &ZigBeeTerminal::on_clipboard_text) );
+}
+
+
+void ZigBeeTerminal::on_clipboard_text(const Glib::ustring &text)
+{
+        if (text.empty())
+                return;
+        
+        if (!dlgSend.send_text(text))
+        {
+                status.pop();
+                status.push("Transfer in progress");
+                return;
         }
+        
+        // show progress for anything that takes more than a moment
+        if (text.bytes() > ZIGBEE_STREAMER_BULK_CHUNK)
+                dlgSend.present();
+}
+
+
+void ZigBeeTerminal::on_stream_send_data(const char *data, size_t len)
+{
+        if (!config_local_echo.get_active())
+                return;
+        
+        for (size_t i = 0; i < len; i++)
+        {
+                data_log.push_back(0x1000 | ((int)data[i] & 0x00FF));
+        }
+        
+        update_log();
 }
 
 
@@ -404,15 +673,7 @@ void ZigBeeTerminal::on_btn_pkt_builder_send_click()
                 update_log();
                 update_raw_log();
                 
-                Gtk::TreeModel::iterator it = tv_pkt_log_tm->append();
-                Gtk::TreePath path = Gtk::TreePath(it);
-                Gtk::TreeModel::Row row = *it;
-                row[cPacketLogModel.Packet] = pkt;
-                row[cPacketLogModel.Direction] = "TX";
-                row[cPacketLogModel.Type] = pkt.get_type_desc();
-                row[cPacketLogModel.Size] = pkt.get_length();
-                row[cPacketLogModel.Data] = pkt.get_hex_packet();
-                tv_pkt_log.scroll_to_row(path);
+                queue_log_record(pkt, SerialInterface::get_timestamp(), true);
         }
         
 }
@@ -439,20 +700,47 @@ void ZigBeeTerminal::on_port_close()
 }
 
 
+void ZigBeeTerminal::on_port_disconnected()
+{
+        status.pop();
+        status.push(ser_int->get_status_string());
+}
+
+
+void ZigBeeTerminal::on_config_auto_reconnect_toggled()
+{
+        ser_int->set_auto_reconnect(config_auto_reconnect.get_active());
+}
+
+
+void ZigBeeTerminal::on_config_source_routing_toggled()
+{
+        zb_int.set_source_routing(config_source_routing.get_active());
+}
+
+
+void ZigBeeTerminal::on_config_address_resolution_toggled()
+{
+        zb_int.set_address_resolution(config_address_resolution.get_active());
+}
+
+
+void ZigBeeTerminal::on_config_api_mode_toggled()
+{
+        // raw file data would corrupt API frames
+        file_send_item.set_sensitive(!config_api_mode.get_active());
+        
+        if (config_api_mode.get_active())
+                dlgSend.hide();
+}
+
+
 void ZigBeeTerminal::on_receive_packet(ZigBeePacket pkt)
 {
+        exporter.add_packet(pkt);
+        
         if (config_api_mode.get_active())
         {
-                Gtk::TreeModel::iterator it = tv_pkt_log_tm->append();
-                Gtk::TreePath path = Gtk::TreePath(it);
-                Gtk::TreeModel::Row row = *it;
-                row[cPacketLogModel.Packet] = pkt;
-                row[cPacketLogModel.Direction] = "RX";
-                row[cPacketLogModel.Type] = pkt.get_type_desc();
-                row[cPacketLogModel.Size] = pkt.get_length();
-                row[cPacketLogModel.Data] = pkt.get_hex_packet();
-                tv_pkt_log.scroll_to_row(path);
-                
                 if (pkt.identifier == ZigBeePacket::ZBPID_TxRequest ||
                         pkt.identifier == ZigBeePacket::ZBPID_EATxRequest ||
                         pkt.identifier == ZigBeePacket::ZBPID_RxPacket ||
@@ -464,8 +752,59 @@ void ZigBeeTerminal::on_receive_packet(ZigBeePacket pkt)
                         }
                 }
                 
+                // row and terminal text are updated on the next log tick
+                queue_log_record(pkt, pkt.read_timestamp, false);
+        }
+}
+
+
+bool ZigBeeTerminal::on_log_tick()
+{
+        ZigBeeLogRecord *r;
+        Gtk::TreeModel::iterator it;
+        uint64_t dropped;
+        int count = 0;
+        
+        // at most one batch per tick so a burst cannot starve redraws
+        while (count < ZIGBEE_LOG_BATCH && (r = log_formatter.front()))
+        {
+                it = tv_pkt_log_tm->append();
+                Gtk::TreeModel::Row row = *it;
+                row[cPacketLogModel.Time] = r->time;
+                row[cPacketLogModel.Direction] = r->tx ? "TX" : "RX";
+                row[cPacketLogModel.Type] = r->type;
+                row[cPacketLogModel.Size] = r->size;
+                row[cPacketLogModel.Data] = r->data;
+                r->pkt.render_timestamp = SerialInterface::get_timestamp();
+                row[cPacketLogModel.Packet] = r->pkt;
+                
+                log_formatter.pop();
+                count++;
+        }
+        
+        if (count > 0)
+                tv_pkt_log.scroll_to_row(Gtk::TreePath(it));
+        
+        if (data_log_ptr < data_log.size())
                 update_log();
+        
+        dropped = log_formatter.get_records_dropped();
+        if (dropped != log_records_dropped)
+        {
+                std::cerr << "[ZigBeeTerminal] Packet log fell behind, " << dropped - log_records_dropped << " records dropped" << std::endl;
+                log_records_dropped = dropped;
         }
+        
+        return !log_formatter.empty();
+}
+
+
+void ZigBeeTerminal::queue_log_record(ZigBeePacket &pkt, uint64_t timestamp, bool tx)
+{
+        log_formatter.push(pkt, timestamp, tx);
+        
+        if (!c_log_tick.connected())
+                c_log_tick = Glib::signal_timeout().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_log_tick), ZIGBEE_LOG_TICK_MS );
 }
 
 
@@ -625,6 +964,7 @@ void ZigBeeTerminal::open_port()
         ser_int->set_bits(bits);
         ser_int->set_stop(stop_bits);
         ser_int->set_flow(flow_control);
+        ser_int->set_latency(latency);
         ser_int->open_port();
 }
 
@@ -39,10 +39,18 @@
 #include <tr1/memory>
 
 #include "PortConfig.h"
+#include "StatsDialog.h"
+#include "ATBatchDialog.h"
+#include "OTADialog.h"
+#include "TrafficDialog.h"
+#include "SendFileDialog.h"
 #include "SerialInterface.h"
 #include "ZigBeePacket.h"
 #include "ZigBeeInterface.h"
 #include "ZigBeePacketBuilder.h"
+#include "ZigBeeExporter.h"
+#include "ZigBeeLogFormatter.h"
+#include "TopologyView.h"
 
 // ZigBeeTerminal class
 class ZigBeeTerminal : public Gtk::Window
@@ -53,6 +61,9 @@ public:
         
 protected:
         //Signal handlers:
+        void on_file_export_trace_item_activate();
+        void on_file_export_samples_toggled();
+        void on_file_send_item_activate();
         void on_file_quit_item_activate();
         void on_config_port_item_activate();
         void on_config_close_port_item_activate();
@@ -60,8 +71,16 @@ protected:
         void on_view_hex_terminal_toggle();
         void on_view_hex_log_toggle();
         void on_view_clear_activate();
+        void on_view_stats_activate();
+        
+        void on_tools_at_batch_activate();
+        void on_tools_ota_activate();
+        void on_tools_traffic_activate();
         
         bool on_tv_key_press(GdkEventKey *key);
+        void on_tv_paste_clipboard();
+        void on_clipboard_text(const Glib::ustring &text);
+        void on_stream_send_data(const char *data, size_t len);
         
         void on_tv_pkt_log_cursor_changed();
         
@@ -70,11 +89,20 @@ protected:
         
         void on_port_open();
         void on_port_close();
+        void on_port_disconnected();
+        void on_config_auto_reconnect_toggled();
+        void on_config_source_routing_toggled();
+        void on_config_address_resolution_toggled();
+        void on_config_api_mode_toggled();
         
         void on_receive_packet(ZigBeePacket pkt);
         void on_receive_raw_data(const char *data, size_t len);
         void on_send_raw_data(const char *data, size_t len);
         
+        bool on_log_tick();
+        
+        void queue_log_record(ZigBeePacket &pkt, uint64_t timestamp, bool tx);
+        
         void update_log();
         void update_raw_log();
         
@@ -86,9 +114,10 @@ protected:
         {
         public:
                 PacketLogModel()
-                { add(Packet); add(Direction); add(Type); add(Size); add(Data); }
+                { add(Packet); add(Time); add(Direction); add(Type); add(Size); add(Data); }
                 
                 Gtk::TreeModelColumn<ZigBeePacket> Packet;
+                Gtk::TreeModelColumn<Glib::ustring> Time;
                 Gtk::TreeModelColumn<Glib::ustring> Direction;
                 Gtk::TreeModelColumn<Glib::ustring> Type;
                 Gtk::TreeModelColumn<int> Size;
@@ -106,6 +135,10 @@ protected:
         Gtk::MenuBar main_menu;
         Gtk::MenuItem file_menu_item;
         Gtk::Menu file_menu;
+        Gtk::MenuItem file_export_trace_item;
+        Gtk::CheckMenuItem file_export_samples_item;
+        Gtk::MenuItem file_send_item;
+        Gtk::SeparatorMenuItem file_sep1;
         Gtk::ImageMenuItem file_quit_item;
         Gtk::MenuItem view_menu_item;
         Gtk::Menu view_menu;
@@ -113,6 +146,8 @@ protected:
         Gtk::CheckMenuItem view_hex_log;
         Gtk::SeparatorMenuItem view_sep1;
         Gtk::ImageMenuItem view_clear_item;
+        Gtk::SeparatorMenuItem view_sep2;
+        Gtk::MenuItem view_stats_item;
         Gtk::MenuItem config_menu_item;
         Gtk::Menu config_menu;
         Gtk::ImageMenuItem config_port_item;
@@ -120,6 +155,14 @@ protected:
         Gtk::SeparatorMenuItem config_sep1;
         Gtk::CheckMenuItem config_local_echo;
         Gtk::CheckMenuItem config_api_mode;
+        Gtk::CheckMenuItem config_auto_reconnect;
+        Gtk::CheckMenuItem config_source_routing;
+        Gtk::CheckMenuItem config_address_resolution;
+        Gtk::MenuItem tools_menu_item;
+        Gtk::Menu tools_menu;
+        Gtk::MenuItem tools_at_batch_item;
+        Gtk::MenuItem tools_ota_item;
+        Gtk::MenuItem tools_traffic_item;
         // tabs
         Gtk::Notebook note;
         // terminal
@@ -146,10 +189,17 @@ protected:
         ZigBeePacketBuilder pkt_builder;
         Gtk::ScrolledWindow sw2_pkt_builder;
         Gtk::TextView tv_pkt_builder;
+        // topology
+        TopologyView topology_view;
         // status bar
         Gtk::Statusbar status;
         
         PortConfig dlgPort;
+        StatsDialog dlgStats;
+        ATBatchDialog dlgATBatch;
+        OTADialog dlgOTA;
+        TrafficDialog dlgTraffic;
+        SendFileDialog dlgSend;
         
         Glib::ustring port;
         unsigned long baud;
@@ -157,11 +207,18 @@ protected:
         int bits;
         int stop_bits;
         SerialInterface::SerialFlow flow_control;
+        SerialInterface::SerialLatency latency;
         
         std::tr1::shared_ptr<SerialInterface> ser_int;
         
         ZigBeeInterface zb_int;
         
+        ZigBeeExporter exporter;
+        
+        ZigBeeLogFormatter log_formatter;
+        sigc::connection c_log_tick;
+        uint64_t log_records_dropped;
+        
         std::deque<char> read_data_queue;
         
         std::vector<int> data_log;
@@ -170,6 +227,8 @@ protected:
         unsigned int data_log_ptr;
         unsigned int raw_data_log_ptr;
         
+        uint64_t start_timestamp;
+        
 };
 
 #endif //__ZIGBEE_TERMINAL_H
@@ -0,0 +1,418 @@
+/************************************************************************/
+/* ZigBeeTopology                                                       */
+/*                                                                      */
+/* ZigBee Terminal - Network Topology                                   */
+/*                                                                      */
+/* ZigBeeTopology.cpp                                                   */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ZigBeeTopology.h"
+
+#include <iostream>
+
+
+ZigBeeTopology::ZigBeeTopology(ZigBeeInterface &zb) :
+        zb_int(zb),
+        batch(zb),
+        nd_frame_id(0)
+{
+        zb_int.signal_receive_packet().connect( sigc::mem_fun(*this, &ZigBeeTopology::on_receive_packet) );
+        batch.signal_result().connect( sigc::mem_fun(*this, &ZigBeeTopology::on_query_result) );
+}
+
+
+ZigBeeTopology::~ZigBeeTopology()
+{
+        
+}
+
+
+bool ZigBeeTopology::discover()
+{
+        ZigBeePacket pkt;
+        
+        if (!zb_int.is_connected())
+        {
+                std::cerr << "[ZigBeeTopology] Not connected" << std::endl;
+                return false;
+        }
+        
+        // local ND; each responsive node answers with its details
+        pkt.identifier = ZigBeePacket::ZBPID_ATCommand;
+        pkt.frame_id = nd_frame_id = zb_int.get_next_frame_id();
+        pkt.at_cmd[0] = 'N';
+        pkt.at_cmd[1] = 'D';
+        pkt.build_packet();
+        
+        zb_int.send_packet(pkt);
+        
+        // meanwhile, query the nodes only seen in traffic
+        if (batch.is_running())
+                return true;
+        
+        batch.clear();
+        
+        for (std::map<uint64_t, Node>::iterator it = nodes.begin(); it != nodes.end(); it++)
+                if (!it->second.identified)
+                        batch.add_node(it->second.addr64, it->second.addr16);
+        
+        batch.add_command("NI", std::vector<uint8_t>());
+        batch.add_command("MP", std::vector<uint8_t>());
+        
+        batch.start();
+        
+        return true;
+}
+
+
+bool ZigBeeTopology::is_discovering()
+{
+        return batch.is_running();
+}
+
+
+void ZigBeeTopology::clear()
+{
+        batch.clear();
+        nodes.clear();
+        nodes16.clear();
+        nd_frame_id = 0;
+        
+        m_signal_cleared.emit();
+}
+
+
+const ZigBeeTopology::Node *ZigBeeTopology::get_node(uint64_t addr64)
+{
+        std::map<uint64_t, Node>::iterator it = nodes.find(addr64);
+        
+        if (it == nodes.end())
+                return NULL;
+        
+        return &it->second;
+}
+
+
+const ZigBeeTopology::Node *ZigBeeTopology::get_node16(uint16_t addr16)
+{
+        std::map<uint16_t, uint64_t>::iterator it = nodes16.find(addr16);
+        
+        if (it == nodes16.end())
+                return NULL;
+        
+        return get_node(it->second);
+}
+
+
+std::vector<uint64_t> ZigBeeTopology::get_children(uint64_t addr64)
+{
+        std::vector<uint64_t> children;
+        
+        for (std::map<uint64_t, Node>::iterator it = nodes.begin(); it != nodes.end(); it++)
+        {
+                const Node *p = get_parent(it->first);
+                if (p && p->addr64 == addr64)
+                        children.push_back(it->first);
+        }
+        
+        return children;
+}
+
+
+const ZigBeeTopology::Node *ZigBeeTopology::get_parent(uint64_t addr64)
+{
+        const Node *n = get_node(addr64);
+        
+        if (n == NULL || n->device_type == ZIGBEE_DEVICE_COORDINATOR)
+                return NULL;
+        
+        if (n->parent16 != ZIGBEE_ADDR16_UNKNOWN)
+                return get_node16(n->parent16);
+        
+        // routers hang off the coordinator, which is always 0x0000
+        if (n->device_type == ZIGBEE_DEVICE_ROUTER)
+                return get_node16(0x0000);
+        
+        return NULL;
+}
+
+
+size_t ZigBeeTopology::size()
+{
+        return nodes.size();
+}
+
+
+std::string ZigBeeTopology::get_device_type_desc(uint8_t type)
+{
+        switch (type)
+        {
+                case ZIGBEE_DEVICE_COORDINATOR:
+                        return "Coordinator";
+                case ZIGBEE_DEVICE_ROUTER:
+                        return "Router";
+                case ZIGBEE_DEVICE_END_DEVICE:
+                        return "End Device";
+        }
+        
+        return "Unknown";
+}
+
+
+sigc::signal<void, uint64_t> ZigBeeTopology::signal_node_changed()
+{
+        return m_signal_node_changed;
+}
+
+
+sigc::signal<void> ZigBeeTopology::signal_cleared()
+{
+        return m_signal_cleared;
+}
+
+
+void ZigBeeTopology::on_receive_packet(ZigBeePacket pkt)
+{
+        uint64_t now = SerialInterface::get_timestamp();
+        
+        if (pkt.identifier == ZigBeePacket::ZBPID_ATCommandResponse)
+        {
+                if (nd_frame_id == 0 || pkt.frame_id != nd_frame_id)
+                        return;
+                
+                if (pkt.at_cmd[0] != 'N' || pkt.at_cmd[1] != 'D' || pkt.status != 0)
+                        return;
+                
+                // an empty response marks the end of discovery
+                if (pkt.data.size() == 0)
+                {
+                        nd_frame_id = 0;
+                        return;
+                }
+                
+                parse_nd(&pkt.data[0], pkt.data.size(), now);
+                return;
+        }
+        
+        if (pkt.identifier == ZigBeePacket::ZBPID_RemoteCommandResponse)
+        {
+                // remote ND answers are in the same format as local ones
+                if (pkt.at_cmd[0] == 'N' && pkt.at_cmd[1] == 'D' && pkt.status == 0 && pkt.data.size() > 0)
+                        parse_nd(&pkt.data[0], pkt.data.size(), now);
+                else
+                        touch(pkt.src64, pkt.src16, now);
+                
+                return;
+        }
+        
+        if (pkt.identifier == ZigBeePacket::ZBPID_NodeIdentification)
+        {
+                Node &n = touch(pkt.src64, pkt.src16, now);
+                
+                if (pkt.data.size() > 0 && parse_details(n, &pkt.data[0], pkt.data.size()))
+                        m_signal_node_changed.emit(n.addr64);
+                
+                if (pkt.sender64_offset && pkt.sender16_offset && pkt.sender64 != pkt.src64)
+                        touch(pkt.sender64, pkt.sender16, now);
+                
+                return;
+        }
+        
+        if (pkt.identifier == ZigBeePacket::ZBPID_JoinNotificationStatus)
+        {
+                if (pkt.status != 0)
+                        return;
+                
+                Node &n = touch(pkt.new64, pkt.new16, now);
+                
+                if (n.parent16 != pkt.parent16)
+                {
+                        n.parent16 = pkt.parent16;
+                        m_signal_node_changed.emit(n.addr64);
+                }
+                
+                return;
+        }
+        
+        if (pkt.src64_offset && pkt.src16_offset)
+                touch(pkt.src64, pkt.src16, now);
+}
+
+
+void ZigBeeTopology::on_query_result(int index)
+{
+        const ZigBeeATBatch::Result &r = batch.get_results()[index];
+        std::map<uint64_t, Node>::iterator it = nodes.find(r.addr64);
+        
+        if (r.state != ZigBeeATBatch::BS_OK || it == nodes.end())
+                return;
+        
+        Node &n = it->second;
+        
+        if (r.cmd == "NI")
+        {
+                std::string name(r.data.begin(), r.data.end());
+                
+                if (n.name == name)
+                        return;
+                
+                n.name = name;
+        }
+        else if (r.cmd == "MP")
+        {
+                if (r.data.size() < 2)
+                        return;
+                
+                uint16_t parent16 = (r.data[0] << 8) | r.data[1];
+                
+                // only end devices report a parent
+                if (parent16 != ZIGBEE_ADDR16_UNKNOWN)
+                        n.device_type = ZIGBEE_DEVICE_END_DEVICE;
+                
+                if (n.parent16 == parent16)
+                        return;
+                
+                n.parent16 = parent16;
+        }
+        else
+        {
+                return;
+        }
+        
+        m_signal_node_changed.emit(n.addr64);
+}
+
+
+void ZigBeeTopology::parse_nd(const uint8_t *p, size_t len, uint64_t now)
+{
+        uint16_t addr16;
+        uint64_t addr64 = 0;
+        
+        // MY, SH, SL, then details
+        if (len < 10)
+        {
+                std::cerr << "[ZigBeeTopology] Truncated ND response" << std::endl;
+                return;
+        }
+        
+        addr16 = (p[0] << 8) | p[1];
+        for (int i = 2; i < 10; i++)
+                addr64 = (addr64 << 8) | p[i];
+        
+        Node &n = touch(addr64, addr16, now);
+        
+        if (parse_details(n, p + 10, len - 10))
+                m_signal_node_changed.emit(n.addr64);
+}
+
+
+bool ZigBeeTopology::parse_details(Node &n, const uint8_t *p, size_t len)
+{
+        size_t k = 0;
+        Node old = n;
+        
+        while (k < len && p[k] != 0)
+                k++;
+        
+        // NI string, then parent(2), type(1), status(1), profile(2) and
+        // manufacturer(2)
+        if (k + 9 > len)
+        {
+                std::cerr << "[ZigBeeTopology] Truncated node details" << std::endl;
+                return false;
+        }
+        
+        n.name = std::string((const char *)p, k);
+        p += k + 1;
+        
+        n.parent16 = (p[0] << 8) | p[1];
+        n.device_type = p[2];
+        n.profile_id = (p[4] << 8) | p[5];
+        n.manufacturer_id = (p[6] << 8) | p[7];
+        
+        if (n.device_type > ZIGBEE_DEVICE_END_DEVICE)
+                n.device_type = ZIGBEE_DEVICE_UNKNOWN;
+        
+        // coordinators and routers report 0xFFFE as parent
+        if (n.device_type != ZIGBEE_DEVICE_END_DEVICE)
+                n.parent16 = ZIGBEE_ADDR16_UNKNOWN;
+        
+        bool changed = !old.identified
+                || old.name != n.name
+                || old.parent16 != n.parent16
+                || old.device_type != n.device_type
+                || old.profile_id != n.profile_id
+                || old.manufacturer_id != n.manufacturer_id;
+        
+        n.identified = true;
+        
+        return changed;
+}
+
+
+ZigBeeTopology::Node &ZigBeeTopology::touch(uint64_t addr64, uint16_t addr16, uint64_t now)
+{
+        std::map<uint64_t, Node>::iterator it = nodes.find(addr64);
+        bool changed = false;
+        
+        if (it == nodes.end())
+        {
+                Node n;
+                n.addr64 = addr64;
+                n.addr16 = ZIGBEE_ADDR16_UNKNOWN;
+                n.parent16 = ZIGBEE_ADDR16_UNKNOWN;
+                n.device_type = ZIGBEE_DEVICE_UNKNOWN;
+                n.profile_id = 0;
+                n.manufacturer_id = 0;
+                n.identified = false;
+                it = nodes.insert(std::make_pair(addr64, n)).first;
+                changed = true;
+        }
+        
+        Node &n = it->second;
+        n.last_seen = now;
+        
+        if (addr16 != ZIGBEE_ADDR16_UNKNOWN && n.addr16 != addr16)
+        {
+                if (n.addr16 != ZIGBEE_ADDR16_UNKNOWN)
+                        nodes16.erase(n.addr16);
+                n.addr16 = addr16;
+                nodes16[addr16] = addr64;
+                
+                // 0x0000 is always the coordinator
+                if (addr16 == 0x0000)
+                        n.device_type = ZIGBEE_DEVICE_COORDINATOR;
+                
+                changed = true;
+        }
+        
+        if (changed)
+                m_signal_node_changed.emit(addr64);
+        
+        return n;
+}
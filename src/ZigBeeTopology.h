@@ -0,0 +1,244 @@
+/************************************************************************/
+/* ZigBeeTopology                                                       */
+/*                                                                      */
+/* ZigBee Terminal - Network Topology                                   */
+/*                                                                      */
+/* ZigBeeTopology.h                                                     */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __ZIGBEE_TOPOLOGY_H
+#define __ZIGBEE_TOPOLOGY_H
+
+#include <gtkmm.h>
+
+#include "ZigBeeInterface.h"
+#include "ZigBeeATBatch.h"
+#include "ZigBeePacket.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <inttypes.h>
+
+#define ZIGBEE_DEVICE_COORDINATOR 0
+#define ZIGBEE_DEVICE_ROUTER 1
+#define ZIGBEE_DEVICE_END_DEVICE 2
+#define ZIGBEE_DEVICE_UNKNOWN 0xff
+
+/** ZigBee network topology
+ * 
+ * Graph of the nodes seen on the network, keyed by 64-bit address, with
+ * parent links for end devices.  Nodes are added and updated one at a
+ * time from Node Identification (0x95) frames, ND responses (local 0x88
+ * and remote 0x97) and the source addresses of any other received frame,
+ * and a change signal is emitted per node so views can update only what
+ * changed.
+ * 
+ * discover() runs a sweep: a local ND, which every responsive node
+ * answers, and in parallel remote NI and MP queries to nodes that are
+ * known only from traffic, such as sleeping end devices that missed a
+ * previous ND.
+ */
+class ZigBeeTopology : public sigc::trackable
+{
+public:
+        /**
+         * Network node.
+         */
+        struct Node
+        {
+                uint64_t addr64;                ///< 64-bit address
+                uint16_t addr16;                ///< 16-bit address
+                uint16_t parent16;              ///< Parent 16-bit address, 0xFFFE if none
+                uint8_t device_type;            ///< ZIGBEE_DEVICE_* value
+                std::string name;               ///< Node identifier (NI)
+                uint16_t profile_id;            ///< Profile ID, 0 if unknown
+                uint16_t manufacturer_id;       ///< Manufacturer ID, 0 if unknown
+                bool identified;                ///< Details came from NI or ND
+                uint64_t last_seen;             ///< Time of last frame (microseconds)
+        };
+        
+        /**
+         * Create a topology model.
+         * @param zb interface to listen and query on
+         */
+        ZigBeeTopology(ZigBeeInterface &zb);
+        virtual ~ZigBeeTopology();
+        
+        /**
+         * Start a discovery sweep.
+         * @return false if not connected
+         */
+        bool discover();
+        
+        /**
+         * Check if the parallel query part of a sweep is running.
+         * @return true if running
+         */
+        bool is_discovering();
+        
+        /**
+         * Remove all nodes.
+         */
+        void clear();
+        
+        /**
+         * Find a node.
+         * @param addr64 64-bit address
+         * @return node, or NULL
+         */
+        const Node *get_node(uint64_t addr64);
+        
+        /**
+         * Find a node by 16-bit address.
+         * @param addr16 16-bit address
+         * @return node, or NULL
+         */
+        const Node *get_node16(uint16_t addr16);
+        
+        /**
+         * Get the 64-bit addresses of a node's children.
+         * @param addr64 parent 64-bit address
+         * @return child addresses
+         */
+        std::vector<uint64_t> get_children(uint64_t addr64);
+        
+        /**
+         * Get the node a node hangs off in the graph: the parent of an
+         * end device, or the coordinator for a router.
+         * @param addr64 64-bit address
+         * @return parent node, or NULL for a root
+         */
+        const Node *get_parent(uint64_t addr64);
+        
+        /**
+         * Get number of nodes.
+         * @return nodes
+         */
+        size_t size();
+        
+        /**
+         * Get device type name.
+         * @param type ZIGBEE_DEVICE_* value
+         * @return name
+         */
+        static std::string get_device_type_desc(uint8_t type);
+        
+        /**
+         * Node changed signal, emitted when a node is added or changes.
+         * @par Prototype:
+         * <tt>void on_my_%node_changed(uint64_t addr64)</tt>
+         */
+        sigc::signal<void, uint64_t> signal_node_changed();
+        
+        /**
+         * Cleared signal.
+         * @par Prototype:
+         * <tt>void on_my_%cleared()</tt>
+         */
+        sigc::signal<void> signal_cleared();
+        
+protected:
+        /**
+         * Receive packet handler.
+         * @param pkt packet
+         */
+        void on_receive_packet(ZigBeePacket pkt);
+        
+        /**
+         * Query result handler.
+         * @param index batch result index
+         */
+        void on_query_result(int index);
+        
+        /**
+         * Parse an ND response.
+         * @param p response data
+         * @param len length
+         * @param now current time
+         */
+        void parse_nd(const uint8_t *p, size_t len, uint64_t now);
+        
+        /**
+         * Parse node details following the address fields of NI and ND
+         * data: NI string, parent, device type, status, profile and
+         * manufacturer.
+         * @param n node to fill in
+         * @param p data starting at the NI string
+         * @param len length
+         * @return true if the details were complete
+         */
+        bool parse_details(Node &n, const uint8_t *p, size_t len);
+        
+        /**
+         * Find or add a node and record it as seen.
+         * @param addr64 64-bit address
+         * @param addr16 16-bit address
+         * @param now current time
+         * @return node
+         */
+        Node &touch(uint64_t addr64, uint16_t addr16, uint64_t now);
+        
+        /**
+         * Interface used for discovery.
+         */
+        ZigBeeInterface &zb_int;
+        
+        /**
+         * Query runner for the parallel part of a sweep.
+         */
+        ZigBeeATBatch batch;
+        
+        /**
+         * Nodes by 64-bit address.
+         */
+        std::map<uint64_t, Node> nodes;
+        
+        /**
+         * 64-bit address by 16-bit address.
+         */
+        std::map<uint16_t, uint64_t> nodes16;
+        
+        /**
+         * Frame ID of the outstanding local ND, 0 if none.
+         */
+        uint8_t nd_frame_id;
+        
+        /**
+         * Node changed signal.
+         */
+        sigc::signal<void, uint64_t> m_signal_node_changed;
+        
+        /**
+         * Cleared signal.
+         */
+        sigc::signal<void> m_signal_cleared;
+};
+
+#endif //__ZIGBEE_TOPOLOGY_H
+
@@ -0,0 +1,447 @@
+/************************************************************************/
+/* ZigBeeTrafficGen                                                     */
+/*                                                                      */
+/* ZigBee Terminal - Traffic Generator                                  */
+/*                                                                      */
+/* ZigBeeTrafficGen.cpp                                                 */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ZigBeeTrafficGen.h"
+
+#include <iostream>
+#include <cstdlib>
+
+// Digi data endpoint, cluster and profile for explicit frames
+#define TRAFFIC_EA_ENDPOINT 0xE8
+#define TRAFFIC_EA_CLUSTER 0x0011
+#define TRAFFIC_EA_PROFILE 0xC105
+
+
+ZigBeeTrafficGen::ZigBeeTrafficGen(ZigBeeInterface &zb) :
+        zb_int(zb),
+        rate(ZIGBEE_TRAFFIC_DEFAULT_RATE),
+        payload_size(ZIGBEE_TRAFFIC_DEFAULT_PAYLOAD),
+        credit(0),
+        next_dest(0),
+        seq(0),
+        running(false),
+        tick_timestamp(0),
+        sample_timestamp(0)
+{
+        for (int i = 0; i < TK_Count; i++)
+                weights[i] = 0;
+        weights[TK_Unicast] = 1;
+        
+        for (int i = 0; i < 256; i++)
+                in_flight[i].active = false;
+        
+        for (int i = 0; i < 4; i++)
+                sample_totals[i] = 0;
+        
+        clear_destinations();
+        
+        zb_int.signal_receive_packet().connect( sigc::mem_fun(*this, &ZigBeeTrafficGen::on_receive_packet) );
+}
+
+
+ZigBeeTrafficGen::~ZigBeeTrafficGen()
+{
+        c_tick.disconnect();
+        c_sample.disconnect();
+}
+
+
+void ZigBeeTrafficGen::clear_destinations()
+{
+        if (running)
+                stop();
+        
+        dests.clear();
+        
+        // broadcasts are counted as destination 0
+        add_destination(ZIGBEE_ADDR64_BROADCAST, ZIGBEE_ADDR16_UNKNOWN);
+}
+
+
+void ZigBeeTrafficGen::add_destination(uint64_t addr64, uint16_t addr16)
+{
+        Destination d;
+        
+        d.addr64 = addr64;
+        d.addr16 = addr16;
+        d.sent = 0;
+        d.delivered = 0;
+        d.failed = 0;
+        d.lost = 0;
+        
+        dests.push_back(d);
+}
+
+
+void ZigBeeTrafficGen::set_weight(TrafficKind kind, int weight)
+{
+        weights[kind] = weight < 0 ? 0 : weight;
+}
+
+
+int ZigBeeTrafficGen::get_weight(TrafficKind kind)
+{
+        return weights[kind];
+}
+
+
+double ZigBeeTrafficGen::set_rate(double pps)
+{
+        if (pps < 1)
+                pps = 1;
+        if (pps > ZIGBEE_TRAFFIC_MAX_RATE)
+                pps = ZIGBEE_TRAFFIC_MAX_RATE;
+        
+        return rate = pps;
+}
+
+
+double ZigBeeTrafficGen::get_rate()
+{
+        return rate;
+}
+
+
+int ZigBeeTrafficGen::set_payload_size(int n)
+{
+        if (n < ZIGBEE_TRAFFIC_MIN_PAYLOAD)
+                n = ZIGBEE_TRAFFIC_MIN_PAYLOAD;
+        if (n > ZIGBEE_TRAFFIC_MAX_PAYLOAD)
+                n = ZIGBEE_TRAFFIC_MAX_PAYLOAD;
+        
+        return payload_size = n;
+}
+
+
+int ZigBeeTrafficGen::get_payload_size()
+{
+        return payload_size;
+}
+
+
+bool ZigBeeTrafficGen::start()
+{
+        int total = 0;
+        
+        if (running)
+                stop();
+        
+        if (!zb_int.is_connected())
+        {
+                std::cerr << "[ZigBeeTrafficGen] Not connected" << std::endl;
+                return false;
+        }
+        
+        // unicast kinds need somewhere to go
+        if (dests.size() < 2 && (weights[TK_Unicast] || weights[TK_EAUnicast]))
+        {
+                std::cerr << "[ZigBeeTrafficGen] No unicast destinations" << std::endl;
+                return false;
+        }
+        
+        for (int i = 0; i < TK_Count; i++)
+                total += weights[i];
+        
+        if (total == 0)
+        {
+                std::cerr << "[ZigBeeTrafficGen] Empty traffic mix" << std::endl;
+                return false;
+        }
+        
+        for (int i = 0; i < TK_Count; i++)
+        {
+                ZigBeePacket pkt;
+                bool explicit_addr = i == TK_EAUnicast || i == TK_EABroadcast;
+                
+                pkt.identifier = explicit_addr ? ZigBeePacket::ZBPID_EATxRequest : ZigBeePacket::ZBPID_TxRequest;
+                pkt.frame_id = 1;
+                pkt.dest64 = ZIGBEE_ADDR64_BROADCAST;
+                pkt.dest16 = ZIGBEE_ADDR16_UNKNOWN;
+                pkt.radius = 0;
+                pkt.options = 0;
+                pkt.data.assign(payload_size, 0);
+                
+                if (explicit_addr)
+                {
+                        pkt.src_ep = TRAFFIC_EA_ENDPOINT;
+                        pkt.dest_ep = TRAFFIC_EA_ENDPOINT;
+                        pkt.cluster_id = TRAFFIC_EA_CLUSTER;
+                        pkt.profile_id = TRAFFIC_EA_PROFILE;
+                }
+                
+                templates[i].compile(pkt);
+        }
+        
+        for (size_t i = 0; i < dests.size(); i++)
+        {
+                dests[i].sent = 0;
+                dests[i].delivered = 0;
+                dests[i].failed = 0;
+                dests[i].lost = 0;
+                dests[i].latency.reset();
+        }
+        
+        for (int i = 0; i < 256; i++)
+                in_flight[i].active = false;
+        
+        for (int i = 0; i < 4; i++)
+                sample_totals[i] = 0;
+        
+        history.clear();
+        
+        next_dest = 0;
+        credit = 1;
+        running = true;
+        tick_timestamp = sample_timestamp = SerialInterface::get_timestamp();
+        
+        c_tick = Glib::signal_timeout().connect( sigc::mem_fun(*this, &ZigBeeTrafficGen::on_tick), ZIGBEE_TRAFFIC_TICK_MS );
+        c_sample = Glib::signal_timeout().connect( sigc::mem_fun(*this, &ZigBeeTrafficGen::on_sample), ZIGBEE_TRAFFIC_SAMPLE_MS );
+        
+        return true;
+}
+
+
+void ZigBeeTrafficGen::stop()
+{
+        if (!running)
+                return;
+        
+        c_tick.disconnect();
+        c_sample.disconnect();
+        running = false;
+        
+        expire(SerialInterface::get_timestamp(), true);
+        
+        m_signal_sample.emit();
+}
+
+
+bool ZigBeeTrafficGen::is_running()
+{
+        return running;
+}
+
+
+const std::vector<ZigBeeTrafficGen::Destination> &ZigBeeTrafficGen::get_destinations()
+{
+        return dests;
+}
+
+
+const std::deque<ZigBeeTrafficGen::Sample> &ZigBeeTrafficGen::get_history()
+{
+        return history;
+}
+
+
+std::string ZigBeeTrafficGen::get_kind_desc(TrafficKind kind)
+{
+        switch (kind)
+        {
+                case TK_Unicast:
+                        return "Unicast";
+                case TK_Broadcast:
+                        return "Broadcast";
+                case TK_EAUnicast:
+                        return "Explicit Unicast";
+                case TK_EABroadcast:
+                        return "Explicit Broadcast";
+                default:
+                        return "Unknown";
+        }
+}
+
+
+sigc::signal<void> ZigBeeTrafficGen::signal_sample()
+{
+        return m_signal_sample;
+}
+
+
+void ZigBeeTrafficGen::on_receive_packet(ZigBeePacket pkt)
+{
+        if (!running || pkt.identifier != ZigBeePacket::ZBPID_TxStatusS2)
+                return;
+        
+        InFlight &f = in_flight[pkt.frame_id];
+        
+        if (!f.active)
+                return;
+        
+        f.active = false;
+        
+        Destination &d = dests[f.dest];
+        
+        if (pkt.delivery_status == 0)
+        {
+                d.delivered++;
+                d.latency.record(SerialInterface::get_timestamp() - f.timestamp);
+        }
+        else
+        {
+                d.failed++;
+        }
+}
+
+
+bool ZigBeeTrafficGen::on_tick()
+{
+        uint64_t now = SerialInterface::get_timestamp();
+        double burst = rate * ZIGBEE_TRAFFIC_MAX_BURST_MS / 1000.0;
+        
+        credit += (now - tick_timestamp) * rate / 1e6;
+        tick_timestamp = now;
+        
+        // don't save up a burst while the port is blocked
+        if (burst < 1)
+                burst = 1;
+        if (credit > burst)
+                credit = burst;
+        
+        while (credit >= 1 && !zb_int.is_write_blocked())
+        {
+                send_next();
+                credit -= 1;
+        }
+        
+        return true;
+}
+
+
+bool ZigBeeTrafficGen::on_sample()
+{
+        uint64_t now = SerialInterface::get_timestamp();
+        uint64_t totals[4] = {0, 0, 0, 0};
+        double dt = (now - sample_timestamp) / 1e6;
+        Sample s;
+        
+        expire(now, false);
+        
+        for (size_t i = 0; i < dests.size(); i++)
+        {
+                totals[0] += dests[i].sent;
+                totals[1] += dests[i].delivered;
+                totals[2] += dests[i].failed;
+                totals[3] += dests[i].lost;
+        }
+        
+        uint64_t delivered = totals[1] - sample_totals[1];
+        uint64_t missed = totals[2] - sample_totals[2] + totals[3] - sample_totals[3];
+        
+        if (dt <= 0)
+                dt = ZIGBEE_TRAFFIC_SAMPLE_MS / 1000.0;
+        
+        s.sent_rate = (totals[0] - sample_totals[0]) / dt;
+        s.delivered_rate = delivered / dt;
+        s.loss = delivered + missed > 0 ? (double)missed / (delivered + missed) : 0;
+        
+        history.push_back(s);
+        while (history.size() > ZIGBEE_TRAFFIC_HISTORY)
+                history.pop_front();
+        
+        for (int i = 0; i < 4; i++)
+                sample_totals[i] = totals[i];
+        sample_timestamp = now;
+        
+        m_signal_sample.emit();
+        
+        return true;
+}
+
+
+void ZigBeeTrafficGen::send_next()
+{
+        int total = 0;
+        int pick;
+        int kind = 0;
+        int dest = 0;
+        uint8_t id;
+        uint8_t s[4];
+        
+        for (int i = 0; i < TK_Count; i++)
+                total += weights[i];
+        
+        pick = rand() % total;
+        
+        while (pick >= weights[kind])
+                pick -= weights[kind++];
+        
+        ZigBeePacketTemplate &tmpl = templates[kind];
+        
+        if (kind == TK_Unicast || kind == TK_EAUnicast)
+        {
+                dest = 1 + next_dest;
+                next_dest = (next_dest + 1) % (dests.size() - 1);
+                
+                tmpl.set_dest64(dests[dest].addr64);
+                tmpl.set_dest16(dests[dest].addr16);
+        }
+        
+        id = zb_int.get_next_frame_id();
+        
+        // frame ID came around before its status did
+        if (in_flight[id].active)
+                dests[in_flight[id].dest].lost++;
+        
+        in_flight[id].active = true;
+        in_flight[id].dest = dest;
+        in_flight[id].timestamp = SerialInterface::get_timestamp();
+        
+        s[0] = seq >> 24;
+        s[1] = seq >> 16;
+        s[2] = seq >> 8;
+        s[3] = seq;
+        seq++;
+        
+        tmpl.set_frame_id(id);
+        tmpl.set_data(0, s, 4);
+        
+        dests[dest].sent++;
+        
+        zb_int.send_template(tmpl);
+}
+
+
+void ZigBeeTrafficGen::expire(uint64_t now, bool all)
+{
+        for (int i = 0; i < 256; i++)
+        {
+                InFlight &f = in_flight[i];
+                
+                if (f.active && (all || now - f.timestamp > (uint64_t)ZIGBEE_TRAFFIC_TIMEOUT_MS * 1000))
+                {
+                        f.active = false;
+                        dests[f.dest].lost++;
+                }
+        }
+}
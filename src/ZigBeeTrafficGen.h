@@ -0,0 +1,353 @@
+/************************************************************************/
+/* ZigBeeTrafficGen                                                     */
+/*                                                                      */
+/* ZigBee Terminal - Traffic Generator                                  */
+/*                                                                      */
+/* ZigBeeTrafficGen.h                                                   */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __ZIGBEE_TRAFFIC_GEN_H
+#define __ZIGBEE_TRAFFIC_GEN_H
+
+#include <gtkmm.h>
+
+#include "ZigBeeInterface.h"
+#include "ZigBeePacket.h"
+#include "ZigBeePacketTemplate.h"
+#include "ZigBeeStats.h"
+
+#include <vector>
+#include <deque>
+#include <inttypes.h>
+
+#define ZIGBEE_TRAFFIC_DEFAULT_RATE 10
+#define ZIGBEE_TRAFFIC_MAX_RATE 5000
+#define ZIGBEE_TRAFFIC_DEFAULT_PAYLOAD 16
+#define ZIGBEE_TRAFFIC_MIN_PAYLOAD 4
+#define ZIGBEE_TRAFFIC_MAX_PAYLOAD 84
+#define ZIGBEE_TRAFFIC_TIMEOUT_MS 5000
+#define ZIGBEE_TRAFFIC_TICK_MS 1
+#define ZIGBEE_TRAFFIC_SAMPLE_MS 1000
+#define ZIGBEE_TRAFFIC_HISTORY 120
+#define ZIGBEE_TRAFFIC_MAX_BURST_MS 50
+
+/** ZigBee Traffic Generator
+ * 
+ * Sends a weighted mix of unicast and broadcast Transmit Request (0x10)
+ * and Explicit Addressing Transmit Request (0x11) frames at a target rate.
+ * Unicast frames go to the destinations in turn.  Each frame carries a
+ * 32-bit sequence number at the start of its payload.
+ * 
+ * Every frame requests a Transmit Status (0x8B); the outcome and the time
+ * from send to status are tracked per destination, with broadcasts
+ * counted together as destination 0.  Frames with no status after
+ * ZIGBEE_TRAFFIC_TIMEOUT_MS, or whose frame ID comes around again first,
+ * are counted as lost.  Throughput and loss are sampled once a second
+ * into a short history for graphing.
+ * 
+ * Frames are sent from precompiled templates through
+ * ZigBeeInterface::send_template(), paced by a token bucket on a 1 ms
+ * tick and held off while the serial write queue is above its high
+ * water mark.
+ */
+class ZigBeeTrafficGen : public sigc::trackable
+{
+public:
+        /**
+         * Frame kinds in the mix.
+         */
+        typedef enum
+        {
+                TK_Unicast = 0,         ///< Unicast Transmit Request
+                TK_Broadcast = 1,       ///< Broadcast Transmit Request
+                TK_EAUnicast = 2,       ///< Unicast Explicit Addressing Transmit Request
+                TK_EABroadcast = 3,     ///< Broadcast Explicit Addressing Transmit Request
+                TK_Count
+        }
+        TrafficKind;
+        
+        /**
+         * Per destination results.
+         */
+        struct Destination
+        {
+                uint64_t addr64;                ///< 64-bit address
+                uint16_t addr16;                ///< 16-bit address
+                uint64_t sent;                  ///< Frames sent
+                uint64_t delivered;             ///< Status success
+                uint64_t failed;                ///< Status failure
+                uint64_t lost;                  ///< No status
+                LatencyHistogram latency;       ///< Send to status success (microseconds)
+        };
+        
+        /**
+         * Throughput sample.
+         */
+        struct Sample
+        {
+                double sent_rate;               ///< Frames sent per second
+                double delivered_rate;          ///< Frames delivered per second
+                double loss;                    ///< Failed or lost fraction of outcomes, 0 to 1
+        };
+        
+        /**
+         * Create a traffic generator.
+         * @param zb interface to send on
+         */
+        ZigBeeTrafficGen(ZigBeeInterface &zb);
+        virtual ~ZigBeeTrafficGen();
+        
+        /**
+         * Remove all unicast destinations.
+         */
+        void clear_destinations();
+        
+        /**
+         * Add a unicast destination.
+         * @param addr64 64-bit address
+         * @param addr16 16-bit address, 0xFFFE if unknown
+         */
+        void add_destination(uint64_t addr64, uint16_t addr16);
+        
+        /**
+         * Set the weight of a frame kind in the mix.
+         * @param kind frame kind
+         * @param weight relative weight, 0 to leave out
+         */
+        void set_weight(TrafficKind kind, int weight);
+        
+        /**
+         * Get the weight of a frame kind.
+         * @param kind frame kind
+         * @return weight
+         */
+        int get_weight(TrafficKind kind);
+        
+        /**
+         * Set target rate.
+         * @param pps frames per second
+         * @return rate set
+         */
+        double set_rate(double pps);
+        
+        /**
+         * Get target rate.
+         * @return frames per second
+         */
+        double get_rate();
+        
+        /**
+         * Set payload size.
+         * @param n bytes, including the sequence number
+         * @return size set
+         */
+        int set_payload_size(int n);
+        
+        /**
+         * Get payload size.
+         * @return bytes
+         */
+        int get_payload_size();
+        
+        /**
+         * Start sending.  Clears previous results.
+         * @return false if not connected or the mix is empty
+         */
+        bool start();
+        
+        /**
+         * Stop sending.  Outstanding frames are counted as lost.
+         */
+        void stop();
+        
+        /**
+         * Check if running.
+         * @return true if running
+         */
+        bool is_running();
+        
+        /**
+         * Get per destination results.  Entry 0 holds broadcasts.
+         * @return destinations
+         */
+        const std::vector<Destination> &get_destinations();
+        
+        /**
+         * Get throughput history, oldest first.
+         * @return samples
+         */
+        const std::deque<Sample> &get_history();
+        
+        /**
+         * Get a name for a frame kind.
+         * @param kind frame kind
+         * @return name
+         */
+        static std::string get_kind_desc(TrafficKind kind);
+        
+        /**
+         * Sample signal, emitted after each throughput sample.
+         * @par Prototype:
+         * <tt>void on_my_%sample()</tt>
+         */
+        sigc::signal<void> signal_sample();
+        
+protected:
+        /**
+         * Outstanding frame.
+         */
+        struct InFlight
+        {
+                bool active;                    ///< Waiting for status
+                int dest;                       ///< Destination index
+                uint64_t timestamp;             ///< Time sent
+        };
+        
+        /**
+         * Receive packet handler.
+         * @param pkt packet
+         */
+        void on_receive_packet(ZigBeePacket pkt);
+        
+        /**
+         * Send tick handler.
+         * @return true to keep running
+         */
+        bool on_tick();
+        
+        /**
+         * Sample timer handler.
+         * @return true to keep running
+         */
+        bool on_sample();
+        
+        /**
+         * Send one frame from the mix.
+         */
+        void send_next();
+        
+        /**
+         * Count outstanding frames older than the timeout as lost.
+         * @param now current time
+         * @param all count every outstanding frame
+         */
+        void expire(uint64_t now, bool all);
+        
+        /**
+         * Interface used for sending.
+         */
+        ZigBeeInterface &zb_int;
+        
+        /**
+         * Destinations, broadcast first.
+         */
+        std::vector<Destination> dests;
+        
+        /**
+         * Compiled frame per kind.
+         */
+        ZigBeePacketTemplate templates[TK_Count];
+        
+        /**
+         * Mix weights.
+         */
+        int weights[TK_Count];
+        
+        /**
+         * Outstanding frames by frame ID.
+         */
+        InFlight in_flight[256];
+        
+        /**
+         * Throughput history.
+         */
+        std::deque<Sample> history;
+        
+        /**
+         * Target rate.
+         */
+        double rate;
+        
+        /**
+         * Payload size.
+         */
+        int payload_size;
+        
+        /**
+         * Send credit, in frames.
+         */
+        double credit;
+        
+        /**
+         * Next unicast destination.
+         */
+        size_t next_dest;
+        
+        /**
+         * Sequence number.
+         */
+        uint32_t seq;
+        
+        /**
+         * Running indicator.
+         */
+        bool running;
+        
+        /**
+         * Time of the last send tick.
+         */
+        uint64_t tick_timestamp;
+        
+        /**
+         * Time of the last sample.
+         */
+        uint64_t sample_timestamp;
+        
+        /**
+         * Totals at the last sample: sent, delivered, failed and lost.
+         */
+        uint64_t sample_totals[4];
+        
+        /**
+         * Send tick timer connection.
+         */
+        sigc::connection c_tick;
+        
+        /**
+         * Sample timer connection.
+         */
+        sigc::connection c_sample;
+        
+        /**
+         * Sample signal.
+         */
+        sigc::signal<void> m_signal_sample;
+};
+
+#endif //__ZIGBEE_TRAFFIC_GEN_H
+
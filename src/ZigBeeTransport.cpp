@@ -0,0 +1,410 @@
+/************************************************************************/
+/* ZigBeeTransport                                                      */
+/*                                                                      */
+/* ZigBee Terminal - ZigBee Transport                                   */
+/*                                                                      */
+/* ZigBeeTransport.cpp                                                  */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ZigBeeTransport.h"
+
+#include <iostream>
+
+
+ZigBeeTransport::ZigBeeTransport(ZigBeeInterface &zb) :
+        zb_int(zb),
+        max_payload(ZIGBEE_TRANSPORT_DEFAULT_PAYLOAD),
+        window(ZIGBEE_TRANSPORT_DEFAULT_WINDOW),
+        next_msg_id(0),
+        write_blocked(false)
+{
+        zb_int.signal_receive_packet().connect( sigc::mem_fun(*this, &ZigBeeTransport::on_receive_packet) );
+        zb_int.signal_write_high_water().connect( sigc::mem_fun(*this, &ZigBeeTransport::on_write_high_water) );
+        
+        c_timeout = Glib::signal_timeout().connect( sigc::mem_fun(*this, &ZigBeeTransport::on_timeout), ZIGBEE_TRANSPORT_POLL_MS );
+}
+
+
+ZigBeeTransport::~ZigBeeTransport()
+{
+        c_timeout.disconnect();
+}
+
+
+int ZigBeeTransport::send(uint64_t dest64, uint16_t dest16, const std::vector<uint8_t> &msg)
+{
+        int frag_size = max_payload - ZIGBEE_TRANSPORT_HEADER_LENGTH;
+        int count = (msg.size() + frag_size - 1) / frag_size;
+        
+        if (count == 0)
+                count = 1;
+        
+        if (count > 0xffff)
+        {
+                std::cerr << "[ZigBeeTransport] Message too large (" << msg.size() << " bytes)" << std::endl;
+                return -1;
+        }
+        
+        out_queue.push_back(OutMessage());
+        
+        OutMessage &m = out_queue.back();
+        m.id = next_msg_id++;
+        m.dest64 = dest64;
+        m.dest16 = dest16;
+        m.data = msg;
+        m.count = count;
+        m.next = 0;
+        m.acked = 0;
+        m.retries.assign(count, 0);
+        m.start_timestamp = 0;
+        
+        if (out_queue.size() == 1)
+                pump();
+        
+        return m.id;
+}
+
+
+void ZigBeeTransport::cancel()
+{
+        pending.clear();
+        
+        while (out_queue.size() > 0)
+        {
+                OutMessage m = out_queue.front();
+                out_queue.pop_front();
+                m_signal_send_complete.emit(m.id, false, m.data.size(), 0);
+        }
+}
+
+
+int ZigBeeTransport::set_max_payload(int n)
+{
+        if (n > ZIGBEE_TRANSPORT_HEADER_LENGTH)
+                max_payload = n;
+        
+        return max_payload;
+}
+
+
+int ZigBeeTransport::get_max_payload()
+{
+        return max_payload;
+}
+
+
+int ZigBeeTransport::set_window(int n)
+{
+        if (n > 0 && n < 255)
+                window = n;
+        
+        pump();
+        
+        return window;
+}
+
+
+int ZigBeeTransport::get_window()
+{
+        return window;
+}
+
+
+int ZigBeeTransport::get_queue_length()
+{
+        return out_queue.size();
+}
+
+
+sigc::signal<void, uint64_t, uint16_t, std::vector<uint8_t> > ZigBeeTransport::signal_receive_message()
+{
+        return m_signal_receive_message;
+}
+
+
+sigc::signal<void, int, bool, size_t, uint64_t> ZigBeeTransport::signal_send_complete()
+{
+        return m_signal_send_complete;
+}
+
+
+void ZigBeeTransport::on_receive_packet(ZigBeePacket pkt)
+{
+        if (pkt.identifier == ZigBeePacket::ZBPID_RxPacket)
+                handle_fragment(pkt);
+        else if (pkt.identifier == ZigBeePacket::ZBPID_TxStatusS2)
+                handle_tx_status(pkt);
+}
+
+
+void ZigBeeTransport::on_write_high_water(bool blocked)
+{
+        write_blocked = blocked;
+        
+        if (!write_blocked)
+                pump();
+}
+
+
+bool ZigBeeTransport::on_timeout()
+{
+        uint64_t now = SerialInterface::get_timestamp();
+        std::map<uint8_t, PendingFragment>::iterator pit;
+        std::map<std::pair<uint64_t, uint8_t>, InMessage>::iterator iit;
+        std::map<std::pair<uint64_t, uint8_t>, uint64_t>::iterator cit;
+        std::vector<int> lost;
+        
+        // fragments whose transmit status never arrived
+        for (pit = pending.begin(); pit != pending.end(); )
+        {
+                if (now - pit->second.timestamp > ZIGBEE_TRANSPORT_TX_TIMEOUT_MS * 1000ULL)
+                {
+                        lost.push_back(pit->second.index);
+                        pending.erase(pit++);
+                }
+                else
+                {
+                        ++pit;
+                }
+        }
+        
+        for (size_t i = 0; i < lost.size() && out_queue.size() > 0; i++)
+        {
+                OutMessage &m = out_queue.front();
+                
+                if (++m.retries[lost[i]] > ZIGBEE_TRANSPORT_RETRIES)
+                {
+                        std::cerr << "[ZigBeeTransport] No status for fragment " << lost[i] << " of message " << m.id << std::endl;
+                        complete(false);
+                        break;
+                }
+                
+                send_fragment(lost[i]);
+        }
+        
+        // abandoned partial messages
+        for (iit = in_messages.begin(); iit != in_messages.end(); )
+        {
+                if (now - iit->second.timestamp > ZIGBEE_TRANSPORT_RX_TIMEOUT_MS * 1000ULL)
+                        in_messages.erase(iit++);
+                else
+                        ++iit;
+        }
+        
+        for (cit = completed.begin(); cit != completed.end(); )
+        {
+                if (now - cit->second > ZIGBEE_TRANSPORT_RX_TIMEOUT_MS * 1000ULL)
+                        completed.erase(cit++);
+                else
+                        ++cit;
+        }
+        
+        return true;
+}
+
+
+void ZigBeeTransport::handle_fragment(ZigBeePacket &pkt)
+{
+        std::vector<uint8_t> &d = pkt.data;
+        uint8_t msg_id;
+        int index, count;
+        
+        if (d.size() < ZIGBEE_TRANSPORT_HEADER_LENGTH || d[0] != ZIGBEE_TRANSPORT_MAGIC)
+                return;
+        
+        msg_id = d[1];
+        index = ((int)d[2] << 8) | d[3];
+        count = ((int)d[4] << 8) | d[5];
+        
+        if (count == 0 || index >= count)
+                return;
+        
+        std::pair<uint64_t, uint8_t> key(pkt.src64, msg_id);
+        
+        // a retry of a fragment of a message already delivered
+        if (completed.count(key))
+                return;
+        
+        // the sender sends one message at a time, so once it moves on
+        // no more retries of its earlier messages can arrive
+        completed.erase(completed.lower_bound(std::make_pair(pkt.src64, (uint8_t)0)),
+                completed.upper_bound(std::make_pair(pkt.src64, (uint8_t)0xff)));
+        
+        InMessage &m = in_messages[key];
+        
+        // new message, or sender reused the ID for a different one
+        if (m.count != count)
+        {
+                m.count = count;
+                m.received = 0;
+                m.fragments.clear();
+                m.fragments.resize(count);
+                m.have.assign(count, false);
+        }
+        
+        m.src16 = pkt.src16;
+        m.timestamp = SerialInterface::get_timestamp();
+        
+        // duplicates happen when a transmit status is lost and the
+        // sender retries a fragment that did arrive
+        if (m.have[index])
+                return;
+        
+        m.fragments[index].assign(d.begin() + ZIGBEE_TRANSPORT_HEADER_LENGTH, d.end());
+        m.have[index] = true;
+        
+        if (++m.received < m.count)
+                return;
+        
+        std::vector<uint8_t> msg;
+        uint16_t src16 = m.src16;
+        size_t len = 0;
+        
+        for (int i = 0; i < m.count; i++)
+                len += m.fragments[i].size();
+        
+        msg.reserve(len);
+        
+        for (int i = 0; i < m.count; i++)
+                msg.insert(msg.end(), m.fragments[i].begin(), m.fragments[i].end());
+        
+        in_messages.erase(key);
+        completed[key] = SerialInterface::get_timestamp();
+        
+        m_signal_receive_message.emit(pkt.src64, src16, msg);
+}
+
+
+void ZigBeeTransport::handle_tx_status(ZigBeePacket &pkt)
+{
+        std::map<uint8_t, PendingFragment>::iterator it = pending.find(pkt.frame_id);
+        int index;
+        
+        if (it == pending.end() || out_queue.size() == 0)
+                return;
+        
+        index = it->second.index;
+        pending.erase(it);
+        
+        OutMessage &m = out_queue.front();
+        
+        if (pkt.delivery_status == 0)
+        {
+                if (++m.acked == m.count)
+                {
+                        complete(true);
+                        return;
+                }
+        }
+        else if (++m.retries[index] > ZIGBEE_TRANSPORT_RETRIES)
+        {
+                std::cerr << "[ZigBeeTransport] Fragment " << index << " of message " << m.id
+                        << " failed (status 0x" << std::hex << (int)pkt.delivery_status << std::dec << ")" << std::endl;
+                complete(false);
+                return;
+        }
+        else
+        {
+                send_fragment(index);
+        }
+        
+        pump();
+}
+
+
+void ZigBeeTransport::pump()
+{
+        while (out_queue.size() > 0 && !write_blocked && zb_int.is_connected())
+        {
+                OutMessage &m = out_queue.front();
+                
+                if (m.next >= m.count || (int)pending.size() >= window)
+                        break;
+                
+                if (m.next == 0)
+                        m.start_timestamp = SerialInterface::get_timestamp();
+                
+                send_fragment(m.next++);
+        }
+}
+
+
+void ZigBeeTransport::send_fragment(int index)
+{
+        OutMessage &m = out_queue.front();
+        int frag_size = max_payload - ZIGBEE_TRANSPORT_HEADER_LENGTH;
+        size_t start = (size_t)index * frag_size;
+        size_t end = start + frag_size;
+        ZigBeePacket pkt;
+        PendingFragment p;
+        
+        if (end > m.data.size())
+                end = m.data.size();
+        
+        pkt.identifier = ZigBeePacket::ZBPID_TxRequest;
+        pkt.frame_id = zb_int.get_next_frame_id();
+        pkt.dest64 = m.dest64;
+        pkt.dest16 = m.dest16;
+        pkt.radius = 0;
+        pkt.options = 0;
+        
+        pkt.data.reserve(ZIGBEE_TRANSPORT_HEADER_LENGTH + end - start);
+        pkt.data.push_back(ZIGBEE_TRANSPORT_MAGIC);
+        pkt.data.push_back(m.id);
+        pkt.data.push_back(index >> 8);
+        pkt.data.push_back(index);
+        pkt.data.push_back(m.count >> 8);
+        pkt.data.push_back(m.count);
+        pkt.data.insert(pkt.data.end(), m.data.begin() + start, m.data.begin() + end);
+        
+        pkt.build_packet();
+        
+        p.index = index;
+        p.timestamp = SerialInterface::get_timestamp();
+        pending[pkt.frame_id] = p;
+        
+        zb_int.send_packet(pkt);
+}
+
+
+void ZigBeeTransport::complete(bool success)
+{
+        OutMessage m = out_queue.front();
+        uint64_t elapsed = 0;
+        
+        out_queue.pop_front();
+        pending.clear();
+        
+        if (m.start_timestamp)
+                elapsed = SerialInterface::get_timestamp() - m.start_timestamp;
+        
+        m_signal_send_complete.emit(m.id, success, m.data.size(), elapsed);
+        
+        pump();
+}
+
@@ -0,0 +1,292 @@
+/************************************************************************/
+/* ZigBeeTransport                                                      */
+/*                                                                      */
+/* ZigBee Terminal - ZigBee Transport                                   */
+/*                                                                      */
+/* ZigBeeTransport.h                                                    */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __ZIGBEE_TRANSPORT_H
+#define __ZIGBEE_TRANSPORT_H
+
+#include <gtkmm.h>
+
+#include "ZigBeeInterface.h"
+#include "ZigBeePacket.h"
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <inttypes.h>
+
+#define ZIGBEE_TRANSPORT_MAGIC 0xFB
+#define ZIGBEE_TRANSPORT_HEADER_LENGTH 6
+#define ZIGBEE_TRANSPORT_DEFAULT_PAYLOAD 84
+#define ZIGBEE_TRANSPORT_DEFAULT_WINDOW 4
+#define ZIGBEE_TRANSPORT_RETRIES 3
+#define ZIGBEE_TRANSPORT_TX_TIMEOUT_MS 5000
+#define ZIGBEE_TRANSPORT_RX_TIMEOUT_MS 30000
+#define ZIGBEE_TRANSPORT_POLL_MS 500
+
+/** ZigBee Transport
+ * 
+ * Sends messages larger than one RF payload by splitting them into
+ * fragments carried in Transmit Request (0x10) frames and reassembles
+ * fragments arriving in Receive Packet (0x90) frames.  Each fragment
+ * starts with a six byte header:
+ * 
+ * <tt>magic (0xFB) | message ID | index (16 bit) | count (16 bit)</tt>
+ * 
+ * Up to window fragments are outstanding at once; each Transmit Status
+ * acknowledges one and lets the next one go.  Fragments that fail or
+ * get no status are retried.  Outgoing messages are sent one at a time
+ * in the order submitted.
+ */
+class ZigBeeTransport : public sigc::trackable
+{
+public:
+        /**
+         * Create a ZigBee Transport.
+         * @param zb interface to send and receive on
+         */
+        ZigBeeTransport(ZigBeeInterface &zb);
+        virtual ~ZigBeeTransport();
+        
+        /**
+         * Queue a message for transmission.
+         * @param dest64 destination 64-bit address
+         * @param dest16 destination 16-bit address, 0xFFFE if unknown
+         * @param msg message data
+         * @return message ID, or -1 if the message is too large
+         * @see signal_send_complete()
+         */
+        int send(uint64_t dest64, uint16_t dest16, const std::vector<uint8_t> &msg);
+        
+        /**
+         * Abort all queued and partly sent messages.
+         */
+        void cancel();
+        
+        /**
+         * Set maximum RF payload (the module's NP value).  Each fragment
+         * carries this less the fragment header.
+         * @param n bytes
+         * @return bytes
+         */
+        int set_max_payload(int n);
+        
+        /**
+         * Get maximum RF payload.
+         * @return bytes
+         */
+        int get_max_payload();
+        
+        /**
+         * Set transmit window.
+         * @param n fragments outstanding before waiting for status
+         * @return fragments
+         */
+        int set_window(int n);
+        
+        /**
+         * Get transmit window.
+         * @return fragments
+         */
+        int get_window();
+        
+        /**
+         * Get number of messages waiting to be sent, including the one
+         * in progress.
+         * @return messages
+         */
+        int get_queue_length();
+        
+        /**
+         * Receive message signal.  
+         * @par Prototype:
+         * <tt>void on_my_%receive_message(uint64_t src64, uint16_t src16, std::vector<uint8_t> msg)</tt>
+         */
+        sigc::signal<void, uint64_t, uint16_t, std::vector<uint8_t> > signal_receive_message();
+        
+        /**
+         * Send complete signal.  
+         * @par Prototype:
+         * <tt>void on_my_%send_complete(int msg_id, bool success, size_t bytes, uint64_t elapsed_us)</tt>
+         */
+        sigc::signal<void, int, bool, size_t, uint64_t> signal_send_complete();
+        
+protected:
+        /**
+         * Outgoing message.
+         */
+        struct OutMessage
+        {
+                int id;                         ///< Message ID
+                uint64_t dest64;                ///< Destination 64-bit address
+                uint16_t dest16;                ///< Destination 16-bit address
+                std::vector<uint8_t> data;      ///< Message data
+                int count;                      ///< Fragment count
+                int next;                       ///< Next fragment to send
+                int acked;                      ///< Fragments delivered
+                std::vector<int> retries;       ///< Retries per fragment
+                uint64_t start_timestamp;       ///< Time first fragment was sent
+        };
+        
+        /**
+         * Fragment waiting for transmit status.
+         */
+        struct PendingFragment
+        {
+                int index;                      ///< Fragment index
+                uint64_t timestamp;             ///< Time sent
+        };
+        
+        /**
+         * Incoming message being reassembled.
+         */
+        struct InMessage
+        {
+                uint16_t src16;                 ///< Source 16-bit address
+                int count;                      ///< Fragment count
+                int received;                   ///< Fragments received
+                std::vector< std::vector<uint8_t> > fragments;  ///< Fragment data
+                std::vector<bool> have;         ///< Fragments present
+                uint64_t timestamp;             ///< Time last fragment arrived
+        };
+        
+        /**
+         * Receive packet handler.
+         * @param pkt packet
+         */
+        void on_receive_packet(ZigBeePacket pkt);
+        
+        /**
+         * Write high water handler.
+         * @param blocked true if blocked
+         */
+        void on_write_high_water(bool blocked);
+        
+        /**
+         * Retry and expiry timer handler.
+         * @return true to keep running
+         */
+        bool on_timeout();
+        
+        /**
+         * Handle a fragment arriving.
+         * @param pkt receive packet
+         */
+        void handle_fragment(ZigBeePacket &pkt);
+        
+        /**
+         * Handle transmit status for an outstanding fragment.
+         * @param pkt transmit status packet
+         */
+        void handle_tx_status(ZigBeePacket &pkt);
+        
+        /**
+         * Send fragments until the window is full.
+         */
+        void pump();
+        
+        /**
+         * Send one fragment of the current message.
+         * @param index fragment index
+         */
+        void send_fragment(int index);
+        
+        /**
+         * Finish the current message and start the next.
+         * @param success true if all fragments were delivered
+         */
+        void complete(bool success);
+        
+        /**
+         * Interface used for transfers.
+         */
+        ZigBeeInterface &zb_int;
+        
+        /**
+         * Outgoing message queue; the front message is in progress.
+         */
+        std::deque<OutMessage> out_queue;
+        
+        /**
+         * Outstanding fragments of the current message by frame ID.
+         */
+        std::map<uint8_t, PendingFragment> pending;
+        
+        /**
+         * Reassembly buffers by source address and message ID.
+         */
+        std::map<std::pair<uint64_t, uint8_t>, InMessage> in_messages;
+        
+        /**
+         * Completion times of recently reassembled messages by source
+         * address and message ID, so late retried fragments are dropped.
+         */
+        std::map<std::pair<uint64_t, uint8_t>, uint64_t> completed;
+        
+        /**
+         * Maximum RF payload.
+         */
+        int max_payload;
+        
+        /**
+         * Transmit window.
+         */
+        int window;
+        
+        /**
+         * Next message ID.
+         */
+        uint8_t next_msg_id;
+        
+        /**
+         * Serial write queue is above its high water mark.
+         */
+        bool write_blocked;
+        
+        /**
+         * Timer connection.
+         */
+        sigc::connection c_timeout;
+        
+        /**
+         * Receive message signal.
+         */
+        sigc::signal<void, uint64_t, uint16_t, std::vector<uint8_t> > m_signal_receive_message;
+        
+        /**
+         * Send complete signal.
+         */
+        sigc::signal<void, int, bool, size_t, uint64_t> m_signal_send_complete;
+};
+
+#endif //__ZIGBEE_TRANSPORT_H
+
@@ -0,0 +1,575 @@
+/************************************************************************/
+/* zigbee_bench                                                         */
+/*                                                                      */
+/* ZigBee Terminal - Codec Benchmark                                    */
+/*                                                                      */
+/* zigbee_bench.cpp                                                     */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ZigBeePacket.h"
+#include "ZigBeeIOSamples.h"
+#include "ZigBeePacketTemplate.h"
+#include "ZigBeeFrame.h"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <deque>
+#include <cstdlib>
+#include <new>
+#include <inttypes.h>
+#include <time.h>
+
+/*
+ * Microbenchmark for the ZigBeePacket codec paths.  Each operation is run
+ * over a set of representative frames and reported in ns/frame and heap
+ * allocations/frame.  Allocations are counted by replacing the global
+ * operator new.
+ * 
+ * Usage: zigbee-bench [iterations]
+ */
+
+static volatile uint64_t alloc_count = 0;
+
+void *operator new(size_t size)
+{
+        void *p;
+        
+        alloc_count++;
+        
+        p = malloc(size ? size : 1);
+        
+        if (!p)
+                throw std::bad_alloc();
+        
+        return p;
+}
+
+void *operator new[](size_t size)
+{
+        return operator new(size);
+}
+
+// GCC pairs the malloc() inside operator new with the free() inlined
+// from operator delete into std::allocator and reports a mismatch, but
+// both replacements use the C heap so they do match.
+#if __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void *p)
+{
+        free(p);
+}
+
+void operator delete[](void *p)
+{
+        free(p);
+}
+
+#if __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+static uint64_t get_time_ns()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// keeps results live so the compiler cannot drop the work
+static volatile uint64_t sink = 0;
+
+/**
+ * Benchmark frame set.
+ */
+struct FrameSet
+{
+        std::string name;                       ///< Frame set name
+        std::vector<ZigBeePacket> packets;      ///< Built packets
+        std::vector<uint8_t> stream;            ///< Concatenated raw frames
+};
+
+/**
+ * IO data sample, one digital and one analog channel.
+ */
+static ZigBeePacket make_io_sample()
+{
+        ZigBeePacket pkt;
+        
+        pkt.identifier = ZigBeePacket::ZBPID_IODataSampleRx;
+        pkt.src64 = 0x0013a20040522baaULL;
+        pkt.src16 = 0x7d84;
+        pkt.options = 0x01;
+        pkt.num_samples = 1;
+        pkt.digital_mask = 0x001c;
+        pkt.analog_mask = 0x02;
+        pkt.data.push_back(0x00);
+        pkt.data.push_back(0x14);
+        pkt.data.push_back(0x02);
+        pkt.data.push_back(0x25);
+        pkt.build_packet();
+        
+        return pkt;
+}
+
+/**
+ * Receive packet with a full 84 byte RF payload.
+ */
+static ZigBeePacket make_rf_payload()
+{
+        ZigBeePacket pkt;
+        
+        pkt.identifier = ZigBeePacket::ZBPID_RxPacket;
+        pkt.src64 = 0x0013a20040522baaULL;
+        pkt.src16 = 0x7d84;
+        pkt.options = 0x01;
+        for (int i = 0; i < 84; i++)
+                pkt.data.push_back(i * 7);
+        pkt.build_packet();
+        
+        return pkt;
+}
+
+/**
+ * Route record with four hops.
+ */
+static ZigBeePacket make_route_record()
+{
+        ZigBeePacket pkt;
+        
+        pkt.identifier = ZigBeePacket::ZBPID_RouteRecord;
+        pkt.src64 = 0x0013a20040401122ULL;
+        pkt.src16 = 0x3344;
+        pkt.options = 0x01;
+        pkt.route_records.push_back(0xeeff);
+        pkt.route_records.push_back(0xccdd);
+        pkt.route_records.push_back(0xaabb);
+        pkt.route_records.push_back(0x7e7d);
+        pkt.build_packet();
+        
+        return pkt;
+}
+
+/**
+ * Transmit status.
+ */
+static ZigBeePacket make_tx_status()
+{
+        ZigBeePacket pkt;
+        
+        pkt.identifier = ZigBeePacket::ZBPID_TxStatusS2;
+        pkt.frame_id = 0x47;
+        pkt.dest16 = 0x7d84;
+        pkt.build_packet();
+        
+        return pkt;
+}
+
+/**
+ * Transmit request with a 32 byte payload.
+ */
+static ZigBeePacket make_tx_request()
+{
+        ZigBeePacket pkt;
+        
+        pkt.identifier = ZigBeePacket::ZBPID_TxRequest;
+        pkt.frame_id = 0x01;
+        pkt.dest64 = 0x0013a20040522baaULL;
+        pkt.dest16 = 0xfffe;
+        for (int i = 0; i < 32; i++)
+                pkt.data.push_back(i);
+        pkt.build_packet();
+        
+        return pkt;
+}
+
+static FrameSet make_frame_set(std::string name, std::vector<ZigBeePacket> packets)
+{
+        FrameSet fs;
+        
+        fs.name = name;
+        fs.packets = packets;
+        
+        for (size_t i = 0; i < packets.size(); i++)
+        {
+                std::vector<uint8_t> raw = packets[i].get_raw_packet();
+                fs.stream.insert(fs.stream.end(), raw.begin(), raw.end());
+        }
+        
+        return fs;
+}
+
+static void report(const char *op, FrameSet &fs, uint64_t ns, uint64_t allocs, uint64_t frames)
+{
+        std::cout << std::left << std::setw(24) << op
+                << std::setw(14) << fs.name
+                << std::right << std::fixed << std::setprecision(1)
+                << std::setw(10) << (double)ns / frames << " ns/frame"
+                << std::setprecision(2)
+                << std::setw(10) << (double)allocs / frames << " allocs/frame"
+                << std::endl;
+}
+
+// Timed region helpers
+#define BENCH_BEGIN() \
+        uint64_t a0 = alloc_count; \
+        uint64_t t0 = get_time_ns();
+
+#define BENCH_END(op, fs, frames) \
+        uint64_t t1 = get_time_ns(); \
+        uint64_t a1 = alloc_count; \
+        report(op, fs, t1 - t0, a1 - a0, frames);
+
+static void bench_read_packet_deque(FrameSet &fs, int iterations)
+{
+        std::deque<char> q(fs.stream.begin(), fs.stream.end());
+        ZigBeePacket pkt;
+        uint64_t frames = 0;
+        
+        BENCH_BEGIN();
+        for (int it = 0; it < iterations; it++)
+        {
+                // same pattern as ZigBeeInterface::on_receive_data,
+                // including refilling the receive queue
+                std::deque<char> rq = q;
+                size_t len;
+                do
+                {
+                        len = 0;
+                        if (pkt.read_packet(rq, len))
+                                frames++;
+                        for (size_t i = 0; i < len; i++)
+                                rq.pop_front();
+                }
+                while (rq.size() > 0 && len > 0);
+        }
+        BENCH_END("read_packet(deque)", fs, frames);
+}
+
+static void bench_read_packet_buffer(FrameSet &fs, int iterations)
+{
+        ZigBeePacket pkt;
+        uint64_t frames = 0;
+        
+        BENCH_BEGIN();
+        for (int it = 0; it < iterations; it++)
+        {
+                size_t pos = 0;
+                size_t len;
+                do
+                {
+                        len = 0;
+                        if (pkt.read_packet(&fs.stream[pos], fs.stream.size() - pos, len))
+                                frames++;
+                        pos += len;
+                }
+                while (pos < fs.stream.size() && len > 0);
+        }
+        BENCH_END("read_packet(buffer)", fs, frames);
+}
+
+static void bench_decode_packet(FrameSet &fs, int iterations)
+{
+        std::vector<ZigBeePacket> pkts = fs.packets;
+        uint64_t frames = 0;
+        
+        BENCH_BEGIN();
+        for (int it = 0; it < iterations; it++)
+        {
+                for (size_t i = 0; i < pkts.size(); i++)
+                {
+                        pkts[i].decode_packet();
+                        sink += pkts[i].src16;
+                        frames++;
+                }
+        }
+        BENCH_END("decode_packet", fs, frames);
+}
+
+// Reads the same address field as bench_decode_packet
+struct SrcVisitor : public ZigBeeFrameVisitor
+{
+        using ZigBeeFrameVisitor::visit;
+        
+        void visit(const ZigBeeFrame<ZigBeePacket::ZBPID_RxPacket> &frame) { sink += frame.src16(); }
+        void visit(const ZigBeeFrame<ZigBeePacket::ZBPID_IODataSampleRx> &frame) { sink += frame.src16(); }
+        void visit(const ZigBeeFrame<ZigBeePacket::ZBPID_RouteRecord> &frame) { sink += frame.src16(); }
+        void visit(const ZigBeeFrame<ZigBeePacket::ZBPID_TxStatusS2> &frame) { sink += frame.dest16(); }
+};
+
+static void bench_dispatch_frame(FrameSet &fs, int iterations)
+{
+        std::vector<ZigBeePacket> pkts = fs.packets;
+        SrcVisitor v;
+        uint64_t frames = 0;
+        
+        BENCH_BEGIN();
+        for (int it = 0; it < iterations; it++)
+        {
+                for (size_t i = 0; i < pkts.size(); i++)
+                {
+                        ZigBeeFrameVisitor::dispatch(pkts[i], v);
+                        frames++;
+                }
+        }
+        BENCH_END("dispatch_frame", fs, frames);
+}
+
+static void bench_build_packet(FrameSet &fs, int iterations)
+{
+        std::vector<ZigBeePacket> pkts = fs.packets;
+        uint64_t frames = 0;
+        
+        BENCH_BEGIN();
+        for (int it = 0; it < iterations; it++)
+        {
+                for (size_t i = 0; i < pkts.size(); i++)
+                {
+                        pkts[i].build_packet();
+                        sink += pkts[i].payload.size();
+                        frames++;
+                }
+        }
+        BENCH_END("build_packet", fs, frames);
+}
+
+// per-send changes: new frame ID, destination and first data byte
+static void bench_rebuild_for_send(FrameSet &fs, int iterations)
+{
+        std::vector<ZigBeePacket> pkts = fs.packets;
+        uint64_t frames = 0;
+        
+        BENCH_BEGIN();
+        for (int it = 0; it < iterations; it++)
+        {
+                for (size_t i = 0; i < pkts.size(); i++)
+                {
+                        pkts[i].frame_id = it;
+                        pkts[i].dest64 = it * 3;
+                        if (pkts[i].data.size())
+                                pkts[i].data[0] = it;
+                        pkts[i].build_packet();
+                        sink += pkts[i].get_raw_packet().size();
+                        frames++;
+                }
+        }
+        BENCH_END("rebuild_for_send", fs, frames);
+}
+
+static void bench_template_patch(FrameSet &fs, int iterations)
+{
+        std::vector<ZigBeePacketTemplate> tmpls;
+        uint64_t frames = 0;
+        
+        for (size_t i = 0; i < fs.packets.size(); i++)
+                tmpls.push_back(ZigBeePacketTemplate(fs.packets[i]));
+        
+        BENCH_BEGIN();
+        for (int it = 0; it < iterations; it++)
+        {
+                for (size_t i = 0; i < tmpls.size(); i++)
+                {
+                        tmpls[i].set_frame_id(it);
+                        tmpls[i].set_dest64(it * 3);
+                        tmpls[i].set_data_uint8(0, it);
+                        sink += tmpls[i].get_frame()[tmpls[i].get_frame_size() - 1];
+                        frames++;
+                }
+        }
+        BENCH_END("template_patch", fs, frames);
+}
+
+static void bench_get_raw_packet(FrameSet &fs, int iterations)
+{
+        uint64_t frames = 0;
+        
+        BENCH_BEGIN();
+        for (int it = 0; it < iterations; it++)
+        {
+                for (size_t i = 0; i < fs.packets.size(); i++)
+                {
+                        sink += fs.packets[i].get_raw_packet().size();
+                        frames++;
+                }
+        }
+        BENCH_END("get_raw_packet", fs, frames);
+}
+
+// caller buffer reused across frames, as the transmit path does
+static void bench_serialize(FrameSet &fs, int iterations, bool escaped)
+{
+        std::vector<uint8_t> buf(1024);
+        uint64_t frames = 0;
+        
+        BENCH_BEGIN();
+        for (int it = 0; it < iterations; it++)
+        {
+                for (size_t i = 0; i < fs.packets.size(); i++)
+                {
+                        sink += fs.packets[i].serialize(&buf[0], buf.size(), escaped);
+                        frames++;
+                }
+        }
+        BENCH_END(escaped ? "serialize_escaped" : "serialize", fs, frames);
+}
+
+static void bench_get_escaped_raw_packet(FrameSet &fs, int iterations)
+{
+        uint64_t frames = 0;
+        
+        BENCH_BEGIN();
+        for (int it = 0; it < iterations; it++)
+        {
+                for (size_t i = 0; i < fs.packets.size(); i++)
+                {
+                        sink += fs.packets[i].get_escaped_raw_packet().size();
+                        frames++;
+                }
+        }
+        BENCH_END("get_escaped_raw_packet", fs, frames);
+}
+
+static void bench_get_hex_packet(FrameSet &fs, int iterations)
+{
+        uint64_t frames = 0;
+        
+        BENCH_BEGIN();
+        for (int it = 0; it < iterations; it++)
+        {
+                for (size_t i = 0; i < fs.packets.size(); i++)
+                {
+                        sink += fs.packets[i].get_hex_packet().size();
+                        frames++;
+                }
+        }
+        BENCH_END("get_hex_packet", fs, frames);
+}
+
+static void bench_get_desc(FrameSet &fs, int iterations)
+{
+        uint64_t frames = 0;
+        
+        BENCH_BEGIN();
+        for (int it = 0; it < iterations; it++)
+        {
+                for (size_t i = 0; i < fs.packets.size(); i++)
+                {
+                        sink += fs.packets[i].get_desc().size();
+                        frames++;
+                }
+        }
+        BENCH_END("get_desc", fs, frames);
+}
+
+static void bench_decode_io_samples(FrameSet &fs, int iterations)
+{
+        std::vector<ZigBeePacket> pkts = fs.packets;
+        ZigBeeIOSamples samples;
+        uint64_t frames = 0;
+        
+        for (size_t i = 0; i < pkts.size(); i++)
+                pkts[i].decode_packet();
+        
+        BENCH_BEGIN();
+        for (int it = 0; it < iterations; it++)
+        {
+                for (size_t i = 0; i < pkts.size(); i++)
+                {
+                        sink += samples.decode(pkts[i], it);
+                        frames++;
+                }
+        }
+        BENCH_END("decode_io_samples", fs, frames);
+}
+
+int main(int argc, char *argv[])
+{
+        int iterations = 20000;
+        std::vector<FrameSet> sets;
+        std::vector<ZigBeePacket> pkts;
+        
+        if (argc > 1)
+                iterations = atoi(argv[1]);
+        
+        if (iterations <= 0)
+        {
+                std::cerr << "Usage: " << argv[0] << " [iterations]" << std::endl;
+                return 1;
+        }
+        
+        pkts.assign(8, make_io_sample());
+        sets.push_back(make_frame_set("io_sample", pkts));
+        
+        pkts.assign(8, make_rf_payload());
+        sets.push_back(make_frame_set("rf_84", pkts));
+        
+        pkts.assign(8, make_route_record());
+        sets.push_back(make_frame_set("route_record", pkts));
+        
+        pkts.assign(8, make_tx_request());
+        sets.push_back(make_frame_set("tx_request", pkts));
+        
+        // typical sensor network traffic: mostly samples, some data,
+        // occasional routing and transmit status frames
+        pkts.clear();
+        for (int i = 0; i < 4; i++)
+                pkts.push_back(make_io_sample());
+        pkts.push_back(make_rf_payload());
+        pkts.push_back(make_rf_payload());
+        pkts.push_back(make_route_record());
+        pkts.push_back(make_tx_status());
+        sets.push_back(make_frame_set("mixed", pkts));
+        
+        std::cout << "zigbee-bench: " << iterations << " iterations of " << pkts.size() << " frames per set" << std::endl;
+        
+        for (size_t i = 0; i < sets.size(); i++)
+        {
+                std::cout << std::endl;
+                bench_read_packet_deque(sets[i], iterations);
+                bench_read_packet_buffer(sets[i], iterations);
+                bench_decode_packet(sets[i], iterations);
+                bench_dispatch_frame(sets[i], iterations);
+                bench_build_packet(sets[i], iterations);
+                bench_get_raw_packet(sets[i], iterations);
+                bench_rebuild_for_send(sets[i], iterations);
+                bench_template_patch(sets[i], iterations);
+                bench_get_escaped_raw_packet(sets[i], iterations);
+                bench_serialize(sets[i], iterations, false);
+                bench_serialize(sets[i], iterations, true);
+                bench_get_hex_packet(sets[i], iterations);
+                bench_get_desc(sets[i], iterations);
+                bench_decode_io_samples(sets[i], iterations);
+        }
+        
+        return 0;
+}
+
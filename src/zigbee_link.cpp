@@ -0,0 +1,363 @@
+/************************************************************************/
+/* zigbee_link                                                          */
+/*                                                                      */
+/* ZigBee Terminal - Radio Link Stand-in                                */
+/*                                                                      */
+/* zigbee_link.cpp                                                      */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ZigBeePacket.h"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <deque>
+#include <cstdlib>
+#include <inttypes.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <termios.h>
+#include <errno.h>
+
+/*
+ * Local stand-in for two radios in range of each other, for testing
+ * without hardware.  Creates two pseudo-terminals, each acting as a
+ * radio in API mode 1 (unescaped) with its own addresses.  A Transmit
+ * Request (0x10) or Explicit Addressing Transmit Request (0x11) written
+ * to one side is delivered to the other as a Receive Packet (0x90 or
+ * 0x91) and answered with a Transmit Status (0x8B).  Local AT commands
+ * are answered OK, with SH, SL and MY returning the radio's addresses.
+ * 
+ * Point zigbee-ping at one side and zigbee-ping -e at the other.
+ * 
+ * Usage: zigbee-link [-d delay_us] [-l loss_percent]
+ */
+
+#define LINK_SIDES 2
+#define LINK_ADDR64_BASE 0x0013a20000000000ULL
+#define LINK_STATUS_SUCCESS 0x00
+#define LINK_STATUS_MAC_ACK_FAILURE 0x01
+#define LINK_STATUS_ADDRESS_NOT_FOUND 0x24
+
+/**
+ * Simulated radio.
+ */
+struct Radio
+{
+        int fd;                         ///< Pseudo-terminal master
+        int slave_fd;                   ///< Slave, held open so the master never sees a hangup
+        std::string name;               ///< Slave device name
+        uint64_t addr64;                ///< 64-bit address
+        uint16_t addr16;                ///< 16-bit address
+        std::vector<uint8_t> rx;        ///< Bytes written by the application, not yet framed
+};
+
+/**
+ * Frame on its way to a radio.
+ */
+struct Delivery
+{
+        uint64_t due;                   ///< Time to hand over (microseconds)
+        int side;                       ///< Receiving radio
+        std::vector<uint8_t> frame;     ///< Raw frame
+};
+
+static uint64_t get_time_us()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static bool open_radio(Radio &r, int index)
+{
+        struct termios tio;
+        
+        r.fd = posix_openpt(O_RDWR | O_NOCTTY);
+        
+        if (r.fd < 0 || grantpt(r.fd) != 0 || unlockpt(r.fd) != 0)
+        {
+                std::cerr << "Error (" << errno << ") creating pseudo-terminal" << std::endl;
+                return false;
+        }
+        
+        r.name = ptsname(r.fd);
+        r.slave_fd = open(r.name.c_str(), O_RDWR | O_NOCTTY);
+        
+        // raw, so frame bytes pass through untouched
+        if (r.slave_fd >= 0 && tcgetattr(r.slave_fd, &tio) == 0)
+        {
+                cfmakeraw(&tio);
+                tcsetattr(r.slave_fd, TCSANOW, &tio);
+        }
+        
+        fcntl(r.fd, F_SETFL, O_NONBLOCK);
+        
+        r.addr64 = LINK_ADDR64_BASE | (0xa1 + index * 0x11);
+        r.addr16 = 0x1000 + index;
+        
+        return true;
+}
+
+static void write_frame(Radio &r, ZigBeePacket &pkt)
+{
+        std::vector<uint8_t> raw;
+        size_t pos = 0;
+        
+        pkt.build_packet();
+        raw = pkt.get_raw_packet();
+        
+        while (pos < raw.size())
+        {
+                ssize_t n = write(r.fd, &raw[pos], raw.size() - pos);
+                
+                if (n < 0)
+                {
+                        if (errno == EAGAIN)
+                        {
+                                usleep(1000);
+                                continue;
+                        }
+                        std::cerr << "Error (" << errno << ") writing " << r.name << std::endl;
+                        return;
+                }
+                
+                pos += n;
+        }
+}
+
+static void handle_at_command(Radio &r, ZigBeePacket &pkt)
+{
+        ZigBeePacket resp;
+        
+        if (!pkt.frame_id)
+                return;
+        
+        resp.identifier = ZigBeePacket::ZBPID_ATCommandResponse;
+        resp.frame_id = pkt.frame_id;
+        resp.at_cmd[0] = pkt.at_cmd[0];
+        resp.at_cmd[1] = pkt.at_cmd[1];
+        resp.status = 0;
+        
+        std::string cmd((const char *)pkt.at_cmd, 2);
+        
+        if (cmd == "SH" || cmd == "SL")
+        {
+                uint32_t v = cmd == "SH" ? r.addr64 >> 32 : r.addr64;
+                for (int i = 3; i >= 0; i--)
+                        resp.data.push_back(v >> (i * 8));
+        }
+        else if (cmd == "MY")
+        {
+                resp.data.push_back(r.addr16 >> 8);
+                resp.data.push_back(r.addr16);
+        }
+        
+        write_frame(r, resp);
+}
+
+static void handle_transmit(Radio *radios, int side, ZigBeePacket &pkt, std::deque<Delivery> &air, uint64_t delay, int loss)
+{
+        Radio &src = radios[side];
+        Radio &dst = radios[1 - side];
+        bool broadcast = pkt.dest64 == 0xffffULL;
+        uint8_t status = LINK_STATUS_SUCCESS;
+        
+        if (!broadcast && pkt.dest64 != dst.addr64)
+                status = LINK_STATUS_ADDRESS_NOT_FOUND;
+        else if (loss && rand() % 100 < loss)
+                status = LINK_STATUS_MAC_ACK_FAILURE;
+        
+        if (status == LINK_STATUS_SUCCESS || (broadcast && status == LINK_STATUS_MAC_ACK_FAILURE))
+        {
+                ZigBeePacket rx;
+                Delivery d;
+                
+                rx.identifier = pkt.identifier == ZigBeePacket::ZBPID_EATxRequest ?
+                        ZigBeePacket::ZBPID_EARxPacket : ZigBeePacket::ZBPID_RxPacket;
+                rx.src64 = src.addr64;
+                rx.src16 = src.addr16;
+                rx.src_ep = pkt.src_ep;
+                rx.dest_ep = pkt.dest_ep;
+                rx.cluster_id = pkt.cluster_id;
+                rx.profile_id = pkt.profile_id;
+                rx.options = broadcast ? 0x02 : 0x01;
+                rx.data = pkt.data;
+                rx.build_packet();
+                
+                // broadcasts are not acknowledged, a lost one just vanishes
+                if (status == LINK_STATUS_SUCCESS)
+                {
+                        d.due = get_time_us() + delay;
+                        d.side = 1 - side;
+                        d.frame = rx.get_raw_packet();
+                        air.push_back(d);
+                }
+                
+                status = LINK_STATUS_SUCCESS;
+        }
+        
+        if (pkt.frame_id)
+        {
+                ZigBeePacket ts;
+                Delivery d;
+                
+                ts.identifier = ZigBeePacket::ZBPID_TxStatusS2;
+                ts.frame_id = pkt.frame_id;
+                ts.dest16 = broadcast ? 0xfffe : dst.addr16;
+                ts.transmit_retries = 0;
+                ts.delivery_status = status;
+                ts.discovery_status = 0;
+                ts.build_packet();
+                
+                // the status follows the delivery's air time
+                d.due = get_time_us() + delay;
+                d.side = side;
+                d.frame = ts.get_raw_packet();
+                air.push_back(d);
+        }
+}
+
+int main(int argc, char *argv[])
+{
+        Radio radios[LINK_SIDES];
+        std::deque<Delivery> air;
+        uint64_t delay = 0;
+        int loss = 0;
+        int c;
+        
+        while ((c = getopt(argc, argv, "d:l:")) != -1)
+        {
+                switch (c)
+                {
+                        case 'd': delay = strtoull(optarg, 0, 10); break;
+                        case 'l': loss = atoi(optarg); break;
+                        default:
+                                std::cerr << "Usage: " << argv[0] << " [-d delay_us] [-l loss_percent]" << std::endl;
+                                return 1;
+                }
+        }
+        
+        for (int i = 0; i < LINK_SIDES; i++)
+        {
+                if (!open_radio(radios[i], i))
+                        return 1;
+                
+                std::cout << "radio " << (char)('A' + i) << ": " << radios[i].name << " "
+                        << std::hex << std::setfill('0') << std::setw(16) << radios[i].addr64 << ","
+                        << std::setw(4) << radios[i].addr16 << std::dec << std::endl;
+        }
+        
+        while (true)
+        {
+                struct pollfd fds[LINK_SIDES];
+                int timeout = -1;
+                uint64_t now = get_time_us();
+                
+                // hand over frames whose air time is up, in order
+                while (!air.empty() && air.front().due <= now)
+                {
+                        Delivery &d = air.front();
+                        ssize_t n = write(radios[d.side].fd, &d.frame[0], d.frame.size());
+                        if (n != (ssize_t)d.frame.size())
+                                std::cerr << "Short write to " << radios[d.side].name << std::endl;
+                        air.pop_front();
+                }
+                
+                if (!air.empty())
+                        timeout = (air.front().due - now) / 1000 + 1;
+                
+                for (int i = 0; i < LINK_SIDES; i++)
+                {
+                        fds[i].fd = radios[i].fd;
+                        fds[i].events = POLLIN;
+                        fds[i].revents = 0;
+                }
+                
+                if (poll(fds, LINK_SIDES, timeout) < 0 && errno != EINTR)
+                {
+                        std::cerr << "Error (" << errno << ") in poll" << std::endl;
+                        return 1;
+                }
+                
+                for (int i = 0; i < LINK_SIDES; i++)
+                {
+                        Radio &r = radios[i];
+                        uint8_t buf[1024];
+                        ssize_t n;
+                        
+                        if (!(fds[i].revents & POLLIN))
+                                continue;
+                        
+                        n = read(r.fd, buf, sizeof(buf));
+                        if (n <= 0)
+                                continue;
+                        
+                        r.rx.insert(r.rx.end(), buf, buf + n);
+                        
+                        while (r.rx.size() > 0)
+                        {
+                                ZigBeePacket pkt;
+                                size_t start = 0;
+                                size_t len;
+                                
+                                // drop junk ahead of the start delimiter
+                                while (start < r.rx.size() && r.rx[start] != ZIGBEE_IDENTIFIER)
+                                        start++;
+                                r.rx.erase(r.rx.begin(), r.rx.begin() + start);
+                                
+                                if (r.rx.size() < 3)
+                                        break;
+                                
+                                // delimiter, length, frame data and checksum
+                                len = ((r.rx[1] << 8) | r.rx[2]) + 4;
+                                if (r.rx.size() < len)
+                                        break;
+                                
+                                bool ok = pkt.read_packet(&r.rx[0], len, start) && pkt.decode_packet();
+                                
+                                r.rx.erase(r.rx.begin(), r.rx.begin() + len);
+                                
+                                if (!ok)
+                                        continue;
+                                
+                                if (pkt.identifier == ZigBeePacket::ZBPID_ATCommand)
+                                        handle_at_command(r, pkt);
+                                else if (pkt.identifier == ZigBeePacket::ZBPID_TxRequest ||
+                                        pkt.identifier == ZigBeePacket::ZBPID_EATxRequest)
+                                        handle_transmit(radios, i, pkt, air, delay, loss);
+                        }
+                }
+        }
+        
+        return 0;
+}
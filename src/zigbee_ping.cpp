@@ -0,0 +1,894 @@
+/************************************************************************/
+/* zigbee_ping                                                          */
+/*                                                                      */
+/* ZigBee Terminal - Ping-Pong Test                                     */
+/*                                                                      */
+/* zigbee_ping.cpp                                                      */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "SerialInterface.h"
+#include "ZigBeePacket.h"
+#include "ZigBeePacketTemplate.h"
+#include "ZigBeeInterface.h"
+#include "ZigBeeTransport.h"
+#include "ZigBeeStats.h"
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cctype>
+#include <inttypes.h>
+#include <unistd.h>
+
+/*
+ * Radio to radio round trip latency and one-way throughput test.  One
+ * end runs zigbee-ping against the local radio and the address of the
+ * far radio; the far end is either a second radio running zigbee-ping -e
+ * or a node that echoes received data back to its sender.
+ * 
+ * For each payload size the pinger sends sequence-numbered pings one at
+ * a time and times each round trip, then streams a burst of frames
+ * with a window of unacknowledged transmits and asks the echo end how
+ * many bytes arrived over how long.  Round trip times are reported as a
+ * percentile table.  A plain echo node answers pings but not the
+ * throughput report, in which case only the sender's rate is shown.
+ * 
+ * Payloads start with a type byte and a 32-bit sequence number:
+ *   P  ping, echoed as p (a plain echo node returns it unchanged)
+ *   T  throughput frame, counted by the echo end; sequence 0 restarts
+ *   E  end of burst, answered with e, frames(4), bytes(4), elapsed us(4)
+ * 
+ * With -x the pinger instead sends messages of the given sizes through
+ * ZigBeeTransport, which splits them into fragments, and reports the
+ * time from the first fragment to the last transmit status.  The echo
+ * end reassembles them and checks the contents.
+ * 
+ * zigbee-link provides two linked pseudo-terminals for testing without
+ * radios.
+ * 
+ * Usage: zigbee-ping [options] port dest64[,dest16]
+ *        zigbee-ping -x sizes [options] port dest64[,dest16]
+ *        zigbee-ping -e [options] port
+ */
+
+#define PING_HEADER_LEN 5
+#define PING_MAX_PAYLOAD 84
+#define PING_POLL_MS 10
+#define PING_DEFAULT_TIMEOUT_MS 2000
+#define PING_DEFAULT_COUNT 100
+#define PING_DEFAULT_BURST 200
+#define PING_DEFAULT_WINDOW 4
+#define PING_DEFAULT_TRANSFERS 3
+#define PING_MAX_TRANSFER 1048576
+
+static void usage(const char *name)
+{
+        std::cerr << "Usage: " << name << " [options] port dest64[,dest16]" << std::endl
+                << "       " << name << " -e [options] port" << std::endl
+                << "  -e          echo mode" << std::endl
+                << "  -b baud     baud rate (default 115200)" << std::endl
+                << "  -H          hardware flow control" << std::endl
+                << "  -s sizes    payload sizes, comma separated (default 8,32,64,84)" << std::endl
+                << "  -n count    pings per size (default 100)" << std::endl
+                << "  -t count    throughput frames per size, 0 to skip (default 200)" << std::endl
+                << "  -w window   unacknowledged throughput frames (default 4)" << std::endl
+                << "  -T ms       ping and report timeout (default 2000)" << std::endl
+                << "  -x sizes    fragmented transfer sizes in bytes, comma separated" << std::endl
+                << "  -r count    transfers per size (default 3)" << std::endl;
+}
+
+static void put_uint32(uint8_t *p, uint32_t v)
+{
+        p[0] = v >> 24;
+        p[1] = v >> 16;
+        p[2] = v >> 8;
+        p[3] = v;
+}
+
+static uint32_t get_uint32(const uint8_t *p)
+{
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// Transfer contents, checked by the echo end
+static uint8_t transfer_pattern(size_t i)
+{
+        return (uint8_t)(i * 7 + (i >> 8));
+}
+
+static uint64_t get_rx_timestamp(ZigBeePacket &pkt)
+{
+        // time the bytes came off the port, if the interface recorded it
+        return pkt.read_timestamp ? pkt.read_timestamp : SerialInterface::get_timestamp();
+}
+
+/** Echo end
+ * 
+ * Returns pings to their sender and counts throughput frames.
+ */
+class Echo : public sigc::trackable
+{
+public:
+        Echo(ZigBeeInterface &zb) :
+                frames(0),
+                bytes(0),
+                first_timestamp(0),
+                last_timestamp(0),
+                zb_int(zb),
+                transport(zb)
+        {
+                zb_int.signal_receive_packet().connect( sigc::mem_fun(*this, &Echo::on_receive_packet) );
+                transport.signal_receive_message().connect( sigc::mem_fun(*this, &Echo::on_receive_message) );
+        }
+        
+protected:
+        /**
+         * Reassembled transfer handler.
+         * @param src64 sender 64-bit address
+         * @param src16 sender 16-bit address
+         * @param msg message
+         */
+        void on_receive_message(uint64_t src64, uint16_t src16, std::vector<uint8_t> msg)
+        {
+                size_t bad = 0;
+                
+                for (size_t i = 0; i < msg.size(); i++)
+                        if (msg[i] != transfer_pattern(i))
+                                bad++;
+                
+                std::cout << "transfer: " << msg.size() << " bytes, "
+                        << (bad ? "corrupt" : "ok") << std::endl;
+        }
+        
+        /**
+         * Receive packet handler.
+         * @param pkt packet
+         */
+        void on_receive_packet(ZigBeePacket pkt)
+        {
+                uint64_t now = get_rx_timestamp(pkt);
+                
+                if (pkt.identifier != ZigBeePacket::ZBPID_RxPacket || pkt.data.size() < PING_HEADER_LEN)
+                        return;
+                
+                switch (pkt.data[0])
+                {
+                        case 'P':
+                                pkt.data[0] = 'p';
+                                reply(pkt, pkt.data);
+                                break;
+                        case 'T':
+                                if (get_uint32(&pkt.data[1]) == 0 || frames == 0)
+                                {
+                                        frames = 0;
+                                        bytes = 0;
+                                        first_timestamp = now;
+                                }
+                                frames++;
+                                bytes += pkt.data.size();
+                                last_timestamp = now;
+                                break;
+                        case 'E':
+                        {
+                                std::vector<uint8_t> data(13, 0);
+                                data[0] = 'e';
+                                put_uint32(&data[1], frames);
+                                put_uint32(&data[5], bytes);
+                                put_uint32(&data[9], last_timestamp - first_timestamp);
+                                reply(pkt, data);
+                                std::cout << "burst: " << frames << " frames, " << bytes << " bytes" << std::endl;
+                                frames = 0;
+                                break;
+                        }
+                }
+        }
+        
+        /**
+         * Send data back to the sender of a packet.
+         * @param pkt received packet
+         * @param data data
+         */
+        void reply(ZigBeePacket &pkt, std::vector<uint8_t> &data)
+        {
+                ZigBeePacket tx;
+                
+                tx.identifier = ZigBeePacket::ZBPID_TxRequest;
+                tx.frame_id = 0;
+                tx.dest64 = pkt.src64;
+                tx.dest16 = pkt.src16;
+                tx.radius = 0;
+                tx.options = 0;
+                tx.data = data;
+                tx.build_packet();
+                
+                zb_int.send_packet(tx);
+        }
+        
+        uint32_t frames;
+        uint32_t bytes;
+        uint64_t first_timestamp;
+        uint64_t last_timestamp;
+        ZigBeeInterface &zb_int;
+        ZigBeeTransport transport;
+};
+
+/** Pinger end
+ * 
+ * Runs the ping and throughput phases for each payload size in turn.
+ */
+class Pinger : public sigc::trackable
+{
+public:
+        /**
+         * Test phase.
+         */
+        typedef enum
+        {
+                PP_Ping = 0,            ///< Timing round trips
+                PP_Burst = 1,           ///< Sending throughput frames
+                PP_Report = 2,          ///< Waiting for the echo end's count
+        }
+        PingPhase;
+        
+        Pinger(ZigBeeInterface &zb, Glib::RefPtr<Glib::MainLoop> l) :
+                dest64(0),
+                dest16(0xfffe),
+                count(PING_DEFAULT_COUNT),
+                burst(PING_DEFAULT_BURST),
+                window(PING_DEFAULT_WINDOW),
+                timeout(PING_DEFAULT_TIMEOUT_MS),
+                size_index(0),
+                zb_int(zb),
+                loop(l)
+        {
+                zb_int.signal_receive_packet().connect( sigc::mem_fun(*this, &Pinger::on_receive_packet) );
+                zb_int.signal_write_high_water().connect( sigc::mem_fun(*this, &Pinger::on_write_high_water) );
+        }
+        
+        /**
+         * Start the first payload size.
+         */
+        void start()
+        {
+                c_poll = Glib::signal_timeout().connect( sigc::mem_fun(*this, &Pinger::on_poll), PING_POLL_MS );
+                start_size();
+        }
+        
+        std::vector<int> sizes;                 ///< Payload sizes
+        uint64_t dest64;                        ///< Echo end 64-bit address
+        uint16_t dest16;                        ///< Echo end 16-bit address
+        int count;                              ///< Pings per size
+        int burst;                              ///< Throughput frames per size
+        int window;                             ///< Unacknowledged throughput frames
+        int timeout;                            ///< Timeout in milliseconds
+        
+protected:
+        /**
+         * Compile a frame for the current size.
+         * @param type payload type byte
+         * @param len payload length
+         * @return template
+         */
+        ZigBeePacketTemplate make_template(uint8_t type, int len)
+        {
+                ZigBeePacket pkt;
+                
+                pkt.identifier = ZigBeePacket::ZBPID_TxRequest;
+                pkt.frame_id = 1;
+                pkt.dest64 = dest64;
+                pkt.dest16 = dest16;
+                pkt.radius = 0;
+                pkt.options = 0;
+                pkt.data.assign(len, 0);
+                pkt.data[0] = type;
+                
+                // recognizable filler after the header
+                for (int i = PING_HEADER_LEN; i < len; i++)
+                        pkt.data[i] = i;
+                
+                return ZigBeePacketTemplate(pkt);
+        }
+        
+        /**
+         * Send a frame with a sequence number.
+         * @param tmpl template
+         * @param s sequence number
+         * @return frame ID used
+         */
+        uint8_t send(ZigBeePacketTemplate &tmpl, uint32_t s)
+        {
+                uint8_t b[4];
+                uint8_t id = zb_int.get_next_frame_id();
+                
+                put_uint32(b, s);
+                tmpl.set_data(1, b, 4);
+                tmpl.set_frame_id(id);
+                
+                zb_int.send_template(tmpl);
+                
+                return id;
+        }
+        
+        /**
+         * Reset and start the ping phase for the current size.
+         */
+        void start_size()
+        {
+                int len = sizes[size_index];
+                
+                ping_tmpl = make_template('P', len);
+                burst_tmpl = make_template('T', len);
+                end_tmpl = make_template('E', PING_HEADER_LEN);
+                
+                rtt.reset();
+                seq = 0;
+                lost = 0;
+                burst_sent = 0;
+                burst_acked = 0;
+                burst_failed = 0;
+                in_flight = 0;
+                for (int i = 0; i < 256; i++)
+                        burst_ids[i] = false;
+                
+                phase = PP_Ping;
+                
+                if (count > 0)
+                        send_ping();
+                else
+                        start_burst();
+        }
+        
+        /**
+         * Send the next ping.
+         */
+        void send_ping()
+        {
+                ping_timestamp = SerialInterface::get_timestamp();
+                send(ping_tmpl, seq);
+        }
+        
+        /**
+         * Move on from a ping, answered or not.
+         */
+        void next_ping()
+        {
+                if (++seq < (uint32_t)count)
+                        send_ping();
+                else
+                        start_burst();
+        }
+        
+        /**
+         * Start the throughput phase.
+         */
+        void start_burst()
+        {
+                if (burst <= 0)
+                {
+                        finish_size(false);
+                        return;
+                }
+                
+                phase = PP_Burst;
+                burst_timestamp = SerialInterface::get_timestamp();
+                pump();
+        }
+        
+        /**
+         * Send throughput frames up to the window.
+         */
+        void pump()
+        {
+                while (phase == PP_Burst && burst_sent < burst && in_flight < window && !zb_int.is_write_blocked())
+                {
+                        burst_ids[send(burst_tmpl, burst_sent)] = true;
+                        burst_sent++;
+                        in_flight++;
+                        poll_timestamp = SerialInterface::get_timestamp();
+                }
+                
+                if (phase == PP_Burst && burst_sent == burst && in_flight == 0)
+                {
+                        burst_end_timestamp = SerialInterface::get_timestamp();
+                        phase = PP_Report;
+                        report_timestamp = burst_end_timestamp;
+                        send(end_tmpl, 0);
+                }
+        }
+        
+        /**
+         * Print results for the current size and move on.
+         * @param report true if the echo end reported
+         */
+        void finish_size(bool report)
+        {
+                int len = sizes[size_index];
+                
+                std::cout << std::endl << "payload " << len << " bytes: " << count << " pings, "
+                        << rtt.get_count() << " answered, " << lost << " lost" << std::endl;
+                
+                if (rtt.get_count())
+                {
+                        static const double percentiles[] = {0, 50, 75, 90, 95, 99, 99.9, 100};
+                        
+                        std::cout << "  RTT " << rtt.get_desc() << std::endl;
+                        std::cout << "  " << std::setw(10) << "percentile" << std::setw(12) << "RTT (ms)" << std::endl;
+                        
+                        for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++)
+                        {
+                                uint64_t v = percentiles[i] == 0 ? rtt.get_min() :
+                                        percentiles[i] == 100 ? rtt.get_max() : rtt.get_percentile(percentiles[i]);
+                                std::cout << "  " << std::fixed << std::setprecision(3) << std::setw(10) << percentiles[i]
+                                        << std::setw(12) << v / 1000.0 << std::endl;
+                        }
+                }
+                
+                if (burst > 0)
+                {
+                        double secs = (burst_end_timestamp - burst_timestamp) / 1e6;
+                        
+                        if (secs <= 0)
+                                secs = 1e-6;
+                        
+                        std::cout << std::setprecision(1) << "  sender: " << burst_acked << " of " << burst_sent
+                                << " frames acknowledged, " << burst_failed << " failed, "
+                                << burst_acked / secs << " frames/s, " << burst_acked * len / secs << " bytes/s" << std::endl;
+                        
+                        if (report)
+                        {
+                                double rsecs = report_elapsed / 1e6;
+                                std::cout << "  receiver: " << report_frames << " frames, " << report_bytes << " bytes";
+                                if (report_frames > 1 && rsecs > 0)
+                                        std::cout << " in " << std::setprecision(3) << rsecs << " s, "
+                                                << std::setprecision(1) << (report_frames - 1) / rsecs << " frames/s, "
+                                                << report_bytes * (report_frames - 1.0) / report_frames / rsecs << " bytes/s";
+                                std::cout << std::endl;
+                        }
+                        else
+                        {
+                                std::cout << "  receiver: no report (needs zigbee-ping -e at the far end)" << std::endl;
+                        }
+                }
+                
+                if (++size_index < sizes.size())
+                {
+                        start_size();
+                        return;
+                }
+                
+                c_poll.disconnect();
+                loop->quit();
+        }
+        
+        /**
+         * Receive packet handler.
+         * @param pkt packet
+         */
+        void on_receive_packet(ZigBeePacket pkt)
+        {
+                if (pkt.identifier == ZigBeePacket::ZBPID_TxStatusS2)
+                {
+                        if (!burst_ids[pkt.frame_id])
+                                return;
+                        
+                        burst_ids[pkt.frame_id] = false;
+                        in_flight--;
+                        
+                        if (pkt.delivery_status == 0)
+                                burst_acked++;
+                        else
+                                burst_failed++;
+                        
+                        pump();
+                        return;
+                }
+                
+                if (pkt.identifier != ZigBeePacket::ZBPID_RxPacket || pkt.src64 != dest64 ||
+                        pkt.data.size() < PING_HEADER_LEN)
+                        return;
+                
+                if (phase == PP_Ping && (pkt.data[0] == 'p' || pkt.data[0] == 'P') &&
+                        get_uint32(&pkt.data[1]) == seq)
+                {
+                        rtt.record(get_rx_timestamp(pkt) - ping_timestamp);
+                        next_ping();
+                }
+                else if (phase == PP_Report && pkt.data[0] == 'e' && pkt.data.size() >= 13)
+                {
+                        report_frames = get_uint32(&pkt.data[1]);
+                        report_bytes = get_uint32(&pkt.data[5]);
+                        report_elapsed = get_uint32(&pkt.data[9]);
+                        finish_size(true);
+                }
+        }
+        
+        /**
+         * Write high water handler.
+         * @param blocked true if blocked
+         */
+        void on_write_high_water(bool blocked)
+        {
+                if (!blocked)
+                        pump();
+        }
+        
+        /**
+         * Poll timer handler, for timeouts.
+         * @return true to keep running
+         */
+        bool on_poll()
+        {
+                uint64_t now = SerialInterface::get_timestamp();
+                uint64_t limit = (uint64_t)timeout * 1000;
+                
+                if (phase == PP_Ping && now - ping_timestamp > limit)
+                {
+                        lost++;
+                        next_ping();
+                }
+                else if (phase == PP_Burst && in_flight > 0 && now - poll_timestamp > limit)
+                {
+                        // transmit status never came; give up on those frames
+                        for (int i = 0; i < 256; i++)
+                                burst_ids[i] = false;
+                        burst_failed += in_flight;
+                        in_flight = 0;
+                        pump();
+                }
+                else if (phase == PP_Report && now - report_timestamp > limit)
+                {
+                        finish_size(false);
+                }
+                
+                return true;
+        }
+        
+        size_t size_index;
+        PingPhase phase;
+        ZigBeePacketTemplate ping_tmpl;
+        ZigBeePacketTemplate burst_tmpl;
+        ZigBeePacketTemplate end_tmpl;
+        LatencyHistogram rtt;
+        uint32_t seq;
+        int lost;
+        uint64_t ping_timestamp;
+        int burst_sent;
+        int burst_acked;
+        int burst_failed;
+        int in_flight;
+        bool burst_ids[256];
+        uint64_t burst_timestamp;
+        uint64_t burst_end_timestamp;
+        uint64_t poll_timestamp;
+        uint64_t report_timestamp;
+        uint32_t report_frames;
+        uint32_t report_bytes;
+        uint32_t report_elapsed;
+        ZigBeeInterface &zb_int;
+        Glib::RefPtr<Glib::MainLoop> loop;
+        sigc::connection c_poll;
+};
+
+/** Transfer end
+ * 
+ * Sends fragmented messages of each size in turn through ZigBeeTransport
+ * and reports the time from first fragment to last transmit status.
+ */
+class Transfer : public sigc::trackable
+{
+public:
+        Transfer(ZigBeeInterface &zb, Glib::RefPtr<Glib::MainLoop> l) :
+                dest64(0),
+                dest16(0xfffe),
+                window(ZIGBEE_TRANSPORT_DEFAULT_WINDOW),
+                count(PING_DEFAULT_TRANSFERS),
+                size_index(0),
+                transport(zb),
+                loop(l)
+        {
+                transport.signal_send_complete().connect( sigc::mem_fun(*this, &Transfer::on_send_complete) );
+        }
+        
+        /**
+         * Start the first size.
+         */
+        void start()
+        {
+                transport.set_window(window);
+                start_size();
+        }
+        
+        std::vector<int> sizes;                 ///< Message sizes
+        uint64_t dest64;                        ///< Echo end 64-bit address
+        uint16_t dest16;                        ///< Echo end 16-bit address
+        int window;                             ///< Fragments outstanding
+        int count;                              ///< Transfers per size
+        
+protected:
+        /**
+         * Reset counters and queue the transfers for the current size.
+         */
+        void start_size()
+        {
+                std::vector<uint8_t> msg(sizes[size_index]);
+                
+                for (size_t i = 0; i < msg.size(); i++)
+                        msg[i] = transfer_pattern(i);
+                
+                done = 0;
+                failed = 0;
+                total_bytes = 0;
+                total_elapsed = 0;
+                elapsed.reset();
+                
+                // the transport sends queued messages back to back
+                for (int i = 0; i < count; i++)
+                        transport.send(dest64, dest16, msg);
+        }
+        
+        /**
+         * Print results for the current size and move on.
+         */
+        void finish_size()
+        {
+                int len = sizes[size_index];
+                int frag = transport.get_max_payload() - ZIGBEE_TRANSPORT_HEADER_LENGTH;
+                
+                std::cout << std::endl << "transfer " << len << " bytes: " << (len + frag - 1) / frag << " fragments, "
+                        << count - failed << " of " << count << " delivered" << std::endl;
+                
+                if (elapsed.get_count())
+                {
+                        std::cout << "  time " << elapsed.get_desc() << std::endl;
+                        std::cout << std::fixed << std::setprecision(1) << "  " << total_bytes / (total_elapsed / 1e6) << " bytes/s" << std::endl;
+                }
+                
+                if (++size_index < sizes.size())
+                {
+                        start_size();
+                        return;
+                }
+                
+                loop->quit();
+        }
+        
+        /**
+         * Send complete handler.
+         * @param msg_id message ID
+         * @param success true if every fragment was delivered
+         * @param bytes message size
+         * @param us time from first fragment to last status
+         */
+        void on_send_complete(int msg_id, bool success, size_t bytes, uint64_t us)
+        {
+                if (success && us > 0)
+                {
+                        elapsed.record(us);
+                        total_bytes += bytes;
+                        total_elapsed += us;
+                }
+                else
+                {
+                        failed++;
+                }
+                
+                if (++done == count)
+                        finish_size();
+        }
+        
+        size_t size_index;
+        int done;
+        int failed;
+        uint64_t total_bytes;
+        uint64_t total_elapsed;
+        LatencyHistogram elapsed;
+        ZigBeeTransport transport;
+        Glib::RefPtr<Glib::MainLoop> loop;
+};
+
+// Parse a comma separated list of sizes
+static bool parse_sizes(std::string str, std::vector<int> &sizes, int min, int max)
+{
+        std::stringstream ss(str);
+        std::string item;
+        
+        sizes.clear();
+        
+        while (std::getline(ss, item, ','))
+        {
+                int n = atoi(item.c_str());
+                
+                if (n < min || n > max)
+                        return false;
+                
+                sizes.push_back(n);
+        }
+        
+        return sizes.size() > 0;
+}
+
+// Parse 64-bit[,16-bit] hex address
+static bool parse_address(std::string str, uint64_t &addr64, uint16_t &addr16)
+{
+        size_t comma = str.find(',');
+        std::string a64 = str.substr(0, comma);
+        char *end;
+        
+        addr64 = strtoull(a64.c_str(), &end, 16);
+        if (a64.empty() || *end)
+                return false;
+        
+        addr16 = 0xfffe;
+        
+        if (comma != std::string::npos)
+        {
+                std::string a16 = str.substr(comma + 1);
+                addr16 = strtoul(a16.c_str(), &end, 16);
+                if (a16.empty() || *end)
+                        return false;
+        }
+        
+        return true;
+}
+
+int main(int argc, char *argv[])
+{
+        bool echo = false;
+        unsigned long baud = 115200;
+        bool hw_flow = false;
+        std::vector<int> sizes;
+        int count = PING_DEFAULT_COUNT;
+        int burst = PING_DEFAULT_BURST;
+        int window = PING_DEFAULT_WINDOW;
+        int timeout = PING_DEFAULT_TIMEOUT_MS;
+        std::vector<int> transfer_sizes;
+        int transfers = PING_DEFAULT_TRANSFERS;
+        uint64_t dest64 = 0;
+        uint16_t dest16 = 0xfffe;
+        int c;
+        
+        parse_sizes("8,32,64,84", sizes, PING_HEADER_LEN, PING_MAX_PAYLOAD);
+        
+        while ((c = getopt(argc, argv, "eb:Hs:n:t:w:T:x:r:")) != -1)
+        {
+                switch (c)
+                {
+                        case 'e': echo = true; break;
+                        case 'b': baud = strtoul(optarg, 0, 10); break;
+                        case 'H': hw_flow = true; break;
+                        case 's':
+                                if (!parse_sizes(optarg, sizes, PING_HEADER_LEN, PING_MAX_PAYLOAD))
+                                {
+                                        std::cerr << "Sizes must be " << PING_HEADER_LEN << " to " << PING_MAX_PAYLOAD << std::endl;
+                                        return 1;
+                                }
+                                break;
+                        case 'n': count = atoi(optarg); break;
+                        case 't': burst = atoi(optarg); break;
+                        case 'w': window = atoi(optarg); break;
+                        case 'T': timeout = atoi(optarg); break;
+                        case 'x':
+                                if (!parse_sizes(optarg, transfer_sizes, 1, PING_MAX_TRANSFER))
+                                {
+                                        std::cerr << "Transfer sizes must be 1 to " << PING_MAX_TRANSFER << std::endl;
+                                        return 1;
+                                }
+                                break;
+                        case 'r': transfers = atoi(optarg); break;
+                        default:
+                                usage(argv[0]);
+                                return 1;
+                }
+        }
+        
+        if (argc - optind != (echo ? 1 : 2) || baud == 0 || count < 0 || burst < 0 || window < 1 || window > 255 || timeout <= 0 || transfers < 1)
+        {
+                usage(argv[0]);
+                return 1;
+        }
+        
+        if (!echo && !parse_address(argv[optind + 1], dest64, dest16))
+        {
+                std::cerr << "Bad destination address " << argv[optind + 1] << std::endl;
+                return 1;
+        }
+        
+        std::string port = argv[optind];
+        
+        if(!Glib::thread_supported()) Glib::thread_init();
+        
+        Glib::RefPtr<Glib::MainLoop> loop = Glib::MainLoop::create();
+        
+        std::tr1::shared_ptr<SerialInterface> ser_int(new SerialInterface());
+        ZigBeeInterface zb_int;
+        
+        ser_int->set_port(port);
+        ser_int->set_baud(baud);
+        ser_int->set_flow(hw_flow ? SerialInterface::SF_Hardware : SerialInterface::SF_None);
+        ser_int->set_latency(SerialInterface::SL_LowLatency);
+        
+        zb_int.set_serial_interface(ser_int);
+        
+        if (ser_int->open_port() != SerialInterface::SS_Success)
+        {
+                std::cerr << "Cannot open " << port << std::endl;
+                return 1;
+        }
+        
+        if (echo)
+        {
+                Echo e(zb_int);
+                
+                std::cout << "Echoing on " << port << std::endl;
+                
+                loop->run();
+        }
+        else if (transfer_sizes.size() > 0)
+        {
+                Transfer t(zb_int, loop);
+                
+                t.sizes = transfer_sizes;
+                t.dest64 = dest64;
+                t.dest16 = dest16;
+                t.window = window;
+                t.count = transfers;
+                
+                std::cout << "Sending to " << std::hex << std::setfill('0') << std::setw(16) << dest64
+                        << std::dec << std::setfill(' ') << " on " << port << std::endl;
+                
+                t.start();
+                
+                loop->run();
+        }
+        else
+        {
+                Pinger p(zb_int, loop);
+                
+                p.sizes = sizes;
+                p.dest64 = dest64;
+                p.dest16 = dest16;
+                p.count = count;
+                p.burst = burst;
+                p.window = window;
+                p.timeout = timeout;
+                
+                std::cout << "Pinging " << std::hex << std::setfill('0') << std::setw(16) << dest64
+                        << std::dec << std::setfill(' ') << " on " << port << std::endl;
+                
+                p.start();
+                
+                loop->run();
+        }
+        
+        ser_int->close_port();
+        
+        return 0;
+}
@@ -0,0 +1,519 @@
+/************************************************************************/
+/* zigbee_send                                                          */
+/*                                                                      */
+/* ZigBee Terminal - Packet Sender                                      */
+/*                                                                      */
+/* zigbee_send.cpp                                                      */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "SerialInterface.h"
+#include "ZigBeePacket.h"
+#include "ZigBeePacketTemplate.h"
+#include "ZigBeeInterface.h"
+#include "ZigBeeStats.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <inttypes.h>
+#include <unistd.h>
+
+/*
+ * Headless packet sender.  Reads API frames from a file and sends them
+ * through ZigBeeInterface as fast as the port takes them, or at a target
+ * rate, then reports throughput, transmit status success and send to
+ * transmit status latency.  Only the core sources are linked; the GTK
+ * terminal is not started.
+ * 
+ * Hex files hold one frame per line, either a complete frame starting
+ * with 7E or just the frame data starting at the API identifier.  Blank
+ * lines and lines starting with # are skipped.  Binary files (.bin) hold
+ * complete unescaped frames back to back.
+ * 
+ * Usage: zigbee-send [options] port file
+ */
+
+#define SEND_PROGRESS_MS 1000
+#define SEND_TICK_MS 1
+#define SEND_DEFAULT_WAIT_MS 2000
+#define SEND_IDLE_BATCH 64
+
+static void usage(const char *name)
+{
+        std::cerr << "Usage: " << name << " [options] port file" << std::endl
+                << "  -b baud     baud rate (default 115200)" << std::endl
+                << "  -H          hardware flow control" << std::endl
+                << "  -r pps      target frames per second (default 0, as fast as possible)" << std::endl
+                << "  -n count    send the file count times (default 1)" << std::endl
+                << "  -f format   file format, hex or bin (default from file name)" << std::endl
+                << "  -k          keep frame IDs from the file instead of renumbering" << std::endl
+                << "  -w ms       wait for outstanding transmit status (default 2000)" << std::endl
+                << "  -q          no progress output" << std::endl;
+}
+
+/**
+ * Read complete frames from a byte buffer.
+ * @param buf buffer
+ * @param pkts decoded frames are appended here
+ * @return false on a bad frame
+ */
+static bool read_frames(std::vector<uint8_t> &buf, std::vector<ZigBeePacket> &pkts)
+{
+        size_t pos = 0;
+        
+        while (pos < buf.size())
+        {
+                ZigBeePacket pkt;
+                size_t n = 0;
+                
+                if (!pkt.read_packet(&buf[pos], buf.size() - pos, n) || !pkt.decode_packet())
+                {
+                        std::cerr << "Bad frame at byte " << pos + n << std::endl;
+                        return false;
+                }
+                
+                pkts.push_back(pkt);
+                pos += n;
+        }
+        
+        return true;
+}
+
+/**
+ * Load frames from a hex file.
+ * @param filename file name
+ * @param pkts frames
+ * @return false on error
+ */
+static bool load_hex(const char *filename, std::vector<ZigBeePacket> &pkts)
+{
+        std::ifstream f(filename);
+        std::string line;
+        int line_num = 0;
+        
+        if (!f)
+        {
+                std::cerr << "Cannot open " << filename << std::endl;
+                return false;
+        }
+        
+        while (std::getline(f, line))
+        {
+                std::vector<uint8_t> bytes;
+                size_t k = line.find_first_not_of(" \t\r");
+                
+                line_num++;
+                
+                if (k == std::string::npos || line[k] == '#')
+                        continue;
+                
+                if (!ZigBeePacket::parse_hex_bytes(line, bytes) || bytes.size() == 0)
+                {
+                        std::cerr << filename << ":" << line_num << ": bad hex" << std::endl;
+                        return false;
+                }
+                
+                if (bytes[0] == ZIGBEE_IDENTIFIER)
+                {
+                        if (!read_frames(bytes, pkts))
+                        {
+                                std::cerr << filename << ":" << line_num << ": bad frame" << std::endl;
+                                return false;
+                        }
+                }
+                else
+                {
+                        ZigBeePacket pkt;
+                        pkt.payload = bytes;
+                        
+                        if (!pkt.decode_packet())
+                        {
+                                std::cerr << filename << ":" << line_num << ": bad frame data" << std::endl;
+                                return false;
+                        }
+                        
+                        pkts.push_back(pkt);
+                }
+        }
+        
+        return true;
+}
+
+/**
+ * Load frames from a binary file.
+ * @param filename file name
+ * @param pkts frames
+ * @return false on error
+ */
+static bool load_bin(const char *filename, std::vector<ZigBeePacket> &pkts)
+{
+        std::ifstream f(filename, std::ios::binary);
+        std::vector<uint8_t> buf;
+        
+        if (!f)
+        {
+                std::cerr << "Cannot open " << filename << std::endl;
+                return false;
+        }
+        
+        buf.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+        
+        return read_frames(buf, pkts);
+}
+
+/** Packet sender
+ * 
+ * Feeds frames to the interface from the main loop.  At full rate frames
+ * are sent in batches from an idle handler until the serial write queue
+ * reaches its high water mark, then sending resumes when it drains.  At a target
+ * rate a 1 ms tick sends however many frames are due, so the average
+ * rate holds even though each tick is coarser than the frame interval.
+ */
+class Sender : public sigc::trackable
+{
+public:
+        Sender(ZigBeeInterface &zb, Glib::RefPtr<Glib::MainLoop> l) :
+                index(0),
+                total(0),
+                sent(0),
+                sent_bytes(0),
+                expected_status(0),
+                pps(0),
+                renumber(true),
+                quiet(false),
+                wait_ms(SEND_DEFAULT_WAIT_MS),
+                start_timestamp(0),
+                end_timestamp(0),
+                zb_int(zb),
+                loop(l)
+        {
+                zb_int.signal_write_high_water().connect( sigc::mem_fun(*this, &Sender::on_write_high_water) );
+        }
+        
+        /**
+         * Start sending.
+         */
+        void start()
+        {
+                start_timestamp = SerialInterface::get_timestamp();
+                
+                if (pps > 0)
+                        c_send = Glib::signal_timeout().connect( sigc::mem_fun(*this, &Sender::on_tick), SEND_TICK_MS );
+                else
+                        c_send = Glib::signal_idle().connect( sigc::mem_fun(*this, &Sender::on_idle) );
+                
+                if (!quiet)
+                        c_progress = Glib::signal_timeout().connect( sigc::mem_fun(*this, &Sender::on_progress), SEND_PROGRESS_MS );
+        }
+        
+        /**
+         * Print summary.
+         */
+        void report()
+        {
+                ZigBeeStats &stats = zb_int.get_stats();
+                uint64_t status = stats.get(ZigBeeStats::SC_TxStatus);
+                uint64_t failures = stats.get(ZigBeeStats::SC_TxStatusFailures);
+                double secs = (end_timestamp - start_timestamp) / 1e6;
+                
+                if (secs <= 0)
+                        secs = 1e-6;
+                
+                std::cout << std::fixed << std::setprecision(3);
+                std::cout << "Sent " << sent << " frames (" << sent_bytes << " bytes) in " << secs << " s" << std::endl;
+                std::cout << std::setprecision(1);
+                std::cout << "Throughput: " << sent / secs << " frames/s, " << sent_bytes / secs << " bytes/s" << std::endl;
+                
+                if (expected_status > 0)
+                {
+                        std::cout << "TX status: " << status << " of " << expected_status << " received, "
+                                << status - failures << " success (" << 100.0 * (status - failures) / expected_status << "%), "
+                                << failures << " failed" << std::endl;
+                        std::cout << "Latency: " << stats.get_histogram(ZigBeeStats::SH_SendToTxStatus).get_desc() << std::endl;
+                }
+                else
+                {
+                        std::cout << "TX status: no frames requested status" << std::endl;
+                }
+        }
+        
+        std::vector<ZigBeePacketTemplate> tmpls;        ///< Frames to send
+        size_t index;                           ///< Next frame
+        uint64_t total;                         ///< Frames to send in all
+        uint64_t sent;                          ///< Frames sent
+        uint64_t sent_bytes;                    ///< Bytes sent
+        uint64_t expected_status;               ///< Frames sent that request status
+        double pps;                             ///< Target rate, 0 for full rate
+        bool renumber;                          ///< Assign fresh frame IDs
+        bool quiet;                             ///< No progress output
+        int wait_ms;                            ///< Time to wait for status
+        uint64_t start_timestamp;               ///< Start time
+        uint64_t end_timestamp;                 ///< Last frame sent
+        
+protected:
+        /**
+         * Send the next frame.
+         */
+        void send_next()
+        {
+                ZigBeePacketTemplate &tmpl = tmpls[index];
+                
+                // patched in place, the frame is not rebuilt
+                if (renumber && tmpl.get_frame_id())
+                        tmpl.set_frame_id(zb_int.get_next_frame_id());
+                
+                if (tmpl.get_frame_id() && is_tx_request(tmpl.get_identifier()))
+                        expected_status++;
+                
+                zb_int.send_template(tmpl);
+                
+                sent++;
+                sent_bytes += tmpl.get_frame_size();
+                
+                if (++index == tmpls.size())
+                        index = 0;
+                
+                if (sent == total)
+                        finish();
+        }
+        
+        /**
+         * Check for frame types answered by a transmit status.
+         * @param identifier frame type
+         * @return true if transmit request
+         */
+        static bool is_tx_request(ZigBeePacket::ZBP_Identifier identifier)
+        {
+                return identifier == ZigBeePacket::ZBPID_TxRequest64 ||
+                        identifier == ZigBeePacket::ZBPID_TxRequest16 ||
+                        identifier == ZigBeePacket::ZBPID_TxRequest ||
+                        identifier == ZigBeePacket::ZBPID_EATxRequest;
+        }
+        
+        /**
+         * All frames sent; wait for outstanding status.
+         */
+        void finish()
+        {
+                end_timestamp = SerialInterface::get_timestamp();
+                c_send.disconnect();
+                c_wait = Glib::signal_timeout().connect( sigc::mem_fun(*this, &Sender::on_wait), SEND_TICK_MS * 10 );
+        }
+        
+        /**
+         * Idle handler, full rate.
+         * @return true to keep sending
+         */
+        bool on_idle()
+        {
+                // send in batches so received status frames get handled
+                for (int i = 0; i < SEND_IDLE_BATCH && sent < total && !zb_int.is_write_blocked(); i++)
+                        send_next();
+                
+                // resumed from the high water handler once blocked
+                return sent < total && !zb_int.is_write_blocked();
+        }
+        
+        /**
+         * Tick handler, target rate.
+         * @return true to keep timer running
+         */
+        bool on_tick()
+        {
+                uint64_t now = SerialInterface::get_timestamp();
+                uint64_t due = (uint64_t)((now - start_timestamp) * pps / 1e6) + 1;
+                
+                while (sent < due && sent < total && !zb_int.is_write_blocked())
+                        send_next();
+                
+                return sent < total;
+        }
+        
+        /**
+         * Write high water handler.
+         * @param blocked true if blocked
+         */
+        void on_write_high_water(bool blocked)
+        {
+                if (!blocked && pps <= 0 && sent < total && !c_send.connected())
+                        c_send = Glib::signal_idle().connect( sigc::mem_fun(*this, &Sender::on_idle) );
+        }
+        
+        /**
+         * Wait handler.
+         * @return true to keep waiting
+         */
+        bool on_wait()
+        {
+                uint64_t now = SerialInterface::get_timestamp();
+                
+                if (zb_int.get_stats().get(ZigBeeStats::SC_TxStatus) >= expected_status ||
+                        now - end_timestamp > (uint64_t)wait_ms * 1000)
+                {
+                        c_progress.disconnect();
+                        loop->quit();
+                        return false;
+                }
+                
+                return true;
+        }
+        
+        /**
+         * Progress handler.
+         * @return true to keep timer running
+         */
+        bool on_progress()
+        {
+                ZigBeeStats &stats = zb_int.get_stats();
+                
+                std::cerr << "sent " << sent << "/" << total
+                        << ", status " << stats.get(ZigBeeStats::SC_TxStatus)
+                        << ", failed " << stats.get(ZigBeeStats::SC_TxStatusFailures) << std::endl;
+                
+                return true;
+        }
+        
+        ZigBeeInterface &zb_int;
+        Glib::RefPtr<Glib::MainLoop> loop;
+        sigc::connection c_send;
+        sigc::connection c_wait;
+        sigc::connection c_progress;
+};
+
+int main(int argc, char *argv[])
+{
+        unsigned long baud = 115200;
+        bool hw_flow = false;
+        double pps = 0;
+        long count = 1;
+        std::string format;
+        bool renumber = true;
+        bool quiet = false;
+        int wait_ms = SEND_DEFAULT_WAIT_MS;
+        std::vector<ZigBeePacket> pkts;
+        int c;
+        
+        while ((c = getopt(argc, argv, "b:Hr:n:f:kw:q")) != -1)
+        {
+                switch (c)
+                {
+                        case 'b': baud = strtoul(optarg, 0, 10); break;
+                        case 'H': hw_flow = true; break;
+                        case 'r': pps = atof(optarg); break;
+                        case 'n': count = atol(optarg); break;
+                        case 'f': format = optarg; break;
+                        case 'k': renumber = false; break;
+                        case 'w': wait_ms = atoi(optarg); break;
+                        case 'q': quiet = true; break;
+                        default:
+                                usage(argv[0]);
+                                return 1;
+                }
+        }
+        
+        if (argc - optind != 2 || baud == 0 || count <= 0 || pps < 0 || wait_ms < 0)
+        {
+                usage(argv[0]);
+                return 1;
+        }
+        
+        std::string port = argv[optind];
+        std::string filename = argv[optind + 1];
+        
+        if (format.empty())
+                format = filename.size() > 4 && filename.substr(filename.size() - 4) == ".bin" ? "bin" : "hex";
+        
+        if (format == "bin")
+        {
+                if (!load_bin(filename.c_str(), pkts))
+                        return 1;
+        }
+        else if (format == "hex")
+        {
+                if (!load_hex(filename.c_str(), pkts))
+                        return 1;
+        }
+        else
+        {
+                usage(argv[0]);
+                return 1;
+        }
+        
+        if (pkts.size() == 0)
+        {
+                std::cerr << "No frames in " << filename << std::endl;
+                return 1;
+        }
+        
+        if(!Glib::thread_supported()) Glib::thread_init();
+        
+        Glib::RefPtr<Glib::MainLoop> loop = Glib::MainLoop::create();
+        
+        std::tr1::shared_ptr<SerialInterface> ser_int(new SerialInterface());
+        ZigBeeInterface zb_int;
+        
+        ser_int->set_port(port);
+        ser_int->set_baud(baud);
+        ser_int->set_flow(hw_flow ? SerialInterface::SF_Hardware : SerialInterface::SF_None);
+        
+        zb_int.set_serial_interface(ser_int);
+        
+        if (ser_int->open_port() != SerialInterface::SS_Success)
+        {
+                std::cerr << "Cannot open " << port << std::endl;
+                return 1;
+        }
+        
+        Sender sender(zb_int, loop);
+        
+        for (size_t i = 0; i < pkts.size(); i++)
+                sender.tmpls.push_back(ZigBeePacketTemplate(pkts[i]));
+        sender.total = (uint64_t)count * pkts.size();
+        sender.pps = pps;
+        sender.renumber = renumber;
+        sender.quiet = quiet;
+        sender.wait_ms = wait_ms;
+        
+        if (!quiet)
+                std::cerr << "Sending " << sender.total << " frames to " << port << std::endl;
+        
+        sender.start();
+        
+        loop->run();
+        
+        sender.report();
+        
+        ser_int->close_port();
+        
+        return 0;
+}